@@ -0,0 +1,92 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "accel_calibration.h"
+
+#define ONE_G_MG 1000.0f
+
+/// <summary>
+///     Works out the user offset registers from the mean accelerometer reading.
+/// </summary>
+/// <returns>0 on success, or -1 if an offset is above maxOffsetMg</returns>
+int accelCalibrationCompute(const float meanMg[3], float maxOffsetMg, accel_calibration_t *calibration)
+{
+	float biasMg[3];
+	float largestBiasMg = 0.0f;
+
+	calibration->valid = false;
+	calibration->gravityAxis = 0;
+	for (int axis = 1; axis < 3; axis++) {
+		if (fabsf(meanMg[axis]) > fabsf(meanMg[calibration->gravityAxis])) {
+			calibration->gravityAxis = axis;
+		}
+	}
+	calibration->gravityMg = (meanMg[calibration->gravityAxis] < 0.0f) ? -ONE_G_MG : ONE_G_MG;
+
+	for (int axis = 0; axis < 3; axis++) {
+		biasMg[axis] = meanMg[axis] - ((axis == calibration->gravityAxis) ? calibration->gravityMg : 0.0f);
+		if (fabsf(biasMg[axis]) > largestBiasMg) {
+			largestBiasMg = fabsf(biasMg[axis]);
+		}
+	}
+
+	if (largestBiasMg > maxOffsetMg) {
+		return -1;
+	}
+
+	// The registers are subtracted from the output, in two's complement between -127 and 127
+	float weightMg = ACCEL_OFFSET_1MG_WEIGHT_MG;
+	calibration->weight = LSM6DSO_LSb_1mg;
+	if (largestBiasMg > 127.0f * ACCEL_OFFSET_1MG_WEIGHT_MG) {
+		weightMg = ACCEL_OFFSET_16MG_WEIGHT_MG;
+		calibration->weight = LSM6DSO_LSb_16mg;
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		long value = lroundf(biasMg[axis] / weightMg);
+		if (value > 127) {
+			value = 127;
+		}
+		else if (value < -127) {
+			value = -127;
+		}
+		calibration->registers[axis] = (int8_t)value;
+		calibration->offsetMg[axis] = (float)value * weightMg;
+	}
+
+	calibration->valid = true;
+	return 0;
+}
+
+/// <summary>
+///     Records the mean reading taken with the offsets applied.
+/// </summary>
+void accelCalibrationResidual(accel_calibration_t *calibration, const float meanMg[3])
+{
+	for (int axis = 0; axis < 3; axis++) {
+		calibration->residualMg[axis] = meanMg[axis] - ((axis == calibration->gravityAxis) ? calibration->gravityMg : 0.0f);
+	}
+}
+
+/// <summary>
+///     Writes the calibration as a JSON object.
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int accelCalibrationToJson(const accel_calibration_t *calibration, char *buffer, size_t size)
+{
+	int written = snprintf(buffer, size,
+		"{\"success\":%s,\"axis\":\"%c\",\"weight\":\"%s\",\"registers\":[%d,%d,%d],\"offsetMg\":[%.2f,%.2f,%.2f],"
+		"\"stdDevMg\":[%.2f,%.2f,%.2f],\"residualMg\":[%.2f,%.2f,%.2f]}",
+		calibration->valid ? "true" : "false", "xyz"[calibration->gravityAxis],
+		(calibration->weight == LSM6DSO_LSb_16mg) ? "16mg" : "1mg",
+		calibration->registers[0], calibration->registers[1], calibration->registers[2],
+		calibration->offsetMg[0], calibration->offsetMg[1], calibration->offsetMg[2],
+		calibration->stdDevMg[0], calibration->stdDevMg[1], calibration->stdDevMg[2],
+		calibration->residualMg[0], calibration->residualMg[1], calibration->residualMg[2]);
+
+	return ((written < 0) || ((size_t)written >= size)) ? -1 : written;
+}
@@ -0,0 +1,50 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+
+// Weights of one X/Y/Z_OFS_USR LSB, 2^-10 g and 2^-6 g
+#define ACCEL_OFFSET_1MG_WEIGHT_MG 0.9765625f
+#define ACCEL_OFFSET_16MG_WEIGHT_MG 15.625f
+
+typedef struct {
+	bool valid;
+	// Axis gravity was found on, and the reading expected there, +1000 or -1000 mg
+	int gravityAxis;
+	float gravityMg;
+	// X/Y/Z_OFS_USR contents and their weight
+	lsm6dso_usr_off_w_t weight;
+	int8_t registers[3];
+	// Offsets the registers remove, after rounding to the weight
+	float offsetMg[3];
+	// Standard deviation during the capture the offsets were measured from
+	float stdDevMg[3];
+	// Mean reading minus the expected one once the offsets were written
+	float residualMg[3];
+} accel_calibration_t;
+
+/// <summary>
+///     Works out the user offset registers from the mean accelerometer reading, in mg, with the
+///     board lying still on one of its faces.  The axis with the largest reading is taken to
+///     carry 1 g and the other two 0 g.  The finest weight that can hold every offset is used.
+/// </summary>
+/// <returns>0 on success, or -1 if an offset is above maxOffsetMg, i.e. the board isn't flat</returns>
+int accelCalibrationCompute(const float meanMg[3], float maxOffsetMg, accel_calibration_t *calibration);
+
+/// <summary>
+///     Records the mean reading, in mg, taken with the offsets applied.
+/// </summary>
+void accelCalibrationResidual(accel_calibration_t *calibration, const float meanMg[3]);
+
+/// <summary>
+///     Writes the calibration as a JSON object, for example
+///     {"success":true,"axis":"z","weight":"1mg","registers":[-26,15,-41],"offsetMg":[-25.39,14.65,-40.04],
+///     "stdDevMg":[1.02,0.98,1.10],"residualMg":[0.21,-0.35,0.18]}
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int accelCalibrationToJson(const accel_calibration_t *calibration, char *buffer, size_t size);
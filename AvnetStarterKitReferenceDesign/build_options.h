@@ -28,5 +28,295 @@
 #define ACCEL_READ_PERIOD_SECONDS 1
 #define ACCEL_READ_PERIOD_NANO_SECONDS 0
 
-// Enables I2C read/write debug
-//#define ENABLE_READ_WRITE_DEBUG
\ No newline at end of file
+// Enables I2C bus statistics: per device and per register transaction counts, bytes, errors,
+// latency histograms and bus utilization.  The statistics are returned by the getI2cStats direct
+// method.  Nothing is recorded, and there is no overhead, when this is not defined.
+//#define ENABLE_I2C_STATS
+
+// Also send the I2C bus statistics as telemetry every I2C_STATS_TELEMETRY_PASSES sensor reads.
+// Requires ENABLE_I2C_STATS.
+//#define ENABLE_I2C_STATS_TELEMETRY
+#define I2C_STATS_TELEMETRY_PASSES 60
+
+// Size of the buffer the I2C statistics JSON is built in
+#define I2C_STATS_JSON_SIZE 1024
+
+#if (defined(ENABLE_I2C_STATS_TELEMETRY) && !defined(ENABLE_I2C_STATS))
+#error "ENABLE_I2C_STATS_TELEMETRY requires ENABLE_I2C_STATS."
+#endif
+
+// Enables FIFO based acquisition of the LSM6DSO accelerometer and gyroscope.  Samples are batched
+// in the device FIFO and drained with burst reads each time AccelTimerEventHandler runs.
+//#define ENABLE_LSM6DSO_FIFO
+
+// FIFO acquisition settings, the samples are batched at the output data rates below
+#define LSM6DSO_FIFO_WATERMARK 64
+
+// Accelerometer and gyroscope settings at startup.  They can be changed at runtime with the
+// accelOdrHz, accelFullScaleG, gyroOdrHz and gyroFullScaleDps device twin properties.  Values the
+// LSM6DSO doesn't support are rounded up, a gyroscope rate of 0 switches the gyroscope off.
+#ifdef ENABLE_LSM6DSO_FIFO
+#define IMU_ACCEL_ODR_HZ 104.0f
+#define IMU_GYRO_ODR_HZ 104.0f
+#else
+#define IMU_ACCEL_ODR_HZ 12.5f
+#define IMU_GYRO_ODR_HZ 12.5f
+#endif
+#define IMU_ACCEL_FULL_SCALE_G 4
+#define IMU_GYRO_FULL_SCALE_DPS 2000
+
+// Gyroscope calibration at startup.  IMU_GYRO_CAL_SAMPLES samples are batched in the FIFO at
+// IMU_GYRO_CAL_ODR_HZ and read in one burst, their mean is the offset.  A capture where the standard
+// deviation of an axis is above IMU_GYRO_CAL_MAX_STDDEV_DPS was taken while the board was moving and
+// is taken again.  After IMU_GYRO_CAL_TIMEOUT_MS the gyroscope is used without offsets.
+#define IMU_GYRO_CAL_SAMPLES 128
+#define IMU_GYRO_CAL_ODR_HZ 208.0f
+#define IMU_GYRO_CAL_MAX_STDDEV_DPS 0.5f
+#define IMU_GYRO_CAL_SETTLE_MS 100
+#define IMU_GYRO_CAL_TIMEOUT_MS 3000
+
+// Keeps the gyroscope calibration in the application's mutable storage, app_manifest.json must
+// grant MutableStorage.  At startup the stored offsets are used, and the calibration is skipped,
+// unless they are older than CALIBRATION_STORE_MAX_AGE_HOURS or were measured more than
+// CALIBRATION_STORE_MAX_DRIFT_DEGC away from the current LSM6DSO temperature.
+//#define ENABLE_CALIBRATION_STORE
+#define CALIBRATION_STORE_MAX_AGE_HOURS 168
+#define CALIBRATION_STORE_MAX_DRIFT_DEGC 5.0f
+
+// Keeps the calibration record in this file instead of mutable storage, for running on Linux
+//#define CALIBRATION_STORE_PATH "/tmp/calibration.bin"
+
+// Tracks the gyroscope offsets while running.  The gyroscope samples are taken in windows of
+// IMU_GYRO_BIAS_WINDOW_SAMPLES.  A window is taken as the board at rest when the accelerometer
+// standard deviation is below IMU_GYRO_BIAS_STILL_ACCEL_MG, the gyroscope standard deviation below
+// IMU_GYRO_BIAS_STILL_GYRO_DPS and the mean rate within IMU_GYRO_BIAS_MAX_RESIDUAL_DPS of the offsets.
+// Each such window moves the offsets towards its mean rate with weight IMU_GYRO_BIAS_GAIN.
+//#define ENABLE_GYRO_BIAS_TRACKING
+#define IMU_GYRO_BIAS_WINDOW_SAMPLES 64
+#define IMU_GYRO_BIAS_GAIN 0.05f
+#define IMU_GYRO_BIAS_STILL_ACCEL_MG 10.0f
+#define IMU_GYRO_BIAS_STILL_GYRO_DPS 0.5f
+#define IMU_GYRO_BIAS_MAX_RESIDUAL_DPS 1.0f
+
+// Also fits how the offsets change with the LSM6DSO temperature and follows the temperature between
+// still windows.  The fit weighs each still window with IMU_GYRO_BIAS_SLOPE_GAIN and is used once
+// the temperatures seen have a standard deviation of IMU_GYRO_BIAS_MIN_SPAN_DEGC.
+// Requires ENABLE_GYRO_BIAS_TRACKING.
+//#define ENABLE_GYRO_BIAS_TEMPERATURE
+#define IMU_GYRO_BIAS_SLOPE_GAIN 0.001f
+#define IMU_GYRO_BIAS_MIN_SPAN_DEGC 1.0f
+
+#if (defined(ENABLE_GYRO_BIAS_TEMPERATURE) && !defined(ENABLE_GYRO_BIAS_TRACKING))
+#error "ENABLE_GYRO_BIAS_TEMPERATURE requires ENABLE_GYRO_BIAS_TRACKING."
+#endif
+
+// Accelerometer calibration, run by the calibrateAccelerometer direct method with the board lying
+// still on one of its faces.  IMU_ACCEL_CAL_SAMPLES samples are batched in the FIFO at
+// IMU_ACCEL_CAL_ODR_HZ, their offsets from 0 g and 1 g are written to the LSM6DSO user offset
+// registers.  The calibration fails if the standard deviation is above IMU_ACCEL_CAL_MAX_STDDEV_MG
+// or an offset above IMU_ACCEL_CAL_MAX_OFFSET_MG.  With ENABLE_CALIBRATION_STORE the offsets are
+// also stored and written again at every start.
+#define IMU_ACCEL_CAL_SAMPLES 128
+#define IMU_ACCEL_CAL_ODR_HZ 417.0f
+#define IMU_ACCEL_CAL_SETTLE_MS 200
+#define IMU_ACCEL_CAL_MAX_STDDEV_MG 10.0f
+#define IMU_ACCEL_CAL_MAX_OFFSET_MG 150.0f
+
+// Size of the buffer the calibrateAccelerometer response is built in
+#define ACCEL_CALIBRATION_JSON_SIZE 256
+
+// Enables full scale auto-ranging.  At the end of each pass of AccelTimerEventHandler the range of
+// each sensor goes up if a sample came within IMU_AUTORANGE_UP_PERCENT of the rails, and down once
+// IMU_AUTORANGE_DOWN_PASSES passes in a row stayed below IMU_AUTORANGE_DOWN_PERCENT of the next
+// smaller range.  The device twin full scales then only set the starting ranges.
+//#define ENABLE_IMU_AUTORANGE
+#define IMU_AUTORANGE_UP_PERCENT 90
+#define IMU_AUTORANGE_DOWN_PERCENT 40
+#define IMU_AUTORANGE_DOWN_PASSES 5
+
+// Raw samples are converted to mg and dps in batches of this many, see imu_convert.h
+#define IMU_CONVERT_BATCH 32
+
+// Enables FIFO compression.  Up to three accelerometer or gyroscope samples are stored in one FIFO
+// word as differences from the previous sample, roughly halving the bytes read per sample for slowly
+// changing signals.  LSM6DSO_FIFO_COMPRESSION_RATE also sets how often an uncompressed word is forced,
+// which bounds how long decoding takes to recover after a FIFO overrun.  Requires ENABLE_LSM6DSO_FIFO.
+//#define ENABLE_LSM6DSO_FIFO_COMPRESSION
+#define LSM6DSO_FIFO_COMPRESSION_RATE LSM6DSO_CMP_16_TO_1
+
+#if (defined(ENABLE_LSM6DSO_FIFO_COMPRESSION) && !defined(ENABLE_LSM6DSO_FIFO))
+#error "ENABLE_LSM6DSO_FIFO_COMPRESSION requires ENABLE_LSM6DSO_FIFO."
+#endif
+
+// Enables hardware timestamps.  The LSM6DSO timestamp counter is batched into the FIFO every
+// LSM6DSO_TIMESTAMP_DECIMATION time slots, every sample gets its capture time from it and the
+// telemetry carries the UTC time of the newest sample.  The counter is read once per pass of
+// AccelTimerEventHandler to correct its drift against CLOCK_MONOTONIC.  Requires ENABLE_LSM6DSO_FIFO.
+//#define ENABLE_LSM6DSO_TIMESTAMP
+#define LSM6DSO_TIMESTAMP_DECIMATION LSM6DSO_DEC_1
+
+#if (defined(ENABLE_LSM6DSO_TIMESTAMP) && !defined(ENABLE_LSM6DSO_FIFO))
+#error "ENABLE_LSM6DSO_TIMESTAMP requires ENABLE_LSM6DSO_FIFO."
+#endif
+
+// Enables INT1 driven acquisition.  Data-ready (or the FIFO watermark when ENABLE_LSM6DSO_FIFO is
+// defined) is routed to the LSM6DSO INT1 pin and the device is read when INT1 asserts instead of on
+// every accelerometer timer tick.  LSM6DSO_INT1_GPIO must be wired to INT1 and added to the Gpio
+// capability in app_manifest.json.  If INT1 can't be opened the timer driven reads are used.
+//#define ENABLE_LSM6DSO_INT1
+#define LSM6DSO_INT1_GPIO AVNET_MT3620_SK_GPIO2
+
+// How often INT1 is sampled when the GPIO can't be registered with epoll
+#define LSM6DSO_INT1_POLL_PERIOD_NANO_SECONDS 5000000
+
+// Enables on-chip tap detection.  Each tap is sent as its own telemetry message, for example
+// {"tap":"double","axis":"z","sign":"-"}, as soon as it has been read.  With ENABLE_LSM6DSO_INT1 taps
+// are routed to INT1, otherwise the tap source is read every LSM6DSO_EVENT_POLL_PERIOD_NANO_SECONDS.
+// The tap engine needs the accelerometer at LSM6DSO_TAP_ODR_HZ or faster, the FIFO and the telemetry
+// keep the accelOdrHz rate (with ENABLE_LSM6DSO_INT1 and without ENABLE_LSM6DSO_FIFO data-ready does
+// assert at the faster rate).  The settings below are the startup values of the tapMode, tapAxes,
+// tapThresholdMg, tapShockMs, tapQuietMs and tapDurationMs device twin properties.  tapMode 0 switches
+// tap detection off, 1 detects single taps and 2 single and double taps.  tapAxes is a mask of 1 (X),
+// 2 (Y) and 4 (Z).  The threshold and windows are rounded to the steps the LSM6DSO supports.
+//#define ENABLE_LSM6DSO_TAP
+#define LSM6DSO_TAP_MODE 2
+#define LSM6DSO_TAP_AXES 7
+#define LSM6DSO_TAP_THRESHOLD_MG 500.0f
+#define LSM6DSO_TAP_SHOCK_MS 40.0f
+#define LSM6DSO_TAP_QUIET_MS 20.0f
+#define LSM6DSO_TAP_DURATION_MS 300.0f
+#define LSM6DSO_TAP_ODR_HZ 417.0f
+
+// Taps beyond this many per pass of AccelTimerEventHandler are counted but not sent
+#define LSM6DSO_TAP_MAX_MESSAGES_PER_PASS 10
+
+// How often the event sources are read when INT1 isn't in use
+#define LSM6DSO_EVENT_POLL_PERIOD_NANO_SECONDS 20000000
+
+// Enables activity gated telemetry.  Once the acceleration has stayed within the wake-up threshold
+// for the inactivity time the LSM6DSO drops to 12.5 Hz on its own (LSM6DSO_ACTIVITY_INACTIVE_MODE also
+// sets what happens to the gyroscope), the application stops the FIFO and the telemetry and runs
+// AccelTimerEventHandler every LSM6DSO_ACTIVITY_IDLE_PERIOD_SECONDS.  Full rate capture resumes when
+// the acceleration exceeds the threshold for LSM6DSO_ACTIVITY_WAKE_SAMPLES + 1 samples.  Each change
+// is sent as {"activity":"idle",...} or {"activity":"active",...} with the seconds, wakeups and
+// messages of the state that ended.  With ENABLE_LSM6DSO_INT1 the change is routed to INT1, otherwise
+// it is read once per pass of AccelTimerEventHandler, so waking up can take an idle period (with
+// ENABLE_LSM6DSO_INT1 and without ENABLE_LSM6DSO_FIFO data-ready keeps asserting at 12.5 Hz).  The
+// settings below are the startup values of the activityMode, activityThresholdMg and
+// activitySleepSeconds device twin properties, activityMode 0 switches the gating off.  The threshold
+// and inactivity time are rounded to the steps the LSM6DSO supports at the accelerometer rate.
+//#define ENABLE_LSM6DSO_ACTIVITY
+#define LSM6DSO_ACTIVITY_MODE 1
+#define LSM6DSO_ACTIVITY_THRESHOLD_MG 60.0f
+#define LSM6DSO_ACTIVITY_SLEEP_SECONDS 30.0f
+#define LSM6DSO_ACTIVITY_WAKE_SAMPLES 1
+#define LSM6DSO_ACTIVITY_INACTIVE_MODE LSM6DSO_XL_12Hz5_GY_PD
+#define LSM6DSO_ACTIVITY_IDLE_PERIOD_SECONDS 5
+
+// Enables drop and shock capture.  The most recent accelerometer samples drained from the FIFO are
+// kept in a fixed ring, see imu_capture.h.  When the LSM6DSO flags a free fall or, on its wake-up
+// engine, a shock the ring is frozen once IMU_CAPTURE_AFTER_MS more samples have come in and sent as
+// one message, for example {"capture":"freefall","rateHz":104.0,"before":104,"aX":[...],...} with
+// IMU_CAPTURE_BEFORE_MS of samples ahead of the event.  Triggers during a capture are counted but
+// don't start a new one.  Events are read like taps: routed to INT1 with ENABLE_LSM6DSO_INT1,
+// otherwise polled every LSM6DSO_EVENT_POLL_PERIOD_NANO_SECONDS.  The settings below are the startup
+// values of the captureMode, captureFreeFallMg, captureFreeFallMs, captureShockMg, captureBeforeMs and
+// captureAfterMs device twin properties.  captureMode is a mask of 1 (free fall) and 2 (shock), 0
+// switches capture off.  The windows are rounded to samples at accelOdrHz and share
+// IMU_CAPTURE_MAX_SAMPLES, the free-fall threshold is one of 156, 219, 250, 312, 344, 406, 469 or
+// 500 mg.  While ENABLE_LSM6DSO_ACTIVITY gating is on the wake-up engine belongs to it and shocks
+// aren't captured, nothing is captured while idle.  Requires ENABLE_LSM6DSO_FIFO.
+//#define ENABLE_IMU_CAPTURE
+#define IMU_CAPTURE_MODE 3
+#define IMU_CAPTURE_FREE_FALL_MG 312.0f
+#define IMU_CAPTURE_FREE_FALL_MS 50.0f
+#define IMU_CAPTURE_SHOCK_MG 3000.0f
+#define IMU_CAPTURE_SHOCK_SAMPLES 0
+#define IMU_CAPTURE_BEFORE_MS 1000.0f
+#define IMU_CAPTURE_AFTER_MS 500.0f
+
+// Size of the buffer a capture message is built in, enough for IMU_CAPTURE_MAX_SAMPLES at 16 g
+#define IMU_CAPTURE_JSON_SIZE 6144
+
+#if (defined(ENABLE_IMU_CAPTURE) && !defined(ENABLE_LSM6DSO_FIFO))
+#error "ENABLE_IMU_CAPTURE requires ENABLE_LSM6DSO_FIFO."
+#endif
+
+// Enables the LSM6DSO finite state machine program loader, see lsm6dso_fsm.h for the image
+// layout.  A program image is loaded at startup from LSM6DSO_FSM_IMAGE_HEX, when it is defined, and
+// at any time with the loadFsmProgram direct method, payload {"image":"<hexadecimal image>"}.  An
+// image with no programs, "00000000", stops them.  Every program that signals is sent as
+// {"fsm":3,"output":64} with its FSM_OUTS register, up to LSM6DSO_FSM_MAX_MESSAGES_PER_PASS per pass
+// of AccelTimerEventHandler.  Events are read like taps: routed to INT1 with ENABLE_LSM6DSO_INT1,
+// otherwise polled every LSM6DSO_EVENT_POLL_PERIOD_NANO_SECONDS.  The accelerometer is sampled at
+// least at the FSM rate of the image.  A loaded image doesn't survive a restart.
+//#define ENABLE_LSM6DSO_FSM
+//#define LSM6DSO_FSM_IMAGE_HEX "..."
+#define LSM6DSO_FSM_MAX_MESSAGES_PER_PASS 10
+
+// Size of the loadFsmProgram direct method response
+#define LSM6DSO_FSM_RESPONSE_JSON_SIZE 128
+
+// Enables orientation change events from the LSM6DSO 6D/4D orientation and tilt detectors, so the
+// orientation doesn't have to be worked out from the acceleration telemetry.  A change is sent as
+// {"orientation":"z+","tilt":false} as soon as it is read, the face being the axis that points up,
+// and a tilt (the board turned more than 35 degrees since the last one) as {"orientation":"x-","tilt":true}.
+// Events are read like taps: routed to INT1 with ENABLE_LSM6DSO_INT1, otherwise polled every
+// LSM6DSO_EVENT_POLL_PERIOD_NANO_SECONDS, which is within one sample up to 50 Hz.  Up to
+// LSM6DSO_ORIENTATION_MAX_MESSAGES_PER_PASS are sent per pass of AccelTimerEventHandler.  The
+// settings below are the startup values of the orientationMode, orientationThresholdDeg and
+// tiltMode device twin properties.  orientationMode 1 is 6D, 2 is 4D (portrait and landscape only)
+// and 0 off, the threshold is one of 50, 60, 70 or 80 degrees.  tiltMode 1 is on and 0 off, tilt
+// detection samples the accelerometer at LSM6DSO_TILT_ODR_HZ at least.
+//#define ENABLE_LSM6DSO_ORIENTATION
+#define LSM6DSO_ORIENTATION_MODE 1
+#define LSM6DSO_ORIENTATION_THRESHOLD_DEG 60.0f
+#define LSM6DSO_TILT_MODE 1
+#define LSM6DSO_TILT_ODR_HZ 26.0f
+#define LSM6DSO_ORIENTATION_MAX_MESSAGES_PER_PASS 10
+
+// Tap detection, activity gating, capture, the FSM and orientation share the LSM6DSO event sources
+#if (defined(ENABLE_LSM6DSO_TAP) || defined(ENABLE_LSM6DSO_ACTIVITY) || defined(ENABLE_IMU_CAPTURE) || \
+	defined(ENABLE_LSM6DSO_FSM) || defined(ENABLE_LSM6DSO_ORIENTATION))
+#define ENABLE_LSM6DSO_EVENTS
+#endif
+
+// Enables the LSM6DSO pedometer, see lsm6dso_pedometer.h.  Steps are counted on the device, with
+// ENABLE_LSM6DSO_FIFO every step is batched in the FIFO with its timestamp (the step rate comes from
+// these with ENABLE_LSM6DSO_TIMESTAMP), otherwise the step counter is read once per pass.  While the
+// pedometer is on the acceleration telemetry is replaced by {"steps":1234,"newSteps":52,"stepsPerMin":104.2},
+// sent every LSM6DSO_PEDOMETER_REPORT_PASSES passes of AccelTimerEventHandler that counted steps.  The
+// pedometer needs the accelerometer at 26 Hz or faster, slower accelOdrHz settings are batched at
+// their rate but sampled at 26 Hz.  LSM6DSO_PEDOMETER_MODE is the startup value of the pedometerMode
+// device twin property: 0 switches the pedometer off, 1 counts steps and 2 also rejects false steps.
+//#define ENABLE_LSM6DSO_PEDOMETER
+#define LSM6DSO_PEDOMETER_MODE 1
+#define LSM6DSO_PEDOMETER_REPORT_PASSES 10
+#define LSM6DSO_PEDOMETER_ODR_HZ 26.0f
+
+// Enables continuous sensor hub reads of the LPS22HH.  The sensor hub is configured once and every
+// pressure/temperature read is batched into the LSM6DSO FIFO with the accelerometer and gyroscope
+// samples, so the accelerometer is no longer switched off and on for each pressure read.
+// Requires ENABLE_LSM6DSO_FIFO.
+//#define ENABLE_SENSOR_HUB_FIFO
+#define SENSOR_HUB_FIFO_ODR LSM6DSO_SH_ODR_13Hz
+
+#if (defined(ENABLE_SENSOR_HUB_FIFO) && !defined(ENABLE_LSM6DSO_FIFO))
+#error "ENABLE_SENSOR_HUB_FIFO requires ENABLE_LSM6DSO_FIFO."
+#endif
+
+// Enables a write-through shadow of the LSM6DSO control registers.  The lsm6dso_*_set functions
+// read-modify-write their register, with the shadow the read is answered from memory and only the
+// write goes over I2C.  The number of bus transactions saved during initI2c is logged.
+//#define ENABLE_LSM6DSO_SHADOW
+
+// Enables the I2C request queue.  Register reads and writes are run by a worker thread so a slow
+// or NAKing device doesn't stall the epoll loop, the LSM6DSO temperature is read asynchronously
+// and completes through an eventfd registered with the epoll.
+//#define ENABLE_I2C_QUEUE
+
+// Replaces the I2C bus with a register level model of the LSM6DSO and the LPS22HH on its sensor
+// hub, see i2c_sim.h.  The application runs without the sensors fitted, every transaction goes to
+// the model instead of ISU2.  The host build in host/ runs the same model on Linux behind the
+// I2CMaster_* functions.
+//#define ENABLE_I2C_SIMULATOR
\ No newline at end of file
@@ -0,0 +1,206 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+#include <applibs/storage.h>
+
+#include "build_options.h"
+#include "calibration_store.h"
+
+// "GCAL", little endian
+#define RECORD_MAGIC 0x4C414347u
+
+// Magic, version and payload length
+#define RECORD_HEADER_SIZE 6
+// Flags, time, temperature, the three gyroscope offsets, the accelerometer offset weight and the
+// three accelerometer offsets
+#define RECORD_PAYLOAD_SIZE (1 + 8 + 4 + 3 * 4 + 1 + 3)
+#define RECORD_CRC_SIZE 4
+#define RECORD_SIZE (RECORD_HEADER_SIZE + RECORD_PAYLOAD_SIZE + RECORD_CRC_SIZE)
+
+/// <summary>
+///     CRC-32 (IEEE 802.3) of a buffer.
+/// </summary>
+static uint32_t Crc32(const uint8_t *data, size_t len)
+{
+	uint32_t crc = 0xFFFFFFFFu;
+
+	for (size_t i = 0; i < len; i++) {
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+		}
+	}
+
+	return ~crc;
+}
+
+/// <summary>
+///     Little endian field helpers, the record layout doesn't depend on structure packing.
+/// </summary>
+static uint8_t *PutBytes(uint8_t *p, uint64_t value, int len)
+{
+	for (int i = 0; i < len; i++) {
+		*p++ = (uint8_t)(value >> (8 * i));
+	}
+	return p;
+}
+
+static const uint8_t *GetBytes(const uint8_t *p, uint64_t *value, int len)
+{
+	*value = 0;
+	for (int i = 0; i < len; i++) {
+		*value |= (uint64_t)*p++ << (8 * i);
+	}
+	return p;
+}
+
+static uint8_t *PutFloat(uint8_t *p, float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(bits));
+	return PutBytes(p, bits, 4);
+}
+
+static const uint8_t *GetFloat(const uint8_t *p, float *value)
+{
+	uint64_t bits;
+	p = GetBytes(p, &bits, 4);
+	uint32_t bits32 = (uint32_t)bits;
+	memcpy(value, &bits32, sizeof(*value));
+	return p;
+}
+
+/// <summary>
+///     Opens the file the record is kept in.
+/// </summary>
+/// <returns>The file descriptor, or -1 on failure</returns>
+static int OpenStore(void)
+{
+#ifdef CALIBRATION_STORE_PATH
+	int fd = open(CALIBRATION_STORE_PATH, O_RDWR | O_CREAT, 0644);
+#else
+	int fd = Storage_OpenMutableFile();
+#endif
+	if (fd < 0) {
+		Log_Debug("ERROR: Could not open the calibration store: errno=%d (%s)\n", errno, strerror(errno));
+	}
+	return fd;
+}
+
+/// <summary>
+///     Reads and validates the calibration record.
+/// </summary>
+/// <returns>0 if a valid record was read, or -1 if there is none or it's corrupt</returns>
+int calibrationStoreLoad(calibration_record_t *record)
+{
+	uint8_t buffer[RECORD_SIZE];
+
+	int fd = OpenStore();
+	if (fd < 0) {
+		return -1;
+	}
+
+	ssize_t bytesRead = -1;
+	if (lseek(fd, 0, SEEK_SET) == 0) {
+		bytesRead = read(fd, buffer, sizeof(buffer));
+	}
+	close(fd);
+
+	if (bytesRead != (ssize_t)sizeof(buffer)) {
+		// A new device, or storage that was cleared, has no record
+		return -1;
+	}
+
+	uint64_t magic, version, length, crc;
+	const uint8_t *p = GetBytes(buffer, &magic, 4);
+	p = GetBytes(p, &version, 1);
+	p = GetBytes(p, &length, 1);
+	if ((magic != RECORD_MAGIC) || (version != CALIBRATION_STORE_VERSION) || (length != RECORD_PAYLOAD_SIZE)) {
+		Log_Debug("Calibration store: unknown record format\n");
+		return -1;
+	}
+
+	GetBytes(&buffer[RECORD_HEADER_SIZE + RECORD_PAYLOAD_SIZE], &crc, 4);
+	if (crc != Crc32(buffer, RECORD_HEADER_SIZE + RECORD_PAYLOAD_SIZE)) {
+		Log_Debug("Calibration store: record is corrupt\n");
+		return -1;
+	}
+
+	uint64_t value;
+	p = GetBytes(p, &value, 1);
+	record->flags = (uint8_t)value;
+	p = GetBytes(p, &value, 8);
+	record->timeUtc = (int64_t)value;
+	p = GetFloat(p, &record->temperatureDegC);
+	for (int axis = 0; axis < 3; axis++) {
+		p = GetFloat(p, &record->gyroBiasDps[axis]);
+	}
+	p = GetBytes(p, &value, 1);
+	record->accelOffsetWeight = (uint8_t)value;
+	for (int axis = 0; axis < 3; axis++) {
+		p = GetBytes(p, &value, 1);
+		record->accelOffset[axis] = (int8_t)(uint8_t)value;
+	}
+
+	return 0;
+}
+
+/// <summary>
+///     Writes the calibration record.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int calibrationStoreSave(const calibration_record_t *record)
+{
+	uint8_t buffer[RECORD_SIZE];
+
+	uint8_t *p = PutBytes(buffer, RECORD_MAGIC, 4);
+	p = PutBytes(p, CALIBRATION_STORE_VERSION, 1);
+	p = PutBytes(p, RECORD_PAYLOAD_SIZE, 1);
+	p = PutBytes(p, record->flags, 1);
+	p = PutBytes(p, (uint64_t)record->timeUtc, 8);
+	p = PutFloat(p, record->temperatureDegC);
+	for (int axis = 0; axis < 3; axis++) {
+		p = PutFloat(p, record->gyroBiasDps[axis]);
+	}
+	p = PutBytes(p, record->accelOffsetWeight, 1);
+	for (int axis = 0; axis < 3; axis++) {
+		p = PutBytes(p, (uint8_t)record->accelOffset[axis], 1);
+	}
+	PutBytes(p, Crc32(buffer, RECORD_HEADER_SIZE + RECORD_PAYLOAD_SIZE), 4);
+
+	int fd = OpenStore();
+	if (fd < 0) {
+		return -1;
+	}
+
+	// The record starts the file, a partial write leaves a record that fails its CRC check
+	ssize_t written = -1;
+	if (lseek(fd, 0, SEEK_SET) == 0) {
+		written = write(fd, buffer, sizeof(buffer));
+	}
+	if (written != (ssize_t)sizeof(buffer)) {
+		Log_Debug("ERROR: Could not write the calibration store: errno=%d (%s)\n", errno, strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	close(fd);
+	return 0;
+}
+
+/// <summary>
+///     Tells whether a wall clock time comes from a clock that has been set.
+/// </summary>
+bool calibrationStoreClockSet(int64_t timeUtc)
+{
+	return timeUtc >= CALIBRATION_STORE_MIN_TIME_UTC;
+}
@@ -0,0 +1,49 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// Bump when the layout of calibration_record_t changes, records of any other version are ignored
+#define CALIBRATION_STORE_VERSION 3
+
+// Wall clock times before 2020-01-01 mean the clock hasn't been set since the device booted
+#define CALIBRATION_STORE_MIN_TIME_UTC 1577836800LL
+
+// calibration_record_t flags, which parts of the record hold a calibration
+#define CALIBRATION_GYRO_VALID 0x01
+#define CALIBRATION_ACCEL_VALID 0x02
+
+typedef struct {
+	uint8_t flags;
+	// UTC time of the gyroscope calibration in seconds, before CALIBRATION_STORE_MIN_TIME_UTC if
+	// the clock wasn't set then
+	int64_t timeUtc;
+	// LSM6DSO temperature during the gyroscope calibration
+	float temperatureDegC;
+	float gyroBiasDps[3];
+	// Accelerometer user offset weight (lsm6dso_usr_off_w_t) and X/Y/Z_OFS_USR
+	uint8_t accelOffsetWeight;
+	int8_t accelOffset[3];
+} calibration_record_t;
+
+/// <summary>
+///     Reads the calibration record from mutable storage, or from CALIBRATION_STORE_PATH when
+///     that is defined.  The record is checked for its magic number, version, length and CRC-32.
+/// </summary>
+/// <returns>0 if a valid record was read, or -1 if there is none or it's corrupt</returns>
+int calibrationStoreLoad(calibration_record_t *record);
+
+/// <summary>
+///     Writes the calibration record, replacing the previous one.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int calibrationStoreSave(const calibration_record_t *record);
+
+/// <summary>
+///     Tells whether a wall clock time comes from a clock that has been set.  Until the device
+///     has synced its clock, time() counts from an arbitrary point and ages can't be measured.
+/// </summary>
+bool calibrationStoreClockSet(int64_t timeUtc);
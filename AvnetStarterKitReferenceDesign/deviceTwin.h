@@ -19,6 +19,7 @@ typedef struct {
 	GPIO_Id twinGPIO;
 	data_type_t twinType;
 	bool active_high;
+	void (*twinHandler)(void);
 } twin_t;
 
 ///<summary>
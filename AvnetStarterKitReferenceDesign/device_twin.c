@@ -21,6 +21,7 @@
 #include "azure_iot_utilities.h"
 #include "parson.h"
 #include "build_options.h"
+#include "i2c.h"
 
 bool userLedRedIsOn = false;
 bool userLedGreenIsOn = false;
@@ -61,6 +62,9 @@ static int desiredVersion = 0;
 // .twinGPIO - The associted GPIO number for this item.  NO_GPIO_ASSOCIATED_WITH_TWIN if NA
 // .twinType - The data type for this item, TYPE_BOOL, TYPE_STRING, TYPE_INT, or TYPE_FLOAT
 // .active_high - true if GPIO item is active high, false if active low.  This is used to init the GPIO 
+// .twinHandler - Called once per twin update after its TYPE_INT and TYPE_FLOAT values are all stored, before
+//                they're reported, however many of them changed.  It may change the values, for example to
+//                the settings actually applied.  NULL if NA.
 twin_t twinArray[] = {
 	{.twinKey = "userLedRed",.twinVar = &userLedRedIsOn,.twinFd = &userLedRedFd,.twinGPIO = AVNET_MT3620_SK_USER_LED_RED,.twinType = TYPE_BOOL,.active_high = false},
 	{.twinKey = "userLedGreen",.twinVar = &userLedGreenIsOn,.twinFd = &userLedGreenFd,.twinGPIO = AVNET_MT3620_SK_USER_LED_GREEN,.twinType = TYPE_BOOL,.active_high = false},
@@ -68,7 +72,41 @@ twin_t twinArray[] = {
 	{.twinKey = "appLed",.twinVar = &appLedIsOn,.twinFd = &appLedFd,.twinGPIO = AVNET_MT3620_SK_APP_STATUS_LED_YELLOW,.twinType = TYPE_BOOL,.active_high = false},
 	{.twinKey = "wifiLed",.twinVar = &wifiLedIsOn,.twinFd = &wifiLedFd,.twinGPIO = AVNET_MT3620_SK_WLAN_STATUS_LED_YELLOW,.twinType = TYPE_BOOL,.active_high = false},
 	{.twinKey = "clickBoardRelay1",.twinVar = &clkBoardRelay1IsOn,.twinFd = &clickSocket1Relay1Fd,.twinGPIO = AVNET_MT3620_SK_GPIO34,.twinType = TYPE_BOOL,.active_high = true},
-	{.twinKey = "clickBoardRelay2",.twinVar = &clkBoardRelay2IsOn,.twinFd = &clickSocket1Relay2Fd,.twinGPIO = AVNET_MT3620_SK_GPIO0,.twinType = TYPE_BOOL,.active_high = true}};
+	{.twinKey = "clickBoardRelay2",.twinVar = &clkBoardRelay2IsOn,.twinFd = &clickSocket1Relay2Fd,.twinGPIO = AVNET_MT3620_SK_GPIO0,.twinType = TYPE_BOOL,.active_high = true},
+	{.twinKey = "accelOdrHz",.twinVar = &imuSettings.accelOdrHz,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = imuSettingsChanged},
+	{.twinKey = "accelFullScaleG",.twinVar = &imuSettings.accelFullScaleG,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = imuSettingsChanged},
+	{.twinKey = "gyroOdrHz",.twinVar = &imuSettings.gyroOdrHz,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = imuSettingsChanged},
+	{.twinKey = "gyroFullScaleDps",.twinVar = &imuSettings.gyroFullScaleDps,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = imuSettingsChanged},
+#ifdef ENABLE_LSM6DSO_TAP
+	{.twinKey = "tapMode",.twinVar = &tapSettings.mode,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = tapSettingsChanged},
+	{.twinKey = "tapAxes",.twinVar = &tapSettings.axes,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = tapSettingsChanged},
+	{.twinKey = "tapThresholdMg",.twinVar = &tapSettings.thresholdMg,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = tapSettingsChanged},
+	{.twinKey = "tapShockMs",.twinVar = &tapSettings.shockMs,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = tapSettingsChanged},
+	{.twinKey = "tapQuietMs",.twinVar = &tapSettings.quietMs,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = tapSettingsChanged},
+	{.twinKey = "tapDurationMs",.twinVar = &tapSettings.durationMs,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = tapSettingsChanged},
+#endif
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+	{.twinKey = "activityMode",.twinVar = &activitySettings.mode,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = activitySettingsChanged},
+	{.twinKey = "activityThresholdMg",.twinVar = &activitySettings.thresholdMg,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = activitySettingsChanged},
+	{.twinKey = "activitySleepSeconds",.twinVar = &activitySettings.sleepSeconds,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = activitySettingsChanged},
+#endif
+#ifdef ENABLE_IMU_CAPTURE
+	{.twinKey = "captureMode",.twinVar = &captureSettings.mode,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = captureSettingsChanged},
+	{.twinKey = "captureFreeFallMg",.twinVar = &captureSettings.freeFallMg,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = captureSettingsChanged},
+	{.twinKey = "captureFreeFallMs",.twinVar = &captureSettings.freeFallMs,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = captureSettingsChanged},
+	{.twinKey = "captureShockMg",.twinVar = &captureSettings.shockMg,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = captureSettingsChanged},
+	{.twinKey = "captureBeforeMs",.twinVar = &captureSettings.beforeMs,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = captureSettingsChanged},
+	{.twinKey = "captureAfterMs",.twinVar = &captureSettings.afterMs,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = captureSettingsChanged},
+#endif
+#ifdef ENABLE_LSM6DSO_PEDOMETER
+	{.twinKey = "pedometerMode",.twinVar = &pedometerSettings.mode,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = pedometerSettingsChanged},
+#endif
+#ifdef ENABLE_LSM6DSO_ORIENTATION
+	{.twinKey = "orientationMode",.twinVar = &orientationSettings.mode,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = orientationSettingsChanged},
+	{.twinKey = "orientationThresholdDeg",.twinVar = &orientationSettings.thresholdDeg,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_FLOAT,.active_high = true,.twinHandler = orientationSettingsChanged},
+	{.twinKey = "tiltMode",.twinVar = &orientationSettings.tilt,.twinFd = NULL,.twinGPIO = NO_GPIO_ASSOCIATED_WITH_TWIN,.twinType = TYPE_INT,.active_high = true,.twinHandler = orientationSettingsChanged},
+#endif
+};
 
 // Calculate how many twin_t items are in the array.  We use this to iterate through the structure.
 int twinArraySize = sizeof(twinArray) / sizeof(twin_t);
@@ -137,6 +175,32 @@ void checkAndUpdateDeviceTwin(char* property, void* value, data_type_t type, boo
 	}
 }
 
+///<summary>
+///		Runs each handler of the updated properties once, however many of its properties changed,
+///		then reports the values it applied.
+///</summary>
+///<param name="handlerPending">true for each twinArray entry updated whose handler hasn't run</param>
+static void RunTwinHandlers(const bool *handlerPending)
+{
+	const size_t twinCount = sizeof(twinArray) / sizeof(twin_t);
+
+	for (size_t i = 0; i < twinCount; i++) {
+		bool alreadyRun = false;
+		for (size_t j = 0; (j < i) && !alreadyRun; j++) {
+			alreadyRun = handlerPending[j] && (twinArray[j].twinHandler == twinArray[i].twinHandler);
+		}
+		if (handlerPending[i] && !alreadyRun) {
+			twinArray[i].twinHandler();
+		}
+	}
+
+	for (size_t i = 0; i < twinCount; i++) {
+		if (handlerPending[i]) {
+			checkAndUpdateDeviceTwin(twinArray[i].twinKey, twinArray[i].twinVar, twinArray[i].twinType, true);
+		}
+	}
+}
+
 ///<summary>
 ///		Parses received desired property changes.
 ///</summary>
@@ -144,6 +208,7 @@ void checkAndUpdateDeviceTwin(char* property, void* value, data_type_t type, boo
 void deviceTwinChangedHandler(JSON_Object * desiredProperties)
 {
 	int result = 0;
+	bool handlerPending[sizeof(twinArray) / sizeof(twin_t)] = { false };
 
 	// Pull the twin version out of the message.  We use this value when we echo the new setting back to IoT Connect.
 	if (json_object_has_value(desiredProperties, "$version") != 0)
@@ -176,12 +241,22 @@ void deviceTwinChangedHandler(JSON_Object * desiredProperties)
 			case TYPE_FLOAT:
 				*(float*)twinArray[i].twinVar = (float)json_object_get_number(currentJSONProperties, "value");
 				Log_Debug("Received device update. New %s is %0.2f\n", twinArray[i].twinKey, *(float*)twinArray[i].twinVar);
-				checkAndUpdateDeviceTwin(twinArray[i].twinKey, twinArray[i].twinVar, TYPE_FLOAT, true);
+				if (twinArray[i].twinHandler != NULL) {
+					handlerPending[i] = true;
+				}
+				else {
+					checkAndUpdateDeviceTwin(twinArray[i].twinKey, twinArray[i].twinVar, TYPE_FLOAT, true);
+				}
 				break;
 			case TYPE_INT:
 				*(int*)twinArray[i].twinVar = (int)json_object_get_number(currentJSONProperties, "value");
 				Log_Debug("Received device update. New %s is %d\n", twinArray[i].twinKey, *(int*)twinArray[i].twinVar);
-				checkAndUpdateDeviceTwin(twinArray[i].twinKey, twinArray[i].twinVar, TYPE_INT, true);
+				if (twinArray[i].twinHandler != NULL) {
+					handlerPending[i] = true;
+				}
+				else {
+					checkAndUpdateDeviceTwin(twinArray[i].twinKey, twinArray[i].twinVar, TYPE_INT, true);
+				}
 				break;
 			case TYPE_STRING:
 				Log_Debug("ERROR: TYPE_STRING case not implemented!");
@@ -212,12 +287,22 @@ void deviceTwinChangedHandler(JSON_Object * desiredProperties)
 			case TYPE_FLOAT:
 				*(float*)twinArray[i].twinVar = (float)json_object_get_number(desiredProperties, twinArray[i].twinKey);
 				Log_Debug("Received device update. New %s is %0.2f\n", twinArray[i].twinKey, *(float*)twinArray[i].twinVar);
-				checkAndUpdateDeviceTwin(twinArray[i].twinKey, twinArray[i].twinVar, TYPE_FLOAT, true);
+				if (twinArray[i].twinHandler != NULL) {
+					handlerPending[i] = true;
+				}
+				else {
+					checkAndUpdateDeviceTwin(twinArray[i].twinKey, twinArray[i].twinVar, TYPE_FLOAT, true);
+				}
 				break;
 			case TYPE_INT:
 				*(int*)twinArray[i].twinVar = (int)json_object_get_number(desiredProperties, twinArray[i].twinKey);
 				Log_Debug("Received device update. New %s is %d\n", twinArray[i].twinKey, *(int*)twinArray[i].twinVar);
-				checkAndUpdateDeviceTwin(twinArray[i].twinKey, twinArray[i].twinVar, TYPE_INT, true);
+				if (twinArray[i].twinHandler != NULL) {
+					handlerPending[i] = true;
+				}
+				else {
+					checkAndUpdateDeviceTwin(twinArray[i].twinKey, twinArray[i].twinVar, TYPE_INT, true);
+				}
 				break;
 			case TYPE_STRING:
 				Log_Debug("ERROR: TYPE_STRING case not implemented!");
@@ -227,4 +312,5 @@ void deviceTwinChangedHandler(JSON_Object * desiredProperties)
 	}
 #endif 
 
+	RunTwinHandlers(handlerPending);
 }
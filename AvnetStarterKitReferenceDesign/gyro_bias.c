@@ -0,0 +1,221 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "gyro_bias.h"
+
+/// <summary>
+///     Standard deviation from a sum and sum of squares.
+/// </summary>
+static double StdDev(double sum, double sumSq, uint32_t count)
+{
+	double mean = sum / count;
+	double variance = sumSq / count - mean * mean;
+	return (variance > 0.0) ? sqrt(variance) : 0.0;
+}
+
+/// <summary>
+///     Adds one still window to the weighted sums, the older windows fade by (1 - gain) and
+///     (1 - slopeGain).
+/// </summary>
+static void AddStillWindow(gyro_bias_t *tracker, const double biasDps[3], double temperatureDegC)
+{
+	double keep = 1.0 - tracker->gain;
+	double slopeKeep = 1.0 - tracker->slopeGain;
+
+	tracker->weight = tracker->weight * keep + 1.0;
+	tracker->sumT = tracker->sumT * keep + temperatureDegC;
+	tracker->slopeWeight = tracker->slopeWeight * slopeKeep + 1.0;
+	tracker->slopeSumT = tracker->slopeSumT * slopeKeep + temperatureDegC;
+	tracker->slopeSumTT = tracker->slopeSumTT * slopeKeep + temperatureDegC * temperatureDegC;
+	for (int axis = 0; axis < 3; axis++) {
+		tracker->sumB[axis] = tracker->sumB[axis] * keep + biasDps[axis];
+		tracker->slopeSumB[axis] = tracker->slopeSumB[axis] * slopeKeep + biasDps[axis];
+		tracker->slopeSumTB[axis] = tracker->slopeSumTB[axis] * slopeKeep + temperatureDegC * biasDps[axis];
+	}
+}
+
+/// <summary>
+///     Refits the temperature coefficients, the previous ones are kept until the temperatures
+///     have spread far enough.
+/// </summary>
+static void FitSlope(gyro_bias_t *tracker)
+{
+	double meanT = tracker->slopeSumT / tracker->slopeWeight;
+	double varianceT = tracker->slopeSumTT / tracker->slopeWeight - meanT * meanT;
+
+	if ((tracker->slopeGain <= 0.0f) || (varianceT < (double)tracker->minSpanDegC * tracker->minSpanDegC)) {
+		return;
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		double meanB = tracker->slopeSumB[axis] / tracker->slopeWeight;
+		double covariance = tracker->slopeSumTB[axis] / tracker->slopeWeight - meanT * meanB;
+		tracker->stats.slopeDpsPerDegC[axis] = (float)(covariance / varianceT);
+	}
+}
+
+/// <summary>
+///     Starts tracking from the offsets measured at startup, or from nothing if they weren't.
+/// </summary>
+void initGyroBias(gyro_bias_t *tracker, const float biasDps[3], bool biasValid, float temperatureDegC, uint32_t windowSamples,
+	float gain, float maxAccelStdDevMg, float maxGyroStdDevDps, float maxResidualDps, float slopeGain, float minSpanDegC)
+{
+	memset(tracker, 0, sizeof(*tracker));
+	tracker->windowSamples = windowSamples;
+	tracker->gain = gain;
+	tracker->maxAccelStdDevMg = maxAccelStdDevMg;
+	tracker->maxGyroStdDevDps = maxGyroStdDevDps;
+	tracker->maxResidualDps = maxResidualDps;
+	tracker->slopeGain = slopeGain;
+	tracker->minSpanDegC = minSpanDegC;
+	tracker->temperatureDegC = temperatureDegC;
+
+	// Without startup offsets there is nothing to seed with or to check residuals against, the
+	// first still window becomes the estimate
+	if (biasValid) {
+		double seed[3] = { biasDps[0], biasDps[1], biasDps[2] };
+		AddStillWindow(tracker, seed, temperatureDegC);
+	}
+}
+
+/// <summary>
+///     Sets the temperature the next window ends at.
+/// </summary>
+void gyroBiasSetTemperature(gyro_bias_t *tracker, float temperatureDegC)
+{
+	tracker->temperatureDegC = temperatureDegC;
+}
+
+/// <summary>
+///     Adds converted accelerometer samples.
+/// </summary>
+void gyroBiasAddAccel(gyro_bias_t *tracker, const float *x, const float *y, const float *z, size_t count)
+{
+	const float *axes[3] = { x, y, z };
+
+	for (int axis = 0; axis < 3; axis++) {
+		double sum = 0.0, sumSq = 0.0;
+		for (size_t i = 0; i < count; i++) {
+			sum += axes[axis][i];
+			sumSq += (double)axes[axis][i] * axes[axis][i];
+		}
+		tracker->accelSum[axis] += sum;
+		tracker->accelSumSq[axis] += sumSq;
+	}
+
+	tracker->accelCount += (uint32_t)count;
+}
+
+/// <summary>
+///     Ends the window, updating the offsets if the board was at rest.
+/// </summary>
+/// <returns>true if the offsets were updated</returns>
+static bool EndWindow(gyro_bias_t *tracker)
+{
+	bool still = (tracker->accelCount >= 2);
+	bool haveEstimate = (tracker->weight > 0.0);
+	double biasDps[3];
+	float estimateDps[3];
+
+	tracker->stats.windows++;
+	gyroBiasEstimate(tracker, tracker->temperatureDegC, estimateDps);
+
+	for (int axis = 0; axis < 3; axis++) {
+		biasDps[axis] = tracker->gyroSum[axis] / tracker->gyroCount;
+		double residual = biasDps[axis] - estimateDps[axis];
+
+		if ((haveEstimate && (fabs(residual) > tracker->maxResidualDps)) ||
+			(StdDev(tracker->gyroSum[axis], tracker->gyroSumSq[axis], tracker->gyroCount) > tracker->maxGyroStdDevDps) ||
+			((tracker->accelCount >= 2) &&
+			 (StdDev(tracker->accelSum[axis], tracker->accelSumSq[axis], tracker->accelCount) > tracker->maxAccelStdDevMg))) {
+			still = false;
+		}
+	}
+
+	if (still) {
+		AddStillWindow(tracker, biasDps, tracker->temperatureDegC);
+		FitSlope(tracker);
+		tracker->stats.stillWindows++;
+	}
+
+	tracker->accelCount = 0;
+	tracker->gyroCount = 0;
+	memset(tracker->accelSum, 0, sizeof(tracker->accelSum));
+	memset(tracker->accelSumSq, 0, sizeof(tracker->accelSumSq));
+	memset(tracker->gyroSum, 0, sizeof(tracker->gyroSum));
+	memset(tracker->gyroSumSq, 0, sizeof(tracker->gyroSumSq));
+
+	return still;
+}
+
+/// <summary>
+///     Adds converted gyroscope samples that had appliedDps subtracted.
+/// </summary>
+/// <returns>true if a window ended and updated the offsets</returns>
+bool gyroBiasAddGyro(gyro_bias_t *tracker, const float *x, const float *y, const float *z, size_t count,
+	const float appliedDps[3])
+{
+	const float *axes[3] = { x, y, z };
+	bool updated = false;
+	size_t i = 0;
+
+	while (i < count) {
+
+		// Only take up to the end of the current window
+		size_t take = count - i;
+		if (take > tracker->windowSamples - tracker->gyroCount) {
+			take = tracker->windowSamples - tracker->gyroCount;
+		}
+
+		for (int axis = 0; axis < 3; axis++) {
+			double sum = 0.0, sumSq = 0.0;
+			for (size_t j = i; j < i + take; j++) {
+				sum += axes[axis][j];
+				sumSq += (double)axes[axis][j] * axes[axis][j];
+			}
+			// Sum the rates as they were before the offset was subtracted
+			double applied = appliedDps[axis];
+			tracker->gyroSum[axis] += sum + applied * take;
+			tracker->gyroSumSq[axis] += sumSq + 2.0 * applied * sum + applied * applied * take;
+		}
+
+		tracker->gyroCount += (uint32_t)take;
+		i += take;
+
+		if (tracker->gyroCount >= tracker->windowSamples) {
+			updated |= EndWindow(tracker);
+		}
+	}
+
+	return updated;
+}
+
+/// <summary>
+///     Returns the offsets to use at temperatureDegC.
+/// </summary>
+void gyroBiasEstimate(const gyro_bias_t *tracker, float temperatureDegC, float biasDps[3])
+{
+	if (tracker->weight <= 0.0) {
+		memset(biasDps, 0, 3 * sizeof(float));
+		return;
+	}
+
+	double meanT = tracker->sumT / tracker->weight;
+
+	for (int axis = 0; axis < 3; axis++) {
+		double meanB = tracker->sumB[axis] / tracker->weight;
+		biasDps[axis] = (float)(meanB + tracker->stats.slopeDpsPerDegC[axis] * (temperatureDegC - meanT));
+	}
+}
+
+/// <summary>
+///     Returns the tracker statistics.
+/// </summary>
+const gyro_bias_stats_t *getGyroBiasStats(const gyro_bias_t *tracker)
+{
+	return &tracker->stats;
+}
@@ -0,0 +1,92 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+	uint32_t windows;
+	// Windows where the board was at rest, each one updates the offsets
+	uint32_t stillWindows;
+	// Temperature coefficient in use, 0 until the temperature has spread far enough to fit one
+	float slopeDpsPerDegC[3];
+} gyro_bias_stats_t;
+
+/// <summary>
+///     Tracks the gyroscope zero rate offsets while the application runs.  Samples are fed in
+///     as they are converted and summed, so memory doesn't grow with the window.  A window of
+///     windowSamples gyroscope samples is taken as the board at rest when the accelerometer and
+///     gyroscope standard deviations are below their limits and the mean rate is within
+///     maxResidualDps of the current offset estimate, which keeps out slow steady turns.  Each
+///     still window moves the offsets towards its mean rate with weight gain.  The temperature
+///     coefficient is fitted separately over still windows with the much smaller weight slopeGain,
+///     and only once their temperatures have a standard deviation of minSpanDegC.  A slopeGain
+///     of 0 disables the temperature fit.
+/// </summary>
+typedef struct {
+	uint32_t windowSamples;
+	float gain;
+	float slopeGain;
+	float maxAccelStdDevMg;
+	float maxGyroStdDevDps;
+	float maxResidualDps;
+	float minSpanDegC;
+	float temperatureDegC;
+	// Current window
+	uint32_t accelCount;
+	double accelSum[3];
+	double accelSumSq[3];
+	uint32_t gyroCount;
+	double gyroSum[3];
+	double gyroSumSq[3];
+	// Weighted sums over still windows of temperature (T) and offsets (B)
+	double weight;
+	double sumT;
+	double sumB[3];
+	// The same with slopeGain, for the temperature fit
+	double slopeWeight;
+	double slopeSumT;
+	double slopeSumTT;
+	double slopeSumB[3];
+	double slopeSumTB[3];
+	gyro_bias_stats_t stats;
+} gyro_bias_t;
+
+/// <summary>
+///     Starts tracking from the offsets measured at temperatureDegC, they count as one still window.
+///     If biasValid is false the startup calibration failed: the offsets are 0 and the mean rate
+///     isn't checked against them until the first still window has been taken.
+/// </summary>
+void initGyroBias(gyro_bias_t *tracker, const float biasDps[3], bool biasValid, float temperatureDegC, uint32_t windowSamples,
+	float gain, float maxAccelStdDevMg, float maxGyroStdDevDps, float maxResidualDps, float slopeGain, float minSpanDegC);
+
+/// <summary>
+///     Sets the temperature the next window ends at.
+/// </summary>
+void gyroBiasSetTemperature(gyro_bias_t *tracker, float temperatureDegC);
+
+/// <summary>
+///     Adds converted accelerometer samples, in mg.
+/// </summary>
+void gyroBiasAddAccel(gyro_bias_t *tracker, const float *x, const float *y, const float *z, size_t count);
+
+/// <summary>
+///     Adds converted gyroscope samples, in dps, that had appliedDps subtracted.
+/// </summary>
+/// <returns>true if a window ended and updated the offsets</returns>
+bool gyroBiasAddGyro(gyro_bias_t *tracker, const float *x, const float *y, const float *z, size_t count,
+	const float appliedDps[3]);
+
+/// <summary>
+///     Returns the offsets to use at temperatureDegC, 0 before the first still window if the
+///     tracker started without offsets.
+/// </summary>
+void gyroBiasEstimate(const gyro_bias_t *tracker, float temperatureDegC, float biasDps[3]);
+
+/// <summary>
+///     Returns the tracker statistics.
+/// </summary>
+const gyro_bias_stats_t *getGyroBiasStats(const gyro_bias_t *tracker);
@@ -0,0 +1,93 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+
+#include "gyro_calibration.h"
+#include "lsm6dso_fifo.h"
+
+/// <summary>
+///     Returns CLOCK_MONOTONIC in milliseconds.
+/// </summary>
+static uint64_t NowMs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000ULL + (uint64_t)now.tv_nsec / 1000000ULL;
+}
+
+/// <summary>
+///     Sleeps for ms milliseconds.
+/// </summary>
+static void SleepMs(uint32_t ms)
+{
+	struct timespec delay = { .tv_sec = ms / 1000,.tv_nsec = (long)(ms % 1000) * 1000000L };
+	nanosleep(&delay, NULL);
+}
+
+/// <summary>
+///     Measures the gyroscope zero rate offset from FIFO captures.
+/// </summary>
+/// <returns>0 if an offset was measured, or -1 on failure or timeout</returns>
+int calibrateGyro(lsm6dso_ctx_t *ctx, const gyro_calibration_config_t *config, gyro_calibration_t *result)
+{
+	uint64_t start = NowMs();
+
+	memset(result, 0, sizeof(*result));
+
+	if ((config->rateHz <= 0.0f) || (config->samples < 2)) {
+		return -1;
+	}
+
+	SleepMs(config->settleMs);
+
+	while (true) {
+
+		fifo_capture_t capture;
+		result->attempts++;
+		if (lsm6dsoFifoCapture(ctx, LSM6DSO_GYRO_NC_TAG, config->rateHz, config->samples, &capture) != 0) {
+			break;
+		}
+
+		float dpsPerLsb = config->mdpsPerLsb / 1000.0f;
+		bool still = true;
+		for (int axis = 0; axis < 3; axis++) {
+			result->biasDps[axis] = (float)capture.mean[axis] * dpsPerLsb;
+			result->stdDevDps[axis] = (float)capture.stdDev[axis] * dpsPerLsb;
+			if (result->stdDevDps[axis] > config->maxStdDevDps) {
+				still = false;
+			}
+		}
+
+		if (still) {
+			result->valid = true;
+			break;
+		}
+
+		result->rejected++;
+		Log_Debug("LSM6DSO: Gyroscope moving during calibration, standard deviation %.3f, %.3f, %.3f dps\n",
+			result->stdDevDps[0], result->stdDevDps[1], result->stdDevDps[2]);
+
+		// Only start another capture if it can finish in time
+		uint64_t captureMs = (uint64_t)((float)config->samples * 1000.0f / config->rateHz);
+		if (NowMs() - start + captureMs > config->timeoutMs) {
+			break;
+		}
+	}
+
+	result->durationMs = (uint32_t)(NowMs() - start);
+
+	if (!result->valid) {
+		memset(result->biasDps, 0, sizeof(result->biasDps));
+		return -1;
+	}
+
+	return 0;
+}
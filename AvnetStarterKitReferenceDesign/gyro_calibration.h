@@ -0,0 +1,41 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+
+typedef struct {
+	// Gyroscope batch rate, the gyroscope must already be running at this rate
+	float rateHz;
+	// Samples per capture, at most what the FIFO holds
+	uint16_t samples;
+	float mdpsPerLsb;
+	// A capture with a larger standard deviation on any axis was taken while moving
+	float maxStdDevDps;
+	// Time for the gyroscope to settle after it was switched on or changed rate
+	uint32_t settleMs;
+	// The calibration gives up once this much time has passed
+	uint32_t timeoutMs;
+} gyro_calibration_config_t;
+
+typedef struct {
+	bool valid;
+	float biasDps[3];
+	float stdDevDps[3];
+	uint32_t attempts;
+	uint32_t rejected;
+	uint32_t durationMs;
+} gyro_calibration_t;
+
+/// <summary>
+///     Measures the gyroscope zero rate offset.  Each capture batches config->samples gyroscope
+///     samples in the FIFO and reads them back in one drain, see lsm6dsoFifoCapture.  The
+///     mean is accepted if the standard deviation shows the board was still, otherwise the capture
+///     is repeated until config->timeoutMs runs out.  The FIFO must be set up to batch only the
+///     gyroscope, at config->rateHz.
+/// </summary>
+/// <returns>0 if an offset was measured, or -1 on failure or timeout</returns>
+int calibrateGyro(lsm6dso_ctx_t *ctx, const gyro_calibration_config_t *config, gyro_calibration_t *result);
@@ -0,0 +1,152 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "accel_calibration.h"
+#include "parson.h"
+
+#include "host_applibs.h"
+
+// Works out the accelerometer user offset registers for mean readings with the board on each kind
+// of face and checks the gravity axis, the weight picked, the rounding to the register LSB, the
+// switch to the 16 mg weight just past what the 1 mg weight holds, the clamp at 127, the
+// rejection of a board that isn't flat and the JSON report.
+
+#define MAX_OFFSET_MG 500.0f
+
+static char json[512];
+static int failures;
+
+/// <summary>
+///     Computes the registers for meanMg and checks them against the expected axis, weight and
+///     register values.  The offsets must be the registers times the weight.
+/// </summary>
+static void ExpectRegisters(const char *name, const float meanMg[3], float maxOffsetMg, int axis, float gravityMg,
+	lsm6dso_usr_off_w_t weight, const int8_t registers[3])
+{
+	accel_calibration_t calibration;
+	float weightMg = (weight == LSM6DSO_LSb_16mg) ? ACCEL_OFFSET_16MG_WEIGHT_MG : ACCEL_OFFSET_1MG_WEIGHT_MG;
+
+	if ((accelCalibrationCompute(meanMg, maxOffsetMg, &calibration) != 0) || !calibration.valid) {
+		printf("FAIL: %s: no calibration\n", name);
+		failures++;
+		return;
+	}
+
+	bool same = (calibration.gravityAxis == axis) && (calibration.gravityMg == gravityMg) &&
+		(calibration.weight == weight);
+	for (int i = 0; i < 3; i++) {
+		same = same && (calibration.registers[i] == registers[i]) &&
+			(calibration.offsetMg[i] == (float)registers[i] * weightMg);
+	}
+
+	printf("%-24s axis %c %+.0f mg, %s weight, registers %d, %d, %d\n", name, "xyz"[calibration.gravityAxis],
+		calibration.gravityMg, (calibration.weight == LSM6DSO_LSb_16mg) ? "16 mg" : "1 mg", calibration.registers[0],
+		calibration.registers[1], calibration.registers[2]);
+	if (!same) {
+		printf("FAIL: %s: expected axis %c %+.0f mg, %s weight, registers %d, %d, %d\n", name, "xyz"[axis], gravityMg,
+			(weight == LSM6DSO_LSb_16mg) ? "16 mg" : "1 mg", registers[0], registers[1], registers[2]);
+		failures++;
+	}
+}
+
+static void CheckFaces(void)
+{
+	const float zUp[3] = { -25.0f, 14.6f, 1040.0f };
+	const int8_t zUpRegisters[3] = { -26, 15, 41 };
+	ExpectRegisters("z up", zUp, MAX_OFFSET_MG, 2, 1000.0f, LSM6DSO_LSb_1mg, zUpRegisters);
+
+	const float yDown[3] = { 3.0f, -998.0f, -5.0f };
+	const int8_t yDownRegisters[3] = { 3, 2, -5 };
+	ExpectRegisters("y down", yDown, MAX_OFFSET_MG, 1, -1000.0f, LSM6DSO_LSb_1mg, yDownRegisters);
+
+	// 127 LSB of 1 mg weight hold 124.02 mg
+	const float fits[3] = { -1000.0f, 124.0f, 0.0f };
+	const int8_t fitsRegisters[3] = { 0, 127, 0 };
+	ExpectRegisters("x down, largest 1 mg", fits, MAX_OFFSET_MG, 0, -1000.0f, LSM6DSO_LSb_1mg, fitsRegisters);
+
+	const float coarse[3] = { 124.1f, 0.0f, 1000.0f };
+	const int8_t coarseRegisters[3] = { 8, 0, 0 };
+	ExpectRegisters("z up, smallest 16 mg", coarse, MAX_OFFSET_MG, 2, 1000.0f, LSM6DSO_LSb_16mg, coarseRegisters);
+
+	// 2100 mg is 134 LSB of 16 mg
+	const float clamped[3] = { 0.0f, 0.0f, 3100.0f };
+	const int8_t clampedRegisters[3] = { 0, 0, 127 };
+	ExpectRegisters("z up, clamped", clamped, 2500.0f, 2, 1000.0f, LSM6DSO_LSb_16mg, clampedRegisters);
+}
+
+/// <summary>
+///     A board propped at an angle reads offsets above the limit and gets no calibration.
+/// </summary>
+static void CheckNotFlat(void)
+{
+	const float tilted[3] = { 600.0f, 0.0f, 800.0f };
+	accel_calibration_t calibration;
+
+	if ((accelCalibrationCompute(tilted, MAX_OFFSET_MG, &calibration) == 0) || calibration.valid) {
+		printf("FAIL: a board tilted by 37 degrees was calibrated\n");
+		failures++;
+	}
+}
+
+/// <summary>
+///     Residuals are the reading less what's expected on each axis, and the JSON report carries
+///     every field.
+/// </summary>
+static void CheckReport(void)
+{
+	const float meanMg[3] = { -25.0f, 14.6f, 1040.0f };
+	const float afterMg[3] = { 0.25f, -0.35f, 1000.5f };
+	accel_calibration_t calibration;
+
+	memset(&calibration, 0, sizeof(calibration));
+	accelCalibrationCompute(meanMg, MAX_OFFSET_MG, &calibration);
+	calibration.stdDevMg[0] = 1.0f;
+	accelCalibrationResidual(&calibration, afterMg);
+
+	if (accelCalibrationToJson(&calibration, json, sizeof(json)) < 0) {
+		printf("FAIL: the report doesn't fit in %zu bytes\n", sizeof(json));
+		failures++;
+		return;
+	}
+	printf("%s\n", json);
+
+	JSON_Value *root = json_parse_string(json);
+	JSON_Object *report = json_value_get_object(root);
+	JSON_Array *registers = json_object_get_array(report, "registers");
+	JSON_Array *residual = json_object_get_array(report, "residualMg");
+	const char *axis = json_object_get_string(report, "axis");
+	const char *weight = json_object_get_string(report, "weight");
+
+	if ((json_object_get_boolean(report, "success") != 1) || (axis == NULL) || (strcmp(axis, "z") != 0) ||
+		(weight == NULL) || (strcmp(weight, "1mg") != 0) || (json_array_get_number(registers, 0) != -26) ||
+		(json_array_get_number(registers, 2) != 41) || (json_array_get_number(residual, 0) != 0.25) ||
+		(json_array_get_number(residual, 1) != -0.35) || (json_array_get_number(residual, 2) != 0.5) ||
+		(json_array_get_number(json_object_get_array(report, "stdDevMg"), 0) != 1.0)) {
+		printf("FAIL: the report doesn't match the calibration\n");
+		failures++;
+	}
+	json_value_free(root);
+
+	if (accelCalibrationToJson(&calibration, json, 16) >= 0) {
+		printf("FAIL: a report that doesn't fit should be refused\n");
+		failures++;
+	}
+}
+
+int main(void)
+{
+	CheckFaces();
+	CheckNotFlat();
+	CheckReport();
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,104 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "lsm6dso_config.h"
+#include "lsm6dso_events.h"
+
+#include "host_applibs.h"
+
+// Puts activity settings in a configuration image and checks the register fields against the
+// LSM6DSO encodings: the wake-up threshold in 1/256 of the full scale, or 1/64 once that no
+// longer fits the 6 bits, never 0, the wake-up samples up to 3, and the inactivity time in 512
+// samples per LSB with a 0 standing for 16 samples.  The settings handed back must be the ones
+// the registers apply, and the inactive mode must only be set when activity detection is on.
+
+#define ODR_HZ 416.0f
+
+// The settings handed back are worked out in float
+#define MAX_SETTING_ERROR 0.001f
+
+static int failures;
+
+typedef struct {
+	const char *name;
+	int fullScaleG;
+	lsm6dso_activity_config_t activity;
+	uint8_t threshold;
+	uint8_t thresholdWeight;
+	uint8_t wakeSamples;
+	uint8_t sleepDur;
+	float thresholdMg;
+	float sleepSeconds;
+} activity_case_t;
+
+static const activity_case_t activityCases[] = {
+	// 50 mg is 6.4 fine steps at 2 g and 10 s is 8.1 inactivity steps at 416 Hz
+	{ "2 g, fine", 2, { true, LSM6DSO_XL_12Hz5_GY_PD, 50.0f, 2, 10.0f }, 6, 1, 2, 8, 46.875f, 4096.0f / ODR_HZ },
+	// 600 mg is 76.8 fine steps, too many, and 19.2 coarse ones
+	{ "2 g, coarse", 2, { true, LSM6DSO_XL_12Hz5_GY_SLEEP, 600.0f, 7, 0.0f }, 19, 0, 3, 0, 593.75f, 16.0f / ODR_HZ },
+	// Nothing asked for gets the smallest threshold, activity detection off leaves the rates alone
+	{ "8 g, off", 8, { false, LSM6DSO_XL_12Hz5_GY_PD, 0.0f, 0, 60.0f }, 1, 1, 0, 15, 31.25f, 7680.0f / ODR_HZ },
+	{ "16 g, clamped", 16, { true, LSM6DSO_XL_12Hz5_GY_NOT_AFFECTED, 20000.0f, 3, 1.0f }, 63, 0, 3, 1, 15750.0f,
+		512.0f / ODR_HZ },
+};
+
+/// <summary>
+///     Applies one case to a default image and checks the fields and the settings handed back.
+/// </summary>
+static void CheckActivityCase(const activity_case_t *activityCase)
+{
+	lsm6dso_config_t config;
+	lsm6dso_activity_config_t activity = activityCase->activity;
+
+	lsm6dsoConfigDefaults(&config);
+	lsm6dsoEventsConfigActivity(&config, &activity, ODR_HZ, activityCase->fullScaleG);
+
+	const lsm6dso_tap_cfg2_t *tapCfg2 = (const lsm6dso_tap_cfg2_t *)lsm6dsoConfigReg(&config, LSM6DSO_TAP_CFG2);
+	const lsm6dso_wake_up_ths_t *wakeUpThs = (const lsm6dso_wake_up_ths_t *)lsm6dsoConfigReg(&config,
+		LSM6DSO_WAKE_UP_THS);
+	const lsm6dso_wake_up_dur_t *wakeUpDur = (const lsm6dso_wake_up_dur_t *)lsm6dsoConfigReg(&config,
+		LSM6DSO_WAKE_UP_DUR);
+
+	printf("%-14s threshold %2u weight %u (%.3f mg), wake %u, sleep %2u (%.3f s), inactive mode %u\n",
+		activityCase->name, wakeUpThs->wk_ths, wakeUpDur->wake_ths_w, activity.thresholdMg, wakeUpDur->wake_dur,
+		wakeUpDur->sleep_dur, activity.sleepSeconds, tapCfg2->inact_en);
+
+	if ((wakeUpThs->wk_ths != activityCase->threshold) || (wakeUpDur->wake_ths_w != activityCase->thresholdWeight) ||
+		(wakeUpDur->wake_dur != activityCase->wakeSamples) || (wakeUpDur->sleep_dur != activityCase->sleepDur)) {
+		printf("FAIL: %s: expected threshold %u weight %u, wake %u, sleep %u\n", activityCase->name,
+			activityCase->threshold, activityCase->thresholdWeight, activityCase->wakeSamples,
+			activityCase->sleepDur);
+		failures++;
+	}
+	if ((fabsf(activity.thresholdMg - activityCase->thresholdMg) > MAX_SETTING_ERROR) ||
+		(activity.wakeSamples != activityCase->wakeSamples) ||
+		(fabsf(activity.sleepSeconds - activityCase->sleepSeconds) > MAX_SETTING_ERROR)) {
+		printf("FAIL: %s: expected %.3f mg, %u samples and %.3f s handed back\n", activityCase->name,
+			activityCase->thresholdMg, activityCase->wakeSamples, activityCase->sleepSeconds);
+		failures++;
+	}
+
+	uint8_t inactiveMode = activityCase->activity.enabled ? (uint8_t)activityCase->activity.inactiveMode
+		: (uint8_t)LSM6DSO_XL_AND_GY_NOT_AFFECTED;
+	if (tapCfg2->inact_en != inactiveMode) {
+		printf("FAIL: %s: the inactive mode should be %u\n", activityCase->name, inactiveMode);
+		failures++;
+	}
+}
+
+int main(void)
+{
+	for (size_t i = 0; i < sizeof(activityCases) / sizeof(activityCases[0]); i++) {
+		CheckActivityCase(&activityCases[i]);
+	}
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "calibration_store.h"
+
+#include "host_applibs.h"
+
+// Saves a calibration record to CALIBRATION_STORE_PATH and loads it back, then damages the file
+// the ways storage goes wrong and checks each damaged record is refused: a flipped payload bit,
+// a record of another version with a good CRC, and a file cut short by a partial write.  Also
+// checks the times the gyroscope record age is trusted for.
+
+// Magic, then the version byte
+#define VERSION_OFFSET 4
+#define RECORD_CRC_SIZE 4
+
+static int failures;
+
+/// <summary>
+///     CRC-32 (IEEE 802.3), to rewrite a record's CRC after changing its version.
+/// </summary>
+static uint32_t Crc32(const uint8_t *data, size_t len)
+{
+	uint32_t crc = 0xFFFFFFFFu;
+
+	for (size_t i = 0; i < len; i++) {
+		crc ^= data[i];
+		for (int bit = 0; bit < 8; bit++) {
+			crc = (crc >> 1) ^ (0xEDB88320u & (0u - (crc & 1u)));
+		}
+	}
+
+	return ~crc;
+}
+
+/// <summary>
+///     Reads the whole store file.
+/// </summary>
+/// <returns>The number of bytes read, or -1 on failure</returns>
+static ssize_t ReadFile(uint8_t *buffer, size_t size)
+{
+	int fd = open(CALIBRATION_STORE_PATH, O_RDONLY);
+	if (fd < 0) {
+		return -1;
+	}
+	ssize_t bytesRead = read(fd, buffer, size);
+	close(fd);
+	return bytesRead;
+}
+
+static void WriteFile(const uint8_t *buffer, size_t len)
+{
+	int fd = open(CALIBRATION_STORE_PATH, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if ((fd < 0) || (write(fd, buffer, len) != (ssize_t)len)) {
+		printf("FAIL: could not write %s\n", CALIBRATION_STORE_PATH);
+		failures++;
+	}
+	if (fd >= 0) {
+		close(fd);
+	}
+}
+
+static void ExpectRefused(const char *name)
+{
+	calibration_record_t loaded;
+
+	if (calibrationStoreLoad(&loaded) == 0) {
+		printf("FAIL: a record with %s was loaded\n", name);
+		failures++;
+	}
+}
+
+int main(void)
+{
+	const calibration_record_t saved = {
+		.flags = CALIBRATION_GYRO_VALID | CALIBRATION_ACCEL_VALID,
+		.timeUtc = 1791000000LL,
+		.temperatureDegC = 31.25f,
+		.gyroBiasDps = { 0.125f, -1.5f, 2.75f },
+		.accelOffsetWeight = 1,
+		.accelOffset = { -12, 0, 127 },
+	};
+	calibration_record_t loaded;
+	uint8_t record[64];
+
+	unlink(CALIBRATION_STORE_PATH);
+	ExpectRefused("no file");
+
+	if ((calibrationStoreSave(&saved) != 0) || (calibrationStoreLoad(&loaded) != 0)) {
+		printf("FAIL: the record didn't round trip\n");
+		return 1;
+	}
+	if ((loaded.flags != saved.flags) || (loaded.timeUtc != saved.timeUtc) ||
+		(loaded.temperatureDegC != saved.temperatureDegC) ||
+		(memcmp(loaded.gyroBiasDps, saved.gyroBiasDps, sizeof(saved.gyroBiasDps)) != 0) ||
+		(loaded.accelOffsetWeight != saved.accelOffsetWeight) ||
+		(memcmp(loaded.accelOffset, saved.accelOffset, sizeof(saved.accelOffset)) != 0)) {
+		printf("FAIL: the loaded record differs from the one saved\n");
+		failures++;
+	}
+
+	ssize_t recordSize = ReadFile(record, sizeof(record));
+	if ((recordSize <= VERSION_OFFSET + RECORD_CRC_SIZE) || (recordSize >= (ssize_t)sizeof(record))) {
+		printf("FAIL: the record is %zd bytes\n", recordSize);
+		return 1;
+	}
+	printf("calibration record: %zd bytes, version %u\n", recordSize, record[VERSION_OFFSET]);
+
+	// One bit of the gyroscope offsets
+	uint8_t damaged[64];
+	memcpy(damaged, record, (size_t)recordSize);
+	damaged[recordSize - RECORD_CRC_SIZE - 8] ^= 0x10;
+	WriteFile(damaged, (size_t)recordSize);
+	ExpectRefused("a bad CRC");
+
+	// Another version, with the CRC it would have been written with
+	memcpy(damaged, record, (size_t)recordSize);
+	damaged[VERSION_OFFSET] = CALIBRATION_STORE_VERSION - 1;
+	uint32_t crc = Crc32(damaged, (size_t)recordSize - RECORD_CRC_SIZE);
+	for (int i = 0; i < RECORD_CRC_SIZE; i++) {
+		damaged[recordSize - RECORD_CRC_SIZE + i] = (uint8_t)(crc >> (8 * i));
+	}
+	WriteFile(damaged, (size_t)recordSize);
+	ExpectRefused("another version");
+
+	WriteFile(record, (size_t)recordSize - 1);
+	ExpectRefused("the last byte missing");
+
+	// The untouched record still loads after all that
+	WriteFile(record, (size_t)recordSize);
+	if (calibrationStoreLoad(&loaded) != 0) {
+		printf("FAIL: the rewritten record didn't load\n");
+		failures++;
+	}
+
+	if (calibrationStoreClockSet(0) || calibrationStoreClockSet(CALIBRATION_STORE_MIN_TIME_UTC - 1) ||
+		!calibrationStoreClockSet(CALIBRATION_STORE_MIN_TIME_UTC) || !calibrationStoreClockSet(saved.timeUtc)) {
+		printf("FAIL: a clock counting from boot should be told from a set one\n");
+		failures++;
+	}
+
+	unlink(CALIBRATION_STORE_PATH);
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,184 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lsm6dso_config.h"
+#include "lsm6dso_reg.h"
+
+#include "host_applibs.h"
+
+// Counts the bus transactions of the initI2c configuration written with the single register
+// setters and with the configuration image, on a counting fake bus, and checks that both leave
+// the device with the same registers.  The image is loaded from the fake device first so the
+// flush only writes what the configuration dirtied.
+
+// Setter chain transactions, one read and one write per setter
+#define EXPECTED_SETTER_TRANSACTIONS 18
+// CTRL1_XL..CTRL3_C and CTRL8_XL..CTRL9_XL
+#define EXPECTED_BURSTS 2
+
+typedef struct {
+	uint8_t regs[LSM6DSO_CONFIG_SIZE];
+	uint32_t transactions;
+	uint32_t writes;
+} fake_bus_t;
+
+static fake_bus_t bus;
+
+/// <summary>
+///     lsm6dso_ctx_t write_reg hook of the fake bus, an auto-increment burst when len > 1.
+/// </summary>
+static int32_t FakeWrite(int *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	(void)handle;
+
+	bus.transactions++;
+	bus.writes++;
+	memcpy(&bus.regs[reg], data, len);
+
+	return 0;
+}
+
+/// <summary>
+///     lsm6dso_ctx_t read_reg hook of the fake bus.
+/// </summary>
+static int32_t FakeRead(int *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	(void)handle;
+
+	bus.transactions++;
+	memcpy(data, &bus.regs[reg], len);
+
+	return 0;
+}
+
+/// <summary>
+///     Powers the fake device up with the register defaults.
+/// </summary>
+static void ResetFakeBus(void)
+{
+	memset(&bus, 0x00, sizeof(bus));
+	bus.regs[LSM6DSO_WHO_AM_I] = LSM6DSO_ID;
+	// IF_INC
+	bus.regs[LSM6DSO_CTRL3_C] = 0x04;
+	// DEN_X, DEN_Y, DEN_Z
+	bus.regs[LSM6DSO_CTRL9_XL] = 0xE0;
+}
+
+/// <summary>
+///     The initI2c configuration through the single register setters.
+/// </summary>
+/// <returns>0 on success, or -1 if a driver call failed</returns>
+static int SetterChain(lsm6dso_ctx_t *ctx)
+{
+	int32_t ret = 0;
+
+	ret |= lsm6dso_i3c_disable_set(ctx, LSM6DSO_I3C_DISABLE);
+	ret |= lsm6dso_block_data_update_set(ctx, PROPERTY_ENABLE);
+	ret |= lsm6dso_xl_data_rate_set(ctx, LSM6DSO_XL_ODR_12Hz5);
+	ret |= lsm6dso_gy_data_rate_set(ctx, LSM6DSO_GY_ODR_12Hz5);
+	ret |= lsm6dso_xl_full_scale_set(ctx, LSM6DSO_4g);
+	ret |= lsm6dso_gy_full_scale_set(ctx, LSM6DSO_2000dps);
+	ret |= lsm6dso_xl_hp_path_on_out_set(ctx, LSM6DSO_LP_ODR_DIV_100);
+	ret |= lsm6dso_xl_filter_lp2_set(ctx, PROPERTY_ENABLE);
+
+	return (ret == 0) ? 0 : -1;
+}
+
+/// <summary>
+///     The same configuration in the image.
+/// </summary>
+static void ConfigImage(lsm6dso_config_t *config)
+{
+	lsm6dsoConfigI3cDisable(config, LSM6DSO_I3C_DISABLE);
+	lsm6dsoConfigBlockDataUpdate(config, PROPERTY_ENABLE);
+	lsm6dsoConfigXlDataRate(config, LSM6DSO_XL_ODR_12Hz5);
+	lsm6dsoConfigGyDataRate(config, LSM6DSO_GY_ODR_12Hz5);
+	lsm6dsoConfigXlFullScale(config, LSM6DSO_4g);
+	lsm6dsoConfigGyFullScale(config, LSM6DSO_2000dps);
+	lsm6dsoConfigXlHpPathOnOut(config, LSM6DSO_LP_ODR_DIV_100);
+	lsm6dsoConfigXlFilterLp2(config, PROPERTY_ENABLE);
+}
+
+int main(void)
+{
+	int fd = 0;
+	lsm6dso_ctx_t ctx = { FakeWrite, FakeRead, &fd };
+	int failures = 0;
+
+	ResetFakeBus();
+	if (SetterChain(&ctx) != 0) {
+		printf("FAIL: setter chain on the fake bus\n");
+		return 1;
+	}
+	uint32_t setterTransactions = bus.transactions;
+	uint8_t setterRegs[LSM6DSO_CONFIG_SIZE];
+	memcpy(setterRegs, bus.regs, sizeof(setterRegs));
+
+	ResetFakeBus();
+	lsm6dso_config_t config;
+	if (lsm6dsoConfigLoad(&ctx, &config) != 0) {
+		printf("FAIL: loading the configuration image\n");
+		return 1;
+	}
+	bus.transactions = 0;
+	bus.writes = 0;
+
+	ConfigImage(&config);
+	int bursts = lsm6dsoConfigFlush(&ctx, &config);
+	printf("configuration: %u setter transactions, %d burst writes from the image in %u transactions\n",
+		setterTransactions, bursts, bus.transactions);
+
+	if (memcmp(setterRegs, bus.regs, sizeof(setterRegs)) != 0) {
+		printf("FAIL: the image left the device with different registers\n");
+		failures++;
+	}
+	if ((setterTransactions != EXPECTED_SETTER_TRANSACTIONS) || (bursts != EXPECTED_BURSTS) ||
+		(bus.transactions != EXPECTED_BURSTS) || (bus.writes != EXPECTED_BURSTS)) {
+		printf("FAIL: expected %d setter transactions and %d burst writes\n", EXPECTED_SETTER_TRANSACTIONS,
+			EXPECTED_BURSTS);
+		failures++;
+	}
+
+	// A clean image writes nothing
+	bus.transactions = 0;
+	bursts = lsm6dsoConfigFlush(&ctx, &config);
+	if ((bursts != 0) || (bus.transactions != 0)) {
+		printf("FAIL: flushing a clean image used %u transactions\n", bus.transactions);
+		failures++;
+	}
+
+	// Changing both output data rates at runtime dirties CTRL1_XL and CTRL2_G, one burst
+	bus.transactions = 0;
+	lsm6dsoConfigXlDataRate(&config, LSM6DSO_XL_ODR_104Hz);
+	lsm6dsoConfigGyDataRate(&config, LSM6DSO_GY_ODR_104Hz);
+	bursts = lsm6dsoConfigFlush(&ctx, &config);
+	printf("output data rate change: %d burst writes in %u transactions\n", bursts, bus.transactions);
+	if ((bursts != 1) || (bus.transactions != 1)) {
+		printf("FAIL: expected the output data rate change in one burst\n");
+		failures++;
+	}
+
+	// A device with auto-increment off gets IF_INC with a single register write before the bursts
+	ResetFakeBus();
+	bus.regs[LSM6DSO_CTRL3_C] = 0x00;
+	if (lsm6dsoConfigLoad(&ctx, &config) != 0) {
+		printf("FAIL: loading the configuration image\n");
+		return 1;
+	}
+	ConfigImage(&config);
+	bursts = lsm6dsoConfigFlush(&ctx, &config);
+	if ((bursts != EXPECTED_BURSTS + 1) || (memcmp(setterRegs, bus.regs, sizeof(setterRegs)) != 0)) {
+		printf("FAIL: flushing with auto-increment off took %d writes\n", bursts);
+		failures++;
+	}
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
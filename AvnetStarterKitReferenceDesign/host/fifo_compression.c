@@ -0,0 +1,370 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "i2c.h"
+#include "i2c_sim.h"
+#include "lsm6dso_fifo.h"
+#include "lsm6dso_fifo_decoder.h"
+#include "lsm6dso_reg.h"
+
+#include "host_applibs.h"
+
+// Checks the FIFO compression decoder twice.  First on hand-built words of every tag it
+// expands, NC, NC_T_1, NC_T_2, 2xC and 3xC, for the samples and slot times they decode to.
+// Then as a round trip through the application's platform layer on the register model: a
+// recorded trace is batched at 833 Hz with compression off and on, drained and decoded, and
+// every sample must come back as recorded.  The model only writes NC_T_2, 2xC and 3xC words
+// with compression on, which is why NC and NC_T_1 are covered by the hand-built words.  Bus
+// bytes read per sample are reported for both runs.
+
+#define ROUND_TRIP_DRAINS 20
+#define ROUND_TRIP_DRAIN_US 50000
+#define ROUND_TRIP_WATERMARK 64
+
+// Bus bytes read per sample, this trace reads 7.02 uncompressed and about 2.8 compressed
+#define MIN_UNCOMPRESSED_BYTES_PER_SAMPLE 7.0
+#define MAX_COMPRESSED_BYTES_PER_SAMPLE 3.0
+
+#define TRACE_SAMPLES 1000
+
+// Slot period of the hand-built words
+#define SLOT_NS 1000
+
+#define MAX_DECODED 16
+
+extern lsm6dso_ctx_t dev_ctx;
+
+static i2c_sim_trace_sample_t trace[TRACE_SAMPLES];
+
+static fifo_decoder_t decoder;
+
+static fifo_word_t decoded[MAX_DECODED];
+static int decodedCount;
+
+// Round trip state: raw tags drained, samples decoded and checked against the trace
+static uint32_t tagsSeen[LSM6DSO_SENSORHUB_NACK_TAG + 1];
+static int accelStart;
+static int gyroStart;
+static uint32_t accelSamples;
+static uint32_t gyroSamples;
+static uint32_t mismatches;
+
+static int failures;
+
+/// <summary>
+///     Keeps the words the decoder hands over.
+/// </summary>
+static void RecordWord(const fifo_word_t *word)
+{
+	if (decodedCount < MAX_DECODED) {
+		decoded[decodedCount] = *word;
+	}
+	decodedCount++;
+}
+
+static void MakeWord(fifo_word_t *word, lsm6dso_fifo_tag_t tag, uint64_t timeNs)
+{
+	memset(word, 0x00, sizeof(*word));
+	word->tag = tag;
+	word->timeNs = timeNs;
+}
+
+static void MakeUncompressed(fifo_word_t *word, lsm6dso_fifo_tag_t tag, uint64_t timeNs, int16_t x, int16_t y,
+	int16_t z)
+{
+	MakeWord(word, tag, timeNs);
+	word->data.i16bit[0] = x;
+	word->data.i16bit[1] = y;
+	word->data.i16bit[2] = z;
+}
+
+/// <summary>
+///     Packs two samples as int8_t differences, diffs[sample][axis].
+/// </summary>
+static void Make2xC(fifo_word_t *word, lsm6dso_fifo_tag_t tag, uint64_t timeNs, const int8_t diffs[2][3])
+{
+	MakeWord(word, tag, timeNs);
+	for (int i = 0; i < 2; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			word->data.u8bit[3 * i + axis] = (uint8_t)diffs[i][axis];
+		}
+	}
+}
+
+/// <summary>
+///     Packs three samples as 5 bit differences, diffs[sample][axis].
+/// </summary>
+static void Make3xC(fifo_word_t *word, lsm6dso_fifo_tag_t tag, uint64_t timeNs, const int8_t diffs[3][3])
+{
+	MakeWord(word, tag, timeNs);
+	for (int i = 0; i < 3; i++) {
+		uint16_t packed = 0;
+		for (int axis = 0; axis < 3; axis++) {
+			packed |= (uint16_t)((diffs[i][axis] & 0x1F) << (5 * axis));
+		}
+		word->data.u8bit[2 * i] = (uint8_t)(packed & 0xFF);
+		word->data.u8bit[2 * i + 1] = (uint8_t)(packed >> 8);
+	}
+}
+
+/// <summary>
+///     Decodes one word and checks the samples it expands to, expected[sample] is X, Y, Z and the
+///     time in slots.
+/// </summary>
+static void ExpectDecode(const char *name, const fifo_word_t *word, lsm6dso_fifo_tag_t outputTag, int count,
+	const int32_t expected[][4])
+{
+	decodedCount = 0;
+	int returned = lsm6dsoFifoDecode(&decoder, word, RecordWord);
+
+	if ((returned != count) || (decodedCount != count)) {
+		printf("FAIL: %s decoded to %d samples, expected %d\n", name, decodedCount, count);
+		failures++;
+		return;
+	}
+	for (int i = 0; i < count; i++) {
+		if ((decoded[i].tag != outputTag) || (decoded[i].data.i16bit[0] != expected[i][0]) ||
+			(decoded[i].data.i16bit[1] != expected[i][1]) || (decoded[i].data.i16bit[2] != expected[i][2]) ||
+			(decoded[i].timeNs != (uint64_t)expected[i][3] * SLOT_NS)) {
+			printf("FAIL: %s sample %d is %d %d %d at %llu ns, expected %d %d %d at %d ns\n", name, i,
+				decoded[i].data.i16bit[0], decoded[i].data.i16bit[1], decoded[i].data.i16bit[2],
+				(unsigned long long)decoded[i].timeNs, expected[i][0], expected[i][1], expected[i][2],
+				expected[i][3] * SLOT_NS);
+			failures++;
+			return;
+		}
+	}
+}
+
+/// <summary>
+///     Every tag on hand-built words, each sample rebuilt from the one before it.
+/// </summary>
+static void CheckDecoder(void)
+{
+	fifo_word_t word;
+
+	initLsm6dsoFifoDecoder(&decoder, SLOT_NS);
+
+	// Compressed words without a reference are dropped
+	const int8_t anyDiffs[3][3] = { { 1, 1, 1 }, { 1, 1, 1 }, { 1, 1, 1 } };
+	Make3xC(&word, LSM6DSO_XL_3XC_TAG, 5 * SLOT_NS, anyDiffs);
+	ExpectDecode("3xC before a reference", &word, LSM6DSO_XL_NC_TAG, 0, NULL);
+
+	MakeUncompressed(&word, LSM6DSO_XL_NC_TAG, 10 * SLOT_NS, 100, 200, 300);
+	const int32_t nc[1][4] = { { 100, 200, 300, 10 } };
+	ExpectDecode("NC", &word, LSM6DSO_XL_NC_TAG, 1, nc);
+
+	const int8_t diffs2[2][3] = { { 1, -2, 3 }, { -128, 127, -6 } };
+	Make2xC(&word, LSM6DSO_XL_2XC_TAG, 13 * SLOT_NS, diffs2);
+	const int32_t twoC[2][4] = { { 101, 198, 303, 11 }, { -27, 325, 297, 12 } };
+	ExpectDecode("2xC", &word, LSM6DSO_XL_NC_TAG, 2, twoC);
+
+	// The 5 bit limits, -16 and 15
+	const int8_t diffs3[3][3] = { { 1, 2, 3 }, { -1, -2, -3 }, { 15, -16, 0 } };
+	Make3xC(&word, LSM6DSO_XL_3XC_TAG, 16 * SLOT_NS, diffs3);
+	const int32_t threeC[3][4] = { { -26, 327, 300, 14 }, { -27, 325, 297, 15 }, { -12, 309, 297, 16 } };
+	ExpectDecode("3xC", &word, LSM6DSO_XL_NC_TAG, 3, threeC);
+
+	MakeUncompressed(&word, LSM6DSO_XL_NC_T_1_TAG, 18 * SLOT_NS, -5, 6, -7);
+	const int32_t ncT1[1][4] = { { -5, 6, -7, 17 } };
+	ExpectDecode("NC_T_1", &word, LSM6DSO_XL_NC_TAG, 1, ncT1);
+
+	MakeUncompressed(&word, LSM6DSO_XL_NC_T_2_TAG, 21 * SLOT_NS, 8, -9, 10);
+	const int32_t ncT2[1][4] = { { 8, -9, 10, 19 } };
+	ExpectDecode("NC_T_2", &word, LSM6DSO_XL_NC_TAG, 1, ncT2);
+
+	// The gyroscope has its own reference
+	Make2xC(&word, LSM6DSO_GYRO_2XC_TAG, 22 * SLOT_NS, diffs2);
+	ExpectDecode("gyroscope 2xC before a reference", &word, LSM6DSO_GYRO_NC_TAG, 0, NULL);
+
+	MakeUncompressed(&word, LSM6DSO_GYRO_NC_T_1_TAG, 24 * SLOT_NS, -1000, 0, 1000);
+	const int32_t gyroNcT1[1][4] = { { -1000, 0, 1000, 23 } };
+	ExpectDecode("gyroscope NC_T_1", &word, LSM6DSO_GYRO_NC_TAG, 1, gyroNcT1);
+
+	Make3xC(&word, LSM6DSO_GYRO_3XC_TAG, 27 * SLOT_NS, diffs3);
+	const int32_t gyroThreeC[3][4] = { { -999, 2, 1003, 25 }, { -1000, 0, 1000, 26 }, { -985, -16, 1000, 27 } };
+	ExpectDecode("gyroscope 3xC", &word, LSM6DSO_GYRO_NC_TAG, 3, gyroThreeC);
+
+	// Anything else goes through unchanged
+	MakeUncompressed(&word, LSM6DSO_TIMESTAMP_TAG, 28 * SLOT_NS, 1, 2, 3);
+	const int32_t timestamp[1][4] = { { 1, 2, 3, 28 } };
+	ExpectDecode("timestamp", &word, LSM6DSO_TIMESTAMP_TAG, 1, timestamp);
+
+	if ((decoder.droppedWords != 2) || (decoder.compressedWords != 3) || (decoder.samples != 12)) {
+		printf("FAIL: decoder counted %u dropped, %u compressed words and %u samples\n", decoder.droppedWords,
+			decoder.compressedWords, decoder.samples);
+		failures++;
+	}
+}
+
+/// <summary>
+///     Recorded motion that exercises every compressed word: the accelerometer X axis and the
+///     gyroscope Y axis count the sample index so a decoded sample identifies its trace entry,
+///     the other axes mostly move by a few LSB, with steps that need 2xC and jumps that need an
+///     uncompressed word.
+/// </summary>
+static void MakeTrace(void)
+{
+	uint32_t seed = 3;
+
+	for (int i = 0; i < TRACE_SAMPLES; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			seed = seed * 1664525U + 1013904223U;
+			int noise = (int)((seed >> 16) % 7) - 3;
+			trace[i].accel[axis] = (int16_t)(1000 * axis + noise + (((i % 13) == 0) ? 60 : 0) +
+				(((i % 97) == 0) ? 3000 : 0));
+			trace[i].gyro[axis] = (int16_t)((i % 50) - 25 + noise);
+		}
+		trace[i].accel[0] = (int16_t)i;
+		trace[i].gyro[1] = (int16_t)-i;
+	}
+}
+
+/// <summary>
+///     Compares a decoded sample with the trace entry after the one the previous sample matched,
+///     the first sample of a run fixes where the replay started.
+/// </summary>
+static void CheckTraceSample(const int16_t *expected, const int16_t *sample)
+{
+	if (memcmp(expected, sample, 3 * sizeof(int16_t)) != 0) {
+		mismatches++;
+	}
+}
+
+static void CheckDecodedWord(const fifo_word_t *word)
+{
+	if (word->tag == LSM6DSO_XL_NC_TAG) {
+		if (accelStart < 0) {
+			accelStart = word->data.i16bit[0];
+		}
+		CheckTraceSample(trace[(uint32_t)(accelStart + (int)accelSamples) % TRACE_SAMPLES].accel, word->data.i16bit);
+		accelSamples++;
+	}
+	else if (word->tag == LSM6DSO_GYRO_NC_TAG) {
+		if (gyroStart < 0) {
+			gyroStart = -word->data.i16bit[1];
+		}
+		CheckTraceSample(trace[(uint32_t)(gyroStart + (int)gyroSamples) % TRACE_SAMPLES].gyro, word->data.i16bit);
+		gyroSamples++;
+	}
+}
+
+/// <summary>
+///     Counts the raw tag of each drained word before it is decoded.
+/// </summary>
+static void DecodeFifoWord(const fifo_word_t *word)
+{
+	if (word->tag <= LSM6DSO_SENSORHUB_NACK_TAG) {
+		tagsSeen[word->tag]++;
+	}
+	lsm6dsoFifoDecode(&decoder, word, CheckDecodedWord);
+}
+
+/// <summary>
+///     Batches the trace with compression at rate, or off with LSM6DSO_CMP_DISABLE, and drains and
+///     decodes it.
+/// </summary>
+/// <returns>Bus bytes read per sample, or a negative value if the FIFO couldn't be set up or drained</returns>
+static double RunRoundTrip(lsm6dso_uncoptr_rate_t rate)
+{
+	memset(tagsSeen, 0x00, sizeof(tagsSeen));
+	accelStart = -1;
+	gyroStart = -1;
+	accelSamples = 0;
+	gyroSamples = 0;
+	mismatches = 0;
+	initLsm6dsoFifoDecoder(&decoder, 0);
+
+	if ((lsm6dsoFifoCompressionSet(&dev_ctx, rate) != 0) ||
+		(initLsm6dsoFifo(&dev_ctx, ROUND_TRIP_WATERMARK, LSM6DSO_XL_BATCHED_AT_833Hz, LSM6DSO_GY_BATCHED_AT_833Hz) != 0)) {
+		return -1.0;
+	}
+
+	uint32_t bytesRead = getI2cSimStats()->bytesRead;
+	for (int i = 0; i < ROUND_TRIP_DRAINS; i++) {
+		usleep(ROUND_TRIP_DRAIN_US);
+		if (drainLsm6dsoFifo(&dev_ctx, DecodeFifoWord) < 0) {
+			return -1.0;
+		}
+	}
+	bytesRead = getI2cSimStats()->bytesRead - bytesRead;
+
+	lsm6dso_fifo_mode_set(&dev_ctx, LSM6DSO_BYPASS_MODE);
+
+	uint32_t samples = accelSamples + gyroSamples;
+	return (samples > 0) ? (double)bytesRead / (double)samples : 0.0;
+}
+
+static void ExpectTags(const char *run, const lsm6dso_fifo_tag_t *tags, int count)
+{
+	for (int i = 0; i < count; i++) {
+		if (tagsSeen[tags[i]] == 0) {
+			printf("FAIL: no words with tag 0x%02X %s\n", tags[i], run);
+			failures++;
+		}
+	}
+}
+
+static void ExpectRoundTrip(const char *run)
+{
+	printf("%s: %u accelerometer and %u gyroscope samples, %u compressed words, %u dropped\n", run,
+		accelSamples, gyroSamples, decoder.compressedWords, decoder.droppedWords);
+	if ((accelSamples == 0) || (gyroSamples == 0) || (mismatches > 0) || (decoder.droppedWords > 0)) {
+		printf("FAIL: %u samples decoded %s don't match the trace\n", mismatches, run);
+		failures++;
+	}
+}
+
+int main(void)
+{
+	CheckDecoder();
+
+	MakeTrace();
+	i2cSimSetTrace(trace, TRACE_SAMPLES);
+
+	epollFd = CreateEpollFd();
+	if ((epollFd < 0) || (initI2c() != 0)) {
+		printf("FAIL: initI2c\n");
+		return 1;
+	}
+	lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_833Hz);
+	lsm6dso_gy_data_rate_set(&dev_ctx, LSM6DSO_GY_ODR_833Hz);
+
+	double uncompressed = RunRoundTrip(LSM6DSO_CMP_DISABLE);
+	ExpectRoundTrip("uncompressed");
+	const lsm6dso_fifo_tag_t uncompressedTags[] = { LSM6DSO_XL_NC_TAG, LSM6DSO_GYRO_NC_TAG };
+	ExpectTags("uncompressed", uncompressedTags, 2);
+
+	double compressed = RunRoundTrip(LSM6DSO_CMP_16_TO_1);
+	ExpectRoundTrip("compressed");
+	const lsm6dso_fifo_tag_t compressedTags[] = { LSM6DSO_XL_NC_T_2_TAG, LSM6DSO_XL_2XC_TAG, LSM6DSO_XL_3XC_TAG,
+		LSM6DSO_GYRO_NC_T_2_TAG, LSM6DSO_GYRO_2XC_TAG, LSM6DSO_GYRO_3XC_TAG };
+	ExpectTags("compressed", compressedTags, 6);
+
+	lsm6dsoFifoCompressionSet(&dev_ctx, LSM6DSO_CMP_DISABLE);
+	closeI2c();
+	i2cSimSetTrace(NULL, 0);
+
+	printf("bus bytes read per sample: %.2f uncompressed, %.2f compressed\n", uncompressed, compressed);
+	if ((uncompressed < 0.0) || (compressed < 0.0)) {
+		printf("FAIL: FIFO drain\n");
+		return 1;
+	}
+	if ((uncompressed < MIN_UNCOMPRESSED_BYTES_PER_SAMPLE) || (compressed > MAX_COMPRESSED_BYTES_PER_SAMPLE)) {
+		printf("FAIL: expected at least %.2f bytes per sample uncompressed and at most %.2f compressed\n",
+			MIN_UNCOMPRESSED_BYTES_PER_SAMPLE, MAX_COMPRESSED_BYTES_PER_SAMPLE);
+		failures++;
+	}
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,208 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "i2c.h"
+#include "i2c_sim.h"
+#include "lsm6dso_fifo.h"
+#include "lsm6dso_reg.h"
+
+#include "host_applibs.h"
+
+// Reads the accelerometer and gyroscope at BENCHMARK_ODR_HZ for BENCHMARK_SECONDS, first by
+// waking once per output data period and reading each sensor whose data-ready flag is set, as
+// the accelerometer timer does, then by letting the FIFO batch the samples and draining it with
+// burst reads once per watermark.  Both run through the application's platform layer on the
+// register model, and report the samples read, I2C calls, bus bytes and CPU time per sample.
+
+#define BENCHMARK_SECONDS 2
+
+#define BENCHMARK_ODR_HZ 416
+#define BENCHMARK_XL_ODR LSM6DSO_XL_ODR_417Hz
+#define BENCHMARK_GY_ODR LSM6DSO_GY_ODR_417Hz
+#define BENCHMARK_XL_BATCH LSM6DSO_XL_BATCHED_AT_417Hz
+#define BENCHMARK_GY_BATCH LSM6DSO_GY_BATCHED_AT_417Hz
+
+// FIFO words, accelerometer and gyroscope together, between two drains
+#define BENCHMARK_WATERMARK 64
+
+extern lsm6dso_ctx_t dev_ctx;
+
+typedef struct {
+	uint32_t produced;
+	uint32_t read;
+	uint32_t wakeups;
+	uint32_t i2cCalls;
+	uint32_t busBytes;
+	double cpuNs;
+} result_t;
+
+static uint32_t fifoSamples;
+
+static uint64_t CpuNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+static uint32_t SamplesProduced(void)
+{
+	return getI2cSimStats()->accelSamples + getI2cSimStats()->gyroSamples;
+}
+
+static uint32_t BusBytes(void)
+{
+	return getI2cSimStats()->bytesWritten + getI2cSimStats()->bytesRead;
+}
+
+/// <summary>
+///     Counts the accelerometer and gyroscope words drained from the FIFO.
+/// </summary>
+static void CountFifoWord(const fifo_word_t *word)
+{
+	if ((word->tag == LSM6DSO_XL_NC_TAG) || (word->tag == LSM6DSO_GYRO_NC_TAG)) {
+		fifoSamples++;
+	}
+}
+
+/// <summary>
+///     Starts a measurement, the samples produced so far don't count.
+/// </summary>
+static void Start(result_t *result)
+{
+	memset(result, 0x00, sizeof(*result));
+	result->produced = SamplesProduced();
+	result->i2cCalls = getHostStats()->i2cCalls;
+	result->busBytes = BusBytes();
+}
+
+static void Stop(result_t *result)
+{
+	result->produced = SamplesProduced() - result->produced;
+	result->i2cCalls = getHostStats()->i2cCalls - result->i2cCalls;
+	result->busBytes = BusBytes() - result->busBytes;
+}
+
+/// <summary>
+///     Wakes once per output data period and reads every sensor whose data-ready flag is set.
+/// </summary>
+static void RunPolling(result_t *result)
+{
+	uint32_t periodUs = 1000000 / BENCHMARK_ODR_HZ;
+
+	Start(result);
+	for (uint32_t i = 0; i < BENCHMARK_SECONDS * BENCHMARK_ODR_HZ; i++) {
+		usleep(periodUs);
+
+		uint64_t start = CpuNs();
+		uint8_t ready;
+		axis3bit16_t raw;
+
+		lsm6dso_xl_flag_data_ready_get(&dev_ctx, &ready);
+		if (ready) {
+			lsm6dso_acceleration_raw_get(&dev_ctx, raw.u8bit);
+			result->read++;
+		}
+		lsm6dso_gy_flag_data_ready_get(&dev_ctx, &ready);
+		if (ready) {
+			lsm6dso_angular_rate_raw_get(&dev_ctx, raw.u8bit);
+			result->read++;
+		}
+
+		result->cpuNs += (double)(CpuNs() - start);
+		result->wakeups++;
+	}
+	Stop(result);
+}
+
+/// <summary>
+///     Wakes once per watermark and drains the FIFO.
+/// </summary>
+/// <returns>0 on success, or -1 if the FIFO couldn't be set up or drained</returns>
+static int RunFifo(result_t *result)
+{
+	uint32_t periodUs = (uint32_t)(1000000ULL * BENCHMARK_WATERMARK / (2 * BENCHMARK_ODR_HZ));
+
+	if (initLsm6dsoFifo(&dev_ctx, BENCHMARK_WATERMARK, BENCHMARK_XL_BATCH, BENCHMARK_GY_BATCH) != 0) {
+		return -1;
+	}
+
+	fifoSamples = 0;
+	Start(result);
+	for (uint32_t elapsedUs = 0; elapsedUs < BENCHMARK_SECONDS * 1000000; elapsedUs += periodUs) {
+		usleep(periodUs);
+
+		uint64_t start = CpuNs();
+		if (drainLsm6dsoFifo(&dev_ctx, CountFifoWord) < 0) {
+			return -1;
+		}
+		result->cpuNs += (double)(CpuNs() - start);
+		result->wakeups++;
+	}
+	Stop(result);
+	result->read = fifoSamples;
+
+	lsm6dso_fifo_mode_set(&dev_ctx, LSM6DSO_BYPASS_MODE);
+	return 0;
+}
+
+static void Print(const char *name, const result_t *result)
+{
+	double read = (double)result->read;
+
+	printf("%-8s %4u wakeups, %5u of %5u samples read, %.3f I2C calls, %.2f bus bytes, %.0f ns CPU per sample\n",
+		name, result->wakeups, result->read, result->produced, (double)result->i2cCalls / read,
+		(double)result->busBytes / read, result->cpuNs / read);
+}
+
+int main(void)
+{
+	epollFd = CreateEpollFd();
+	if ((epollFd < 0) || (initI2c() != 0)) {
+		printf("FAIL: initI2c\n");
+		return 1;
+	}
+
+	lsm6dso_xl_data_rate_set(&dev_ctx, BENCHMARK_XL_ODR);
+	lsm6dso_gy_data_rate_set(&dev_ctx, BENCHMARK_GY_ODR);
+
+	result_t polling;
+	result_t fifo;
+
+	RunPolling(&polling);
+	int fifoResult = RunFifo(&fifo);
+	closeI2c();
+
+	if (fifoResult != 0) {
+		printf("FAIL: FIFO drain\n");
+		return 1;
+	}
+
+	Print("polling", &polling);
+	Print("fifo", &fifo);
+
+	int failures = 0;
+
+	// Samples batched before the first drain are read within the window, allow for them and
+	// for the ones still queued at the end
+	if ((fifo.read < fifo.produced * 95 / 100) || (fifo.read > fifo.produced + BENCHMARK_WATERMARK)) {
+		printf("FAIL: the FIFO drain should read every sample produced\n");
+		failures++;
+	}
+	if ((polling.read == 0) || (fifo.i2cCalls * polling.read >= polling.i2cCalls * fifo.read)) {
+		printf("FAIL: the FIFO drain should take fewer I2C calls per sample than polling\n");
+		failures++;
+	}
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
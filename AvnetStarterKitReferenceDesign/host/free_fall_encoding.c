@@ -0,0 +1,135 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "lsm6dso_config.h"
+#include "lsm6dso_events.h"
+
+#include "host_applibs.h"
+
+// Puts the free-fall and shock settings the capture triggers on in a configuration image and
+// checks the register fields against the LSM6DSO encodings: the nearest of the eight free-fall
+// thresholds, the free-fall duration in samples split over FREE_FALL and WAKE_UP_DUR, and the
+// shock threshold on the wake-up engine.  The settings handed back must be the ones the
+// registers apply.
+
+#define ODR_HZ 416.0f
+
+// The settings handed back are worked out in float
+#define MAX_SETTING_ERROR 0.001f
+
+static int failures;
+
+typedef struct {
+	const char *name;
+	lsm6dso_free_fall_config_t freeFall;
+	uint8_t threshold;
+	uint8_t samples;
+	float thresholdMg;
+} free_fall_case_t;
+
+static const free_fall_case_t freeFallCases[] = {
+	{ "below the range", { 50.0f, 0.0f }, 0, 0, 156.0f },
+	// 300 mg lies between 250 and 312, 31 ms is 12.9 samples
+	{ "between steps", { 300.0f, 31.0f }, 3, 13, 312.0f },
+	// 100 ms is 41.6 samples, past the 5 bits in FREE_FALL
+	{ "high duration bit", { 469.0f, 100.0f }, 6, 42, 469.0f },
+	{ "above the range", { 1000.0f, 1000.0f }, 7, 63, 500.0f },
+};
+
+typedef struct {
+	const char *name;
+	int fullScaleG;
+	lsm6dso_shock_config_t shock;
+	uint8_t threshold;
+	uint8_t thresholdWeight;
+	uint8_t samples;
+	float thresholdMg;
+} shock_case_t;
+
+static const shock_case_t shockCases[] = {
+	// 2000 mg is 64 fine steps at 8 g, one too many, and 16 coarse ones
+	{ "8 g", 8, { 2000.0f, 1 }, 16, 0, 1, 2000.0f },
+	{ "16 g, fine", 16, { 3000.0f, 5 }, 48, 1, 3, 3000.0f },
+};
+
+/// <summary>
+///     Applies one free-fall case to a default image and checks the fields and the settings handed
+///     back.
+/// </summary>
+static void CheckFreeFallCase(const free_fall_case_t *freeFallCase)
+{
+	lsm6dso_config_t config;
+	lsm6dso_free_fall_config_t freeFall = freeFallCase->freeFall;
+
+	lsm6dsoConfigDefaults(&config);
+	lsm6dsoEventsConfigFreeFall(&config, &freeFall, ODR_HZ);
+
+	const lsm6dso_free_fall_t *freeFallReg = (const lsm6dso_free_fall_t *)lsm6dsoConfigReg(&config, LSM6DSO_FREE_FALL);
+	const lsm6dso_wake_up_dur_t *wakeUpDur = (const lsm6dso_wake_up_dur_t *)lsm6dsoConfigReg(&config,
+		LSM6DSO_WAKE_UP_DUR);
+	uint8_t samples = (uint8_t)((wakeUpDur->ff_dur << 5) | freeFallReg->ff_dur);
+
+	printf("%-18s threshold %u (%.0f mg), duration %2u samples (%.3f ms)\n", freeFallCase->name, freeFallReg->ff_ths,
+		freeFall.thresholdMg, samples, freeFall.durationMs);
+
+	if ((freeFallReg->ff_ths != freeFallCase->threshold) || (samples != freeFallCase->samples)) {
+		printf("FAIL: %s: expected threshold %u and %u samples\n", freeFallCase->name, freeFallCase->threshold,
+			freeFallCase->samples);
+		failures++;
+	}
+	float durationMs = (float)freeFallCase->samples * 1000.0f / ODR_HZ;
+	if ((freeFall.thresholdMg != freeFallCase->thresholdMg) ||
+		(fabsf(freeFall.durationMs - durationMs) > MAX_SETTING_ERROR)) {
+		printf("FAIL: %s: expected %.0f mg and %.3f ms handed back\n", freeFallCase->name, freeFallCase->thresholdMg,
+			durationMs);
+		failures++;
+	}
+}
+
+/// <summary>
+///     Applies one shock case to a default image and checks the fields and the settings handed back.
+/// </summary>
+static void CheckShockCase(const shock_case_t *shockCase)
+{
+	lsm6dso_config_t config;
+	lsm6dso_shock_config_t shock = shockCase->shock;
+
+	lsm6dsoConfigDefaults(&config);
+	lsm6dsoEventsConfigShock(&config, &shock, shockCase->fullScaleG);
+
+	const lsm6dso_wake_up_ths_t *wakeUpThs = (const lsm6dso_wake_up_ths_t *)lsm6dsoConfigReg(&config,
+		LSM6DSO_WAKE_UP_THS);
+	const lsm6dso_wake_up_dur_t *wakeUpDur = (const lsm6dso_wake_up_dur_t *)lsm6dsoConfigReg(&config,
+		LSM6DSO_WAKE_UP_DUR);
+
+	printf("%-18s threshold %u weight %u (%.0f mg), %u samples\n", shockCase->name, wakeUpThs->wk_ths,
+		wakeUpDur->wake_ths_w, shock.thresholdMg, wakeUpDur->wake_dur);
+
+	if ((wakeUpThs->wk_ths != shockCase->threshold) || (wakeUpDur->wake_ths_w != shockCase->thresholdWeight) ||
+		(wakeUpDur->wake_dur != shockCase->samples) || (shock.samples != shockCase->samples) ||
+		(fabsf(shock.thresholdMg - shockCase->thresholdMg) > MAX_SETTING_ERROR)) {
+		printf("FAIL: %s: expected threshold %u weight %u (%.0f mg), %u samples\n", shockCase->name,
+			shockCase->threshold, shockCase->thresholdWeight, shockCase->thresholdMg, shockCase->samples);
+		failures++;
+	}
+}
+
+int main(void)
+{
+	for (size_t i = 0; i < sizeof(freeFallCases) / sizeof(freeFallCases[0]); i++) {
+		CheckFreeFallCase(&freeFallCases[i]);
+	}
+	for (size_t i = 0; i < sizeof(shockCases) / sizeof(shockCases[0]); i++) {
+		CheckShockCase(&shockCases[i]);
+	}
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
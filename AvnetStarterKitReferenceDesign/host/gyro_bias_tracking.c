@@ -0,0 +1,162 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "gyro_bias.h"
+
+#include "host_applibs.h"
+
+// Feeds the gyroscope offset tracker windows of synthetic samples, converted the way
+// AccumulateGyroBatch converts them with the current estimate subtracted.  After a failed startup
+// calibration the tracker starts from zero offsets and has to converge on a bias larger than the
+// residual limit.  With a valid calibration a slow steady turn must still be kept out by the
+// residual limit, and a board that moves must never count as still.
+
+#define WINDOW_SAMPLES 64
+#define GAIN 0.05f
+#define STILL_ACCEL_MG 10.0f
+#define STILL_GYRO_DPS 0.5f
+#define MAX_RESIDUAL_DPS 1.0f
+#define TEMPERATURE_DEGC 25.0f
+
+#define CONVERGE_WINDOWS 50
+#define MAX_BIAS_ERROR_DPS 0.02f
+
+// Peak to peak noise added to every axis
+#define GYRO_NOISE_DPS 0.1f
+#define ACCEL_NOISE_MG 2.0f
+
+static float accel[3][WINDOW_SAMPLES];
+static float gyro[3][WINDOW_SAMPLES];
+static uint32_t seed = 1;
+
+static int failures;
+
+static float Noise(float peakToPeak)
+{
+	seed = seed * 1664525U + 1013904223U;
+	return peakToPeak * ((float)(seed >> 16) / 65535.0f - 0.5f);
+}
+
+/// <summary>
+///     Feeds one window at rest, gyroscope rates rateDps plus noise, and swingDps added to every
+///     other sample when the board moves.  The rates are converted with appliedDps subtracted and
+///     appliedDps follows the estimate, as in the application.
+/// </summary>
+/// <returns>true if the window updated the offsets</returns>
+static bool FeedWindow(gyro_bias_t *tracker, const float rateDps[3], float swingDps, float appliedDps[3])
+{
+	for (int i = 0; i < WINDOW_SAMPLES; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			accel[axis][i] = ((axis == 2) ? 1000.0f : 0.0f) + Noise(ACCEL_NOISE_MG);
+			gyro[axis][i] = rateDps[axis] + Noise(GYRO_NOISE_DPS) + (((i & 1) != 0) ? swingDps : -swingDps) -
+				appliedDps[axis];
+		}
+	}
+
+	gyroBiasAddAccel(tracker, accel[0], accel[1], accel[2], WINDOW_SAMPLES);
+	bool updated = gyroBiasAddGyro(tracker, gyro[0], gyro[1], gyro[2], WINDOW_SAMPLES, appliedDps);
+	if (updated) {
+		gyroBiasEstimate(tracker, TEMPERATURE_DEGC, appliedDps);
+	}
+	return updated;
+}
+
+static void InitTracker(gyro_bias_t *tracker, const float biasDps[3], bool biasValid)
+{
+	initGyroBias(tracker, biasDps, biasValid, TEMPERATURE_DEGC, WINDOW_SAMPLES, GAIN, STILL_ACCEL_MG, STILL_GYRO_DPS,
+		MAX_RESIDUAL_DPS, 0.0f, 1.0f);
+}
+
+static void ExpectBias(const char *name, const float estimateDps[3], const float expectedDps[3])
+{
+	for (int axis = 0; axis < 3; axis++) {
+		if (fabsf(estimateDps[axis] - expectedDps[axis]) > MAX_BIAS_ERROR_DPS) {
+			printf("FAIL: %s: axis %d offset is %.3f dps, expected %.3f\n", name, axis, estimateDps[axis],
+				expectedDps[axis]);
+			failures++;
+			return;
+		}
+	}
+}
+
+/// <summary>
+///     Startup calibration failed, the tracker starts from zero with a bias above the residual limit.
+/// </summary>
+static void CheckFailedCalibration(void)
+{
+	const float biasDps[3] = { 2.5f, -1.8f, 1.2f };
+	const float zero[3] = { 0.0f, 0.0f, 0.0f };
+	float appliedDps[3] = { 0.0f, 0.0f, 0.0f };
+	gyro_bias_t tracker;
+
+	InitTracker(&tracker, zero, false);
+
+	// Moving windows don't count even without an estimate to compare with
+	if (FeedWindow(&tracker, biasDps, 2.0f, appliedDps)) {
+		printf("FAIL: failed calibration: a moving window was taken as still\n");
+		failures++;
+	}
+	ExpectBias("failed calibration, after moving", appliedDps, zero);
+
+	for (int i = 0; i < CONVERGE_WINDOWS; i++) {
+		FeedWindow(&tracker, biasDps, 0.0f, appliedDps);
+	}
+
+	const gyro_bias_stats_t *stats = getGyroBiasStats(&tracker);
+	printf("failed calibration: %u of %u windows still, offsets %.3f, %.3f, %.3f dps\n", stats->stillWindows,
+		stats->windows, appliedDps[0], appliedDps[1], appliedDps[2]);
+	if (stats->stillWindows != CONVERGE_WINDOWS) {
+		printf("FAIL: failed calibration: every window at rest should be still\n");
+		failures++;
+	}
+	ExpectBias("failed calibration", appliedDps, biasDps);
+}
+
+/// <summary>
+///     Startup calibration succeeded, a slow steady turn past the residual limit is kept out.
+/// </summary>
+static void CheckValidCalibration(void)
+{
+	const float biasDps[3] = { 2.5f, -1.8f, 1.2f };
+	const float turnDps[3] = { 2.5f, -1.8f, 1.2f + 3.0f };
+	float appliedDps[3] = { 2.5f, -1.8f, 1.2f };
+	gyro_bias_t tracker;
+
+	InitTracker(&tracker, biasDps, true);
+
+	for (int i = 0; i < CONVERGE_WINDOWS; i++) {
+		if (FeedWindow(&tracker, turnDps, 0.0f, appliedDps)) {
+			printf("FAIL: valid calibration: a steady turn was taken as still\n");
+			failures++;
+			break;
+		}
+	}
+	for (int i = 0; i < CONVERGE_WINDOWS; i++) {
+		FeedWindow(&tracker, biasDps, 0.0f, appliedDps);
+	}
+
+	const gyro_bias_stats_t *stats = getGyroBiasStats(&tracker);
+	printf("valid calibration: %u of %u windows still, offsets %.3f, %.3f, %.3f dps\n", stats->stillWindows,
+		stats->windows, appliedDps[0], appliedDps[1], appliedDps[2]);
+	if (stats->stillWindows != CONVERGE_WINDOWS) {
+		printf("FAIL: valid calibration: only the windows at rest should be still\n");
+		failures++;
+	}
+	ExpectBias("valid calibration", appliedDps, biasDps);
+}
+
+int main(void)
+{
+	CheckFailedCalibration();
+	CheckValidCalibration();
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,162 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "gyro_calibration.h"
+#include "i2c.h"
+#include "i2c_sim.h"
+#include "lsm6dso_reg.h"
+
+#include "host_applibs.h"
+
+// Runs the gyroscope calibration on the register model replaying recorded samples.  With the
+// board still, the first capture must give the mean of the trace in dps.  With the board turning
+// back and forth, every capture must be rejected and the calibration must give up within its
+// timeout, with no offsets.
+
+#define TRACE_SAMPLES 64
+
+// 2000 dps full scale
+#define MDPS_PER_LSB 70.0f
+
+#define CAL_RATE_HZ 416.0f
+#define CAL_SAMPLES 128
+#define MAX_STDDEV_DPS 0.5f
+#define SETTLE_MS 10
+#define TIMEOUT_MS 1000
+
+// Time a capture may take past the timeout, for the register reads after the last sample
+#define MAX_OVERRUN_MS 100
+
+#define MAX_BIAS_ERROR_DPS 0.01f
+
+static const int16_t biasLsb[3] = { 143, -71, 29 };
+
+static i2c_sim_trace_sample_t trace[TRACE_SAMPLES];
+static int failures;
+
+extern lsm6dso_ctx_t dev_ctx;
+
+/// <summary>
+///     Fills the trace with the offsets plus noise of +-2 LSB, or a turn of +-swingLsb every
+///     other sample.
+/// </summary>
+static void MakeTrace(int16_t swingLsb)
+{
+	for (int i = 0; i < TRACE_SAMPLES; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			int16_t noise = (int16_t)(((i * 7 + axis * 3) % 5) - 2);
+			trace[i].accel[axis] = (axis == 2) ? 16384 : 0;
+			trace[i].gyro[axis] = (int16_t)(biasLsb[axis] + noise + (((i & 1) != 0) ? swingLsb : -swingLsb));
+		}
+	}
+}
+
+/// <summary>
+///     The mean of the trace in dps, which is what the captures average over whole trace loops.
+/// </summary>
+static float TraceMeanDps(int axis)
+{
+	int32_t sum = 0;
+	for (int i = 0; i < TRACE_SAMPLES; i++) {
+		sum += trace[i].gyro[axis];
+	}
+	return (float)sum / TRACE_SAMPLES * MDPS_PER_LSB / 1000.0f;
+}
+
+static int Calibrate(gyro_calibration_t *result)
+{
+	const gyro_calibration_config_t config = {
+		.rateHz = CAL_RATE_HZ,
+		.samples = CAL_SAMPLES,
+		.mdpsPerLsb = MDPS_PER_LSB,
+		.maxStdDevDps = MAX_STDDEV_DPS,
+		.settleMs = SETTLE_MS,
+		.timeoutMs = TIMEOUT_MS
+	};
+
+	// Only the gyroscope batched, as CalibrateGyroBias sets up
+	lsm6dso_fifo_mode_set(&dev_ctx, LSM6DSO_BYPASS_MODE);
+	lsm6dso_fifo_xl_batch_set(&dev_ctx, LSM6DSO_XL_NOT_BATCHED);
+	lsm6dso_fifo_gy_batch_set(&dev_ctx, LSM6DSO_GY_BATCHED_AT_417Hz);
+	lsm6dso_gy_data_rate_set(&dev_ctx, LSM6DSO_GY_ODR_417Hz);
+
+	int ret = calibrateGyro(&dev_ctx, &config, result);
+
+	lsm6dso_fifo_mode_set(&dev_ctx, LSM6DSO_BYPASS_MODE);
+	lsm6dso_fifo_gy_batch_set(&dev_ctx, LSM6DSO_GY_NOT_BATCHED);
+	return ret;
+}
+
+static void PrintResult(const char *name, int ret, const gyro_calibration_t *result)
+{
+	printf("%s: returned %d, offsets %.3f, %.3f, %.3f dps, standard deviation %.3f, %.3f, %.3f dps, %u captures, "
+		"%u rejected, %u ms\n", name, ret, result->biasDps[0], result->biasDps[1], result->biasDps[2],
+		result->stdDevDps[0], result->stdDevDps[1], result->stdDevDps[2], result->attempts, result->rejected,
+		result->durationMs);
+}
+
+int main(void)
+{
+	gyro_calibration_t result;
+
+	MakeTrace(0);
+	i2cSimSetTrace(trace, TRACE_SAMPLES);
+
+	epollFd = CreateEpollFd();
+	if ((epollFd < 0) || (initI2c() != 0)) {
+		printf("FAIL: initI2c\n");
+		return 1;
+	}
+
+	int ret = Calibrate(&result);
+	PrintResult("still", ret, &result);
+	if ((ret != 0) || !result.valid || (result.attempts != 1) || (result.rejected != 0)) {
+		printf("FAIL: the first capture of a still board should be accepted\n");
+		failures++;
+	}
+	for (int axis = 0; axis < 3; axis++) {
+		if (fabsf(result.biasDps[axis] - TraceMeanDps(axis)) > MAX_BIAS_ERROR_DPS) {
+			printf("FAIL: axis %d offset should be %.3f dps\n", axis, TraceMeanDps(axis));
+			failures++;
+		}
+	}
+
+	// 14 dps back and forth
+	MakeTrace(200);
+	ret = Calibrate(&result);
+	PrintResult("moving", ret, &result);
+	if ((ret == 0) || result.valid || (result.attempts < 2) || (result.rejected != result.attempts)) {
+		printf("FAIL: every capture of a moving board should be rejected until the timeout\n");
+		failures++;
+	}
+	if ((result.biasDps[0] != 0.0f) || (result.biasDps[1] != 0.0f) || (result.biasDps[2] != 0.0f)) {
+		printf("FAIL: a failed calibration should give no offsets\n");
+		failures++;
+	}
+	if (result.durationMs > TIMEOUT_MS + MAX_OVERRUN_MS) {
+		printf("FAIL: the calibration should give up within %d ms\n", TIMEOUT_MS);
+		failures++;
+	}
+
+	// A capture of one sample has no standard deviation
+	const gyro_calibration_config_t tooShort = { .rateHz = CAL_RATE_HZ, .samples = 1, .mdpsPerLsb = MDPS_PER_LSB };
+	if (calibrateGyro(&dev_ctx, &tooShort, &result) == 0) {
+		printf("FAIL: a one sample capture should be refused\n");
+		failures++;
+	}
+
+	closeI2c();
+	i2cSimSetTrace(NULL, 0);
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
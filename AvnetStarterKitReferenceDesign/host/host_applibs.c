@@ -0,0 +1,322 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+#include <applibs/i2c.h>
+#include <applibs/gpio.h>
+#include <applibs/storage.h>
+#include "hw/avnet_mt3620_sk.h"
+
+#include "azure_iot_utilities.h"
+#include "build_options.h"
+#include "i2c.h"
+#include "i2c_sim.h"
+
+#include "host_applibs.h"
+
+// File standing in for the application's mutable storage, in the working directory
+#define HOST_MUTABLE_STORAGE_PATH "mutable_storage.bin"
+
+#define HOST_MESSAGE_SIZE 8192
+
+// Longest the INT1 thread sleeps while every sensor is off, events can still be simulated
+#define HOST_INT1_IDLE_NANO_SECONDS 10000000ULL
+
+// Defined by main.c on the device
+int epollFd = -1;
+volatile sig_atomic_t terminationRequired = false;
+
+static bool hostVerbose;
+static char lastMessage[HOST_MESSAGE_SIZE];
+static host_stats_t hostStats;
+
+// The model is shared by the application's threads and the INT1 thread
+static pthread_mutex_t simLock = PTHREAD_MUTEX_INITIALIZER;
+
+// INT1 is an eventfd the INT1 thread signals on each rising edge, the application gets a
+// duplicate it can close
+static bool int1Wired = true;
+static int int1EventFd = -1;
+static int int1GpioFd = -1;
+static uint32_t int1EdgesSignalled;
+
+/// <summary>
+///     Returns a file descriptor the application can close, standing in for a device handle.
+/// </summary>
+static int OpenHandle(void)
+{
+	return open("/dev/null", O_RDWR | O_CLOEXEC);
+}
+
+void hostSetVerbose(bool verbose)
+{
+	hostVerbose = verbose;
+}
+
+const char *hostLastMessage(void)
+{
+	return lastMessage;
+}
+
+const host_stats_t *getHostStats(void)
+{
+	return &hostStats;
+}
+
+void hostResetStats(void)
+{
+	memset(&hostStats, 0x00, sizeof(hostStats));
+}
+
+void hostSetInt1Wired(bool wired)
+{
+	int1Wired = wired;
+}
+
+/// <summary>
+///     Signals the INT1 eventfd if INT1 rose since it was last signalled.  Called with simLock held.
+/// </summary>
+static void SignalInt1Edges(void)
+{
+	uint32_t edges = getI2cSimStats()->int1Edges;
+	if ((int1EventFd < 0) || (edges == int1EdgesSignalled)) {
+		return;
+	}
+
+	int1EdgesSignalled = edges;
+	uint64_t one = 1;
+	if (write(int1EventFd, &one, sizeof(one)) != sizeof(one)) {
+		hostStats.i2cErrors++;
+	}
+}
+
+/// <summary>
+///     Keeps the model running in real time while INT1 is in use.  It wakes when each sample is
+///     due, so INT1 rises then rather than on the application's next transaction.
+/// </summary>
+static void *Int1Thread(void *arg)
+{
+	(void)arg;
+
+	for (;;) {
+		pthread_mutex_lock(&simLock);
+		i2cSimInt1();
+		SignalInt1Edges();
+		uint64_t nextNs = i2cSimNextSampleNs();
+		pthread_mutex_unlock(&simLock);
+
+		struct timespec now;
+		clock_gettime(CLOCK_MONOTONIC, &now);
+		uint64_t nowNs = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+		if ((nextNs == 0) || (nextNs > nowNs + HOST_INT1_IDLE_NANO_SECONDS)) {
+			nextNs = nowNs + HOST_INT1_IDLE_NANO_SECONDS;
+		}
+
+		struct timespec wake = { .tv_sec = (time_t)(nextNs / 1000000000ULL),.tv_nsec = (long)(nextNs % 1000000000ULL) };
+		clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wake, NULL);
+	}
+
+	return NULL;
+}
+
+int Log_DebugVarArgs(const char *fmt, va_list args)
+{
+	// The application starts some messages with an empty line
+	const char *text = fmt + strspn(fmt, "\n");
+	bool error = (strncmp(text, "ERROR", 5) == 0);
+
+	if (error) {
+		hostStats.logErrors++;
+	}
+	if (!error && !hostVerbose) {
+		return 0;
+	}
+	return vfprintf(error ? stderr : stdout, fmt, args);
+}
+
+int Log_Debug(const char *fmt, ...)
+{
+	va_list args;
+	va_start(args, fmt);
+	int result = Log_DebugVarArgs(fmt, args);
+	va_end(args);
+	return result;
+}
+
+void AzureIoT_SendMessage(const char *messagePayload)
+{
+	hostStats.messages++;
+	snprintf(lastMessage, sizeof(lastMessage), "%s", messagePayload);
+	if (hostVerbose) {
+		printf("[telemetry] %s\n", messagePayload);
+	}
+}
+
+int I2CMaster_Open(I2C_InterfaceId id)
+{
+	(void)id;
+
+	// The bus has the LSM6DSO on it, with the LPS22HH behind its sensor hub
+	pthread_mutex_lock(&simLock);
+	int result = i2cSimInit(LSM6DSO_ADDRESS);
+	int1EdgesSignalled = 0;
+	pthread_mutex_unlock(&simLock);
+	if (result != 0) {
+		errno = EIO;
+		return -1;
+	}
+	return OpenHandle();
+}
+
+int I2CMaster_SetBusSpeed(int fd, uint32_t speedInHz)
+{
+	(void)fd;
+	(void)speedInHz;
+	return 0;
+}
+
+int I2CMaster_SetTimeout(int fd, uint32_t timeoutInMs)
+{
+	(void)fd;
+	(void)timeoutInMs;
+	return 0;
+}
+
+int I2CMaster_SetDefaultTargetAddress(int fd, I2C_DeviceAddress address)
+{
+	(void)fd;
+	(void)address;
+	return 0;
+}
+
+ssize_t I2CMaster_Write(int fd, I2C_DeviceAddress address, const uint8_t *buffer, size_t length)
+{
+	(void)fd;
+	hostStats.i2cCalls++;
+	pthread_mutex_lock(&simLock);
+	ssize_t result = i2cSimWrite(address, buffer, length);
+	SignalInt1Edges();
+	pthread_mutex_unlock(&simLock);
+	if (result < 0) {
+		hostStats.i2cErrors++;
+	}
+	return result;
+}
+
+ssize_t I2CMaster_Read(int fd, I2C_DeviceAddress address, uint8_t *buffer, size_t maxLength)
+{
+	(void)fd;
+	hostStats.i2cCalls++;
+	pthread_mutex_lock(&simLock);
+	ssize_t result = i2cSimRead(address, buffer, maxLength);
+	SignalInt1Edges();
+	pthread_mutex_unlock(&simLock);
+	if (result < 0) {
+		hostStats.i2cErrors++;
+	}
+	return result;
+}
+
+ssize_t I2CMaster_WriteThenRead(int fd, I2C_DeviceAddress address, const uint8_t *writeData, size_t lenWriteData,
+	uint8_t *readData, size_t lenReadData)
+{
+	(void)fd;
+	hostStats.i2cCalls++;
+	pthread_mutex_lock(&simLock);
+	ssize_t result = i2cSimWriteThenRead(address, writeData, lenWriteData, readData, lenReadData);
+	SignalInt1Edges();
+	pthread_mutex_unlock(&simLock);
+	if (result < 0) {
+		hostStats.i2cErrors++;
+	}
+	return result;
+}
+
+int GPIO_OpenAsOutput(GPIO_Id gpioId, GPIO_OutputMode_Type outputMode, GPIO_Value_Type initialValue)
+{
+	(void)gpioId;
+	(void)outputMode;
+	(void)initialValue;
+	return OpenHandle();
+}
+
+int GPIO_OpenAsInput(GPIO_Id gpioId)
+{
+	// Only the LSM6DSO INT1 input is wired up
+	if ((gpioId != LSM6DSO_INT1_GPIO) || !int1Wired) {
+		errno = ENODEV;
+		return -1;
+	}
+
+	if (int1EventFd < 0) {
+		int1EventFd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+		if (int1EventFd < 0) {
+			return -1;
+		}
+
+		pthread_t thread;
+		if (pthread_create(&thread, NULL, Int1Thread, NULL) != 0) {
+			close(int1EventFd);
+			int1EventFd = -1;
+			errno = EAGAIN;
+			return -1;
+		}
+		pthread_detach(thread);
+	}
+
+	int1GpioFd = fcntl(int1EventFd, F_DUPFD_CLOEXEC, 0);
+	return int1GpioFd;
+}
+
+int GPIO_GetValue(int gpioFd, GPIO_Value_Type *outValue)
+{
+	if ((int1GpioFd < 0) || (gpioFd != int1GpioFd)) {
+		*outValue = GPIO_Value_Low;
+		return 0;
+	}
+
+	// Reading the level acknowledges the edges so far, the next one wakes epoll again
+	uint64_t edges;
+	if ((read(gpioFd, &edges, sizeof(edges)) < 0) && (errno != EAGAIN)) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&simLock);
+	*outValue = i2cSimInt1() ? GPIO_Value_High : GPIO_Value_Low;
+	pthread_mutex_unlock(&simLock);
+	return 0;
+}
+
+int GPIO_SetValue(int gpioFd, GPIO_Value_Type value)
+{
+	(void)gpioFd;
+	(void)value;
+	return 0;
+}
+
+int Storage_OpenMutableFile(void)
+{
+	return open(HOST_MUTABLE_STORAGE_PATH, O_RDWR | O_CREAT | O_CLOEXEC, S_IRUSR | S_IWUSR);
+}
+
+int Storage_DeleteMutableFile(void)
+{
+	if ((unlink(HOST_MUTABLE_STORAGE_PATH) != 0) && (errno != ENOENT)) {
+		return -1;
+	}
+	return 0;
+}
@@ -0,0 +1,54 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+// Host build stand-ins for the applibs and Azure IoT functions the application calls, and for
+// the globals main.c defines.  The I2C master functions are served by the register model in
+// i2c_sim.c, telemetry messages are counted and kept rather than sent.  The LSM6DSO INT1 GPIO is an
+// eventfd that becomes readable when the model's INT1 rises, the application can wait on it with
+// epoll, and GPIO_GetValue returns the model's INT1 level.
+
+typedef struct {
+	// I2CMaster_Write, I2CMaster_Read and I2CMaster_WriteThenRead calls
+	uint32_t i2cCalls;
+	uint32_t i2cErrors;
+	// AzureIoT_SendMessage calls
+	uint32_t messages;
+	// Log_Debug messages starting with ERROR
+	uint32_t logErrors;
+} host_stats_t;
+
+// Defined by main.c on the device
+extern int epollFd;
+extern volatile sig_atomic_t terminationRequired;
+
+/// <summary>
+///     Prints every Log_Debug message when verbose is true, otherwise only errors are printed.
+/// </summary>
+void hostSetVerbose(bool verbose);
+
+/// <summary>
+///     With wired false GPIO_OpenAsInput fails for INT1, as if it wasn't connected, and the
+///     application falls back to its timers.  Call before initI2c.
+/// </summary>
+void hostSetInt1Wired(bool wired);
+
+/// <summary>
+///     Returns the last message passed to AzureIoT_SendMessage, or an empty string.
+/// </summary>
+const char *hostLastMessage(void);
+
+/// <summary>
+///     Returns the host statistics.
+/// </summary>
+const host_stats_t *getHostStats(void);
+
+/// <summary>
+///     Clears the host statistics.
+/// </summary>
+void hostResetStats(void);
@@ -0,0 +1,150 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+#include <applibs/i2c.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "i2c.h"
+#include "i2c_sim.h"
+#include "lsm6dso_reg.h"
+
+#include "host_applibs.h"
+
+// Counts the I2CMaster calls per sensor sample of the per-sample register reads the accelerometer
+// timer made before FIFO acquisition: data-ready flag and output registers of the accelerometer,
+// gyroscope and temperature.  They are run through the application's platform layer, which makes
+// one combined write-then-read per register read, and through the separate address write and read
+// it replaced.  Both go to the register model through the counting I2CMaster_* stand-ins.
+
+#define BENCHMARK_PASSES 500
+
+// Pass period, the model runs at 1667 Hz so every pass reads new samples
+#define BENCHMARK_PERIOD_US 1000
+
+extern lsm6dso_ctx_t dev_ctx;
+extern int i2cFd;
+
+typedef struct {
+	uint32_t passes;
+	uint32_t samples;
+	uint32_t i2cCalls;
+	double cpuNs;
+} result_t;
+
+/// <summary>
+///     platform_write before combined transactions: the register and the data are copied to a
+///     buffer on the stack and written.
+/// </summary>
+static int32_t LegacyWrite(int *fD, uint8_t reg, uint8_t *bufp, uint16_t len)
+{
+	uint8_t cmdBuffer[len + 1];
+	cmdBuffer[0] = reg;
+	memcpy(&cmdBuffer[1], bufp, len);
+
+	return (I2CMaster_Write(*fD, LSM6DSO_ADDRESS, cmdBuffer, (size_t)len + 1) < 0) ? -1 : 0;
+}
+
+/// <summary>
+///     platform_read before combined transactions: the register address is written, then the data
+///     read in a second call.
+/// </summary>
+static int32_t LegacyRead(int *fD, uint8_t reg, uint8_t *bufp, uint16_t len)
+{
+	if (I2CMaster_Write(*fD, LSM6DSO_ADDRESS, &reg, 1) < 0) {
+		return -1;
+	}
+	return (I2CMaster_Read(*fD, LSM6DSO_ADDRESS, bufp, len) < 0) ? -1 : 0;
+}
+
+static uint64_t CpuNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/// <summary>
+///     Reads each sensor whose data-ready flag is set, counting the I2C calls and CPU time.
+/// </summary>
+static void Run(lsm6dso_ctx_t *ctx, result_t *result)
+{
+	memset(result, 0x00, sizeof(*result));
+
+	for (int pass = 0; pass < BENCHMARK_PASSES; pass++) {
+		usleep(BENCHMARK_PERIOD_US);
+
+		uint32_t calls = getHostStats()->i2cCalls;
+		uint64_t start = CpuNs();
+		uint8_t ready;
+		axis3bit16_t raw;
+
+		lsm6dso_xl_flag_data_ready_get(ctx, &ready);
+		if (ready) {
+			lsm6dso_acceleration_raw_get(ctx, raw.u8bit);
+			result->samples++;
+		}
+		lsm6dso_gy_flag_data_ready_get(ctx, &ready);
+		if (ready) {
+			lsm6dso_angular_rate_raw_get(ctx, raw.u8bit);
+			result->samples++;
+		}
+		lsm6dso_temp_flag_data_ready_get(ctx, &ready);
+		if (ready) {
+			lsm6dso_temperature_raw_get(ctx, raw.u8bit);
+		}
+
+		result->cpuNs += (double)(CpuNs() - start);
+		result->i2cCalls += getHostStats()->i2cCalls - calls;
+		result->passes++;
+	}
+}
+
+static void Print(const char *name, const result_t *result)
+{
+	printf("%-9s %u samples, %.2f I2C calls per sample, %.0f ns CPU per sample\n", name, result->samples,
+		(double)result->i2cCalls / (double)result->samples, result->cpuNs / (double)result->samples);
+}
+
+int main(void)
+{
+	epollFd = CreateEpollFd();
+	if ((epollFd < 0) || (initI2c() != 0)) {
+		printf("FAIL: initI2c\n");
+		return 1;
+	}
+
+	lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_1667Hz);
+	lsm6dso_gy_data_rate_set(&dev_ctx, LSM6DSO_GY_ODR_1667Hz);
+
+	lsm6dso_ctx_t legacyCtx = { LegacyWrite, LegacyRead, &i2cFd };
+	result_t legacy;
+	result_t combined;
+
+	Run(&legacyCtx, &legacy);
+	Run(&dev_ctx, &combined);
+	closeI2c();
+
+	Print("separate", &legacy);
+	Print("combined", &combined);
+
+	if ((legacy.samples != 2 * BENCHMARK_PASSES) || (combined.samples != 2 * BENCHMARK_PASSES)) {
+		printf("FAIL: a pass didn't find new samples\n");
+		return 1;
+	}
+	if (legacy.i2cCalls != 2 * combined.i2cCalls) {
+		printf("FAIL: expected one combined transaction in place of each write and read\n");
+		return 1;
+	}
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		return 1;
+	}
+	return 0;
+}
@@ -0,0 +1,242 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "i2c_queue.h"
+
+#include "host_applibs.h"
+
+// Runs the I2C queue on a fake transfer function that holds the worker until the test lets it go,
+// so the requests pile up behind the first one.  The transfers must then run highest priority
+// first and in submission order within a priority, async requests must be refused once only the
+// slot kept for sync requests is left, and a sync request must still get that slot and complete
+// without the epoll loop running.  The completion handlers must run in submission order.
+
+#define HIGH_ADDRESS 0x6A
+#define NORMAL_ADDRESS 0x10
+#define LOW_ADDRESS 0x5C
+
+#define SYNC_REG 0x20
+#define SYNC_READ_LEN 2
+
+// How long to wait for the worker or the sync thread to get somewhere
+#define WAIT_MS 1000
+
+#define MAX_TRANSFERS 32
+
+static pthread_mutex_t fakeMutex = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t fakeCond = PTHREAD_COND_INITIALIZER;
+static bool gateOpen;
+static uint8_t transferRegs[MAX_TRANSFERS];
+static int transferCount;
+
+static uint8_t handledRegs[MAX_TRANSFERS];
+static int handledCount;
+static int handlerFailures;
+
+static uint8_t syncData[SYNC_READ_LEN];
+static int32_t syncStatus = -1;
+
+static int failures;
+
+/// <summary>
+///     I2cTransferFunction of the fake bus.  Records the register, waits for the gate, and answers
+///     reads with the register number.
+/// </summary>
+static int32_t FakeTransfer(I2C_DeviceAddress address, uint8_t reg, uint8_t *data, uint16_t len, bool isRead)
+{
+	(void)address;
+
+	pthread_mutex_lock(&fakeMutex);
+	if (transferCount < MAX_TRANSFERS) {
+		transferRegs[transferCount] = reg;
+	}
+	transferCount++;
+	pthread_cond_broadcast(&fakeCond);
+	while (!gateOpen) {
+		pthread_cond_wait(&fakeCond, &fakeMutex);
+	}
+	pthread_mutex_unlock(&fakeMutex);
+
+	if (isRead) {
+		memset(data, reg, len);
+	}
+	return 0;
+}
+
+/// <summary>
+///     I2cCompletionHandler, the context is the register the request was for.
+/// </summary>
+static void RecordCompletion(int32_t status, const uint8_t *data, uint16_t len, void *context)
+{
+	(void)data;
+	(void)len;
+
+	if (status != 0) {
+		handlerFailures++;
+	}
+	if (handledCount < MAX_TRANSFERS) {
+		handledRegs[handledCount] = (uint8_t)(uintptr_t)context;
+	}
+	handledCount++;
+}
+
+static int QueueWrite(I2C_DeviceAddress address, uint8_t reg)
+{
+	uint8_t value = reg;
+	return i2cQueueWriteAsync(address, reg, &value, 1, RecordCompletion, (void *)(uintptr_t)reg);
+}
+
+/// <summary>
+///     Waits up to WAIT_MS for the fake bus to have seen count transfers.
+/// </summary>
+/// <returns>true if it did</returns>
+static bool WaitForTransfers(int count)
+{
+	for (int ms = 0; ms < WAIT_MS; ms++) {
+		pthread_mutex_lock(&fakeMutex);
+		bool reached = (transferCount >= count);
+		pthread_mutex_unlock(&fakeMutex);
+		if (reached) {
+			return true;
+		}
+		usleep(1000);
+	}
+	return false;
+}
+
+static void *SyncReadThread(void *arg)
+{
+	(void)arg;
+	syncStatus = i2cQueueReadSync(HIGH_ADDRESS, SYNC_REG, syncData, SYNC_READ_LEN);
+	return NULL;
+}
+
+static void ExpectOrder(const char *name, const uint8_t *actual, int actualCount, const uint8_t *expected,
+	int expectedCount)
+{
+	bool same = (actualCount == expectedCount);
+	for (int i = 0; same && (i < expectedCount); i++) {
+		same = (actual[i] == expected[i]);
+	}
+
+	printf("%-12s", name);
+	for (int i = 0; (i < actualCount) && (i < MAX_TRANSFERS); i++) {
+		printf(" %u", actual[i]);
+	}
+	printf("\n");
+
+	if (!same) {
+		printf("FAIL: the %s should be", name);
+		for (int i = 0; i < expectedCount; i++) {
+			printf(" %u", expected[i]);
+		}
+		printf("\n");
+		failures++;
+	}
+}
+
+int main(void)
+{
+	int epollFd = CreateEpollFd();
+	if ((epollFd < 0) || (initI2cQueue(epollFd, FakeTransfer) != 0)) {
+		printf("FAIL: initI2cQueue\n");
+		return 1;
+	}
+	i2cQueueSetDevicePriority(HIGH_ADDRESS, I2C_PRIORITY_HIGH);
+	i2cQueueSetDevicePriority(LOW_ADDRESS, I2C_PRIORITY_LOW);
+
+	// The worker takes the first request and holds on to it, the rest queue up behind it
+	if ((QueueWrite(NORMAL_ADDRESS, 0) != 0) || !WaitForTransfers(1)) {
+		printf("FAIL: the worker didn't start the first request\n");
+		return 1;
+	}
+
+	const I2C_DeviceAddress addresses[] = { LOW_ADDRESS, NORMAL_ADDRESS, HIGH_ADDRESS, NORMAL_ADDRESS, HIGH_ADDRESS,
+		LOW_ADDRESS };
+	int queued = 1;
+	for (int i = 0; i < (int)(sizeof(addresses) / sizeof(addresses[0])); i++) {
+		queued += (QueueWrite(addresses[i], (uint8_t)queued) == 0) ? 1 : 0;
+	}
+
+	// Fill the queue up to the slot kept for sync requests, the one running counts
+	while (queued < I2C_QUEUE_DEPTH - 1) {
+		if (QueueWrite(NORMAL_ADDRESS, (uint8_t)queued) != 0) {
+			break;
+		}
+		queued++;
+	}
+	if ((queued != I2C_QUEUE_DEPTH - 1) || (QueueWrite(NORMAL_ADDRESS, (uint8_t)queued) == 0) ||
+		(getI2cQueueStats()->rejectedRequests != 1)) {
+		printf("FAIL: %d async requests were queued, expected %d and then a refusal\n", queued, I2C_QUEUE_DEPTH - 1);
+		failures++;
+	}
+
+	// The sync request gets the last slot while the queue is full of async requests
+	pthread_t syncThread;
+	if (pthread_create(&syncThread, NULL, SyncReadThread, NULL) != 0) {
+		printf("FAIL: could not start the sync thread\n");
+		return 1;
+	}
+	for (int ms = 0; (ms < WAIT_MS) && (getI2cQueueStats()->syncRequests == 0); ms++) {
+		usleep(1000);
+	}
+	if (getI2cQueueStats()->syncRequests != 1) {
+		printf("FAIL: the sync request didn't get the slot kept for it\n");
+		failures++;
+	}
+
+	pthread_mutex_lock(&fakeMutex);
+	gateOpen = true;
+	pthread_cond_broadcast(&fakeCond);
+	pthread_mutex_unlock(&fakeMutex);
+
+	// The sync request completes without the epoll loop freeing the async slots
+	pthread_join(syncThread, NULL);
+	if ((syncStatus != 0) || (syncData[0] != SYNC_REG) || (syncData[1] != SYNC_REG)) {
+		printf("FAIL: the sync read returned %d\n", syncStatus);
+		failures++;
+	}
+
+	if (!WaitForTransfers(queued + 1)) {
+		printf("FAIL: only %d of %d transfers ran\n", transferCount, queued + 1);
+		return 1;
+	}
+	while (handledCount < queued) {
+		if (WaitForEventAndCallHandler(epollFd) != 0) {
+			printf("FAIL: epoll wait\n");
+			return 1;
+		}
+	}
+
+	// The first request, then high priority, the sync read (high, queued last), normal and low,
+	// each priority in submission order
+	const uint8_t expectedTransfers[] = { 0, 3, 5, SYNC_REG, 2, 4, 7, 8, 9, 10, 11, 12, 13, 14, 1, 6 };
+	ExpectOrder("transfers", transferRegs, transferCount, expectedTransfers,
+		(int)(sizeof(expectedTransfers) / sizeof(expectedTransfers[0])));
+
+	uint8_t expectedHandlers[I2C_QUEUE_DEPTH];
+	for (int i = 0; i < queued; i++) {
+		expectedHandlers[i] = (uint8_t)i;
+	}
+	ExpectOrder("completions", handledRegs, handledCount, expectedHandlers, queued);
+	if (handlerFailures > 0) {
+		printf("FAIL: %d requests failed\n", handlerFailures);
+		failures++;
+	}
+
+	closeI2cQueue();
+	CloseFdAndPrintError(epollFd, "Epoll");
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,134 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "i2c_stats.h"
+#include "parson.h"
+
+#include "host_applibs.h"
+
+// Records transactions of known length, outcome and duration and checks the counters, the latency
+// histogram, the percentiles and the busiest register list in the JSON report.  Durations are
+// set by backdating the start time.  A start in the future counts as 0 us, so bucket 0 is tested
+// without a race against the clock.
+
+#define IMU_ADDRESS 0x6A
+
+// Bucket 0 is under 2 us, bucket n covers [2^n, 2^(n+1)) us
+static const uint32_t expectedHistogram[I2C_STATS_LATENCY_BUCKETS] = { 3, 1, 0, 0, 0, 0, 1, 0, 0, 1, 0, 0, 0, 0, 0, 1 };
+
+// [register, reads, writes, bytes, errors], busiest first and by register within a count.  The
+// write to 0xF0 lands in the last register entry.
+static const uint32_t expectedRegisters[][5] = {
+	{ 0x1E, 3, 0, 9, 0 }, { 0x28, 2, 0, 26, 0 }, { 0x10, 0, 1, 0, 1 }, { I2C_STATS_MAX_REGISTERS - 1, 0, 1, 2, 0 } };
+
+static char json[2048];
+static int failures;
+
+/// <summary>
+///     Records a transaction that started durationNs ago, or in the future if durationNs is negative.
+/// </summary>
+static void Record(I2C_DeviceAddress address, uint8_t reg, uint16_t len, bool isRead, int32_t status,
+	int64_t durationNs)
+{
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	int64_t startNs = (int64_t)start.tv_sec * 1000000000LL + start.tv_nsec - durationNs;
+	start.tv_sec = (time_t)(startNs / 1000000000LL);
+	start.tv_nsec = (long)(startNs % 1000000000LL);
+
+	i2cStatsRecord(address, reg, len, isRead, status, &start);
+}
+
+static void ExpectNumber(const char *name, double actual, double expected)
+{
+	if (actual != expected) {
+		printf("FAIL: %s is %.0f, expected %.0f\n", name, actual, expected);
+		failures++;
+	}
+}
+
+int main(void)
+{
+	i2cStatsReset();
+
+	for (int i = 0; i < 3; i++) {
+		Record(IMU_ADDRESS, 0x1E, 2, true, 0, -1000000);
+	}
+	Record(IMU_ADDRESS, 0x28, 12, true, 0, 2500);
+	Record(IMU_ADDRESS, 0x28, 12, true, 0, 100000);
+	Record(IMU_ADDRESS, 0x10, 1, false, -1, 700000);
+	Record(IMU_ADDRESS, 0xF0, 1, false, 0, 10000000000LL);
+
+	// Three more devices fill the table, the fifth address isn't tracked
+	Record(0x5C, 0x20, 1, false, 0, 0);
+	Record(0x10, 0x00, 1, true, 0, 0);
+	Record(0x11, 0x00, 1, true, 0, 0);
+	Record(0x12, 0x00, 1, true, 0, 0);
+
+	if (i2cStatsToJson(json, sizeof(json)) < 0) {
+		printf("FAIL: the report doesn't fit in %zu bytes\n", sizeof(json));
+		return 1;
+	}
+	printf("%s\n", json);
+
+	JSON_Value *root = json_parse_string(json);
+	JSON_Object *report = json_value_get_object(root);
+	JSON_Array *devices = json_object_get_array(report, "devices");
+	JSON_Object *imu = json_array_get_object(devices, 0);
+	if (imu == NULL) {
+		printf("FAIL: the report has no devices\n");
+		json_value_free(root);
+		return 1;
+	}
+
+	ExpectNumber("devices", (double)json_array_get_count(devices), I2C_STATS_MAX_DEVICES);
+	ExpectNumber("untracked", json_object_get_number(report, "untracked"), 1);
+	ExpectNumber("addr", json_object_get_number(imu, "addr"), IMU_ADDRESS);
+	ExpectNumber("txn", json_object_get_number(imu, "txn"), 7);
+	// The register address byte counts, failed transactions don't
+	ExpectNumber("bytes", json_object_get_number(imu, "bytes"), 37);
+	ExpectNumber("err", json_object_get_number(imu, "err"), 1);
+	// The 4th of 7 is in bucket 1, the 7th in the last bucket, reported as the bucket upper bounds
+	ExpectNumber("p50us", json_object_get_number(imu, "p50us"), 4);
+	ExpectNumber("p99us", json_object_get_number(imu, "p99us"), 1U << I2C_STATS_LATENCY_BUCKETS);
+
+	JSON_Array *histogram = json_object_get_array(imu, "hist");
+	ExpectNumber("buckets", (double)json_array_get_count(histogram), I2C_STATS_LATENCY_BUCKETS);
+	for (int i = 0; i < I2C_STATS_LATENCY_BUCKETS; i++) {
+		char name[16];
+		snprintf(name, sizeof(name), "bucket %d", i);
+		ExpectNumber(name, json_array_get_number(histogram, (size_t)i), expectedHistogram[i]);
+	}
+
+	JSON_Array *registers = json_object_get_array(imu, "regs");
+	size_t registerCount = sizeof(expectedRegisters) / sizeof(expectedRegisters[0]);
+	ExpectNumber("registers listed", (double)json_array_get_count(registers), (double)registerCount);
+	for (size_t r = 0; r < registerCount; r++) {
+		JSON_Array *entry = json_array_get_array(registers, r);
+		for (size_t field = 0; field < 5; field++) {
+			char name[32];
+			snprintf(name, sizeof(name), "regs[%zu][%zu]", r, field);
+			ExpectNumber(name, json_array_get_number(entry, field), expectedRegisters[r][field]);
+		}
+	}
+	json_value_free(root);
+
+	i2cStatsReset();
+	const char *cleared = (i2cStatsToJson(json, sizeof(json)) < 0) ? NULL : strstr(json, "\"untracked\"");
+	if ((cleared == NULL) || (strcmp(cleared, "\"untracked\":0,\"devices\":[]}") != 0)) {
+		printf("FAIL: the statistics weren't cleared: %s\n", json);
+		failures++;
+	}
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,182 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdio.h>
+
+#include "build_options.h"
+#include "imu_autorange.h"
+
+#include "host_applibs.h"
+
+// Runs the full scale controller with the application's thresholds on a simulated accelerometer
+// with the LSM6DSO ranges, whose readings clip at the rails.  A loud signal must take the range up
+// until it fits, a quiet one down after IMU_AUTORANGE_DOWN_PASSES windows, and once settled on any
+// amplitude the range must never switch again: a step down reads at most 2 * down percent of
+// the new range, which stays below the up threshold.
+
+#define WINDOW_SAMPLES 50
+#define SETTLE_WINDOWS 50
+#define HOLD_WINDOWS 200
+
+static const int fullScales[] = { 2, 4, 8, 16 };
+#define RANGE_COUNT ((int)(sizeof(fullScales) / sizeof(fullScales[0])))
+
+static int failures;
+
+/// <summary>
+///     Feeds one window of a sine of peak amplitudeG read at fullScales[*range], ends it and
+///     applies the step.
+/// </summary>
+/// <returns>The step taken</returns>
+static autorange_step_t RunWindow(autorange_t *autorange, int *range, float amplitudeG)
+{
+	for (int i = 0; i < WINDOW_SAMPLES; i++) {
+		float g = amplitudeG * sinf(2.0f * 3.14159265f * (float)i / (float)WINDOW_SAMPLES + 0.3f);
+		float raw = g / (float)fullScales[*range] * 32768.0f;
+		axis3bit16_t sample = { .i16bit = { 0, 0, 0 } };
+		sample.i16bit[2] = (int16_t)fmaxf(fminf(raw, 32767.0f), -32768.0f);
+		autorangeSample(autorange, &sample);
+	}
+
+	float lowerRatio = (*range > 0) ? (float)fullScales[*range - 1] / (float)fullScales[*range] : 0.0f;
+	autorange_step_t step = autorangeEndWindow(autorange, lowerRatio, *range < RANGE_COUNT - 1);
+	if (step == AUTORANGE_UP) {
+		(*range)++;
+	}
+	else if (step == AUTORANGE_DOWN) {
+		(*range)--;
+	}
+	autorangeSwitched(autorange, step);
+
+	return step;
+}
+
+static void InitController(autorange_t *autorange)
+{
+	initAutorange(autorange, IMU_AUTORANGE_UP_PERCENT, IMU_AUTORANGE_DOWN_PERCENT, IMU_AUTORANGE_DOWN_PASSES);
+}
+
+/// <summary>
+///     A loud signal goes up range by range until it fits, then holds.
+/// </summary>
+static void CheckUp(void)
+{
+	autorange_t autorange;
+	int range = 0;
+
+	InitController(&autorange);
+	for (int i = 0; i < SETTLE_WINDOWS; i++) {
+		RunWindow(&autorange, &range, 6.0f);
+	}
+
+	const autorange_stats_t *stats = getAutorangeStats(&autorange);
+	printf("6 g from 2 g: %d g, %u ups, %u downs, %u saturated samples\n", fullScales[range], stats->rangeUps,
+		stats->rangeDowns, stats->saturatedSamples);
+	if ((fullScales[range] != 8) || (stats->rangeUps != 2) || (stats->rangeDowns != 0) ||
+		(stats->saturatedSamples == 0)) {
+		printf("FAIL: 6 g should settle on 8 g in two steps up\n");
+		failures++;
+	}
+
+	// Nothing above the largest range, the samples clip
+	for (int i = 0; i < SETTLE_WINDOWS; i++) {
+		RunWindow(&autorange, &range, 20.0f);
+	}
+	if ((fullScales[range] != 16) || (stats->rangeUps != 3)) {
+		printf("FAIL: 20 g should stop at 16 g\n");
+		failures++;
+	}
+}
+
+/// <summary>
+///     A quiet signal goes down after exactly IMU_AUTORANGE_DOWN_PASSES quiet windows in a row.
+/// </summary>
+static void CheckDown(void)
+{
+	autorange_t autorange;
+	int range = 2;
+
+	InitController(&autorange);
+
+	// A loud window in the middle of a quiet run starts the count again
+	for (int i = 0; i < IMU_AUTORANGE_DOWN_PASSES - 1; i++) {
+		RunWindow(&autorange, &range, 0.5f);
+	}
+	RunWindow(&autorange, &range, 3.0f);
+	for (int i = 0; i < IMU_AUTORANGE_DOWN_PASSES - 1; i++) {
+		RunWindow(&autorange, &range, 0.5f);
+	}
+	if (fullScales[range] != 8) {
+		printf("FAIL: a loud window should restart the quiet count\n");
+		failures++;
+	}
+
+	// A window without samples says nothing and doesn't break the run
+	autorangeEndWindow(&autorange, 0.5f, true);
+	if ((RunWindow(&autorange, &range, 0.5f) != AUTORANGE_DOWN) || (fullScales[range] != 4)) {
+		printf("FAIL: 0.5 g on 8 g should go down on quiet window %d\n", IMU_AUTORANGE_DOWN_PASSES);
+		failures++;
+	}
+
+	for (int i = 0; i < SETTLE_WINDOWS; i++) {
+		RunWindow(&autorange, &range, 0.5f);
+	}
+	if (fullScales[range] != 2) {
+		printf("FAIL: 0.5 g should settle on 2 g, not %d g\n", fullScales[range]);
+		failures++;
+	}
+}
+
+/// <summary>
+///     Once settled the range holds on any amplitude, from every starting range.
+/// </summary>
+static void CheckHysteresis(void)
+{
+	int unsettled = 0;
+
+	for (int start = 0; start < RANGE_COUNT; start++) {
+		for (float amplitudeG = 0.05f; amplitudeG < 16.0f; amplitudeG *= 1.07f) {
+			autorange_t autorange;
+			int range = start;
+
+			InitController(&autorange);
+			for (int i = 0; i < SETTLE_WINDOWS; i++) {
+				RunWindow(&autorange, &range, amplitudeG);
+			}
+
+			int settledRange = range;
+			uint32_t switches = getAutorangeStats(&autorange)->rangeUps + getAutorangeStats(&autorange)->rangeDowns;
+			for (int i = 0; i < HOLD_WINDOWS; i++) {
+				RunWindow(&autorange, &range, amplitudeG);
+			}
+			uint32_t later = getAutorangeStats(&autorange)->rangeUps + getAutorangeStats(&autorange)->rangeDowns;
+
+			if ((range != settledRange) || (later != switches)) {
+				if (unsettled++ == 0) {
+					printf("FAIL: %.2f g from %d g switched %u more times after settling on %d g\n", amplitudeG,
+						fullScales[start], later - switches, fullScales[settledRange]);
+				}
+			}
+		}
+	}
+
+	printf("hysteresis: %d amplitudes kept switching\n", unsettled);
+	if (unsettled > 0) {
+		failures++;
+	}
+}
+
+int main(void)
+{
+	CheckUp();
+	CheckDown();
+	CheckHysteresis();
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
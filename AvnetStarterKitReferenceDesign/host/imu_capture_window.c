@@ -0,0 +1,188 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "imu_capture.h"
+
+#include "host_applibs.h"
+
+// Runs the capture ring on numbered samples, x = n, y = -n and z = 1000 + n, and checks which
+// samples each capture holds: the window before the trigger from a ring that has wrapped and
+// from one that hasn't filled yet, the samples ignored once a capture is ready, the ring kept
+// across a rearm, a capture without a window after, and the window limits.  Values are rounded
+// and saturated to int16_t, and a JSON report that doesn't fit is refused.
+
+#define RATE_HZ 104.0f
+
+static imu_capture_t capture;
+static char json[512];
+static int failures;
+
+/// <summary>
+///     Adds the numbered samples first to last with one imuCaptureAdd call.
+/// </summary>
+static void AddSamples(int first, int last)
+{
+	float x[32];
+	float y[32];
+	float z[32];
+	size_t count = 0;
+
+	for (int n = first; (n <= last) && (count < sizeof(x) / sizeof(x[0])); n++) {
+		x[count] = (float)n;
+		y[count] = (float)-n;
+		z[count] = 1000.0f + (float)n;
+		count++;
+	}
+	imuCaptureAdd(&capture, x, y, z, count);
+}
+
+/// <summary>
+///     Checks the JSON of a ready capture, and that it is refused by a buffer one byte short.
+/// </summary>
+static void ExpectCapture(const char *name, const char *expectedJson)
+{
+	if (!imuCaptureReady(&capture) || (imuCaptureToJson(&capture, RATE_HZ, json, sizeof(json)) < 0)) {
+		printf("FAIL: %s: the capture isn't ready\n", name);
+		failures++;
+		return;
+	}
+
+	printf("%-16s %s\n", name, json);
+	if (strcmp(json, expectedJson) != 0) {
+		printf("FAIL: %s: expected %s\n", name, expectedJson);
+		failures++;
+	}
+	if (imuCaptureToJson(&capture, RATE_HZ, json, strlen(expectedJson)) >= 0) {
+		printf("FAIL: %s: a capture that doesn't fit should be refused\n", name);
+		failures++;
+	}
+}
+
+/// <summary>
+///     Three samples before and two after, in a ring that has wrapped twice.
+/// </summary>
+static void CheckWrapped(void)
+{
+	initImuCapture(&capture);
+	imuCaptureSetWindow(&capture, 3, 2);
+	AddSamples(1, 10);
+
+	if (!imuCaptureTrigger(&capture, "freefall") || imuCaptureReady(&capture) ||
+		(imuCaptureToJson(&capture, RATE_HZ, json, sizeof(json)) >= 0)) {
+		printf("FAIL: wrapped: the capture should start and wait for the window after\n");
+		failures++;
+	}
+	AddSamples(11, 11);
+	if (imuCaptureReady(&capture)) {
+		printf("FAIL: wrapped: the capture was ready one sample early\n");
+		failures++;
+	}
+
+	// 13 and 14 come after the capture is complete and are ignored
+	AddSamples(12, 14);
+	ExpectCapture("wrapped", "{\"capture\":\"freefall\",\"rateHz\":104.0,\"before\":3,\"aX\":[8,9,10,11,12],"
+		"\"aY\":[-8,-9,-10,-11,-12],\"aZ\":[1008,1009,1010,1011,1012]}");
+
+	if (imuCaptureTrigger(&capture, "shock") || (getImuCaptureStats(&capture)->missedTriggers != 1)) {
+		printf("FAIL: wrapped: a trigger while a capture waits to be sent should be missed\n");
+		failures++;
+	}
+
+	// The ring keeps 10 to 12 for the window before the next trigger
+	imuCaptureRearm(&capture);
+	imuCaptureTrigger(&capture, "shock");
+	AddSamples(20, 21);
+	ExpectCapture("rearmed", "{\"capture\":\"shock\",\"rateHz\":104.0,\"before\":3,\"aX\":[10,11,12,20,21],"
+		"\"aY\":[-10,-11,-12,-20,-21],\"aZ\":[1010,1011,1012,1020,1021]}");
+
+	if (getImuCaptureStats(&capture)->triggers != 2) {
+		printf("FAIL: wrapped: %u triggers counted, expected 2\n", getImuCaptureStats(&capture)->triggers);
+		failures++;
+	}
+}
+
+/// <summary>
+///     A trigger before the window before has filled, and one with no window after.
+/// </summary>
+static void CheckShortWindows(void)
+{
+	initImuCapture(&capture);
+	imuCaptureSetWindow(&capture, 4, 2);
+	AddSamples(1, 1);
+	imuCaptureTrigger(&capture, "freefall");
+	AddSamples(2, 3);
+	ExpectCapture("early trigger", "{\"capture\":\"freefall\",\"rateHz\":104.0,\"before\":1,\"aX\":[1,2,3],"
+		"\"aY\":[-1,-2,-3],\"aZ\":[1001,1002,1003]}");
+
+	// A different window drops the capture and the ring
+	imuCaptureSetWindow(&capture, 2, 0);
+	if (imuCaptureReady(&capture)) {
+		printf("FAIL: a new window should drop the capture\n");
+		failures++;
+	}
+	AddSamples(5, 7);
+	imuCaptureTrigger(&capture, "shock");
+	ExpectCapture("nothing after", "{\"capture\":\"shock\",\"rateHz\":104.0,\"before\":2,\"aX\":[6,7],"
+		"\"aY\":[-6,-7],\"aZ\":[1006,1007]}");
+}
+
+/// <summary>
+///     The window limits, and a trigger without a window.
+/// </summary>
+static void CheckLimits(void)
+{
+	initImuCapture(&capture);
+
+	imuCaptureSetWindow(&capture, 300, 300);
+	if ((capture.before != 0) || (capture.after != IMU_CAPTURE_MAX_SAMPLES)) {
+		printf("FAIL: a window of 300 and 300 samples is %zu and %zu\n", capture.before, capture.after);
+		failures++;
+	}
+	imuCaptureSetWindow(&capture, 100, 200);
+	if ((capture.before != IMU_CAPTURE_MAX_SAMPLES - 200) || (capture.after != 200)) {
+		printf("FAIL: a window of 100 and 200 samples is %zu and %zu\n", capture.before, capture.after);
+		failures++;
+	}
+
+	imuCaptureSetWindow(&capture, 0, 0);
+	AddSamples(1, 4);
+	if (imuCaptureTrigger(&capture, "shock") || (getImuCaptureStats(&capture)->missedTriggers != 1)) {
+		printf("FAIL: a trigger without a window should be missed\n");
+		failures++;
+	}
+}
+
+/// <summary>
+///     Values are rounded half away from zero and saturated to int16_t.
+/// </summary>
+static void CheckValues(void)
+{
+	const float x[4] = { 1.5f, -2.5f, 40000.0f, -40000.0f };
+	const float y[4] = { 0.49f, -0.49f, 32767.4f, -32768.4f };
+	const float z[4] = { 998.6f, 1001.4f, 0.0f, -0.0f };
+
+	initImuCapture(&capture);
+	imuCaptureSetWindow(&capture, 4, 0);
+	imuCaptureAdd(&capture, x, y, z, 4);
+	imuCaptureTrigger(&capture, "shock");
+	ExpectCapture("rounded", "{\"capture\":\"shock\",\"rateHz\":104.0,\"before\":4,\"aX\":[2,-3,32767,-32768],"
+		"\"aY\":[0,0,32767,-32768],\"aZ\":[999,1001,0,0]}");
+}
+
+int main(void)
+{
+	CheckWrapped();
+	CheckShortWindows();
+	CheckLimits();
+	CheckValues();
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
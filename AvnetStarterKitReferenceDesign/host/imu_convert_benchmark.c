@@ -0,0 +1,217 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <time.h>
+
+#include "imu_convert.h"
+#include "lsm6dso_reg.h"
+
+#include "host_applibs.h"
+
+// Checks the batch conversion kernels against a scalar reference, on batch lengths that leave a
+// partial vector at the end and on raw values that saturate, then times them against converting
+// one axis at a time the way AccelTimerEventHandler used to and reports samples per microsecond.
+
+#define BENCHMARK_SAMPLES 1024
+#define BENCHMARK_ROUNDS 100
+
+// Not a multiple of the eight samples a vector holds
+#define CHECK_SAMPLES 37
+
+// 2000 dps sensitivity in dps/LSB
+#define GYRO_SCALE 0.070f
+
+static axis3bit16_t samples[BENCHMARK_SAMPLES];
+static float outFloat[3][BENCHMARK_SAMPLES];
+static int16_t outQ15[3][BENCHMARK_SAMPLES];
+static int32_t outQ31[3][BENCHMARK_SAMPLES];
+
+static int failures;
+
+static uint64_t NowNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/// <summary>
+///     Samples per microsecond for BENCHMARK_ROUNDS batches in elapsedNs.
+/// </summary>
+static double SamplesPerUs(uint64_t elapsedNs)
+{
+	double converted = (double)BENCHMARK_SAMPLES * BENCHMARK_ROUNDS;
+	return (elapsedNs > 0) ? converted * 1000.0 / (double)elapsedNs : 0.0;
+}
+
+/// <summary>
+///     Deterministic pseudo-random raw data with both 16 bit extremes among the first samples.
+/// </summary>
+static void FillSamples(void)
+{
+	uint32_t seed = 1;
+
+	for (int i = 0; i < BENCHMARK_SAMPLES; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			seed = seed * 1664525U + 1013904223U;
+			samples[i].i16bit[axis] = (int16_t)(seed >> 16);
+		}
+	}
+	samples[0].i16bit[0] = INT16_MIN;
+	samples[1].i16bit[1] = INT16_MAX;
+	samples[2].i16bit[2] = INT16_MIN;
+}
+
+static int64_t Clamp(int64_t value, int64_t min, int64_t max)
+{
+	return (value < min) ? min : ((value > max) ? max : value);
+}
+
+/// <summary>
+///     Compares the kernels with the scalar definitions in imu_convert.h on count samples.
+/// </summary>
+static void CheckKernels(size_t count, int rangeShift)
+{
+	const float offsetFloat[3] = { 1.5f, -2.0f, 3.25f };
+	// Large enough to push the extremes past the 16 and 32 bit limits
+	const int16_t offsetQ15[3] = { 100, -100, 0 };
+	const int32_t offsetQ31[3] = { 1 << 20, -(1 << 20), 0 };
+
+	imuConvertFloat(samples, count, GYRO_SCALE, offsetFloat, outFloat[0], outFloat[1], outFloat[2]);
+	imuConvertQ15(samples, count, rangeShift, offsetQ15, outQ15[0], outQ15[1], outQ15[2]);
+	imuConvertQ31(samples, count, rangeShift, offsetQ31, outQ31[0], outQ31[1], outQ31[2]);
+
+	int mismatches = 0;
+	for (size_t i = 0; i < count; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			int16_t raw = samples[i].i16bit[axis];
+			float expectedFloat = (float)raw * GYRO_SCALE - offsetFloat[axis];
+			int64_t expectedQ15 = Clamp((raw >> rangeShift) - offsetQ15[axis], INT16_MIN, INT16_MAX);
+			int64_t expectedQ31 = Clamp(((int64_t)raw << (16 - rangeShift)) - offsetQ31[axis], INT32_MIN, INT32_MAX);
+
+			if ((fabsf(outFloat[axis][i] - expectedFloat) > 1e-6f * fabsf(expectedFloat) + 1e-6f) ||
+				(outQ15[axis][i] != expectedQ15) || (outQ31[axis][i] != expectedQ31)) {
+				mismatches++;
+			}
+		}
+	}
+
+	if (mismatches > 0) {
+		printf("FAIL: %d of %zu axes converted wrong with %zu samples and range shift %d\n", mismatches,
+			count * 3, count, rangeShift);
+		failures++;
+	}
+}
+
+/// <summary>
+///     The float kernel at the 2000 dps sensitivity gives the dps AccelTimerEventHandler computed
+///     from lsm6dso_from_fs2000_to_mdps.
+/// </summary>
+static void CheckGyroDps(void)
+{
+	const int16_t calibration[3] = { 14, -29, 43 };
+	const float offset[3] = { calibration[0] * GYRO_SCALE, calibration[1] * GYRO_SCALE, calibration[2] * GYRO_SCALE };
+
+	imuConvertFloat(samples, CHECK_SAMPLES, GYRO_SCALE, offset, outFloat[0], outFloat[1], outFloat[2]);
+
+	for (int i = 0; i < CHECK_SAMPLES; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			int32_t lsb = samples[i].i16bit[axis] - calibration[axis];
+			// The old conversion wrapped these in its int16_t argument
+			if ((lsb < INT16_MIN) || (lsb > INT16_MAX)) {
+				continue;
+			}
+			float dps = lsm6dso_from_fs2000_to_mdps((int16_t)lsb) / 1000.0f;
+			if (fabsf(outFloat[axis][i] - dps) > 1e-3f) {
+				printf("FAIL: sample %d axis %d is %f dps, %f one axis at a time\n", i, axis, outFloat[axis][i], dps);
+				failures++;
+				return;
+			}
+		}
+	}
+}
+
+static void CheckRangeShift(int fullScale, int maxFullScale, int expected)
+{
+	int shift = imuConvertRangeShift(fullScale, maxFullScale);
+	if (shift != expected) {
+		printf("FAIL: range shift of %d in %d is %d, expected %d\n", fullScale, maxFullScale, shift, expected);
+		failures++;
+	}
+}
+
+int main(void)
+{
+	const float offsetFloat[3] = { 1.0f, -2.0f, 3.0f };
+	const int16_t offsetQ15[3] = { 1, -2, 3 };
+	const int32_t offsetQ31[3] = { 65536, -131072, 196608 };
+	const int16_t calibration[3] = { 14, -29, 43 };
+	volatile float sink = 0.0f;
+	uint64_t start;
+
+	FillSamples();
+
+	for (int rangeShift = 0; rangeShift <= 4; rangeShift++) {
+		CheckKernels(CHECK_SAMPLES, rangeShift);
+	}
+	CheckKernels(BENCHMARK_SAMPLES, 1);
+	CheckKernels(1, 0);
+	CheckGyroDps();
+
+	CheckRangeShift(2000, 2000, 0);
+	CheckRangeShift(125, 2000, 4);
+	CheckRangeShift(250, 2000, 3);
+	CheckRangeShift(4, 16, 2);
+	CheckRangeShift(2, 16, 3);
+
+	start = NowNs();
+	for (int round = 0; round < BENCHMARK_ROUNDS; round++) {
+		for (int i = 0; i < BENCHMARK_SAMPLES; i++) {
+			for (int axis = 0; axis < 3; axis++) {
+				outFloat[axis][i] = lsm6dso_from_fs2000_to_mdps(samples[i].i16bit[axis] - calibration[axis]) / 1000.0f;
+			}
+		}
+		sink += outFloat[0][round % BENCHMARK_SAMPLES];
+	}
+	uint64_t perAxisNs = NowNs() - start;
+
+	start = NowNs();
+	for (int round = 0; round < BENCHMARK_ROUNDS; round++) {
+		imuConvertFloat(samples, BENCHMARK_SAMPLES, GYRO_SCALE, offsetFloat, outFloat[0], outFloat[1], outFloat[2]);
+		sink += outFloat[0][round % BENCHMARK_SAMPLES];
+	}
+	uint64_t floatNs = NowNs() - start;
+
+	start = NowNs();
+	for (int round = 0; round < BENCHMARK_ROUNDS; round++) {
+		imuConvertQ15(samples, BENCHMARK_SAMPLES, 1, offsetQ15, outQ15[0], outQ15[1], outQ15[2]);
+		sink += outQ15[0][round % BENCHMARK_SAMPLES];
+	}
+	uint64_t q15Ns = NowNs() - start;
+
+	start = NowNs();
+	for (int round = 0; round < BENCHMARK_ROUNDS; round++) {
+		imuConvertQ31(samples, BENCHMARK_SAMPLES, 1, offsetQ31, outQ31[0], outQ31[1], outQ31[2]);
+		sink += (float)outQ31[0][round % BENCHMARK_SAMPLES];
+	}
+	uint64_t q31Ns = NowNs() - start;
+	(void)sink;
+
+	printf("IMU convert: %.1f samples/us one axis at a time, %.1f float, %.1f Q15, %.1f Q31 (%s)\n",
+		SamplesPerUs(perAxisNs), SamplesPerUs(floatNs), SamplesPerUs(q15Ns), SamplesPerUs(q31Ns),
+#ifdef __ARM_NEON
+		"NEON");
+#else
+		"generic");
+#endif
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
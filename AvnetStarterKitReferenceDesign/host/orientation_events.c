@@ -0,0 +1,179 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lsm6dso_config.h"
+#include "lsm6dso_events.h"
+#include "lsm6dso_reg.h"
+#include "lsm6dso_tilt.h"
+
+#include "host_applibs.h"
+
+// Puts orientation settings in a configuration image and checks the nearest 6D threshold and
+// the 4D mode, decodes D6D_SRC values and writes them as JSON.  Then switches tilt detection on
+// and off on a fake bus that keeps the user and embedded functions banks apart, and checks the
+// enable, the INT1 routing, the latch and that the bus is left on the user bank even when a
+// write in the embedded functions bank fails.
+
+#define BANKS 3
+
+static uint8_t registers[BANKS][256];
+static int failingReg = -1;
+static char json[64];
+static int failures;
+
+/// <summary>
+///     FUNC_CFG_ACCESS is in every bank, its reg_access field selects the bank of the others.
+/// </summary>
+static uint8_t *BankReg(uint8_t reg)
+{
+	uint8_t bank = (reg == LSM6DSO_FUNC_CFG_ACCESS) ? LSM6DSO_USER_BANK : (registers[0][LSM6DSO_FUNC_CFG_ACCESS] >> 6);
+	return &registers[bank % BANKS][reg];
+}
+
+static int32_t FakeWrite(int *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	(void)handle;
+	if ((registers[0][LSM6DSO_FUNC_CFG_ACCESS] >> 6 == LSM6DSO_EMBEDDED_FUNC_BANK) && (reg == failingReg)) {
+		return -1;
+	}
+	memcpy(BankReg(reg), data, len);
+	return 0;
+}
+
+static int32_t FakeRead(int *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	(void)handle;
+	memcpy(data, BankReg(reg), len);
+	return 0;
+}
+
+static void CheckOrientationThreshold(float thresholdDeg, bool enabled, bool fourD, uint8_t expected)
+{
+	lsm6dso_config_t config;
+	lsm6dso_orientation_config_t orientation = { enabled, fourD, thresholdDeg };
+	static const float appliedDeg[] = { 80.0f, 70.0f, 60.0f, 50.0f };
+
+	lsm6dsoConfigDefaults(&config);
+	lsm6dsoEventsConfigOrientation(&config, &orientation);
+
+	const lsm6dso_tap_ths_6d_t *tapThs6d = (const lsm6dso_tap_ths_6d_t *)lsm6dsoConfigReg(&config, LSM6DSO_TAP_THS_6D);
+	if ((tapThs6d->sixd_ths != expected) || (orientation.thresholdDeg != appliedDeg[expected]) ||
+		(tapThs6d->d4d_en != (enabled && fourD))) {
+		printf("FAIL: %.0f degrees%s is sixd_ths %u (%.0f degrees) d4d_en %u, expected %u (%.0f degrees)\n",
+			thresholdDeg, fourD ? " in 4D" : "", tapThs6d->sixd_ths, orientation.thresholdDeg, tapThs6d->d4d_en,
+			expected, appliedDeg[expected]);
+		failures++;
+	}
+}
+
+/// <summary>
+///     Decodes a D6D_SRC value and checks its JSON.
+/// </summary>
+static void CheckOrientationSource(uint8_t d6dSrc, bool changed, const char *expectedJson)
+{
+	lsm6dso_event_sources_t sources;
+	lsm6dso_orientation_event_t event;
+
+	memset(&sources, 0, sizeof(sources));
+	memcpy(&sources.d6dSrc, &d6dSrc, 1);
+
+	bool flagged = lsm6dsoEventsOrientation(&sources, &event);
+	if ((flagged != changed) || (lsm6dsoEventsOrientationToJson(&event, json, sizeof(json)) < 0) ||
+		(strcmp(json, expectedJson) != 0)) {
+		printf("FAIL: D6D_SRC 0x%02X is %s%s, expected %s\n", d6dSrc, json, flagged ? " flagged" : "", expectedJson);
+		failures++;
+	}
+	if (lsm6dsoEventsOrientationToJson(&event, json, strlen(expectedJson)) >= 0) {
+		printf("FAIL: an orientation that doesn't fit should be refused\n");
+		failures++;
+	}
+}
+
+/// <summary>
+///     Switches tilt detection and checks the embedded functions registers and the bank left selected.
+/// </summary>
+static void CheckTiltSet(lsm6dso_ctx_t *ctx, bool enable, bool int1, int expectedResult)
+{
+	int result = lsm6dsoTiltSet(ctx, enable, int1);
+
+	const uint8_t *embedded = registers[LSM6DSO_EMBEDDED_FUNC_BANK];
+	const lsm6dso_emb_func_en_a_t *embFuncEnA = (const lsm6dso_emb_func_en_a_t *)&embedded[LSM6DSO_EMB_FUNC_EN_A];
+	const lsm6dso_emb_func_int1_t *embFuncInt1 = (const lsm6dso_emb_func_int1_t *)&embedded[LSM6DSO_EMB_FUNC_INT1];
+	const lsm6dso_page_rw_t *pageRw = (const lsm6dso_page_rw_t *)&embedded[LSM6DSO_PAGE_RW];
+
+	printf("tilt %-8s %-8s returned %2d: tilt_en %u, int1_tilt %u, emb_func_lir %u, bank %u\n",
+		enable ? "on" : "off", int1 ? "on INT1" : "", result, embFuncEnA->tilt_en, embFuncInt1->int1_tilt,
+		pageRw->emb_func_lir, registers[0][LSM6DSO_FUNC_CFG_ACCESS] >> 6);
+
+	if (result != expectedResult) {
+		printf("FAIL: lsm6dsoTiltSet returned %d, expected %d\n", result, expectedResult);
+		failures++;
+	}
+	if ((registers[0][LSM6DSO_FUNC_CFG_ACCESS] >> 6) != LSM6DSO_USER_BANK) {
+		printf("FAIL: lsm6dsoTiltSet left the embedded functions bank selected\n");
+		failures++;
+	}
+	if ((result == 0) && ((embFuncEnA->tilt_en != enable) || (embFuncInt1->int1_tilt != (enable && int1)) ||
+		(enable && !pageRw->emb_func_lir))) {
+		printf("FAIL: tilt detection %s%s isn't what the registers hold\n", enable ? "on" : "off",
+			int1 ? " on INT1" : "");
+		failures++;
+	}
+}
+
+int main(void)
+{
+	int fd = 0;
+	lsm6dso_ctx_t ctx = { FakeWrite, FakeRead, &fd };
+
+	// sixd_ths 0 to 3 are 80, 70, 60 and 50 degrees
+	CheckOrientationThreshold(90.0f, true, false, 0);
+	CheckOrientationThreshold(72.0f, true, true, 1);
+	CheckOrientationThreshold(58.0f, false, true, 2);
+	CheckOrientationThreshold(10.0f, true, false, 3);
+
+	// D6D_SRC: xl 0x01, xh 0x02, yl 0x04, yh 0x08, zl 0x10, zh 0x20, d6d_ia 0x40
+	CheckOrientationSource(0x00, false, "{\"orientation\":\"none\",\"tilt\":false}");
+	CheckOrientationSource(0x60, true, "{\"orientation\":\"z+\",\"tilt\":false}");
+	CheckOrientationSource(0x54, true, "{\"orientation\":\"y-\",\"tilt\":false}");
+	CheckOrientationSource(0x41, true, "{\"orientation\":\"x-\",\"tilt\":false}");
+	CheckOrientationSource(0x02, false, "{\"orientation\":\"x+\",\"tilt\":false}");
+
+	lsm6dso_orientation_event_t tilt = { true, -1, false };
+	if ((lsm6dsoEventsOrientationToJson(&tilt, json, sizeof(json)) < 0) ||
+		(strcmp(json, "{\"orientation\":\"none\",\"tilt\":true}") != 0)) {
+		printf("FAIL: a tilt is %s\n", json);
+		failures++;
+	}
+
+	CheckTiltSet(&ctx, true, true, 0);
+	CheckTiltSet(&ctx, true, false, 0);
+	CheckTiltSet(&ctx, false, true, 0);
+
+	failingReg = LSM6DSO_EMB_FUNC_INT1;
+	CheckTiltSet(&ctx, true, true, -1);
+	failingReg = -1;
+
+	// The flag is read from the user bank without switching
+	bool tilted = false;
+	registers[LSM6DSO_USER_BANK][LSM6DSO_EMB_FUNC_STATUS_MAINPAGE] = 0x10;
+	if ((lsm6dsoTiltRead(&ctx, &tilted) != 0) || !tilted) {
+		printf("FAIL: the tilt flag wasn't read\n");
+		failures++;
+	}
+	registers[LSM6DSO_USER_BANK][LSM6DSO_EMB_FUNC_STATUS_MAINPAGE] = 0xEF;
+	if ((lsm6dsoTiltRead(&ctx, &tilted) != 0) || tilted) {
+		printf("FAIL: the other embedded function flags were read as a tilt\n");
+		failures++;
+	}
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
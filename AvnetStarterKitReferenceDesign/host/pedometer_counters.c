@@ -0,0 +1,138 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lsm6dso_fifo.h"
+#include "lsm6dso_pedometer.h"
+#include "lsm6dso_reg.h"
+
+#include "host_applibs.h"
+
+// Follows the step counter through STEP_COUNTER reads on a fake bus and through hand-made FIFO
+// step words, across the wrap of the 16 bit step counter and of the 32 bit timestamp counter.
+// The steps per minute must come from the step word timestamps when a period has two or more,
+// and from the period length otherwise, including when the timestamp counter is off.
+
+// Half a second between steps in 25 us ticks
+#define STEP_TICKS 20000u
+
+// Close enough below the wrap that the step words of a period straddle it
+#define WRAP_TICKS (0xFFFFFFFFu - STEP_TICKS)
+
+#define MAX_RATE_ERROR 0.01f
+
+static uint8_t registers[256];
+static char json[64];
+static int failures;
+
+static int32_t FakeWrite(int *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	(void)handle;
+	memcpy(&registers[reg], data, len);
+	return 0;
+}
+
+static int32_t FakeRead(int *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	(void)handle;
+	memcpy(data, &registers[reg], len);
+	return 0;
+}
+
+/// <summary>
+///     Hands the pedometer a step word with the step counter and timestamp counter given.
+/// </summary>
+static bool StepWord(lsm6dso_pedometer_t *pedometer, lsm6dso_fifo_tag_t tag, uint16_t counter, uint32_t ticks)
+{
+	fifo_word_t word;
+
+	memset(&word, 0, sizeof(word));
+	word.tag = tag;
+	word.data.u8bit[0] = (uint8_t)counter;
+	word.data.u8bit[1] = (uint8_t)(counter >> 8);
+	for (int i = 0; i < 4; i++) {
+		word.data.u8bit[2 + i] = (uint8_t)(ticks >> (8 * i));
+	}
+	return lsm6dsoPedometerFifoWord(pedometer, &word);
+}
+
+/// <summary>
+///     Checks the step counts and the steps per minute over periodSeconds.
+/// </summary>
+static void ExpectSteps(const char *name, const lsm6dso_pedometer_t *pedometer, float periodSeconds, uint32_t steps,
+	uint32_t periodSteps, float stepsPerMinute)
+{
+	float measured = lsm6dsoPedometerStepsPerMinute(pedometer, periodSeconds);
+
+	printf("%-24s %u steps, %u new, %.2f steps/min\n", name, pedometer->steps, pedometer->periodSteps, measured);
+	if ((pedometer->steps != steps) || (pedometer->periodSteps != periodSteps) ||
+		(fabsf(measured - stepsPerMinute) > MAX_RATE_ERROR)) {
+		printf("FAIL: %s: expected %u steps, %u new, %.2f steps/min\n", name, steps, periodSteps, stepsPerMinute);
+		failures++;
+	}
+}
+
+int main(void)
+{
+	int fd = 0;
+	lsm6dso_ctx_t ctx = { FakeWrite, FakeRead, &fd };
+	lsm6dso_pedometer_t pedometer;
+
+	initLsm6dsoPedometer(&pedometer);
+
+	// Read from the step counter: no timestamps, the rate is over the period
+	registers[LSM6DSO_STEP_COUNTER_L] = 0xF6;
+	registers[LSM6DSO_STEP_COUNTER_H] = 0xFF;
+	if (lsm6dsoPedometerRead(&ctx, &pedometer) != 0) {
+		printf("FAIL: lsm6dsoPedometerRead\n");
+		return 1;
+	}
+	ExpectSteps("read", &pedometer, 60.0f, 65526, 65526, 65526.0f);
+	ExpectSteps("read, no period", &pedometer, 0.0f, 65526, 65526, 0.0f);
+
+	lsm6dsoPedometerNewPeriod(&pedometer);
+	registers[LSM6DSO_STEP_COUNTER_L] = 0x04;
+	registers[LSM6DSO_STEP_COUNTER_H] = 0x00;
+	lsm6dsoPedometerRead(&ctx, &pedometer);
+	ExpectSteps("read across the wrap", &pedometer, 7.0f, 65540, 14, 120.0f);
+
+	// Step words across both wraps, one step every half second.  The first word only starts the
+	// timing, the six steps after it took three seconds.
+	lsm6dsoPedometerNewPeriod(&pedometer);
+	if (StepWord(&pedometer, LSM6DSO_XL_NC_TAG, 100, 0) || (pedometer.periodSteps != 0)) {
+		printf("FAIL: an accelerometer word was counted as steps\n");
+		failures++;
+	}
+	StepWord(&pedometer, LSM6DSO_STEP_CPUNTER_TAG, 5, WRAP_TICKS - STEP_TICKS);
+	ExpectSteps("one step word", &pedometer, 5.0f, 65541, 1, 12.0f);
+	StepWord(&pedometer, LSM6DSO_STEP_CPUNTER_TAG, 6, WRAP_TICKS);
+	StepWord(&pedometer, LSM6DSO_STEP_CPUNTER_TAG, 8, WRAP_TICKS + 2 * STEP_TICKS);
+	StepWord(&pedometer, LSM6DSO_STEP_CPUNTER_TAG, 11, WRAP_TICKS + 5 * STEP_TICKS);
+	ExpectSteps("step words", &pedometer, 60.0f, 65547, 7, 120.0f);
+
+	if ((lsm6dsoPedometerToJson(&pedometer, 60.0f, json, sizeof(json)) < 0) ||
+		(strcmp(json, "{\"steps\":65547,\"newSteps\":7,\"stepsPerMin\":120.0}") != 0)) {
+		printf("FAIL: the counters are %s\n", json);
+		failures++;
+	}
+	if (lsm6dsoPedometerToJson(&pedometer, 60.0f, json, strlen(json)) >= 0) {
+		printf("FAIL: counters that don't fit should be refused\n");
+		failures++;
+	}
+
+	// With the timestamp counter off the step words carry 0
+	lsm6dsoPedometerNewPeriod(&pedometer);
+	StepWord(&pedometer, LSM6DSO_STEP_CPUNTER_TAG, 12, 0);
+	StepWord(&pedometer, LSM6DSO_STEP_CPUNTER_TAG, 15, 0);
+	ExpectSteps("step words, no time", &pedometer, 2.0f, 65551, 4, 120.0f);
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
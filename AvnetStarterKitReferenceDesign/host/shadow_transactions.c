@@ -0,0 +1,172 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lsm6dso_reg.h"
+#include "lsm6dso_shadow.h"
+
+#include "host_applibs.h"
+
+// Counts the bus transactions of the initI2c setter sequence the register shadow was written
+// for, straight on a counting fake bus and through the shadow, and checks that both leave the
+// device with the same registers.  The fake bus keeps the user, sensor hub and embedded
+// functions banks apart so a shadow that loses track of the selected bank shows up as a
+// register mismatch.
+
+// Sensor hub pull-up retries, initI2c retried until the LPS22HH answered
+#define PULL_UP_RETRIES 10
+
+// Transactions of the sequence measured when the shadow was added
+#define EXPECTED_PLAIN_TRANSACTIONS 81
+#define EXPECTED_SHADOW_TRANSACTIONS 58
+
+#define BANKS 3
+#define BANK_SIZE 0x80
+
+typedef struct {
+	uint8_t regs[BANKS][BANK_SIZE];
+	uint32_t transactions;
+} fake_bus_t;
+
+static fake_bus_t bus;
+
+/// <summary>
+///     Returns the bank FUNC_CFG_ACCESS selects, FUNC_CFG_ACCESS itself is mapped in every bank.
+/// </summary>
+static int SelectedBank(uint8_t reg)
+{
+	if (reg == LSM6DSO_FUNC_CFG_ACCESS) {
+		return 0;
+	}
+	lsm6dso_func_cfg_access_t *access = (lsm6dso_func_cfg_access_t *)&bus.regs[0][LSM6DSO_FUNC_CFG_ACCESS];
+	return access->reg_access;
+}
+
+/// <summary>
+///     lsm6dso_ctx_t write_reg hook of the fake bus.  Reset and reboot complete at once, so CTRL3_C
+///     reads back with them cleared.
+/// </summary>
+static int32_t FakeWrite(int *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	(void)handle;
+
+	bus.transactions++;
+	for (uint16_t i = 0; i < len; i++) {
+		bus.regs[SelectedBank((uint8_t)(reg + i))][(reg + i) % BANK_SIZE] = data[i];
+	}
+	bus.regs[0][LSM6DSO_CTRL3_C] &= (uint8_t)~0x81;
+
+	return 0;
+}
+
+/// <summary>
+///     lsm6dso_ctx_t read_reg hook of the fake bus.
+/// </summary>
+static int32_t FakeRead(int *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	(void)handle;
+
+	bus.transactions++;
+	for (uint16_t i = 0; i < len; i++) {
+		data[i] = bus.regs[SelectedBank((uint8_t)(reg + i))][(reg + i) % BANK_SIZE];
+	}
+
+	return 0;
+}
+
+/// <summary>
+///     Powers the fake device up with the register defaults the sequence depends on.
+/// </summary>
+static void ResetFakeBus(void)
+{
+	memset(&bus, 0x00, sizeof(bus));
+	bus.regs[0][LSM6DSO_WHO_AM_I] = LSM6DSO_ID;
+	// IF_INC
+	bus.regs[0][LSM6DSO_CTRL3_C] = 0x04;
+}
+
+/// <summary>
+///     The initI2c setter sequence from before the configuration image: device reset, interface,
+///     data rates, full scales and filters, then the sensor hub pull-up retries.
+/// </summary>
+/// <returns>0 on success, or -1 if a driver call failed</returns>
+static int InitSequence(lsm6dso_ctx_t *ctx)
+{
+	int32_t ret = 0;
+	uint8_t rst;
+
+	ret |= lsm6dso_reset_set(ctx, PROPERTY_ENABLE);
+	do {
+		ret |= lsm6dso_reset_get(ctx, &rst);
+	} while (rst && (ret == 0));
+
+	ret |= lsm6dso_i3c_disable_set(ctx, LSM6DSO_I3C_DISABLE);
+	ret |= lsm6dso_block_data_update_set(ctx, PROPERTY_ENABLE);
+	ret |= lsm6dso_xl_data_rate_set(ctx, LSM6DSO_XL_ODR_12Hz5);
+	ret |= lsm6dso_gy_data_rate_set(ctx, LSM6DSO_GY_ODR_12Hz5);
+	ret |= lsm6dso_xl_full_scale_set(ctx, LSM6DSO_4g);
+	ret |= lsm6dso_gy_full_scale_set(ctx, LSM6DSO_2000dps);
+	ret |= lsm6dso_xl_hp_path_on_out_set(ctx, LSM6DSO_LP_ODR_DIV_100);
+	ret |= lsm6dso_xl_filter_lp2_set(ctx, PROPERTY_ENABLE);
+
+	for (int i = 0; i < PULL_UP_RETRIES; i++) {
+		ret |= lsm6dso_sh_pin_mode_set(ctx, LSM6DSO_INTERNAL_PULL_UP);
+	}
+
+	return (ret == 0) ? 0 : -1;
+}
+
+int main(void)
+{
+	int fd = 0;
+
+	ResetFakeBus();
+	lsm6dso_ctx_t plainCtx = { FakeWrite, FakeRead, &fd };
+	if (InitSequence(&plainCtx) != 0) {
+		printf("FAIL: init sequence on the fake bus\n");
+		return 1;
+	}
+	uint32_t plainTransactions = bus.transactions;
+	uint8_t plainRegs[BANKS][BANK_SIZE];
+	memcpy(plainRegs, bus.regs, sizeof(plainRegs));
+
+	ResetFakeBus();
+	lsm6dso_ctx_t shadowCtx = { FakeWrite, FakeRead, &fd };
+	if ((initLsm6dsoShadow(&shadowCtx) != 0) || (InitSequence(&shadowCtx) != 0)) {
+		printf("FAIL: init sequence through the shadow\n");
+		return 1;
+	}
+	uint32_t shadowTransactions = bus.transactions;
+	const lsm6dso_shadow_stats_t *stats = getLsm6dsoShadowStats();
+
+	printf("init sequence: %u bus transactions, %u through the shadow (%u reads answered from it, %u invalidations)\n",
+		plainTransactions, shadowTransactions, stats->shadowReads, stats->invalidations);
+
+	int failures = 0;
+
+	if (memcmp(plainRegs, bus.regs, sizeof(plainRegs)) != 0) {
+		printf("FAIL: the shadow left the device with different registers\n");
+		failures++;
+	}
+	if (shadowTransactions != stats->busReads + stats->busWrites) {
+		printf("FAIL: the shadow counted %u transactions, the bus saw %u\n", stats->busReads + stats->busWrites,
+			shadowTransactions);
+		failures++;
+	}
+	if (plainTransactions != shadowTransactions + stats->shadowReads) {
+		printf("FAIL: every read answered from the shadow should save exactly one transaction\n");
+		failures++;
+	}
+	if ((plainTransactions != EXPECTED_PLAIN_TRANSACTIONS) || (shadowTransactions != EXPECTED_SHADOW_TRANSACTIONS)) {
+		printf("FAIL: expected %d and %d transactions\n", EXPECTED_PLAIN_TRANSACTIONS, EXPECTED_SHADOW_TRANSACTIONS);
+		failures++;
+	}
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
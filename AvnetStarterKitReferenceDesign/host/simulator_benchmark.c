@@ -0,0 +1,167 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "build_options.h"
+#include "epoll_timerfd_utilities.h"
+#include "i2c.h"
+#include "i2c_sim.h"
+
+#include "host_applibs.h"
+
+// Runs the application's sensor acquisition against the register model for a number of seconds,
+// as main.c would, and reports what AccelTimerEventHandler achieved between its first and last
+// pass: samples read per second, samples lost, I2C calls and CPU time per sample, and how long
+// samples waited in the device before they were read.  The CPU time includes the model, which runs
+// in the same process.  With ENABLE_LSM6DSO_INT1, -t leaves INT1 unconnected so the same build can
+// be compared on the timer.
+//
+// simulator_benchmark [seconds] [-t] [-v]
+
+#define DEFAULT_RUN_SECONDS 10
+
+// With the FIFO every sample the model produces must be read
+#define FIFO_MIN_READ_RATIO 0.95
+
+// With INT1 samples are read once the watermark is reached, or as soon as they are ready,
+// rather than on the next accelerometer timer pass.  The mean wait is half that, allow all of it.
+#ifdef ENABLE_LSM6DSO_FIFO
+#define INT1_MAX_MEAN_LATENCY_SECONDS (LSM6DSO_FIFO_WATERMARK / (IMU_ACCEL_ODR_HZ + IMU_GYRO_ODR_HZ))
+#else
+#define INT1_MAX_MEAN_LATENCY_SECONDS (1.0 / IMU_ACCEL_ODR_HZ)
+#endif
+
+typedef struct {
+	struct timespec monotonic;
+	struct timespec cpu;
+	i2c_sim_stats_t sim;
+	host_stats_t host;
+	uint32_t wakeups;
+} snapshot_t;
+
+static double Seconds(const struct timespec *start, const struct timespec *end)
+{
+	return (double)(end->tv_sec - start->tv_sec) + (double)(end->tv_nsec - start->tv_nsec) / 1e9;
+}
+
+static void TakeSnapshot(snapshot_t *snapshot, uint32_t wakeups)
+{
+	clock_gettime(CLOCK_MONOTONIC, &snapshot->monotonic);
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &snapshot->cpu);
+	snapshot->sim = *getI2cSimStats();
+	snapshot->host = *getHostStats();
+	snapshot->wakeups = wakeups;
+}
+
+int main(int argc, char *argv[])
+{
+	int runSeconds = DEFAULT_RUN_SECONDS;
+	bool int1Wired = true;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-v") == 0) {
+			hostSetVerbose(true);
+		}
+		else if (strcmp(argv[i], "-t") == 0) {
+			int1Wired = false;
+		}
+		else {
+			runSeconds = atoi(argv[i]);
+		}
+	}
+
+	hostSetInt1Wired(int1Wired);
+	epollFd = CreateEpollFd();
+	if ((epollFd < 0) || (initI2c() != 0)) {
+		printf("FAIL: initI2c\n");
+		return 1;
+	}
+
+	// Wait for the first accelerometer timer pass, then measure until the run time is up.  Only
+	// the accelerometer timer, and INT1 when it is in use, read samples.
+	snapshot_t first = { 0 };
+	snapshot_t last = { 0 };
+	uint32_t wakeups = 0;
+	uint32_t messages = getHostStats()->messages;
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	while (!terminationRequired) {
+		if (WaitForEventAndCallHandler(epollFd) != 0) {
+			break;
+		}
+		wakeups++;
+
+		const i2c_sim_stats_t *sim = getI2cSimStats();
+		if ((sim->accelSamplesRead + sim->gyroSamplesRead) == (last.sim.accelSamplesRead + last.sim.gyroSamplesRead)) {
+			continue;
+		}
+		if (first.wakeups == 0) {
+			TakeSnapshot(&first, wakeups);
+		}
+		TakeSnapshot(&last, wakeups);
+
+		if (Seconds(&start, &last.monotonic) >= runSeconds) {
+			break;
+		}
+	}
+
+	closeI2c();
+
+	double seconds = Seconds(&first.monotonic, &last.monotonic);
+	uint32_t produced = (last.sim.accelSamples - first.sim.accelSamples) + (last.sim.gyroSamples - first.sim.gyroSamples);
+	uint32_t read = (last.sim.accelSamplesRead - first.sim.accelSamplesRead) +
+		(last.sim.gyroSamplesRead - first.sim.gyroSamplesRead);
+	uint32_t i2cCalls = last.host.i2cCalls - first.host.i2cCalls;
+	double cpuSeconds = Seconds(&first.cpu, &last.cpu);
+	double meanLatency = (double)(last.sim.readLatencyNs - first.sim.readLatencyNs) / 1e9 / (double)read;
+
+	if ((seconds <= 0.0) || (read == 0)) {
+		printf("FAIL: no samples were read\n");
+		return 1;
+	}
+
+	// Samples still in the FIFO at the first pass are read in the window, more can be read than produced
+	double readRatio = (double)read / (double)produced;
+	uint32_t lost = (produced > read) ? produced - read : 0;
+	printf("%.1f s, %.1f wakeups/s\n", seconds, (double)(last.wakeups - first.wakeups) / seconds);
+	printf("samples: %u produced, %u read, %.1f read/s, %u lost, %.1f%% read\n", produced, read,
+		(double)read / seconds, lost, 100.0 * readRatio);
+	printf("I2C: %u calls, %.2f per sample read\n", i2cCalls, (double)i2cCalls / (double)read);
+	printf("CPU: %.2f us per sample read, %.3f%% load\n", cpuSeconds * 1e6 / (double)read, 100.0 * cpuSeconds / seconds);
+	printf("latency: %.2f ms mean from a sample being produced to it being read, %u INT1 edges\n",
+		meanLatency * 1e3, last.sim.int1Edges - first.sim.int1Edges);
+
+	if (getHostStats()->messages == messages) {
+		printf("FAIL: no telemetry was sent\n");
+		return 1;
+	}
+	// Without INT1 connected the application logs the GPIO failing to open, and uses its timers
+	uint32_t expectedErrors = 0;
+#ifdef ENABLE_LSM6DSO_INT1
+	expectedErrors = int1Wired ? 0 : 1;
+#endif
+	if (getHostStats()->logErrors > expectedErrors) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		return 1;
+	}
+#ifdef ENABLE_LSM6DSO_FIFO
+	if (readRatio < FIFO_MIN_READ_RATIO) {
+		printf("FAIL: the FIFO read %.1f%% of the samples, expected %.0f%%\n", 100.0 * readRatio,
+			100.0 * FIFO_MIN_READ_RATIO);
+		return 1;
+	}
+#endif
+#ifdef ENABLE_LSM6DSO_INT1
+	if (int1Wired && (meanLatency > INT1_MAX_MEAN_LATENCY_SECONDS)) {
+		printf("FAIL: samples waited %.1f ms on average with INT1, expected at most %.1f ms\n", meanLatency * 1e3,
+			INT1_MAX_MEAN_LATENCY_SECONDS * 1e3);
+		return 1;
+	}
+#endif
+	return 0;
+}
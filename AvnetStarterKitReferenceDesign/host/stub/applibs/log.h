@@ -0,0 +1,11 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+// Host build stand-in for the Azure Sphere applibs log API, see host_applibs.c
+
+#include <stdarg.h>
+
+int Log_Debug(const char *fmt, ...);
+int Log_DebugVarArgs(const char *fmt, va_list args);
@@ -0,0 +1,7 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+// Host build stand-in for the Azure Sphere applibs networking API, nothing the host build
+// compiles uses it
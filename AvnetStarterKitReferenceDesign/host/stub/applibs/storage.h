@@ -0,0 +1,10 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+// Host build stand-in for the Azure Sphere applibs storage API.  The mutable storage is a file in
+// the working directory, see host_applibs.c
+
+int Storage_OpenMutableFile(void);
+int Storage_DeleteMutableFile(void);
@@ -0,0 +1,7 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+// Host build stand-in for the Azure IoT C SDK header azure_iot_utilities.h includes.  The host
+// build doesn't compile azure_iot_utilities.c, AzureIoT_SendMessage is in host_applibs.c
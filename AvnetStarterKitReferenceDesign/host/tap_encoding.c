@@ -0,0 +1,157 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lsm6dso_config.h"
+#include "lsm6dso_events.h"
+
+#include "host_applibs.h"
+
+// Puts tap settings in a configuration image and checks the register fields against the
+// LSM6DSO encodings: the threshold in 1/32 of the full scale, never 0, and the shock, quiet and
+// duration windows in 8, 4 and 32 samples per LSB with a 0 standing for 4, 2 and 16 samples.
+// The settings handed back must be the ones the registers apply.  Then decodes TAP_SRC values
+// and writes them as JSON.
+
+#define ODR_HZ 416.0f
+
+// The settings handed back are worked out in float
+#define MAX_SETTING_ERROR 0.01f
+
+static char json[64];
+static int failures;
+
+typedef struct {
+	const char *name;
+	int fullScaleG;
+	lsm6dso_tap_config_t tap;
+	uint8_t threshold;
+	uint8_t shock;
+	uint8_t quiet;
+	uint8_t dur;
+	float thresholdMg;
+	float shockMs;
+	float quietMs;
+	float durationMs;
+} tap_case_t;
+
+static const tap_case_t tapCases[] = {
+	// 38 ms is 1.98 shock steps, 10 ms 1.04 quiet steps and 400 ms 5.2 duration steps at 416 Hz
+	{ "2 g", 2, { true, true, LSM6DSO_TAP_AXIS_X | LSM6DSO_TAP_AXIS_Z, 500.0f, 38.0f, 10.0f, 400.0f }, 8, 2, 1, 5,
+		500.0f, 16000.0f / ODR_HZ, 4000.0f / ODR_HZ, 160000.0f / ODR_HZ },
+	// Nothing asked for gets the smallest threshold and the windows a 0 stands for
+	{ "4 g, zero", 4, { true, false, LSM6DSO_TAP_AXIS_Y, 0.0f, 0.0f, 0.0f, 0.0f }, 1, 0, 0, 0, 125.0f,
+		4000.0f / ODR_HZ, 2000.0f / ODR_HZ, 16000.0f / ODR_HZ },
+	// Past the largest fields everything clamps
+	{ "16 g, clamped", 16, { false, true, LSM6DSO_TAP_AXIS_X, 20000.0f, 500.0f, 500.0f, 5000.0f }, 31, 3, 3, 15,
+		15500.0f, 24000.0f / ODR_HZ, 12000.0f / ODR_HZ, 480000.0f / ODR_HZ },
+};
+
+static bool Near(float actual, float expected)
+{
+	return fabsf(actual - expected) <= MAX_SETTING_ERROR;
+}
+
+/// <summary>
+///     Applies one case to a default image and checks the fields and the settings handed back.
+/// </summary>
+static void CheckTapCase(const tap_case_t *tapCase)
+{
+	lsm6dso_config_t config;
+	lsm6dso_tap_config_t tap = tapCase->tap;
+
+	lsm6dsoConfigDefaults(&config);
+	lsm6dsoEventsConfigTap(&config, &tap, ODR_HZ, tapCase->fullScaleG);
+
+	const lsm6dso_tap_cfg0_t *tapCfg0 = (const lsm6dso_tap_cfg0_t *)lsm6dsoConfigReg(&config, LSM6DSO_TAP_CFG0);
+	const lsm6dso_tap_cfg1_t *tapCfg1 = (const lsm6dso_tap_cfg1_t *)lsm6dsoConfigReg(&config, LSM6DSO_TAP_CFG1);
+	const lsm6dso_tap_cfg2_t *tapCfg2 = (const lsm6dso_tap_cfg2_t *)lsm6dsoConfigReg(&config, LSM6DSO_TAP_CFG2);
+	const lsm6dso_tap_ths_6d_t *tapThs6d = (const lsm6dso_tap_ths_6d_t *)lsm6dsoConfigReg(&config, LSM6DSO_TAP_THS_6D);
+	const lsm6dso_int_dur2_t *intDur2 = (const lsm6dso_int_dur2_t *)lsm6dsoConfigReg(&config, LSM6DSO_INT_DUR2);
+	const lsm6dso_wake_up_ths_t *wakeUpThs = (const lsm6dso_wake_up_ths_t *)lsm6dsoConfigReg(&config,
+		LSM6DSO_WAKE_UP_THS);
+
+	printf("%-14s threshold %2u (%.1f mg), shock %u (%.2f ms), quiet %u (%.2f ms), dur %2u (%.2f ms)\n",
+		tapCase->name, tapCfg1->tap_ths_x, tap.thresholdMg, intDur2->shock, tap.shockMs, intDur2->quiet,
+		tap.quietMs, intDur2->dur, tap.durationMs);
+
+	if ((tapCfg1->tap_ths_x != tapCase->threshold) || (tapCfg2->tap_ths_y != tapCase->threshold) ||
+		(tapThs6d->tap_ths_z != tapCase->threshold) || (intDur2->shock != tapCase->shock) ||
+		(intDur2->quiet != tapCase->quiet) || (intDur2->dur != tapCase->dur)) {
+		printf("FAIL: %s: expected threshold %u, shock %u, quiet %u, dur %u\n", tapCase->name, tapCase->threshold,
+			tapCase->shock, tapCase->quiet, tapCase->dur);
+		failures++;
+	}
+	if (!Near(tap.thresholdMg, tapCase->thresholdMg) || !Near(tap.shockMs, tapCase->shockMs) ||
+		!Near(tap.quietMs, tapCase->quietMs) || !Near(tap.durationMs, tapCase->durationMs)) {
+		printf("FAIL: %s: expected %.1f mg, %.2f, %.2f and %.2f ms handed back\n", tapCase->name,
+			tapCase->thresholdMg, tapCase->shockMs, tapCase->quietMs, tapCase->durationMs);
+		failures++;
+	}
+
+	// Only the axes asked for, and nothing when tap detection is off
+	uint8_t axes = tapCase->tap.enabled ? tapCase->tap.axes : 0;
+	bool doubleTap = tapCase->tap.enabled && tapCase->tap.doubleTap;
+	if ((tapCfg0->tap_x_en != ((axes & LSM6DSO_TAP_AXIS_X) != 0)) ||
+		(tapCfg0->tap_y_en != ((axes & LSM6DSO_TAP_AXIS_Y) != 0)) ||
+		(tapCfg0->tap_z_en != ((axes & LSM6DSO_TAP_AXIS_Z) != 0)) ||
+		(wakeUpThs->single_double_tap != (doubleTap ? LSM6DSO_BOTH_SINGLE_DOUBLE : LSM6DSO_ONLY_SINGLE))) {
+		printf("FAIL: %s: the axes or the double tap enable don't match\n", tapCase->name);
+		failures++;
+	}
+}
+
+/// <summary>
+///     Decodes a TAP_SRC value and checks the event and its JSON.  expectedJson is NULL when no
+///     tap is flagged.
+/// </summary>
+static void CheckTapSource(uint8_t tapSrc, const char *expectedJson)
+{
+	lsm6dso_event_sources_t sources;
+	lsm6dso_tap_event_t event;
+
+	memset(&sources, 0, sizeof(sources));
+	memcpy(&sources.tapSrc, &tapSrc, 1);
+
+	bool tapped = lsm6dsoEventsTap(&sources, &event);
+	if (!tapped || (expectedJson == NULL)) {
+		if (tapped != (expectedJson != NULL)) {
+			printf("FAIL: TAP_SRC 0x%02X %s\n", tapSrc, tapped ? "flagged a tap" : "flagged no tap");
+			failures++;
+		}
+		return;
+	}
+
+	if ((lsm6dsoEventsTapToJson(&event, json, sizeof(json)) < 0) || (strcmp(json, expectedJson) != 0)) {
+		printf("FAIL: TAP_SRC 0x%02X is %s, expected %s\n", tapSrc, json, expectedJson);
+		failures++;
+	}
+	if (lsm6dsoEventsTapToJson(&event, json, strlen(expectedJson)) >= 0) {
+		printf("FAIL: a tap that doesn't fit should be refused\n");
+		failures++;
+	}
+}
+
+int main(void)
+{
+	for (size_t i = 0; i < sizeof(tapCases) / sizeof(tapCases[0]); i++) {
+		CheckTapCase(&tapCases[i]);
+	}
+
+	// TAP_SRC: z_tap 0x01, y_tap 0x02, x_tap 0x04, tap_sign 0x08, double_tap 0x10, single_tap 0x20
+	CheckTapSource(0x00, NULL);
+	CheckTapSource(0x47, NULL);
+	CheckTapSource(0x61, "{\"tap\":\"single\",\"axis\":\"z\",\"sign\":\"+\"}");
+	CheckTapSource(0x73, "{\"tap\":\"double\",\"axis\":\"y\",\"sign\":\"+\"}");
+	CheckTapSource(0x5C, "{\"tap\":\"double\",\"axis\":\"x\",\"sign\":\"-\"}");
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,196 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "i2c.h"
+#include "i2c_sim.h"
+#include "lsm6dso_fifo.h"
+#include "lsm6dso_fifo_decoder.h"
+#include "lsm6dso_reg.h"
+#include "lsm6dso_timestamp.h"
+
+#include "host_applibs.h"
+
+// Runs the timestamp fit against the register model, whose counter ticks
+// I2C_SIM_TIMESTAMP_ERROR_PPM slow of CLOCK_MONOTONIC, and checks that the measured drift finds
+// that error.  The FIFO batches timestamps and compressed accelerometer and gyroscope words at
+// 833 Hz while the counter is synced and the FIFO drained every SYNC_PERIOD_US, as the
+// application does.  The sample times from the fit must keep increasing at the batch period and
+// never lie in the future.
+
+#define SYNC_PERIOD_US 250000
+
+// Just past LSM6DSO_TIMESTAMP_RATE_MIN_SECONDS, the drift isn't measured before
+#define RUN_SECONDS 11
+
+#define BATCH_HZ 833.0f
+#define WATERMARK 64
+
+// The fit finds 197 to 200 ppm against the model's 200
+#define MAX_DRIFT_ERROR_PPM 10.0
+
+// Mean sample period against 1 / BATCH_HZ
+#define MAX_PERIOD_ERROR 0.01
+
+// A sync that lands off the fit by more than this means the offset filter isn't tracking
+#define MAX_SYNC_ERROR_NS 1000000
+
+extern lsm6dso_ctx_t dev_ctx;
+
+typedef struct {
+	uint64_t firstNs;
+	uint64_t lastNs;
+	uint32_t samples;
+	uint32_t untimed;
+	uint32_t backwards;
+} sensor_times_t;
+
+static fifo_decoder_t decoder;
+static sensor_times_t accelTimes;
+static sensor_times_t gyroTimes;
+static uint64_t newestNs;
+
+static uint64_t NowNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/// <summary>
+///     Tracks the times of one sensor's decoded samples.
+/// </summary>
+static void AddSampleTime(sensor_times_t *times, uint64_t timeNs)
+{
+	times->samples++;
+	if (timeNs == 0) {
+		times->untimed++;
+		return;
+	}
+
+	if (times->lastNs == 0) {
+		times->firstNs = timeNs;
+	}
+	else if (timeNs <= times->lastNs) {
+		times->backwards++;
+	}
+	times->lastNs = timeNs;
+
+	if (timeNs > newestNs) {
+		newestNs = timeNs;
+	}
+}
+
+static void TimeDecodedWord(const fifo_word_t *word)
+{
+	if (word->tag == LSM6DSO_XL_NC_TAG) {
+		AddSampleTime(&accelTimes, word->timeNs);
+	}
+	else if (word->tag == LSM6DSO_GYRO_NC_TAG) {
+		AddSampleTime(&gyroTimes, word->timeNs);
+	}
+}
+
+/// <summary>
+///     Times each drained word in FIFO order, then decompresses it.
+/// </summary>
+static void TimeFifoWord(const fifo_word_t *word)
+{
+	fifo_word_t timed = *word;
+
+	lsm6dsoTimestampFifoWord(&timed);
+	lsm6dsoFifoDecode(&decoder, &timed, TimeDecodedWord);
+}
+
+/// <summary>
+///     Checks one sensor's sample times.  Samples drained before the first timestamp word have
+///     no time.
+/// </summary>
+/// <returns>The number of failures</returns>
+static int CheckSampleTimes(const char *name, const sensor_times_t *times)
+{
+	uint32_t timed = times->samples - times->untimed;
+	double periodNs = (timed > 1) ? (double)(times->lastNs - times->firstNs) / (double)(timed - 1) : 0.0;
+	double expectedNs = 1e9 / BATCH_HZ;
+
+	printf("%-13s %5u samples, %u untimed, %u out of order, %.1f us mean period\n", name, times->samples,
+		times->untimed, times->backwards, periodNs / 1000.0);
+
+	if ((timed == 0) || (times->backwards > 0)) {
+		printf("FAIL: the %s sample times should keep increasing\n", name);
+		return 1;
+	}
+	if ((periodNs < expectedNs * (1.0 - MAX_PERIOD_ERROR)) || (periodNs > expectedNs * (1.0 + MAX_PERIOD_ERROR))) {
+		printf("FAIL: the %s samples should be %.1f us apart\n", name, expectedNs / 1000.0);
+		return 1;
+	}
+
+	return 0;
+}
+
+int main(void)
+{
+	epollFd = CreateEpollFd();
+	if ((epollFd < 0) || (initI2c() != 0)) {
+		printf("FAIL: initI2c\n");
+		return 1;
+	}
+
+	lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_833Hz);
+	lsm6dso_gy_data_rate_set(&dev_ctx, LSM6DSO_GY_ODR_833Hz);
+	if ((initLsm6dsoTimestamp(&dev_ctx, LSM6DSO_DEC_8, BATCH_HZ) != 0) ||
+		(lsm6dsoFifoCompressionSet(&dev_ctx, LSM6DSO_CMP_16_TO_1) != 0) ||
+		(initLsm6dsoFifo(&dev_ctx, WATERMARK, LSM6DSO_XL_BATCHED_AT_833Hz, LSM6DSO_GY_BATCHED_AT_833Hz) != 0)) {
+		printf("FAIL: timestamp and FIFO setup\n");
+		return 1;
+	}
+	initLsm6dsoFifoDecoder(&decoder, lsm6dsoTimestampSlotPeriodNs());
+
+	int failures = 0;
+
+	for (uint32_t elapsedUs = 0; elapsedUs < RUN_SECONDS * 1000000; elapsedUs += SYNC_PERIOD_US) {
+		usleep(SYNC_PERIOD_US);
+		if ((lsm6dsoTimestampSync(&dev_ctx) != 0) || (drainLsm6dsoFifo(&dev_ctx, TimeFifoWord) < 0)) {
+			printf("FAIL: sync or FIFO drain\n");
+			return 1;
+		}
+		uint64_t drainedNs = NowNs();
+		if (newestNs > drainedNs) {
+			printf("FAIL: a sample was timed %.3f ms in the future\n", (double)(newestNs - drainedNs) / 1e6);
+			failures++;
+		}
+	}
+
+	lsm6dso_fifo_mode_set(&dev_ctx, LSM6DSO_BYPASS_MODE);
+	lsm6dsoFifoCompressionSet(&dev_ctx, LSM6DSO_CMP_DISABLE);
+	closeI2c();
+
+	const lsm6dso_timestamp_stats_t *stats = getLsm6dsoTimestampStats();
+	printf("timestamp fit: %.1f ppm drift, %.0f ppm simulated, last sync %lld ns off the fit, %u syncs, %u rejected\n",
+		stats->driftPpm, I2C_SIM_TIMESTAMP_ERROR_PPM, (long long)stats->lastErrorNs, stats->syncs,
+		stats->rejectedSyncs);
+
+	failures += CheckSampleTimes("accelerometer", &accelTimes);
+	failures += CheckSampleTimes("gyroscope", &gyroTimes);
+
+	if ((stats->driftPpm < I2C_SIM_TIMESTAMP_ERROR_PPM - MAX_DRIFT_ERROR_PPM) ||
+		(stats->driftPpm > I2C_SIM_TIMESTAMP_ERROR_PPM + MAX_DRIFT_ERROR_PPM)) {
+		printf("FAIL: the drift should be within %.0f ppm of the simulated %.0f ppm\n", MAX_DRIFT_ERROR_PPM,
+			I2C_SIM_TIMESTAMP_ERROR_PPM);
+		failures++;
+	}
+	if ((stats->lastErrorNs > MAX_SYNC_ERROR_NS) || (stats->lastErrorNs < -MAX_SYNC_ERROR_NS)) {
+		printf("FAIL: the last sync should land within %d ns of the fit\n", MAX_SYNC_ERROR_NS);
+		failures++;
+	}
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
@@ -0,0 +1,129 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "lsm6dso_fifo.h"
+#include "lsm6dso_reg.h"
+#include "lsm6dso_timestamp.h"
+
+#include "host_applibs.h"
+
+// Times a hand-made FIFO stream against one sync on a fake bus.  The stream loses five time slots,
+// which the 2 bit tag_cnt shows as a step of one, and the next timestamp word must bring the slot
+// count back so the words after it get their true time.  After a FIFO overrun the words must have
+// no time until a timestamp word arrives.
+
+#define BATCH_HZ 833.0f
+
+// 1 / BATCH_HZ in 25 us ticks, rounded
+#define SLOT_TICKS 48
+
+#define SYNC_TICKS 1000000u
+
+static uint8_t registers[256];
+static int failures;
+
+static int32_t FakeWrite(int *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	(void)handle;
+	memcpy(&registers[reg], data, len);
+	return 0;
+}
+
+static int32_t FakeRead(int *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	(void)handle;
+	memcpy(data, &registers[reg], len);
+	return 0;
+}
+
+/// <summary>
+///     Times one word of the time slot given, which sets its tag_cnt.  Timestamp words carry the
+///     counter value of their slot.
+/// </summary>
+/// <returns>The word's time</returns>
+static uint64_t TimeWord(lsm6dso_fifo_tag_t tag, uint32_t slot)
+{
+	fifo_word_t word;
+
+	memset(&word, 0, sizeof(word));
+	word.tag = tag;
+	word.tagCount = (uint8_t)(slot & 0x03);
+	if (tag == LSM6DSO_TIMESTAMP_TAG) {
+		uint32_t ticks = SYNC_TICKS + slot * SLOT_TICKS;
+		for (int i = 0; i < 4; i++) {
+			word.data.u8bit[i] = (uint8_t)(ticks >> (8 * i));
+		}
+	}
+
+	lsm6dsoTimestampFifoWord(&word);
+	return word.timeNs;
+}
+
+/// <summary>
+///     Checks a word's time is its slot's, counted from slot 0.
+/// </summary>
+static void ExpectSlot(const char *name, uint64_t timeNs, uint64_t slot0Ns, uint32_t slot)
+{
+	int64_t expectedNs = (int64_t)slot * SLOT_TICKS * (int64_t)LSM6DSO_TIMESTAMP_TICK_NS;
+	int64_t actualNs = (int64_t)(timeNs - slot0Ns);
+
+	if ((timeNs == 0) || (actualNs != expectedNs)) {
+		printf("FAIL: %s is %lld ns after slot 0, slot %u is %lld ns after it\n", name, (long long)actualNs, slot,
+			(long long)expectedNs);
+		failures++;
+	}
+}
+
+int main(void)
+{
+	int fd = 0;
+	lsm6dso_ctx_t ctx = { FakeWrite, FakeRead, &fd };
+
+	// INTERNAL_FREQ_FINE is 0, the counter runs at the nominal 25 us
+	for (int i = 0; i < 4; i++) {
+		registers[LSM6DSO_TIMESTAMP0 + i] = (uint8_t)(SYNC_TICKS >> (8 * i));
+	}
+	if (initLsm6dsoTimestamp(&ctx, LSM6DSO_DEC_8, BATCH_HZ) != 0) {
+		printf("FAIL: initLsm6dsoTimestamp\n");
+		return 1;
+	}
+
+	uint64_t slot0Ns = TimeWord(LSM6DSO_TIMESTAMP_TAG, 0);
+	ExpectSlot("slot 0", TimeWord(LSM6DSO_XL_NC_TAG, 0), slot0Ns, 0);
+	for (uint32_t slot = 1; slot < 4; slot++) {
+		ExpectSlot("a slot before the gap", TimeWord(LSM6DSO_XL_NC_TAG, slot), slot0Ns, slot);
+	}
+
+	// Slots 4 to 8 are lost, slot 9 is taken for slot 6 until the timestamp word of slot 10
+	TimeWord(LSM6DSO_XL_NC_TAG, 9);
+	ExpectSlot("the timestamp word after the gap", TimeWord(LSM6DSO_TIMESTAMP_TAG, 10), slot0Ns, 10);
+	ExpectSlot("slot 10", TimeWord(LSM6DSO_XL_NC_TAG, 10), slot0Ns, 10);
+	ExpectSlot("slot 11", TimeWord(LSM6DSO_XL_NC_TAG, 11), slot0Ns, 11);
+	ExpectSlot("slot 12", TimeWord(LSM6DSO_GYRO_NC_TAG, 12), slot0Ns, 12);
+
+	const lsm6dso_timestamp_stats_t *stats = getLsm6dsoTimestampStats();
+	printf("timestamp slots: %u slot gaps found\n", stats->slotGaps);
+	if (stats->slotGaps != 1) {
+		printf("FAIL: the timestamp word after the gap should find it\n");
+		failures++;
+	}
+
+	// An overrun loses the slot count until the next timestamp word
+	lsm6dsoTimestampResetFifo();
+	if (TimeWord(LSM6DSO_XL_NC_TAG, 40) != 0) {
+		printf("FAIL: a word after an overrun was given a time\n");
+		failures++;
+	}
+	ExpectSlot("the timestamp word after the overrun", TimeWord(LSM6DSO_TIMESTAMP_TAG, 41), slot0Ns, 41);
+	ExpectSlot("slot 42", TimeWord(LSM6DSO_XL_NC_TAG, 42), slot0Ns, 42);
+
+	if (getHostStats()->logErrors > 0) {
+		printf("FAIL: %u errors were logged\n", getHostStats()->logErrors);
+		failures++;
+	}
+
+	return (failures == 0) ? 0 : 1;
+}
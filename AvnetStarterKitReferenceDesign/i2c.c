@@ -32,30 +32,55 @@
 
 #include <errno.h>
 #include <signal.h>
+#include <stdatomic.h>
 #include <stdbool.h>
 #include <stdio.h>
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
+#include <time.h>
 
 // applibs_versions.h defines the API struct versions to use for applibs APIs.
 #include "applibs_versions.h"
 
 #include <applibs/log.h>
 #include <applibs/i2c.h>
+#include <applibs/gpio.h>
 
 #include "hw/avnet_mt3620_sk.h"
 
 #include "deviceTwin.h"
+#include "accel_calibration.h"
 #include "azure_iot_utilities.h"
 #include "build_options.h"
+#include "calibration_store.h"
+#include "gyro_bias.h"
+#include "gyro_calibration.h"
 #include "i2c.h"
+#include "i2c_queue.h"
+#include "i2c_sim.h"
+#include "i2c_stats.h"
+#include "imu_autorange.h"
+#include "imu_capture.h"
+#include "imu_convert.h"
 #include "lsm6dso_reg.h"
+#include "lsm6dso_config.h"
+#include "lsm6dso_events.h"
+#include "lsm6dso_fifo.h"
+#include "lsm6dso_fifo_decoder.h"
+#include "lsm6dso_fsm.h"
+#include "lsm6dso_pedometer.h"
+#include "lsm6dso_shadow.h"
+#include "lsm6dso_tilt.h"
+#include "lsm6dso_timestamp.h"
 #include "lps22hh_reg.h"
+#include "sensor_hub.h"
 
 /* Private variables ---------------------------------------------------------*/
+#ifndef ENABLE_LSM6DSO_FIFO
 static axis3bit16_t data_raw_acceleration;
 static axis3bit16_t data_raw_angular_rate;
-static axis3bit16_t raw_angular_rate_calibration;
+#endif
 static axis1bit32_t data_raw_pressure;
 static axis1bit16_t data_raw_temperature;
 static float acceleration_mg[3];
@@ -63,11 +88,241 @@ static float angular_rate_dps[3];
 static float lsm6dsoTemperature_degC;
 static float pressure_hPa;
 static float lps22hhTemperature_degC;
+static uint32_t lps22hhSampleCount;
+
+// Running sums, in mg and dps, of the samples acquired since the last pass of AccelTimerEventHandler.
+// Samples are converted as they are acquired so a full scale change between passes is handled.
+static double imuAccelSum[3];
+static double imuGyroSum[3];
+
+// Raw samples waiting to be converted, see AccumulateBatch
+typedef struct {
+	axis3bit16_t raw[IMU_CONVERT_BATCH];
+	size_t count;
+} imu_batch_t;
+
+static imu_batch_t imuAccelBatch;
+static imu_batch_t imuGyroBatch;
+static float imuConverted[3][IMU_CONVERT_BATCH];
+static uint32_t imuAccelCount;
+static uint32_t imuGyroCount;
+
+// Acquisition statistics, reported and cleared each pass of AccelTimerEventHandler
+static uint32_t imuWakeups;
+static uint64_t imuAcquireTimeNs;
+static struct timespec imuStatsStart;
+
+imu_settings_t imuSettings = {
+	.accelOdrHz = IMU_ACCEL_ODR_HZ,
+	.accelFullScaleG = IMU_ACCEL_FULL_SCALE_G,
+	.gyroOdrHz = IMU_GYRO_ODR_HZ,
+	.gyroFullScaleDps = IMU_GYRO_FULL_SCALE_DPS
+};
+
+// Settings in use, see ConfigImuSettings.  The accelerometer runs at imuAccelOdr, which is faster
+// than imuAccelRate while the tap engine needs it, and is batched at imuAccelRate.
+static const lsm6dso_rate_t *imuAccelRate;
+static const lsm6dso_rate_t *imuAccelOdr;
+static const lsm6dso_rate_t *imuGyroRate;
+static float accelMgPerLsb;
+static float gyroMdpsPerLsb;
+
+// Zero offsets subtracted during conversion, the gyroscope one is captured at startup
+static const float accelOffsetMg[3] = { 0.0f, 0.0f, 0.0f };
+static float gyroBiasDps[3];
+// false when neither a stored calibration nor the startup one gave the gyroscope offsets
+static bool gyroBiasValid;
+static gyro_calibration_t gyroCalibration;
+static accel_calibration_t accelCalibration;
+
+#ifdef ENABLE_CALIBRATION_STORE
+// Copy of the stored calibration record, updated and written back as each part is recalibrated
+static calibration_record_t storedCalibration;
+#endif
+
+#ifdef ENABLE_GYRO_BIAS_TRACKING
+static gyro_bias_t gyroBiasTracker;
+#endif
+
+// Startup phases, logged with their times once the first telemetry has been reported
+typedef enum {
+	BOOT_PHASE_START,
+	BOOT_PHASE_CONFIGURED,
+	BOOT_PHASE_CALIBRATED,
+	BOOT_PHASE_INIT_DONE,
+	BOOT_PHASE_FIRST_TELEMETRY,
+	BOOT_PHASE_COUNT
+} boot_phase_t;
+
+static const char *const bootPhaseNames[BOOT_PHASE_COUNT] = {
+	"start", "configured", "gyroscope calibrated", "init done", "first telemetry"
+};
+static struct timespec bootPhaseTimes[BOOT_PHASE_COUNT];
+static bool bootPhasesReported = false;
+
+#ifdef ENABLE_IMU_AUTORANGE
+static autorange_t accelAutorange;
+static autorange_t gyroAutorange;
+#endif
+
+#ifdef ENABLE_LSM6DSO_TIMESTAMP
+// Capture time of the newest sample acquired since the last pass, CLOCK_MONOTONIC nanoseconds
+static uint64_t imuNewestSampleNs;
+
+// FIFO overruns seen, the time slot count is lost on each one
+static uint32_t fifoTimestampOverruns;
+
+// Telemetry also carries the sample time
+#define IMU_TELEMETRY_BUFFER_SIZE (JSON_BUFFER_SIZE + 64)
+#else
+#define IMU_TELEMETRY_BUFFER_SIZE JSON_BUFFER_SIZE
+#endif
+
+#ifdef ENABLE_LSM6DSO_FIFO_COMPRESSION
+// Expands compressed FIFO words, reset whenever the FIFO overruns
+static fifo_decoder_t fifoDecoder;
+static uint32_t fifoDecoderOverruns;
+#endif
+
+#ifdef ENABLE_LSM6DSO_INT1
+static int int1GpioFd = -1;
+static int int1PollTimerFd = -1;
+#endif
+
+#ifdef ENABLE_LSM6DSO_TAP
+tap_settings_t tapSettings = {
+	.mode = LSM6DSO_TAP_MODE,
+	.axes = LSM6DSO_TAP_AXES,
+	.thresholdMg = LSM6DSO_TAP_THRESHOLD_MG,
+	.shockMs = LSM6DSO_TAP_SHOCK_MS,
+	.quietMs = LSM6DSO_TAP_QUIET_MS,
+	.durationMs = LSM6DSO_TAP_DURATION_MS
+};
+
+// Taps read since the last pass of AccelTimerEventHandler, and how many of them were sent
+static uint32_t tapSingleCount;
+static uint32_t tapDoubleCount;
+static uint32_t tapMessages;
+
+// Largest tap message
+#define TAP_EVENT_JSON_SIZE 64
+#endif
+
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+activity_settings_t activitySettings = {
+	.mode = LSM6DSO_ACTIVITY_MODE,
+	.thresholdMg = LSM6DSO_ACTIVITY_THRESHOLD_MG,
+	.sleepSeconds = LSM6DSO_ACTIVITY_SLEEP_SECONDS
+};
+
+// Set while the LSM6DSO is in its inactive state, nothing is acquired or sent until it wakes up
+static bool imuIdle;
+
+// When the activity state last changed, and the handler runs and messages sent since
+static struct timespec activityStateStart;
+static uint32_t activityWakeups;
+static uint32_t activityMessages;
+
+// Largest activity change message
+#define ACTIVITY_EVENT_JSON_SIZE 128
+#endif
+
+#ifdef ENABLE_IMU_CAPTURE
+capture_settings_t captureSettings = {
+	.mode = IMU_CAPTURE_MODE,
+	.freeFallMg = IMU_CAPTURE_FREE_FALL_MG,
+	.freeFallMs = IMU_CAPTURE_FREE_FALL_MS,
+	.shockMg = IMU_CAPTURE_SHOCK_MG,
+	.beforeMs = IMU_CAPTURE_BEFORE_MS,
+	.afterMs = IMU_CAPTURE_AFTER_MS
+};
+
+// Recent accelerometer samples, and the events that trigger a capture, set by ConfigCapture
+static imu_capture_t imuCapture;
+static bool captureFreeFall;
+static bool captureShock;
+
+// Capture messages are built here, nothing is allocated when an event fires
+static char captureJson[IMU_CAPTURE_JSON_SIZE];
+#endif
+
+#ifdef ENABLE_LSM6DSO_PEDOMETER
+pedometer_settings_t pedometerSettings = {
+	.mode = LSM6DSO_PEDOMETER_MODE
+};
+
+// Steps counted by the LSM6DSO, and the passes of AccelTimerEventHandler since they were last sent
+static lsm6dso_pedometer_t pedometer;
+static int pedometerPasses;
+static struct timespec pedometerPeriodStart;
+
+// Largest pedometer message
+#define PEDOMETER_JSON_SIZE 96
+#endif
+
+#ifdef ENABLE_LSM6DSO_FSM
+// Programs running on the FSMs and the rate they need, set by loadFsmProgram
+static uint8_t fsmPrograms;
+static float fsmOdrHz;
+
+// FSM events sent since the last pass of AccelTimerEventHandler
+static uint32_t fsmMessages;
+
+// Program images are decoded here, nothing is allocated for them
+static uint8_t fsmImage[LSM6DSO_FSM_MAX_IMAGE_SIZE];
+
+// Largest FSM event message
+#define FSM_EVENT_JSON_SIZE 48
+#endif
+
+#ifdef ENABLE_LSM6DSO_ORIENTATION
+orientation_settings_t orientationSettings = {
+	.mode = LSM6DSO_ORIENTATION_MODE,
+	.thresholdDeg = LSM6DSO_ORIENTATION_THRESHOLD_DEG,
+	.tilt = LSM6DSO_TILT_MODE
+};
+
+// Orientation changes and tilts sent since the last pass of AccelTimerEventHandler
+static uint32_t orientationMessages;
+
+// Largest orientation message
+#define ORIENTATION_EVENT_JSON_SIZE 48
+#endif
+
+#ifdef ENABLE_LSM6DSO_EVENTS
+// Set by ConfigImuEvents while any of the event engines is on
+static bool imuEventsEnabled;
+
+// Reads the event sources when INT1 isn't in use, disarmed unless tap detection or capture is on
+static int eventPollTimerFd = -1;
+#endif
+
+// One piece of an I2C write, I2cTransfer sends all the pieces of a transaction as a single write
+typedef struct {
+	const uint8_t *data;
+	size_t len;
+} i2c_segment_t;
+
+// Largest write we gather, the register address plus the longest transfer the I2C queue carries.
+// The I2CMaster API has no gather write, so the segments are copied into one buffer on the stack.
+#define I2C_MAX_WRITE_LEN (I2C_QUEUE_MAX_DATA + 1)
+
+// I2CMaster calls made, reported per sample by AccelTimerEventHandler.  With ENABLE_I2C_QUEUE the
+// calls are made on the I2C worker thread.
+static _Atomic uint32_t i2cSyscalls;
+
+// LSM6DSO STATUS_REG, an unused register and OUT_TEMP_L/H
+#define LSM6DSO_TEMP_READ_LEN 4
+
+// STATUS, PRESS_OUT_XL/L/H and TEMP_OUT_L/H
+#define LPS22HH_READ_LEN 6
 
 static uint8_t whoamI, rst;
 int accelTimerFd;
 const uint8_t lsm6dsOAddress = LSM6DSO_ADDRESS;     // Addr = 0x6A
 lsm6dso_ctx_t dev_ctx;
+// Desired LSM6DSO control register contents, see lsm6dso_config.h
+static lsm6dso_config_t imuConfig;
 lps22hh_ctx_t pressure_ctx;
 bool lps22hhDetected;
 
@@ -79,13 +334,17 @@ extern volatile sig_atomic_t terminationRequired;
 
 //Private functions
 
+static void DecodeLps22hhSample(const uint8_t *data);
+
 // Routines to read/write to the LSM6DSO device
 static int32_t platform_write(int *fD, uint8_t reg, uint8_t *bufp, uint16_t len);
 static int32_t platform_read(int *fD, uint8_t reg, uint8_t *bufp, uint16_t len);
-
-// Routines to read/write to the LPS22HH device connected to the LSM6DSO sensor hub
-static int32_t lsm6dso_write_lps22hh_cx(void* ctx, uint8_t reg, uint8_t* data, uint16_t len);
-static int32_t lsm6dso_read_lps22hh_cx(void* ctx, uint8_t reg, uint8_t* data, uint16_t len);
+static int32_t I2cTransfer(int fd, I2C_DeviceAddress address, const i2c_segment_t *segments, size_t segmentCount,
+	uint8_t *readBuf, size_t readLen);
+static int32_t BusTransfer(int fd, I2C_DeviceAddress address, uint8_t reg, uint8_t *data, uint16_t len, bool isRead);
+#ifdef ENABLE_I2C_QUEUE
+static int32_t RegisterTransfer(I2C_DeviceAddress address, uint8_t reg, uint8_t *data, uint16_t len, bool isRead);
+#endif
 
 /// <summary>
 ///     Sleep for delayTime ms
@@ -97,93 +356,1930 @@ void HAL_Delay(int delayTime) {
 	nanosleep(&ts, NULL);
 }
 
-/// <summary>
-///     Print latest data from on-board sensors.
-/// </summary>
-void AccelTimerEventHandler(EventData *eventData)
-{
-	uint8_t reg;
-	lps22hh_reg_t lps22hhReg;
+/// <summary>
+///     Returns the nanoseconds elapsed between two CLOCK_MONOTONIC readings
+/// </summary>
+static uint64_t ElapsedNs(const struct timespec *start, const struct timespec *end)
+{
+	return (uint64_t)(end->tv_sec - start->tv_sec) * 1000000000ULL + (uint64_t)end->tv_nsec - (uint64_t)start->tv_nsec;
+}
+
+/// <summary>
+///     Clear the sums and the acquisition statistics and start a new statistics period at now.
+/// </summary>
+static void ResetImuStats(const struct timespec *now)
+{
+	memset(imuAccelSum, 0x00, sizeof(imuAccelSum));
+	memset(imuGyroSum, 0x00, sizeof(imuGyroSum));
+	imuAccelCount = 0;
+	imuGyroCount = 0;
+	imuWakeups = 0;
+	imuAcquireTimeNs = 0;
+	atomic_store(&i2cSyscalls, 0);
+	imuStatsStart = *now;
+}
+
+/// <summary>
+///     Send a telemetry message, counting it against the current activity state.
+/// </summary>
+static void SendMessage(const char *json)
+{
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+	activityMessages++;
+#endif
+	AzureIoT_SendMessage(json);
+#endif
+}
+
+#ifdef ENABLE_IMU_CAPTURE
+/// <summary>
+///     Send the capture that just completed and wait for the next event.
+/// </summary>
+static void ReportCapture(void)
+{
+	if (imuCaptureToJson(&imuCapture, imuAccelRate->hz, captureJson, sizeof(captureJson)) < 0) {
+		Log_Debug("ERROR: The %s capture doesn't fit in %d bytes\n", imuCapture.event, IMU_CAPTURE_JSON_SIZE);
+	}
+	else {
+		Log_Debug("LSM6DSO: Sending %s capture, %u samples before and %u after, %u triggers missed\n",
+			imuCapture.event, (unsigned)imuCapture.triggerBefore, (unsigned)imuCapture.after,
+			getImuCaptureStats(&imuCapture)->missedTriggers);
+		SendMessage(captureJson);
+	}
+
+	imuCaptureRearm(&imuCapture);
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_PEDOMETER
+/// <summary>
+///     Every LSM6DSO_PEDOMETER_REPORT_PASSES passes send the step counters, if there were any
+///     steps, and start a new period at now.
+/// </summary>
+static void ReportSteps(const struct timespec *now)
+{
+	if ((pedometerSettings.mode == PEDOMETER_MODE_OFF) || (++pedometerPasses < LSM6DSO_PEDOMETER_REPORT_PASSES)) {
+		return;
+	}
+
+	if (pedometer.periodSteps > 0) {
+		char json[PEDOMETER_JSON_SIZE];
+		float periodSeconds = (float)ElapsedNs(&pedometerPeriodStart, now) / 1e9f;
+		if (lsm6dsoPedometerToJson(&pedometer, periodSeconds, json, sizeof(json)) > 0) {
+			Log_Debug("\n[Info] Sending steps: %s\n", json);
+			SendMessage(json);
+		}
+	}
+
+	lsm6dsoPedometerNewPeriod(&pedometer);
+	pedometerPasses = 0;
+	pedometerPeriodStart = *now;
+}
+#endif
+
+/// <summary>
+///     Convert a batch of raw 3-axis samples, subtracting the offset, and add them to a running sum.
+/// </summary>
+static void AccumulateBatch(imu_batch_t *batch, float scale, const float offset[3], double *sum, uint32_t *count)
+{
+	if (batch->count == 0) {
+		return;
+	}
+
+	imuConvertFloat(batch->raw, batch->count, scale, offset, imuConverted[0], imuConverted[1], imuConverted[2]);
+
+	for (int axis = 0; axis < 3; axis++) {
+		float batchSum = 0.0f;
+		for (size_t i = 0; i < batch->count; i++) {
+			batchSum += imuConverted[axis][i];
+		}
+		sum[axis] += batchSum;
+	}
+
+	*count += (uint32_t)batch->count;
+	batch->count = 0;
+}
+
+/// <summary>
+///     Convert the accelerometer samples batched so far to mg.
+/// </summary>
+static void AccumulateAccelBatch(void)
+{
+#if (defined(ENABLE_GYRO_BIAS_TRACKING) || defined(ENABLE_IMU_CAPTURE))
+	size_t count = imuAccelBatch.count;
+#endif
+
+	AccumulateBatch(&imuAccelBatch, accelMgPerLsb, accelOffsetMg, imuAccelSum, &imuAccelCount);
+
+#ifdef ENABLE_GYRO_BIAS_TRACKING
+	// imuConverted still holds the batch
+	gyroBiasAddAccel(&gyroBiasTracker, imuConverted[0], imuConverted[1], imuConverted[2], count);
+#endif
+
+#ifdef ENABLE_IMU_CAPTURE
+	if (captureFreeFall || captureShock) {
+		imuCaptureAdd(&imuCapture, imuConverted[0], imuConverted[1], imuConverted[2], count);
+		if (imuCaptureReady(&imuCapture)) {
+			ReportCapture();
+		}
+	}
+#endif
+}
+
+/// <summary>
+///     Convert the gyroscope samples batched so far to dps.
+/// </summary>
+static void AccumulateGyroBatch(void)
+{
+#ifdef ENABLE_GYRO_BIAS_TRACKING
+	size_t count = imuGyroBatch.count;
+#endif
+
+	AccumulateBatch(&imuGyroBatch, gyroMdpsPerLsb / 1000.0f, gyroBiasDps, imuGyroSum, &imuGyroCount);
+
+#ifdef ENABLE_GYRO_BIAS_TRACKING
+	// A still window moves the offsets, the next batch is converted with the new ones
+	if (gyroBiasAddGyro(&gyroBiasTracker, imuConverted[0], imuConverted[1], imuConverted[2], count, gyroBiasDps)) {
+		gyroBiasEstimate(&gyroBiasTracker, lsm6dsoTemperature_degC, gyroBiasDps);
+	}
+#endif
+}
+
+/// <summary>
+///     Record a new LSM6DSO temperature reading.
+/// </summary>
+static void Lsm6dsoTemperatureRead(void)
+{
+	lsm6dsoTemperature_degC = lsm6dso_from_lsb_to_celsius(data_raw_temperature.i16bit);
+
+	Log_Debug("LSM6DSO: Temperature  [degC]: %.2f\r\n", lsm6dsoTemperature_degC);
+
+#ifdef ENABLE_GYRO_BIAS_TRACKING
+	gyroBiasSetTemperature(&gyroBiasTracker, lsm6dsoTemperature_degC);
+#ifdef ENABLE_GYRO_BIAS_TEMPERATURE
+	// Follow the temperature between still windows
+	gyroBiasEstimate(&gyroBiasTracker, lsm6dsoTemperature_degC, gyroBiasDps);
+#endif
+#endif
+}
+
+/// <summary>
+///     Queue one raw accelerometer sample for conversion.
+/// </summary>
+static void AccumulateAccel(const axis3bit16_t *sample)
+{
+	imuAccelBatch.raw[imuAccelBatch.count++] = *sample;
+	if (imuAccelBatch.count == IMU_CONVERT_BATCH) {
+		AccumulateAccelBatch();
+	}
+#ifdef ENABLE_IMU_AUTORANGE
+	autorangeSample(&accelAutorange, sample);
+#endif
+}
+
+/// <summary>
+///     Queue one raw gyroscope sample for conversion.
+/// </summary>
+static void AccumulateGyro(const axis3bit16_t *sample)
+{
+	imuGyroBatch.raw[imuGyroBatch.count++] = *sample;
+	if (imuGyroBatch.count == IMU_CONVERT_BATCH) {
+		AccumulateGyroBatch();
+	}
+#ifdef ENABLE_IMU_AUTORANGE
+	autorangeSample(&gyroAutorange, sample);
+#endif
+}
+
+#ifdef ENABLE_LSM6DSO_FIFO
+/// <summary>
+///     Accumulate one accelerometer or gyroscope word drained from the FIFO.
+/// </summary>
+static void AccumulateFifoWord(const fifo_word_t *word)
+{
+	switch (word->tag) {
+	case LSM6DSO_XL_NC_TAG:
+		AccumulateAccel(&word->data);
+#ifdef ENABLE_LSM6DSO_TIMESTAMP
+		if (word->timeNs > imuNewestSampleNs) {
+			imuNewestSampleNs = word->timeNs;
+		}
+#endif
+		break;
+	case LSM6DSO_GYRO_NC_TAG:
+		AccumulateGyro(&word->data);
+#ifdef ENABLE_LSM6DSO_TIMESTAMP
+		if (word->timeNs > imuNewestSampleNs) {
+			imuNewestSampleNs = word->timeNs;
+		}
+#endif
+		break;
+#ifdef ENABLE_SENSOR_HUB_FIFO
+	case LSM6DSO_SENSORHUB_SLAVE0_TAG:
+		// The six data bytes hold LPS22HH STATUS, PRESS_OUT and TEMP_OUT
+		DecodeLps22hhSample(word->data.u8bit);
+		break;
+#endif
+#ifdef ENABLE_LSM6DSO_PEDOMETER
+	case LSM6DSO_STEP_CPUNTER_TAG:
+		lsm6dsoPedometerFifoWord(&pedometer, word);
+		break;
+#endif
+	default:
+		break;
+	}
+}
+
+/// <summary>
+///     Handle one word drained from the FIFO: time stamp it, expand it if it's compressed and
+///     accumulate the samples.
+/// </summary>
+static void HandleFifoWord(const fifo_word_t *word)
+{
+#ifdef ENABLE_LSM6DSO_TIMESTAMP
+	// Slots lost to an overrun can't be counted, the words have no time until the next timestamp
+	uint32_t timestampOverruns = getLsm6dsoFifoStats()->overruns;
+	if (timestampOverruns != fifoTimestampOverruns) {
+		lsm6dsoTimestampResetFifo();
+		fifoTimestampOverruns = timestampOverruns;
+	}
+
+	// Every word has to be seen, in order, to follow the FIFO time slots
+	fifo_word_t stamped = *word;
+	lsm6dsoTimestampFifoWord(&stamped);
+	word = &stamped;
+#endif
+
+#ifdef ENABLE_LSM6DSO_FIFO_COMPRESSION
+	// drainLsm6dsoFifo counts an overrun before handing out any word, the samples the next
+	// compressed word is relative to may have been lost
+	uint32_t overruns = getLsm6dsoFifoStats()->overruns;
+	if (overruns != fifoDecoderOverruns) {
+		initLsm6dsoFifoDecoder(&fifoDecoder, fifoDecoder.slotPeriodNs);
+		fifoDecoderOverruns = overruns;
+	}
+
+	lsm6dsoFifoDecode(&fifoDecoder, word, AccumulateFifoWord);
+#else
+	AccumulateFifoWord(word);
+#endif
+}
+#endif
+
+/// <summary>
+///     Pull any new accelerometer and gyroscope samples from the lsm6dso device into the
+///     running sums.  Called from the timer, or from the INT1 handler when INT1 is in use.
+/// </summary>
+static void AcquireImuSamples(void)
+{
+	struct timespec acquireStart, acquireEnd;
+
+	clock_gettime(CLOCK_MONOTONIC, &acquireStart);
+	imuWakeups++;
+
+#ifdef ENABLE_LSM6DSO_FIFO
+	// Drain everything the FIFO collected since the last wakeup
+	if (drainLsm6dsoFifo(&dev_ctx, HandleFifoWord) < 0) {
+		Log_Debug("ERROR: Could not drain the LSM6DSO FIFO\n");
+	}
+#else
+	uint8_t reg;
+
+	//Read output only if new xl value is available
+	lsm6dso_xl_flag_data_ready_get(&dev_ctx, &reg);
+	if (reg)
+	{
+		// Read acceleration field data
+		memset(data_raw_acceleration.u8bit, 0x00, 3 * sizeof(int16_t));
+		lsm6dso_acceleration_raw_get(&dev_ctx, data_raw_acceleration.u8bit);
+		AccumulateAccel(&data_raw_acceleration);
+	}
+
+	lsm6dso_gy_flag_data_ready_get(&dev_ctx, &reg);
+	if (reg)
+	{
+		// Read angular rate field data
+		memset(data_raw_angular_rate.u8bit, 0x00, 3 * sizeof(int16_t));
+		lsm6dso_angular_rate_raw_get(&dev_ctx, data_raw_angular_rate.u8bit);
+		AccumulateGyro(&data_raw_angular_rate);
+	}
+#endif
+
+	// Convert the partial batches, the sensitivity may change before the next wakeup
+	AccumulateAccelBatch();
+	AccumulateGyroBatch();
+
+	clock_gettime(CLOCK_MONOTONIC, &acquireEnd);
+	imuAcquireTimeNs += ElapsedNs(&acquireStart, &acquireEnd);
+}
+
+/// <summary>
+///     Records the time a startup phase was reached.
+/// </summary>
+static void BootPhase(boot_phase_t phase)
+{
+	clock_gettime(CLOCK_MONOTONIC, &bootPhaseTimes[phase]);
+}
+
+/// <summary>
+///     Marks the first telemetry and logs how long each startup phase took, only the first time
+///     it's called.
+/// </summary>
+static void ReportBootPhases(void)
+{
+	if (bootPhasesReported) {
+		return;
+	}
+	bootPhasesReported = true;
+
+	BootPhase(BOOT_PHASE_FIRST_TELEMETRY);
+	for (int phase = BOOT_PHASE_START + 1; phase < BOOT_PHASE_COUNT; phase++) {
+		Log_Debug("BOOT: %-20s %6u ms (+%u ms)\n", bootPhaseNames[phase],
+			(unsigned)(ElapsedNs(&bootPhaseTimes[BOOT_PHASE_START], &bootPhaseTimes[phase]) / 1000000ULL),
+			(unsigned)(ElapsedNs(&bootPhaseTimes[phase - 1], &bootPhaseTimes[phase]) / 1000000ULL));
+	}
+}
+
+/// <summary>
+///     Puts the accelerometer user offsets in the configuration image and switches them on for
+///     the output data, and so the FIFO, and for the wake-up and free-fall functions.
+/// </summary>
+static void ConfigAccelOffset(lsm6dso_usr_off_w_t weight, const int8_t registers[3])
+{
+	lsm6dsoConfigXlOffsetWeight(&imuConfig, weight);
+	lsm6dsoConfigXlUsrOffsetXyz(&imuConfig, registers);
+	lsm6dsoConfigXlUsrOffset(&imuConfig, PROPERTY_ENABLE);
+	lsm6dsoConfigXlUsrOffsetOnWkup(&imuConfig, PROPERTY_ENABLE);
+}
+
+#ifdef ENABLE_CALIBRATION_STORE
+/// <summary>
+///     Reads the calibration record and puts the stored accelerometer offsets in the configuration
+///     image.  The record lives in this device's mutable storage.  The LSM6DSO has no serial
+///     number, so a sensor swapped onto the board can't be told apart.  Its offsets are corrected
+///     by the next calibration.
+/// </summary>
+static void LoadStoredCalibration(void)
+{
+	if (calibrationStoreLoad(&storedCalibration) != 0) {
+		Log_Debug("LSM6DSO: No stored calibration\n");
+		memset(&storedCalibration, 0, sizeof(storedCalibration));
+	}
+
+	if ((storedCalibration.flags & CALIBRATION_ACCEL_VALID) != 0) {
+		ConfigAccelOffset((lsm6dso_usr_off_w_t)storedCalibration.accelOffsetWeight, storedCalibration.accelOffset);
+		Log_Debug("LSM6DSO: Using the stored accelerometer offsets %d, %d, %d (%s weight)\n",
+			storedCalibration.accelOffset[0], storedCalibration.accelOffset[1], storedCalibration.accelOffset[2],
+			(storedCalibration.accelOffsetWeight == LSM6DSO_LSb_16mg) ? "16 mg" : "1 mg");
+	}
+}
+
+/// <summary>
+///     Writes the calibration record back.
+/// </summary>
+static void StoreCalibration(void)
+{
+	if (calibrationStoreSave(&storedCalibration) != 0) {
+		Log_Debug("ERROR: Could not store the calibration\n");
+	}
+}
+
+/// <summary>
+///     Uses the stored gyroscope offsets if they were measured no longer than
+///     CALIBRATION_STORE_MAX_AGE_HOURS ago and within CALIBRATION_STORE_MAX_DRIFT_DEGC of the
+///     current temperature.  Until the clock is set at boot the age can't be measured and only
+///     the temperature is checked.
+/// </summary>
+/// <returns>0 if the stored offsets are in use, or -1 if the gyroscope has to be calibrated</returns>
+static int LoadStoredGyroBias(float temperatureDegC)
+{
+	if ((storedCalibration.flags & CALIBRATION_GYRO_VALID) == 0) {
+		Log_Debug("LSM6DSO: No stored gyroscope calibration\n");
+		return -1;
+	}
+
+	int64_t nowUtc = (int64_t)time(NULL);
+	if (!calibrationStoreClockSet(nowUtc)) {
+		Log_Debug("LSM6DSO: The clock isn't set yet, the age of the stored calibration is unknown\n");
+	}
+	else {
+		int64_t ageSeconds = nowUtc - storedCalibration.timeUtc;
+		// A record stored before the clock was set, or by a clock that was wrong, has no usable age
+		if (!calibrationStoreClockSet(storedCalibration.timeUtc) || (ageSeconds < 0) ||
+			(ageSeconds > CALIBRATION_STORE_MAX_AGE_HOURS * 3600LL)) {
+			Log_Debug("LSM6DSO: Stored calibration is stale\n");
+			return -1;
+		}
+		Log_Debug("LSM6DSO: Stored calibration is %lld s old\n", (long long)ageSeconds);
+	}
+	if (fabsf(temperatureDegC - storedCalibration.temperatureDegC) > CALIBRATION_STORE_MAX_DRIFT_DEGC) {
+		Log_Debug("LSM6DSO: Stored calibration was taken at %.1f degC, now %.1f degC\n", storedCalibration.temperatureDegC,
+			temperatureDegC);
+		return -1;
+	}
+
+	memcpy(gyroBiasDps, storedCalibration.gyroBiasDps, sizeof(gyroBiasDps));
+	gyroBiasValid = true;
+	Log_Debug("LSM6DSO: Using the calibration stored at %.1f degC, offsets %.3f, %.3f, %.3f dps\n",
+		storedCalibration.temperatureDegC, gyroBiasDps[0], gyroBiasDps[1], gyroBiasDps[2]);
+	return 0;
+}
+
+/// <summary>
+///     Stores the gyroscope offsets so the next start can skip the calibration.
+/// </summary>
+static void StoreGyroBias(float temperatureDegC)
+{
+	storedCalibration.flags |= CALIBRATION_GYRO_VALID;
+	storedCalibration.timeUtc = (int64_t)time(NULL);
+	storedCalibration.temperatureDegC = temperatureDegC;
+	memcpy(storedCalibration.gyroBiasDps, gyroBiasDps, sizeof(storedCalibration.gyroBiasDps));
+	StoreCalibration();
+}
+#endif
+
+/// <summary>
+///     Measures the gyroscope offsets with the board at rest.  The gyroscope is switched to
+///     IMU_GYRO_CAL_ODR_HZ and batched on its own in the FIFO for the captures, then put back to
+///     imuSettings.  The FIFO is left in bypass mode.  With ENABLE_CALIBRATION_STORE offsets that
+///     are still good are loaded instead, and new ones are stored.
+/// </summary>
+static void CalibrateGyroBias(void)
+{
+	// The accelerometer has been running since the configuration was written, so the temperature
+	// is valid.  The offsets are taken at this temperature.
+	lsm6dso_temperature_raw_get(&dev_ctx, data_raw_temperature.u8bit);
+	lsm6dsoTemperature_degC = lsm6dso_from_lsb_to_celsius(data_raw_temperature.i16bit);
+	gyroBiasValid = false;
+
+#ifdef ENABLE_CALIBRATION_STORE
+	if (LoadStoredGyroBias(lsm6dsoTemperature_degC) == 0) {
+		return;
+	}
+#endif
+
+	const lsm6dso_rate_t *calRate = lsm6dsoConfigFindRate(IMU_GYRO_CAL_ODR_HZ, false);
+	gyro_calibration_config_t calConfig = {
+		.rateHz = calRate->hz,
+		.samples = IMU_GYRO_CAL_SAMPLES,
+		.mdpsPerLsb = gyroMdpsPerLsb,
+		.maxStdDevDps = IMU_GYRO_CAL_MAX_STDDEV_DPS,
+		.settleMs = IMU_GYRO_CAL_SETTLE_MS,
+		.timeoutMs = IMU_GYRO_CAL_TIMEOUT_MS
+	};
+
+	Log_Debug("LSM6DSO: Calibrating angular rate . . .\n");
+	Log_Debug("LSM6DSO: Please make sure the device is stationary.\n");
+
+	lsm6dso_fifo_mode_set(&dev_ctx, LSM6DSO_BYPASS_MODE);
+	lsm6dso_fifo_xl_batch_set(&dev_ctx, LSM6DSO_XL_NOT_BATCHED);
+	lsm6dso_fifo_gy_batch_set(&dev_ctx, calRate->gyBatch);
+	lsm6dso_gy_data_rate_set(&dev_ctx, calRate->gyOdr);
+
+	if (calibrateGyro(&dev_ctx, &calConfig, &gyroCalibration) == 0) {
+		Log_Debug("LSM6DSO: Calibrating angular rate complete! Offsets %.3f, %.3f, %.3f dps, standard deviation %.3f, %.3f, %.3f dps\n",
+			gyroCalibration.biasDps[0], gyroCalibration.biasDps[1], gyroCalibration.biasDps[2],
+			gyroCalibration.stdDevDps[0], gyroCalibration.stdDevDps[1], gyroCalibration.stdDevDps[2]);
+	}
+	else {
+		Log_Debug("LSM6DSO: Angular rate calibration failed, using the gyroscope without offsets\n");
+	}
+	Log_Debug("LSM6DSO: Calibration took %u ms, %u captures, %u rejected\n", gyroCalibration.durationMs,
+		gyroCalibration.attempts, gyroCalibration.rejected);
+
+	// Keep the offsets in dps so they stay valid when the full scale changes
+	memcpy(gyroBiasDps, gyroCalibration.biasDps, sizeof(gyroBiasDps));
+	gyroBiasValid = gyroCalibration.valid;
+
+#ifdef ENABLE_CALIBRATION_STORE
+	if (gyroCalibration.valid) {
+		StoreGyroBias(lsm6dsoTemperature_degC);
+	}
+#endif
+
+	lsm6dso_fifo_mode_set(&dev_ctx, LSM6DSO_BYPASS_MODE);
+	lsm6dso_fifo_gy_batch_set(&dev_ctx, LSM6DSO_GY_NOT_BATCHED);
+	lsm6dso_gy_data_rate_set(&dev_ctx, imuGyroRate->gyOdr);
+}
+
+#ifdef ENABLE_LSM6DSO_TAP
+/// <summary>
+///     Round tapSettings to what the tap engine supports at the accelerometer output data rate and
+///     fullScaleG, and put them in the configuration image.  The image still has to be flushed.
+/// </summary>
+/// <returns>true if tap detection is on</returns>
+static bool ConfigTap(int fullScaleG)
+{
+	if (tapSettings.mode < TAP_MODE_OFF) {
+		tapSettings.mode = TAP_MODE_OFF;
+	}
+	else if (tapSettings.mode > TAP_MODE_SINGLE_DOUBLE) {
+		tapSettings.mode = TAP_MODE_SINGLE_DOUBLE;
+	}
+	tapSettings.axes &= LSM6DSO_TAP_AXIS_X | LSM6DSO_TAP_AXIS_Y | LSM6DSO_TAP_AXIS_Z;
+
+	lsm6dso_tap_config_t tap = {
+		.enabled = (tapSettings.mode != TAP_MODE_OFF),
+		.doubleTap = (tapSettings.mode == TAP_MODE_SINGLE_DOUBLE),
+		.axes = (uint8_t)tapSettings.axes,
+		.thresholdMg = tapSettings.thresholdMg,
+		.shockMs = tapSettings.shockMs,
+		.quietMs = tapSettings.quietMs,
+		.durationMs = tapSettings.durationMs
+	};
+	lsm6dsoEventsConfigTap(&imuConfig, &tap, imuAccelOdr->hz, fullScaleG);
+
+#ifdef ENABLE_LSM6DSO_INT1
+	lsm6dso_md1_cfg_t *md1Cfg = (lsm6dso_md1_cfg_t *)lsm6dsoConfigReg(&imuConfig, LSM6DSO_MD1_CFG);
+	md1Cfg->int1_single_tap = tap.enabled ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+	md1Cfg->int1_double_tap = tap.doubleTap ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+#endif
+
+	// Report back what is actually in use.  While tap detection is off the windows are rounded at
+	// the slower rate, keep the settings as they were.
+	if (tap.enabled) {
+		tapSettings.thresholdMg = tap.thresholdMg;
+		tapSettings.shockMs = tap.shockMs;
+		tapSettings.quietMs = tap.quietMs;
+		tapSettings.durationMs = tap.durationMs;
+	}
+	return tap.enabled;
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+/// <summary>
+///     Round activitySettings to what the activity engine supports at the accelerometer output data
+///     rate and fullScaleG, and put them in the configuration image.  The image still has to be
+///     flushed.
+/// </summary>
+/// <returns>true if activity gating is on</returns>
+static bool ConfigActivity(int fullScaleG)
+{
+	if (activitySettings.mode < 0) {
+		activitySettings.mode = 0;
+	}
+	else if (activitySettings.mode > 1) {
+		activitySettings.mode = 1;
+	}
+
+	lsm6dso_activity_config_t activity = {
+		.enabled = (activitySettings.mode != 0),
+		.inactiveMode = LSM6DSO_ACTIVITY_INACTIVE_MODE,
+		.thresholdMg = activitySettings.thresholdMg,
+		.wakeSamples = LSM6DSO_ACTIVITY_WAKE_SAMPLES,
+		.sleepSeconds = activitySettings.sleepSeconds
+	};
+	lsm6dsoEventsConfigActivity(&imuConfig, &activity, imuAccelOdr->hz, fullScaleG);
+
+#ifdef ENABLE_LSM6DSO_INT1
+	lsm6dso_md1_cfg_t *md1Cfg = (lsm6dso_md1_cfg_t *)lsm6dsoConfigReg(&imuConfig, LSM6DSO_MD1_CFG);
+	md1Cfg->int1_sleep_change = activity.enabled ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+#endif
+
+	// Report back what is actually in use, as for the tap settings only while it is on
+	if (activity.enabled) {
+		activitySettings.thresholdMg = activity.thresholdMg;
+		activitySettings.sleepSeconds = activity.sleepSeconds;
+	}
+	return activity.enabled;
+}
+#endif
+
+#ifdef ENABLE_IMU_CAPTURE
+/// <summary>
+///     Round captureSettings to what the free-fall and wake-up engines support at the accelerometer
+///     output data rate and fullScaleG, put them in the configuration image and size the capture
+///     window for the FIFO batch rate.  The image still has to be flushed.
+/// </summary>
+/// <returns>true if capture is on</returns>
+static bool ConfigCapture(int fullScaleG)
+{
+	captureSettings.mode &= CAPTURE_MODE_FREE_FALL | CAPTURE_MODE_SHOCK;
+	if (captureSettings.beforeMs < 0.0f) {
+		captureSettings.beforeMs = 0.0f;
+	}
+	if (captureSettings.afterMs < 0.0f) {
+		captureSettings.afterMs = 0.0f;
+	}
+
+	captureFreeFall = ((captureSettings.mode & CAPTURE_MODE_FREE_FALL) != 0);
+	captureShock = ((captureSettings.mode & CAPTURE_MODE_SHOCK) != 0);
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+	// The wake-up engine can only have one threshold, activity gating keeps it
+	captureShock = captureShock && (activitySettings.mode == 0);
+#endif
+
+	lsm6dso_free_fall_config_t freeFall = {
+		.thresholdMg = captureSettings.freeFallMg,
+		.durationMs = captureSettings.freeFallMs
+	};
+	lsm6dsoEventsConfigFreeFall(&imuConfig, &freeFall, imuAccelOdr->hz);
+
+	lsm6dso_shock_config_t shock = {
+		.thresholdMg = captureSettings.shockMg,
+		.samples = IMU_CAPTURE_SHOCK_SAMPLES
+	};
+	if (captureShock) {
+		lsm6dsoEventsConfigShock(&imuConfig, &shock, fullScaleG);
+	}
+
+#ifdef ENABLE_LSM6DSO_INT1
+	lsm6dso_md1_cfg_t *md1Cfg = (lsm6dso_md1_cfg_t *)lsm6dsoConfigReg(&imuConfig, LSM6DSO_MD1_CFG);
+	md1Cfg->int1_ff = captureFreeFall ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+	md1Cfg->int1_wu = captureShock ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+#endif
+
+	// The windows are in samples at the rate the FIFO batches at
+	float rateHz = imuAccelRate->hz;
+	imuCaptureSetWindow(&imuCapture, (size_t)lroundf(captureSettings.beforeMs * rateHz / 1000.0f),
+		(size_t)lroundf(captureSettings.afterMs * rateHz / 1000.0f));
+
+	// Report back what is actually in use, as for the tap settings only while it is on
+	if (captureFreeFall) {
+		captureSettings.freeFallMg = freeFall.thresholdMg;
+		captureSettings.freeFallMs = freeFall.durationMs;
+	}
+	if (captureShock) {
+		captureSettings.shockMg = shock.thresholdMg;
+	}
+	if (captureFreeFall || captureShock) {
+		captureSettings.beforeMs = (float)imuCapture.before * 1000.0f / rateHz;
+		captureSettings.afterMs = (float)imuCapture.after * 1000.0f / rateHz;
+	}
+	return captureFreeFall || captureShock;
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_ORIENTATION
+/// <summary>
+///     Round orientationSettings to what the 6D engine supports and put them in the configuration
+///     image.  Tilt detection is in the embedded functions bank, see ConfigTilt.  The image still
+///     has to be flushed.
+/// </summary>
+/// <returns>true if orientation or tilt detection is on</returns>
+static bool ConfigOrientation(void)
+{
+	if ((orientationSettings.mode < ORIENTATION_MODE_OFF) || (orientationSettings.mode > ORIENTATION_MODE_4D)) {
+		orientationSettings.mode = ORIENTATION_MODE_OFF;
+	}
+	orientationSettings.tilt = (orientationSettings.tilt != 0) ? 1 : 0;
+
+	lsm6dso_orientation_config_t orientation = {
+		.enabled = (orientationSettings.mode != ORIENTATION_MODE_OFF),
+		.fourD = (orientationSettings.mode == ORIENTATION_MODE_4D),
+		.thresholdDeg = orientationSettings.thresholdDeg
+	};
+	lsm6dsoEventsConfigOrientation(&imuConfig, &orientation);
+
+#ifdef ENABLE_LSM6DSO_INT1
+	lsm6dso_md1_cfg_t *md1Cfg = (lsm6dso_md1_cfg_t *)lsm6dsoConfigReg(&imuConfig, LSM6DSO_MD1_CFG);
+	md1Cfg->int1_6d = orientation.enabled ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+#endif
+
+	// Report back what is actually in use
+	orientationSettings.thresholdDeg = orientation.thresholdDeg;
+	return orientation.enabled || (orientationSettings.tilt != 0);
+}
+
+/// <summary>
+///     Switch tilt detection to orientationSettings.tilt, routed to INT1 when it is in use.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+static int ConfigTilt(void)
+{
+	bool int1 = false;
+
+#ifdef ENABLE_LSM6DSO_INT1
+	int1 = (int1GpioFd >= 0);
+#endif
+	if (lsm6dsoTiltSet(&dev_ctx, orientationSettings.tilt != 0, int1) != 0) {
+		Log_Debug("ERROR: Could not configure LSM6DSO tilt detection\n");
+		return -1;
+	}
+	return 0;
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_EVENTS
+/// <summary>
+///     Put the settings of every event engine in the configuration image, and latch and enable the
+///     basic interrupts while any of them is on.  The image still has to be flushed.
+/// </summary>
+static void ConfigImuEvents(int fullScaleG)
+{
+	bool enabled = false;
+	bool embedded = false;
+
+#ifdef ENABLE_LSM6DSO_TAP
+	enabled |= ConfigTap(fullScaleG);
+#endif
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+	enabled |= ConfigActivity(fullScaleG);
+#endif
+#ifdef ENABLE_IMU_CAPTURE
+	// After the activity settings, the shock threshold shares their register
+	enabled |= ConfigCapture(fullScaleG);
+#endif
+#ifdef ENABLE_LSM6DSO_FSM
+	// lsm6dsoFsmLoad set up the rest, the programs live in the embedded function pages
+	embedded |= (fsmPrograms > 0);
+#endif
+#ifdef ENABLE_LSM6DSO_ORIENTATION
+	enabled |= ConfigOrientation();
+	embedded |= (orientationSettings.tilt != 0);
+#endif
+	enabled |= embedded;
+
+#ifdef ENABLE_LSM6DSO_INT1
+	// The embedded functions share this route, behind it each has its own INT1 routing
+	lsm6dso_md1_cfg_t *md1Cfg = (lsm6dso_md1_cfg_t *)lsm6dsoConfigReg(&imuConfig, LSM6DSO_MD1_CFG);
+	md1Cfg->int1_emb_func = embedded ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+#endif
+
+	lsm6dsoEventsConfigLatch(&imuConfig, enabled);
+	imuEventsEnabled = enabled;
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_TIMESTAMP
+/// <summary>
+///     Fastest FIFO batch rate, which sets the FIFO time slot period.
+/// </summary>
+static float ImuBatchHz(void)
+{
+	return (imuGyroRate->hz > imuAccelRate->hz) ? imuGyroRate->hz : imuAccelRate->hz;
+}
+#endif
+
+/// <summary>
+///     Round imuSettings up to supported settings, put them in the configuration image and
+///     switch to their sensitivities.  The image still has to be flushed.
+/// </summary>
+static void ConfigImuSettings(void)
+{
+	// The accelerometer can't be switched off, the sensor hub uses it as its trigger
+	imuAccelRate = lsm6dsoConfigFindRate(imuSettings.accelOdrHz, false);
+	imuGyroRate = lsm6dsoConfigFindRate(imuSettings.gyroOdrHz, true);
+	const lsm6dso_xl_range_t *accelRange = lsm6dsoConfigFindXlRange(imuSettings.accelFullScaleG);
+	const lsm6dso_gy_range_t *gyroRange = lsm6dsoConfigFindGyRange(imuSettings.gyroFullScaleDps);
+
+	// Report back what is actually in use
+	imuSettings.accelOdrHz = imuAccelRate->hz;
+	imuSettings.gyroOdrHz = imuGyroRate->hz;
+	imuSettings.accelFullScaleG = accelRange->fullScaleG;
+	imuSettings.gyroFullScaleDps = gyroRange->fullScaleDps;
+
+	imuAccelOdr = imuAccelRate;
+#ifdef ENABLE_LSM6DSO_TAP
+	// The tap engine needs a faster output data rate than we batch at
+	const lsm6dso_rate_t *tapRate = lsm6dsoConfigFindRate(LSM6DSO_TAP_ODR_HZ, false);
+	if ((tapSettings.mode != TAP_MODE_OFF) && (tapRate->hz > imuAccelRate->hz)) {
+		imuAccelOdr = tapRate;
+	}
+#endif
+#ifdef ENABLE_LSM6DSO_PEDOMETER
+	// So does the pedometer, when accelOdrHz is below 26 Hz
+	const lsm6dso_rate_t *pedometerRate = lsm6dsoConfigFindRate(LSM6DSO_PEDOMETER_ODR_HZ, false);
+	if ((pedometerSettings.mode != PEDOMETER_MODE_OFF) && (pedometerRate->hz > imuAccelOdr->hz)) {
+		imuAccelOdr = pedometerRate;
+	}
+#endif
+#ifdef ENABLE_LSM6DSO_FSM
+	// And the FSMs, which run at the rate of the program image
+	const lsm6dso_rate_t *fsmRate = lsm6dsoConfigFindRate(fsmOdrHz, false);
+	if ((fsmPrograms > 0) && (fsmRate->hz > imuAccelOdr->hz)) {
+		imuAccelOdr = fsmRate;
+	}
+#endif
+#ifdef ENABLE_LSM6DSO_ORIENTATION
+	// And tilt detection, 6D orientation works at any rate
+	const lsm6dso_rate_t *tiltRate = lsm6dsoConfigFindRate(LSM6DSO_TILT_ODR_HZ, false);
+	if ((orientationSettings.tilt != 0) && (tiltRate->hz > imuAccelOdr->hz)) {
+		imuAccelOdr = tiltRate;
+	}
+#endif
+
+	lsm6dsoConfigXlDataRate(&imuConfig, imuAccelOdr->xlOdr);
+	lsm6dsoConfigGyDataRate(&imuConfig, imuGyroRate->gyOdr);
+	lsm6dsoConfigXlFullScale(&imuConfig, accelRange->fs);
+	lsm6dsoConfigGyFullScale(&imuConfig, gyroRange->fs);
+#ifdef ENABLE_LSM6DSO_FIFO
+	lsm6dsoConfigFifoBatch(&imuConfig, imuAccelRate->xlBatch, imuGyroRate->gyBatch);
+#endif
+
+	accelMgPerLsb = accelRange->mgPerLsb;
+	gyroMdpsPerLsb = gyroRange->mdpsPerLsb;
+
+#ifdef ENABLE_LSM6DSO_EVENTS
+	// The event thresholds and windows depend on the full scale and output data rate
+	ConfigImuEvents(accelRange->fullScaleG);
+#endif
+}
+
+#ifdef ENABLE_LSM6DSO_FIFO
+/// <summary>
+///     Start batching from an empty FIFO, which must be in bypass mode.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+static int RestartImuFifo(void)
+{
+#ifdef ENABLE_LSM6DSO_TIMESTAMP
+	lsm6dsoTimestampSetBatchRate(ImuBatchHz());
+#endif
+
+#ifdef ENABLE_LSM6DSO_FIFO_COMPRESSION
+	// Restart compression so the first word batched after the flush is uncompressed
+	if (lsm6dsoFifoCompressionSet(&dev_ctx, LSM6DSO_FIFO_COMPRESSION_RATE) != 0) {
+		Log_Debug("ERROR: Could not restart LSM6DSO FIFO compression\n");
+	}
+#ifdef ENABLE_LSM6DSO_TIMESTAMP
+	initLsm6dsoFifoDecoder(&fifoDecoder, lsm6dsoTimestampSlotPeriodNs());
+#else
+	initLsm6dsoFifoDecoder(&fifoDecoder, 0);
+#endif
+#endif
+
+	lsm6dsoConfigFifoMode(&imuConfig, LSM6DSO_STREAM_MODE);
+	if (lsm6dsoConfigFlush(&dev_ctx, &imuConfig) < 0) {
+		Log_Debug("ERROR: Could not restart the LSM6DSO FIFO\n");
+		return -1;
+	}
+	return 0;
+}
+#endif
+
+/// <summary>
+///     Apply imuSettings after the device twin changed one of them.  Samples taken with the old
+///     settings are acquired first and, with the FIFO, anything batched while the device is being
+///     reconfigured is flushed, so every sample is converted with the sensitivity it was taken at.
+/// </summary>
+void imuSettingsChanged(void)
+{
+	AcquireImuSamples();
+
+#ifdef ENABLE_LSM6DSO_FIFO
+	lsm6dsoConfigFifoMode(&imuConfig, LSM6DSO_BYPASS_MODE);
+#endif
+	ConfigImuSettings();
+	if (lsm6dsoConfigFlush(&dev_ctx, &imuConfig) < 0) {
+		Log_Debug("ERROR: Could not apply the LSM6DSO settings\n");
+		return;
+	}
+
+#ifdef ENABLE_LSM6DSO_FIFO
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+	// While idle the FIFO stays in bypass, ExitIdle restarts it
+	bool restartFifo = !imuIdle;
+#else
+	bool restartFifo = true;
+#endif
+	if (restartFifo && (RestartImuFifo() != 0)) {
+		return;
+	}
+#endif
+
+	Log_Debug("LSM6DSO: accelerometer %.1f Hz, %d g, gyroscope %.1f Hz, %d dps\n", imuSettings.accelOdrHz,
+		imuSettings.accelFullScaleG, imuSettings.gyroOdrHz, imuSettings.gyroFullScaleDps);
+}
+
+#ifdef ENABLE_LSM6DSO_EVENTS
+/// <summary>
+///     Poll the event sources while tap detection, capture, the FSMs or orientation are on, unless INT1 signals them.
+///     Taps aren't detected at the inactive state rate and nothing is captured while idle, so the
+///     polling also stops while idle.
+/// </summary>
+static void ArmEventPoll(void)
+{
+	struct timespec period = { .tv_sec = 0,.tv_nsec = 0 };
+
+	bool poll = false;
+#ifdef ENABLE_LSM6DSO_TAP
+	poll = poll || (tapSettings.mode != TAP_MODE_OFF);
+#endif
+#ifdef ENABLE_IMU_CAPTURE
+	poll = poll || captureFreeFall || captureShock;
+#endif
+#ifdef ENABLE_LSM6DSO_FSM
+	poll = poll || (fsmPrograms > 0);
+#endif
+#ifdef ENABLE_LSM6DSO_ORIENTATION
+	poll = poll || (orientationSettings.mode != ORIENTATION_MODE_OFF) || (orientationSettings.tilt != 0);
+#endif
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+	poll = poll && !imuIdle;
+#endif
+#ifdef ENABLE_LSM6DSO_INT1
+	poll = poll && (int1GpioFd < 0);
+#endif
+	if (poll) {
+		period.tv_nsec = LSM6DSO_EVENT_POLL_PERIOD_NANO_SECONDS;
+	}
+
+	SetTimerFdToPeriod(eventPollTimerFd, &period);
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_TAP
+/// <summary>
+///     Send a tap as its own telemetry message, up to LSM6DSO_TAP_MAX_MESSAGES_PER_PASS per pass
+///     of AccelTimerEventHandler.
+/// </summary>
+static void ReportTap(const lsm6dso_tap_event_t *tap)
+{
+	char json[TAP_EVENT_JSON_SIZE];
+
+	if (tap->doubleTap) {
+		tapDoubleCount++;
+	}
+	else {
+		tapSingleCount++;
+	}
+
+	if ((tapMessages >= LSM6DSO_TAP_MAX_MESSAGES_PER_PASS) || (lsm6dsoEventsTapToJson(tap, json, sizeof(json)) < 0)) {
+		return;
+	}
+	tapMessages++;
+
+	Log_Debug("LSM6DSO: Tap %s\n", json);
+	SendMessage(json);
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_FSM
+/// <summary>
+///     Send an FSM event as its own telemetry message, up to LSM6DSO_FSM_MAX_MESSAGES_PER_PASS per
+///     pass of AccelTimerEventHandler.
+/// </summary>
+static void ReportFsmEvent(const lsm6dso_fsm_event_t *event)
+{
+	char json[FSM_EVENT_JSON_SIZE];
+
+	if ((fsmMessages >= LSM6DSO_FSM_MAX_MESSAGES_PER_PASS) || (lsm6dsoFsmEventToJson(event, json, sizeof(json)) < 0)) {
+		return;
+	}
+	fsmMessages++;
+
+	Log_Debug("LSM6DSO: FSM %s\n", json);
+	SendMessage(json);
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_ORIENTATION
+/// <summary>
+///     Send an orientation change or a tilt as its own telemetry message, up to
+///     LSM6DSO_ORIENTATION_MAX_MESSAGES_PER_PASS per pass of AccelTimerEventHandler.
+/// </summary>
+static void ReportOrientation(const lsm6dso_orientation_event_t *orientation)
+{
+	char json[ORIENTATION_EVENT_JSON_SIZE];
+
+	if ((orientationMessages >= LSM6DSO_ORIENTATION_MAX_MESSAGES_PER_PASS) ||
+		(lsm6dsoEventsOrientationToJson(orientation, json, sizeof(json)) < 0)) {
+		return;
+	}
+	orientationMessages++;
+
+	Log_Debug("LSM6DSO: Orientation %s\n", json);
+	SendMessage(json);
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+/// <summary>
+///     Send an activity change with the seconds, wakeups and messages of the state that ended, and
+///     start counting the new state.
+/// </summary>
+static void ReportActivityChange(void)
+{
+	char json[ACTIVITY_EVENT_JSON_SIZE];
+	struct timespec now;
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	const char *ended = imuIdle ? "active" : "idle";
+	snprintf(json, sizeof(json), "{\"activity\":\"%s\",\"%sSeconds\":%.1f,\"%sWakeups\":%u,\"%sMessages\":%u}",
+		imuIdle ? "idle" : "active", ended, (double)ElapsedNs(&activityStateStart, &now) / 1e9, ended, activityWakeups,
+		ended, activityMessages);
+
+	activityStateStart = now;
+	activityWakeups = 0;
+	activityMessages = 0;
+
+	Log_Debug("LSM6DSO: Activity %s\n", json);
+	SendMessage(json);
+}
+
+/// <summary>
+///     The LSM6DSO went to its inactive state: stop batching and slow AccelTimerEventHandler down.
+/// </summary>
+static void EnterIdle(void)
+{
+	imuIdle = true;
+
+#ifdef ENABLE_LSM6DSO_FIFO
+	// Bypass mode also empties the FIFO, the few samples batched since the device went to sleep
+	// would only be thrown away by ExitIdle
+	lsm6dsoConfigFifoMode(&imuConfig, LSM6DSO_BYPASS_MODE);
+	if (lsm6dsoConfigFlush(&dev_ctx, &imuConfig) < 0) {
+		Log_Debug("ERROR: Could not stop the LSM6DSO FIFO\n");
+	}
+#endif
+
+	struct timespec idlePeriod = { .tv_sec = LSM6DSO_ACTIVITY_IDLE_PERIOD_SECONDS,.tv_nsec = 0 };
+	SetTimerFdToPeriod(accelTimerFd, &idlePeriod);
+#ifdef ENABLE_LSM6DSO_EVENTS
+	ArmEventPoll();
+#endif
+
+	ReportActivityChange();
+}
+
+/// <summary>
+///     The LSM6DSO woke up: start batching again from an empty FIFO and resume full rate capture.
+/// </summary>
+static void ExitIdle(void)
+{
+	struct timespec now;
+
+	imuIdle = false;
+
+	// Nothing acquired while idle belongs to the next report
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	ResetImuStats(&now);
+
+#ifdef ENABLE_LSM6DSO_FIFO
+	RestartImuFifo();
+#endif
+
+	struct timespec accelReadPeriod = { .tv_sec = ACCEL_READ_PERIOD_SECONDS,.tv_nsec = ACCEL_READ_PERIOD_NANO_SECONDS };
+	SetTimerFdToPeriod(accelTimerFd, &accelReadPeriod);
+#ifdef ENABLE_LSM6DSO_EVENTS
+	ArmEventPoll();
+#endif
+
+	ReportActivityChange();
+}
+#endif
+
+#ifdef ENABLE_IMU_CAPTURE
+/// <summary>
+///     Start a capture at the newest sample.  The FIFO is drained first so the trigger lands as
+///     close to the event as the event read latency allows.
+/// </summary>
+static void TriggerCapture(const char *event)
+{
+	AcquireImuSamples();
+
+	if (imuCaptureTrigger(&imuCapture, event)) {
+		Log_Debug("LSM6DSO: %s, capturing\n", event);
+	}
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_EVENTS
+/// <summary>
+///     Read the LSM6DSO event sources, which also clears the latched interrupts, and report the
+///     events they flag.
+/// </summary>
+static void ReadImuEvents(void)
+{
+	lsm6dso_event_sources_t sources;
+
+	if (lsm6dsoEventSourcesGet(&dev_ctx, &sources) != 0) {
+		Log_Debug("ERROR: Could not read the LSM6DSO event sources\n");
+		return;
+	}
+
+#ifdef ENABLE_LSM6DSO_TAP
+	lsm6dso_tap_event_t tap;
+	if (lsm6dsoEventsTap(&sources, &tap)) {
+		ReportTap(&tap);
+	}
+#endif
+
+#ifdef ENABLE_LSM6DSO_ORIENTATION
+	// D6D_SRC came with the basic event sources, the tilt flag is a separate read
+	lsm6dso_orientation_event_t orientation;
+	bool changed = lsm6dsoEventsOrientation(&sources, &orientation) && (orientationSettings.mode != ORIENTATION_MODE_OFF);
+	if ((orientationSettings.tilt != 0) && (lsm6dsoTiltRead(&dev_ctx, &orientation.tilt) != 0)) {
+		Log_Debug("ERROR: Could not read the LSM6DSO tilt status\n");
+	}
+	if (changed || orientation.tilt) {
+		ReportOrientation(&orientation);
+	}
+#endif
+
+#ifdef ENABLE_LSM6DSO_FSM
+	// The FSM status is on the main page, a separate read from the basic event sources
+	if ((fsmPrograms > 0) && (lsm6dsoFsmReadEvents(&dev_ctx, ReportFsmEvent) < 0)) {
+		Log_Debug("ERROR: Could not read the LSM6DSO FSM status\n");
+	}
+#endif
+
+#ifdef ENABLE_IMU_CAPTURE
+	if (captureFreeFall && (sources.wakeUpSrc.ff_ia != 0)) {
+		TriggerCapture("freefall");
+	}
+	else if (captureShock && (sources.wakeUpSrc.wu_ia != 0)) {
+		TriggerCapture("shock");
+	}
+#endif
+
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+	// Follow sleep_state rather than the change flag, so a missed change is caught up with
+	if ((activitySettings.mode != 0) && ((sources.wakeUpSrc.sleep_state != 0) != imuIdle)) {
+		if (imuIdle) {
+			ExitIdle();
+		}
+		else {
+			EnterIdle();
+		}
+	}
+#endif
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_EVENTS
+/// <summary>
+///     Read the event sources when INT1 isn't in use.
+/// </summary>
+static void EventPollTimerEventHandler(EventData *eventData)
+{
+	(void)eventData;
+
+	if (ConsumeTimerFdEvent(eventPollTimerFd) != 0) {
+		terminationRequired = true;
+		return;
+	}
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+	activityWakeups++;
+#endif
+
+	ReadImuEvents();
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_TAP
+/// <summary>
+///     Apply tapSettings after the device twin changed one of them.  Only the registers that
+///     differ are written, the FIFO keeps running.
+/// </summary>
+void tapSettingsChanged(void)
+{
+	ConfigImuSettings();
+	if (lsm6dsoConfigFlush(&dev_ctx, &imuConfig) < 0) {
+		Log_Debug("ERROR: Could not apply the tap settings\n");
+		return;
+	}
+	ArmEventPoll();
+
+	Log_Debug("LSM6DSO: tap mode %d, axes %d, threshold %.0f mg, shock %.1f ms, quiet %.1f ms, duration %.1f ms at %.0f Hz\n",
+		tapSettings.mode, tapSettings.axes, tapSettings.thresholdMg, tapSettings.shockMs, tapSettings.quietMs,
+		tapSettings.durationMs, imuAccelOdr->hz);
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+/// <summary>
+///     Apply activitySettings after the device twin changed one of them.  Only the registers that
+///     differ are written.
+/// </summary>
+void activitySettingsChanged(void)
+{
+	ConfigImuSettings();
+	if (lsm6dsoConfigFlush(&dev_ctx, &imuConfig) < 0) {
+		Log_Debug("ERROR: Could not apply the activity settings\n");
+		return;
+	}
+
+	// Switching the gating off wakes the device up without a sleep change
+	if ((activitySettings.mode == 0) && imuIdle) {
+		ExitIdle();
+	}
+
+	Log_Debug("LSM6DSO: activity mode %d, threshold %.1f mg, inactive after %.1f s at %.0f Hz\n",
+		activitySettings.mode, activitySettings.thresholdMg, activitySettings.sleepSeconds, imuAccelOdr->hz);
+}
+#endif
+
+#ifdef ENABLE_IMU_CAPTURE
+/// <summary>
+///     Apply captureSettings after the device twin changed one of them.  Only the registers that
+///     differ are written, a new window drops the samples kept so far.
+/// </summary>
+void captureSettingsChanged(void)
+{
+	ConfigImuSettings();
+	if (lsm6dsoConfigFlush(&dev_ctx, &imuConfig) < 0) {
+		Log_Debug("ERROR: Could not apply the capture settings\n");
+		return;
+	}
+	ArmEventPoll();
+
+	Log_Debug("LSM6DSO: capture mode %d, free fall below %.0f mg for %.1f ms, shock above %.0f mg, %.0f ms before and %.0f ms after\n",
+		captureSettings.mode, captureSettings.freeFallMg, captureSettings.freeFallMs, captureSettings.shockMg,
+		captureSettings.beforeMs, captureSettings.afterMs);
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_PEDOMETER
+/// <summary>
+///     Switch the pedometer to pedometerSettings.mode and start counting from zero.  With the FIFO
+///     every step is batched as a step word, otherwise the step counter is read once per pass.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+static int ConfigPedometer(void)
+{
+	lsm6dso_pedo_md_t mode;
+
+	switch (pedometerSettings.mode) {
+	case PEDOMETER_MODE_STEPS:
+		mode = LSM6DSO_PEDO_BASE_MODE;
+		break;
+	case PEDOMETER_MODE_FALSE_STEP_REJECTION:
+		mode = LSM6DSO_FALSE_STEP_REJ;
+		break;
+	default:
+		// Report back what is actually in use
+		pedometerSettings.mode = PEDOMETER_MODE_OFF;
+		mode = LSM6DSO_PEDO_DISABLE;
+		break;
+	}
+
+#ifdef ENABLE_LSM6DSO_FIFO
+	bool batch = true;
+#else
+	bool batch = false;
+#endif
+	if (lsm6dsoPedometerSet(&dev_ctx, mode, batch) != 0) {
+		Log_Debug("ERROR: Could not configure the LSM6DSO pedometer\n");
+		return -1;
+	}
+
+	initLsm6dsoPedometer(&pedometer);
+	pedometerPasses = 0;
+	clock_gettime(CLOCK_MONOTONIC, &pedometerPeriodStart);
+	return 0;
+}
+
+/// <summary>
+///     Apply pedometerSettings after the device twin changed them.  The accelerometer rate is
+///     raised or restored, the FIFO keeps running, and the step count starts over.  Steps
+///     batched before the change are drained first, they belong to the old count.
+/// </summary>
+void pedometerSettingsChanged(void)
+{
+	AcquireImuSamples();
+
+	ConfigImuSettings();
+	if (lsm6dsoConfigFlush(&dev_ctx, &imuConfig) < 0) {
+		Log_Debug("ERROR: Could not apply the pedometer settings\n");
+		return;
+	}
+	if (ConfigPedometer() != 0) {
+		return;
+	}
+
+	Log_Debug("LSM6DSO: pedometer mode %d, accelerometer sampled at %.1f Hz\n", pedometerSettings.mode,
+		imuAccelOdr->hz);
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_ORIENTATION
+/// <summary>
+///     Apply orientationSettings after the device twin changed one of them.  The accelerometer
+///     rate is raised or restored for tilt detection, the FIFO keeps running.
+/// </summary>
+void orientationSettingsChanged(void)
+{
+	ConfigImuSettings();
+	if (lsm6dsoConfigFlush(&dev_ctx, &imuConfig) < 0) {
+		Log_Debug("ERROR: Could not apply the orientation settings\n");
+		return;
+	}
+	if (ConfigTilt() != 0) {
+		return;
+	}
+	ArmEventPoll();
+
+	Log_Debug("LSM6DSO: orientation mode %d, threshold %.0f degrees, tilt %d, accelerometer sampled at %.1f Hz\n",
+		orientationSettings.mode, orientationSettings.thresholdDeg, orientationSettings.tilt, imuAccelOdr->hz);
+}
+#endif
+
+/// <summary>
+///     Captures IMU_ACCEL_CAL_SAMPLES accelerometer samples once the output has settled.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+static int CaptureAccelMg(float rateHz, float meanMg[3], float stdDevMg[3])
+{
+	fifo_capture_t capture;
+
+	// Let the output filters settle after the rate or the offsets changed
+	struct timespec settle = { .tv_sec = IMU_ACCEL_CAL_SETTLE_MS / 1000,.tv_nsec = (IMU_ACCEL_CAL_SETTLE_MS % 1000) * 1000000L };
+	nanosleep(&settle, NULL);
+
+	if (lsm6dsoFifoCapture(&dev_ctx, LSM6DSO_XL_NC_TAG, rateHz, IMU_ACCEL_CAL_SAMPLES, &capture) != 0) {
+		return -1;
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		meanMg[axis] = (float)capture.mean[axis] * accelMgPerLsb;
+		stdDevMg[axis] = (float)capture.stdDev[axis] * accelMgPerLsb;
+	}
+
+	return 0;
+}
+
+/// <summary>
+///     Measures the accelerometer offsets and writes them to the user offset registers.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+static int CalibrateAccelOffset(float rateHz)
+{
+	float meanMg[3];
+	float stdDevMg[3];
+
+	if (CaptureAccelMg(rateHz, meanMg, accelCalibration.stdDevMg) != 0) {
+		return -1;
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		if (accelCalibration.stdDevMg[axis] > IMU_ACCEL_CAL_MAX_STDDEV_MG) {
+			Log_Debug("LSM6DSO: Accelerometer moving during calibration, standard deviation %.2f, %.2f, %.2f mg\n",
+				accelCalibration.stdDevMg[0], accelCalibration.stdDevMg[1], accelCalibration.stdDevMg[2]);
+			return -1;
+		}
+	}
+
+	if (accelCalibrationCompute(meanMg, IMU_ACCEL_CAL_MAX_OFFSET_MG, &accelCalibration) != 0) {
+		Log_Debug("LSM6DSO: Accelerometer reads %.1f, %.1f, %.1f mg, the board isn't lying flat\n",
+			meanMg[0], meanMg[1], meanMg[2]);
+		return -1;
+	}
+
+	ConfigAccelOffset(accelCalibration.weight, accelCalibration.registers);
+	if (lsm6dsoConfigFlush(&dev_ctx, &imuConfig) < 0) {
+		accelCalibration.valid = false;
+		return -1;
+	}
+
+	// Check what is left with the offsets applied
+	if (CaptureAccelMg(rateHz, meanMg, stdDevMg) != 0) {
+		accelCalibration.valid = false;
+		return -1;
+	}
+	accelCalibrationResidual(&accelCalibration, meanMg);
+
+	return 0;
+}
+
+/// <summary>
+///     Measures the accelerometer offsets, with the board lying still on one of its faces, and
+///     writes them to the LSM6DSO user offset registers.  From then on the samples in the FIFO
+///     and the data the wake-up and free-fall functions see are corrected by the device itself.
+///     The result, with the residual offsets measured afterwards, is written to json.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int calibrateAccelerometer(char *json, size_t size)
+{
+	const lsm6dso_rate_t *calRate = lsm6dsoConfigFindRate(IMU_ACCEL_CAL_ODR_HZ, false);
+	lsm6dso_ctrl6_c_t previousCtrl6 = *(lsm6dso_ctrl6_c_t *)lsm6dsoConfigReg(&imuConfig, LSM6DSO_CTRL6_C);
+	lsm6dso_ctrl7_g_t previousCtrl7 = *(lsm6dso_ctrl7_g_t *)lsm6dsoConfigReg(&imuConfig, LSM6DSO_CTRL7_G);
+	lsm6dso_wake_up_ths_t previousWakeUpThs = *(lsm6dso_wake_up_ths_t *)lsm6dsoConfigReg(&imuConfig, LSM6DSO_WAKE_UP_THS);
+	int8_t previousOffsets[3];
+	memcpy(previousOffsets, lsm6dsoConfigReg(&imuConfig, LSM6DSO_X_OFS_USR), sizeof(previousOffsets));
+	int result = -1;
+
+	memset(&accelCalibration, 0, sizeof(accelCalibration));
+
+	// Convert what was taken with the current settings, then batch only the accelerometer, at the
+	// calibration rate, with the current offsets switched off
+	AcquireImuSamples();
+	lsm6dsoConfigFifoMode(&imuConfig, LSM6DSO_BYPASS_MODE);
+	lsm6dsoConfigFifoBatch(&imuConfig, calRate->xlBatch, LSM6DSO_GY_NOT_BATCHED);
+	lsm6dsoConfigXlDataRate(&imuConfig, calRate->xlOdr);
+	lsm6dsoConfigXlUsrOffset(&imuConfig, PROPERTY_DISABLE);
+	lsm6dsoConfigXlUsrOffsetOnWkup(&imuConfig, PROPERTY_DISABLE);
+
+#ifdef ENABLE_LSM6DSO_FIFO_COMPRESSION
+	// The capture only counts uncompressed words, imuSettingsChanged switches compression back on
+	lsm6dsoFifoCompressionSet(&dev_ctx, LSM6DSO_CMP_DISABLE);
+#endif
+
+	if (lsm6dsoConfigFlush(&dev_ctx, &imuConfig) >= 0) {
+		result = CalibrateAccelOffset(calRate->hz);
+	}
+
+	if (result == 0) {
+		Log_Debug("LSM6DSO: Accelerometer offsets %.2f, %.2f, %.2f mg, residual %.2f, %.2f, %.2f mg\n",
+			accelCalibration.offsetMg[0], accelCalibration.offsetMg[1], accelCalibration.offsetMg[2],
+			accelCalibration.residualMg[0], accelCalibration.residualMg[1], accelCalibration.residualMg[2]);
+#ifdef ENABLE_CALIBRATION_STORE
+		storedCalibration.flags |= CALIBRATION_ACCEL_VALID;
+		storedCalibration.accelOffsetWeight = (uint8_t)accelCalibration.weight;
+		memcpy(storedCalibration.accelOffset, accelCalibration.registers, sizeof(storedCalibration.accelOffset));
+		StoreCalibration();
+#endif
+	}
+	else {
+		// Put back the offsets that were in use, the new ones may already have been written
+		Log_Debug("LSM6DSO: Accelerometer calibration failed\n");
+		lsm6dsoConfigXlOffsetWeight(&imuConfig, (lsm6dso_usr_off_w_t)previousCtrl6.usr_off_w);
+		lsm6dsoConfigXlUsrOffsetXyz(&imuConfig, previousOffsets);
+		lsm6dsoConfigXlUsrOffset(&imuConfig, previousCtrl7.usr_off_on_out);
+		lsm6dsoConfigXlUsrOffsetOnWkup(&imuConfig, previousWakeUpThs.usr_off_on_wu);
+	}
+
+	// Back to imuSettings, which flushes the image and restarts FIFO acquisition
+	lsm6dsoConfigFifoBatch(&imuConfig, LSM6DSO_XL_NOT_BATCHED, LSM6DSO_GY_NOT_BATCHED);
+	imuSettingsChanged();
+
+	if (accelCalibrationToJson(&accelCalibration, json, size) < 0) {
+		json[0] = '\0';
+	}
+
+	return result;
+}
+
+#ifdef ENABLE_LSM6DSO_FSM
+/// <summary>
+///     Loads a program image, written as hexadecimal digits, on the LSM6DSO finite state
+///     machines and starts them.  The accelerometer rate is raised to the rate of the image
+///     when needed, and the FSM events are read from then on.  The result is written to json.
+///     An image that is rejected leaves the programs that were running alone, one that fails to
+///     load leaves the FSMs stopped.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int loadFsmProgram(const char *hex, char *json, size_t size)
+{
+	lsm6dso_fsm_image_t image;
+	const char *message = NULL;
+	bool int1 = false;
+
+#ifdef ENABLE_LSM6DSO_INT1
+	int1 = (int1GpioFd >= 0);
+#endif
+
+	int bytes = lsm6dsoFsmHexDecode(hex, fsmImage, sizeof(fsmImage));
+	if (bytes < 0) {
+		message = "image is not hexadecimal or too large";
+	}
+	else if (lsm6dsoFsmParseImage(fsmImage, (size_t)bytes, &image) != 0) {
+		message = "invalid program image";
+	}
+	else {
+		if (lsm6dsoFsmLoad(&dev_ctx, &image, int1) == 0) {
+			fsmPrograms = image.programs;
+			fsmOdrHz = image.odrHz;
+		}
+		else {
+			message = "could not load the programs";
+			fsmPrograms = 0;
+			fsmOdrHz = 0.0f;
+		}
+
+		// Raise or restore the accelerometer rate and route or unroute INT1, the FIFO keeps running
+		ConfigImuSettings();
+		if (lsm6dsoConfigFlush(&dev_ctx, &imuConfig) < 0) {
+			Log_Debug("ERROR: Could not apply the FSM settings\n");
+			if (message == NULL) {
+				message = "could not apply the FSM settings";
+			}
+		}
+		ArmEventPoll();
+	}
+
+	int written;
+	if (message == NULL) {
+		Log_Debug("LSM6DSO: %u FSM programs running, accelerometer sampled at %.1f Hz\n", fsmPrograms,
+			imuAccelOdr->hz);
+		written = snprintf(json, size, "{\"success\":true,\"programs\":%u,\"bytes\":%d}", fsmPrograms, bytes);
+	}
+	else {
+		Log_Debug("ERROR: FSM program image not loaded, %s\n", message);
+		written = snprintf(json, size, "{\"success\":false,\"message\":\"%s\"}", message);
+	}
+	if ((written < 0) || ((size_t)written >= size)) {
+		json[0] = '\0';
+	}
+
+	return (message == NULL) ? 0 : -1;
+}
+#endif
+
+#ifdef ENABLE_IMU_AUTORANGE
+/// <summary>
+///     End the auto-ranging window and switch full scales where needed.  The switch goes through
+///     imuSettingsChanged, so with the FIFO it falls on a flush: every sample drained before it was
+///     taken at the old full scale and every sample after it at the new one.
+/// </summary>
+static void AutorangeImu(void)
+{
+	const lsm6dso_xl_range_t *accelLower = lsm6dsoConfigStepXlRange(imuSettings.accelFullScaleG, -1);
+	const lsm6dso_xl_range_t *accelUpper = lsm6dsoConfigStepXlRange(imuSettings.accelFullScaleG, 1);
+	const lsm6dso_gy_range_t *gyroLower = lsm6dsoConfigStepGyRange(imuSettings.gyroFullScaleDps, -1);
+	const lsm6dso_gy_range_t *gyroUpper = lsm6dsoConfigStepGyRange(imuSettings.gyroFullScaleDps, 1);
+
+	autorange_step_t accelStep = autorangeEndWindow(&accelAutorange,
+		(accelLower != NULL) ? (float)accelLower->fullScaleG / (float)imuSettings.accelFullScaleG : 0.0f,
+		accelUpper != NULL);
+	autorange_step_t gyroStep = autorangeEndWindow(&gyroAutorange,
+		(gyroLower != NULL) ? (float)gyroLower->fullScaleDps / (float)imuSettings.gyroFullScaleDps : 0.0f,
+		gyroUpper != NULL);
+
+	if (accelStep == AUTORANGE_UP) {
+		imuSettings.accelFullScaleG = accelUpper->fullScaleG;
+	}
+	else if (accelStep == AUTORANGE_DOWN) {
+		imuSettings.accelFullScaleG = accelLower->fullScaleG;
+	}
+
+	if (gyroStep == AUTORANGE_UP) {
+		imuSettings.gyroFullScaleDps = gyroUpper->fullScaleDps;
+	}
+	else if (gyroStep == AUTORANGE_DOWN) {
+		imuSettings.gyroFullScaleDps = gyroLower->fullScaleDps;
+	}
+
+	if ((accelStep != AUTORANGE_HOLD) || (gyroStep != AUTORANGE_HOLD)) {
+
+		imuSettingsChanged();
+		autorangeSwitched(&accelAutorange, accelStep);
+		autorangeSwitched(&gyroAutorange, gyroStep);
+
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+		// Keep the reported full scales in line with the device
+		if (accelStep != AUTORANGE_HOLD) {
+			checkAndUpdateDeviceTwin("accelFullScaleG", &imuSettings.accelFullScaleG, TYPE_INT, false);
+		}
+		if (gyroStep != AUTORANGE_HOLD) {
+			checkAndUpdateDeviceTwin("gyroFullScaleDps", &imuSettings.gyroFullScaleDps, TYPE_INT, false);
+		}
+#endif
+	}
+
+	const autorange_stats_t *accelStats = getAutorangeStats(&accelAutorange);
+	const autorange_stats_t *gyroStats = getAutorangeStats(&gyroAutorange);
+	Log_Debug("LSM6DSO: %d g, %u saturated samples, %u range ups, %u range downs\n", imuSettings.accelFullScaleG,
+		accelStats->saturatedSamples, accelStats->rangeUps, accelStats->rangeDowns);
+	Log_Debug("LSM6DSO: %d dps, %u saturated samples, %u range ups, %u range downs\n", imuSettings.gyroFullScaleDps,
+		gyroStats->saturatedSamples, gyroStats->rangeUps, gyroStats->rangeDowns);
+}
+#endif
+
+#ifdef ENABLE_LSM6DSO_INT1
+/// <summary>
+///     Handle the LSM6DSO INT1 line.  When the GPIO could be registered with epoll this runs
+///     on the edge, otherwise it runs on the INT1 poll timer and only touches the I2C bus
+///     when the line is asserted.
+/// </summary>
+static void Int1EventHandler(EventData *eventData)
+{
+	if (eventData->fd == int1PollTimerFd) {
+		if (ConsumeTimerFdEvent(int1PollTimerFd) != 0) {
+			terminationRequired = true;
+			return;
+		}
+	}
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+	activityWakeups++;
+#endif
+
+	GPIO_Value_Type int1State;
+	if (GPIO_GetValue(int1GpioFd, &int1State) != 0) {
+		Log_Debug("ERROR: Could not read LSM6DSO INT1 GPIO: %s (%d).\n", strerror(errno), errno);
+		terminationRequired = true;
+		return;
+	}
+
+	// INT1 is active high and stays asserted until the data, and the latched events, are read
+	if (int1State == GPIO_Value_High) {
+		AcquireImuSamples();
+#ifdef ENABLE_LSM6DSO_EVENTS
+		if (imuEventsEnabled) {
+			ReadImuEvents();
+		}
+#endif
+	}
+}
+
+// event handler data structure for INT1. Only the event handler field needs to be populated.
+static EventData int1EventData = { .eventHandler = &Int1EventHandler };
+
+/// <summary>
+///     Route data-ready (or the FIFO watermark) to INT1 and hook the INT1 GPIO into the epoll loop.
+/// </summary>
+/// <returns>0 on success, or -1 if INT1 can't be used and the timer path should be used instead</returns>
+static int initLsm6dsoInt1(void)
+{
+	lsm6dso_pin_int1_route_t int1Route;
+
+	memset(&int1Route, 0x00, sizeof(int1Route));
+	// Keep the event routes set up in the configuration image
+	memcpy(&int1Route.md1_cfg, lsm6dsoConfigReg(&imuConfig, LSM6DSO_MD1_CFG), sizeof(int1Route.md1_cfg));
+#ifdef ENABLE_LSM6DSO_FIFO
+	int1Route.int1_ctrl.int1_fifo_th = PROPERTY_ENABLE;
+#else
+	int1Route.int1_ctrl.int1_drdy_xl = PROPERTY_ENABLE;
+#endif
+	if (lsm6dso_pin_int1_route_set(&dev_ctx, &int1Route) != 0) {
+		Log_Debug("ERROR: Could not route LSM6DSO interrupts to INT1\n");
+		return -1;
+	}
+
+	int1GpioFd = GPIO_OpenAsInput(LSM6DSO_INT1_GPIO);
+	if (int1GpioFd < 0) {
+		Log_Debug("ERROR: Could not open LSM6DSO INT1 GPIO: %s (%d).\n", strerror(errno), errno);
+		return -1;
+	}
+
+	// Prefer waking on the edge.  If the GPIO can't be waited on, sample the line on a short
+	// timer, which still saves the I2C traffic of reading the status registers every tick.
+	if (RegisterEventHandlerToEpoll(epollFd, int1GpioFd, &int1EventData, EPOLLIN) == 0) {
+		Log_Debug("LSM6DSO: INT1 registered with epoll\n");
+		return 0;
+	}
+
+	struct timespec int1PollPeriod = { .tv_sec = 0,.tv_nsec = LSM6DSO_INT1_POLL_PERIOD_NANO_SECONDS };
+	int1PollTimerFd = CreateTimerFdAndAddToEpoll(epollFd, &int1PollPeriod, &int1EventData, EPOLLIN);
+	if (int1PollTimerFd < 0) {
+		CloseFdAndPrintError(int1GpioFd, "lsm6dsoInt1");
+		int1GpioFd = -1;
+		return -1;
+	}
+
+	Log_Debug("LSM6DSO: INT1 sampled every %d ns\n", LSM6DSO_INT1_POLL_PERIOD_NANO_SECONDS);
+	return 0;
+}
+#endif
+
+#ifdef ENABLE_I2C_QUEUE
+/// <summary>
+///     Completion handler for the queued LSM6DSO STATUS_REG/OUT_TEMP read.
+/// </summary>
+static void Lsm6dsoTemperatureReadComplete(int32_t status, const uint8_t *data, uint16_t len, void *context)
+{
+	(void)context;
+
+	lsm6dso_status_reg_t *lsm6dsoStatus = (lsm6dso_status_reg_t *)&data[0];
+
+	if ((status != 0) || (len < LSM6DSO_TEMP_READ_LEN)) {
+		Log_Debug("ERROR: LSM6DSO temperature read failed\n");
+		return;
+	}
+
+	if (lsm6dsoStatus->tda) {
+		memcpy(data_raw_temperature.u8bit, &data[LSM6DSO_OUT_TEMP_L - LSM6DSO_STATUS_REG], sizeof(int16_t));
+		Lsm6dsoTemperatureRead();
+	}
+}
+#endif
+
+/// <summary>
+///     Decode an LPS22HH STATUS/PRESS_OUT/TEMP_OUT register block.
+/// </summary>
+static void DecodeLps22hhSample(const uint8_t *data)
+{
+	lps22hh_status_t *lps22hhStatus = (lps22hh_status_t *)&data[0];
+
+	//Read output only if new value is available
+	if ((lps22hhStatus->p_da == 1) && (lps22hhStatus->t_da == 1))
+	{
+		// Initialize the data structures to 0s.
+		memset(data_raw_pressure.u8bit, 0x00, sizeof(int32_t));
+		memset(data_raw_temperature.u8bit, 0x00, sizeof(int16_t));
+
+		memcpy(data_raw_pressure.u8bit, &data[1], 3);
+		pressure_hPa = lps22hh_from_lsb_to_hpa(data_raw_pressure.i32bit);
+
+		memcpy(data_raw_temperature.u8bit, &data[4], 2);
+		lps22hhTemperature_degC = lps22hh_from_lsb_to_celsius(data_raw_temperature.i16bit);
+		lps22hhSampleCount++;
+	}
+}
+
+#ifndef ENABLE_SENSOR_HUB_FIFO
+/// <summary>
+///     Completion handler for the non-blocking LPS22HH STATUS/PRESS_OUT/TEMP_OUT read.
+/// </summary>
+static void Lps22hhReadComplete(int32_t status, const uint8_t *data, uint16_t len)
+{
+	if ((status != 0) || (len < LPS22HH_READ_LEN)) {
+		Log_Debug("ERROR: LPS22HH read failed\n");
+		return;
+	}
+
+	DecodeLps22hhSample(data);
+}
+#endif
+
+/// <summary>
+///     Print latest data from on-board sensors.
+/// </summary>
+void AccelTimerEventHandler(EventData *eventData)
+{
+	(void)eventData;
+
+#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
+	static bool firstPass = true;
+#endif
+	// Consume the event.  If we don't do this we'll come right back 
+	// to process the same event again
+	if (ConsumeTimerFdEvent(accelTimerFd) != 0) {
+		terminationRequired = true;
+		return;
+	}
+
+#ifdef ENABLE_LSM6DSO_TIMESTAMP
+	// One counter read per pass keeps the sample times locked to CLOCK_MONOTONIC
+	if (lsm6dsoTimestampSync(&dev_ctx) != 0) {
+		Log_Debug("ERROR: Could not read the LSM6DSO timestamp\n");
+	}
+#endif
+
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+	activityWakeups++;
+
+	// Without INT1 the activity changes are picked up here, once per pass
+	bool readEvents = (activitySettings.mode != 0);
+#ifdef ENABLE_LSM6DSO_INT1
+	readEvents = readEvents && (int1GpioFd < 0);
+#endif
+	if (readEvents) {
+		ReadImuEvents();
+	}
+
+	// Nothing is acquired or sent until the device wakes up
+	if (imuIdle) {
+		return;
+	}
+#endif
+
+	// Read the sensors on the lsm6dso device.  When INT1 is in use the samples have
+	// already been collected by Int1EventHandler.
+#ifdef ENABLE_LSM6DSO_INT1
+	if (int1GpioFd < 0) {
+		AcquireImuSamples();
+	}
+#else
+	AcquireImuSamples();
+#endif
+
+#if (defined(ENABLE_LSM6DSO_PEDOMETER) && !defined(ENABLE_LSM6DSO_FIFO))
+	// Without the FIFO the step counter is read once per pass
+	if ((pedometerSettings.mode != PEDOMETER_MODE_OFF) && (lsm6dsoPedometerRead(&dev_ctx, &pedometer) != 0)) {
+		Log_Debug("ERROR: Could not read the LSM6DSO step counter\n");
+	}
+#endif
+
+	// Report the mean of everything acquired since the last pass
+	bool accelDataReady = (imuAccelCount > 0);
+	bool gyroDataReady = (imuGyroCount > 0);
+
+	if (accelDataReady) {
+		acceleration_mg[0] = (float)(imuAccelSum[0] / imuAccelCount);
+		acceleration_mg[1] = (float)(imuAccelSum[1] / imuAccelCount);
+		acceleration_mg[2] = (float)(imuAccelSum[2] / imuAccelCount);
+	}
+
+	if (gyroDataReady) {
+		// The calibration data we captured at startup was subtracted during conversion
+		angular_rate_dps[0] = (float)(imuGyroSum[0] / imuGyroCount);
+		angular_rate_dps[1] = (float)(imuGyroSum[1] / imuGyroCount);
+		angular_rate_dps[2] = (float)(imuGyroSum[2] / imuGyroCount);
+	}
+
+	// Log the acquisition cost so the timer and INT1 paths can be compared
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	uint64_t statsPeriodNs = ElapsedNs(&imuStatsStart, &now);
+	if ((statsPeriodNs > 0) && (imuWakeups > 0)) {
+		Log_Debug("\nLSM6DSO: %.2f wakeups/s, %d accelerometer and %d gyroscope samples, %llu us per wakeup\n",
+			(double)imuWakeups * 1e9 / (double)statsPeriodNs, imuAccelCount, imuGyroCount,
+			(unsigned long long)(imuAcquireTimeNs / imuWakeups / 1000));
+	}
+	if ((imuAccelCount + imuGyroCount) > 0) {
+		uint32_t syscalls = atomic_load(&i2cSyscalls);
+		Log_Debug("LSM6DSO: %u I2C syscalls, %.2f per sample\n", syscalls,
+			(double)syscalls / (double)(imuAccelCount + imuGyroCount));
+		if (statsPeriodNs > 0) {
+			Log_Debug("LSM6DSO: %.1f samples/s, %llu ns acquisition time per sample\n",
+				(double)(imuAccelCount + imuGyroCount) * 1e9 / (double)statsPeriodNs,
+				(unsigned long long)(imuAcquireTimeNs / (imuAccelCount + imuGyroCount)));
+		}
+	}
+
+#ifdef ENABLE_LSM6DSO_TIMESTAMP
+	const lsm6dso_timestamp_stats_t *tsStats = getLsm6dsoTimestampStats();
+	Log_Debug("LSM6DSO: timestamp drift %.1f ppm, last sync error %lld us, %u syncs rejected\n",
+		tsStats->driftPpm, (long long)(tsStats->lastErrorNs / 1000), tsStats->rejectedSyncs);
+	uint64_t sampleTimeNs = imuNewestSampleNs;
+	imuNewestSampleNs = 0;
+#endif
 
-#if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
-	static bool firstPass = true;
+#ifdef ENABLE_LSM6DSO_FIFO_COMPRESSION
+	if (fifoDecoder.samples > 0) {
+		Log_Debug("LSM6DSO: %.2f FIFO bytes per sample, %u compressed words, %u dropped\n",
+			(double)getLsm6dsoFifoStats()->words * LSM6DSO_FIFO_WORD_SIZE / (double)fifoDecoder.samples,
+			fifoDecoder.compressedWords, fifoDecoder.droppedWords);
+	}
 #endif
-	// Consume the event.  If we don't do this we'll come right back 
-	// to process the same event again
-	if (ConsumeTimerFdEvent(accelTimerFd) != 0) {
-		terminationRequired = true;
-		return;
+
+	ResetImuStats(&now);
+
+#ifdef ENABLE_IMU_AUTORANGE
+	// Samples drained by a range switch belong to the next pass
+	AutorangeImu();
+#endif
+
+#ifdef ENABLE_LSM6DSO_TAP
+	if ((tapSingleCount + tapDoubleCount) > 0) {
+		Log_Debug("LSM6DSO: %u single taps, %u double taps, %u not sent\n", tapSingleCount, tapDoubleCount,
+			tapSingleCount + tapDoubleCount - tapMessages);
 	}
+	tapSingleCount = 0;
+	tapDoubleCount = 0;
+	tapMessages = 0;
+#endif
 
-	// Read the sensors on the lsm6dso device
+#ifdef ENABLE_LSM6DSO_FSM
+	fsmMessages = 0;
+#endif
 
-	//Read output only if new xl value is available
-	lsm6dso_xl_flag_data_ready_get(&dev_ctx, &reg);
-	if (reg)
-	{
-		// Read acceleration field data
-		memset(data_raw_acceleration.u8bit, 0x00, 3 * sizeof(int16_t));
-		lsm6dso_acceleration_raw_get(&dev_ctx, data_raw_acceleration.u8bit);
+#ifdef ENABLE_LSM6DSO_ORIENTATION
+	orientationMessages = 0;
+#endif
 
-		acceleration_mg[0] = lsm6dso_from_fs4_to_mg(data_raw_acceleration.i16bit[0]);
-		acceleration_mg[1] = lsm6dso_from_fs4_to_mg(data_raw_acceleration.i16bit[1]);
-		acceleration_mg[2] = lsm6dso_from_fs4_to_mg(data_raw_acceleration.i16bit[2]);
+#ifdef ENABLE_LSM6DSO_PEDOMETER
+	ReportSteps(&now);
+#endif
+
+#ifdef ENABLE_GYRO_BIAS_TRACKING
+	const gyro_bias_stats_t *biasStats = getGyroBiasStats(&gyroBiasTracker);
+	Log_Debug("LSM6DSO: Gyroscope offsets %.3f, %.3f, %.3f dps, %u of %u windows still\n", gyroBiasDps[0],
+		gyroBiasDps[1], gyroBiasDps[2], biasStats->stillWindows, biasStats->windows);
+#endif
 
+	if (accelDataReady)
+	{
 		Log_Debug("\nLSM6DSO: Acceleration [mg]  : %.4lf, %.4lf, %.4lf\n",
 			acceleration_mg[0], acceleration_mg[1], acceleration_mg[2]);
 	}
 
-	lsm6dso_gy_flag_data_ready_get(&dev_ctx, &reg);
-	if (reg)
+	if (gyroDataReady)
 	{
-		// Read angular rate field data
-		memset(data_raw_angular_rate.u8bit, 0x00, 3 * sizeof(int16_t));
-		lsm6dso_angular_rate_raw_get(&dev_ctx, data_raw_angular_rate.u8bit);
-
-		// Before we store the mdps values subtract the calibration data we captured at startup.
-		angular_rate_dps[0] = (lsm6dso_from_fs2000_to_mdps(data_raw_angular_rate.i16bit[0] - raw_angular_rate_calibration.i16bit[0])) / 1000.0;
-		angular_rate_dps[1] = (lsm6dso_from_fs2000_to_mdps(data_raw_angular_rate.i16bit[1] - raw_angular_rate_calibration.i16bit[1])) / 1000.0;
-		angular_rate_dps[2] = (lsm6dso_from_fs2000_to_mdps(data_raw_angular_rate.i16bit[2] - raw_angular_rate_calibration.i16bit[2])) / 1000.0;
-
 		Log_Debug("LSM6DSO: Angular rate [dps] : %4.2f, %4.2f, %4.2f\r\n",
 			angular_rate_dps[0], angular_rate_dps[1], angular_rate_dps[2]);
 
 	}
 
+#ifdef ENABLE_I2C_QUEUE
+	// STATUS_REG through OUT_TEMP_H in one queued read, Lsm6dsoTemperatureReadComplete logs the result
+	if (i2cQueueReadAsync(lsm6dsOAddress, LSM6DSO_STATUS_REG, LSM6DSO_TEMP_READ_LEN, Lsm6dsoTemperatureReadComplete, NULL) != 0) {
+		Log_Debug("ERROR: Could not queue the LSM6DSO temperature read\n");
+	}
+#else
+	uint8_t reg;
 	lsm6dso_temp_flag_data_ready_get(&dev_ctx, &reg);
 	if (reg)
 	{
 		// Read temperature data
 		memset(data_raw_temperature.u8bit, 0x00, sizeof(int16_t));
 		lsm6dso_temperature_raw_get(&dev_ctx, data_raw_temperature.u8bit);
-		lsm6dsoTemperature_degC = lsm6dso_from_lsb_to_celsius(data_raw_temperature.i16bit);
-
-		Log_Debug("LSM6DSO: Temperature  [degC]: %.2f\r\n", lsm6dsoTemperature_degC);
+		Lsm6dsoTemperatureRead();
 	}
+#endif
 
 	// Read the lps22hh sensor on the lsm6dso device
 
-	// Initialize the data structures to 0s.
-	memset(data_raw_pressure.u8bit, 0x00, sizeof(int32_t));
-	memset(data_raw_temperature.u8bit, 0x00, sizeof(int16_t));
-
 	if (lps22hhDetected) {
-		lps22hh_read_reg(&pressure_ctx, LPS22HH_STATUS, (uint8_t *)&lps22hhReg, 1);
 
-		//Read output only if new value is available
-
-		if ((lps22hhReg.status.p_da == 1) && (lps22hhReg.status.t_da == 1))
-		{
-			lps22hh_pressure_raw_get(&pressure_ctx, data_raw_pressure.u8bit);
-
-			pressure_hPa = lps22hh_from_lsb_to_hpa(data_raw_pressure.i32bit);
-
-			lps22hh_temperature_raw_get(&pressure_ctx, data_raw_temperature.u8bit);
-			lps22hhTemperature_degC = lps22hh_from_lsb_to_celsius(data_raw_temperature.i16bit);
+#ifdef ENABLE_SENSOR_HUB_FIFO
+		// The sensor hub reads the LPS22HH on its own and the samples arrive in the FIFO,
+		// they have already been decoded by AccumulateFifoWord.
+#else
+		// STATUS, PRESS_OUT and TEMP_OUT are consecutive registers, so a single sensor hub transaction
+		// reads all three.  The read completes in Lps22hhReadComplete while the epoll loop keeps running,
+		// so the telemetry below carries the pressure from the previous pass.
+		if (!sensorHubBusy()) {
+			if (sensorHubReadAsync(LPS22HH_STATUS, LPS22HH_READ_LEN, Lps22hhReadComplete) != 0) {
+				Log_Debug("ERROR: Could not start LPS22HH read\n");
+			}
+		}
+#endif
 
-			Log_Debug("LPS22HH: Pressure     [hPa] : %.2f\r\n", pressure_hPa);
+		if (lps22hhSampleCount > 0) {
+			Log_Debug("LPS22HH: Pressure     [hPa] : %.2f (%d samples)\r\n", pressure_hPa, lps22hhSampleCount);
 			Log_Debug("LPS22HH: Temperature  [degC]: %.2f\r\n", lps22hhTemperature_degC);
+			lps22hhSampleCount = 0;
 		}
+
+		const sensor_hub_stats_t *shStats = getSensorHubStats();
+		Log_Debug("LPS22HH: Loop blocked %llu us (max %llu us) over %d blocking reads, %llu us (max %llu us) over %d non-blocking reads\r\n",
+			(unsigned long long)(shStats->syncBlockedNs / 1000), (unsigned long long)(shStats->maxSyncBlockedNs / 1000), shStats->syncTransactions,
+			(unsigned long long)(shStats->asyncBlockedNs / 1000), (unsigned long long)(shStats->maxAsyncBlockedNs / 1000), shStats->asyncTransactions);
 	}
 	// LPS22HH was not detected
 	else {
@@ -193,31 +2289,84 @@ void AccelTimerEventHandler(EventData *eventData)
 	}
 
 
+#if (!defined(IOT_CENTRAL_APPLICATION) && !defined(IOT_HUB_APPLICATION))
+	// Without a cloud connection the readings logged above are the first telemetry
+	if (accelDataReady || gyroDataReady) {
+		ReportBootPhases();
+	}
+#endif
+
 #if (defined(IOT_CENTRAL_APPLICATION) || defined(IOT_HUB_APPLICATION))
 
 		// We've seen that the first read of the Accelerometer data is garbage.  If this is the first pass
 		// reading data, don't report it to Azure.  Since we're graphing data in Azure, this data point
 		// will skew the data.
-		if (!firstPass) {
+#ifdef ENABLE_LSM6DSO_PEDOMETER
+		// While the pedometer is on the step counters replace the acceleration telemetry
+		bool sendImuTelemetry = !firstPass && (pedometerSettings.mode == PEDOMETER_MODE_OFF);
+		if (!firstPass && !sendImuTelemetry) {
+			ReportBootPhases();
+		}
+#else
+		bool sendImuTelemetry = !firstPass;
+#endif
+		if (sendImuTelemetry) {
 
 			// Allocate memory for a telemetry message to Azure
-			char *pjsonBuffer = (char *)malloc(JSON_BUFFER_SIZE);
+			char *pjsonBuffer = (char *)malloc(IMU_TELEMETRY_BUFFER_SIZE);
 			if (pjsonBuffer == NULL) {
 				Log_Debug("ERROR: not enough memory to send telemetry");
 			}
 
 			// construct the telemetry message
-			snprintf(pjsonBuffer, JSON_BUFFER_SIZE, "{\"gX\":\"%.4lf\", \"gY\":\"%.4lf\", \"gZ\":\"%.4lf\", \"pressure\": \"%.2f\", \"aX\": \"%4.2f\", \"aY\": \"%4.2f\", \"aZ\": \"%4.2f\"}",
+			snprintf(pjsonBuffer, IMU_TELEMETRY_BUFFER_SIZE, "{\"gX\":\"%.4lf\", \"gY\":\"%.4lf\", \"gZ\":\"%.4lf\", \"pressure\": \"%.2f\", \"aX\": \"%4.2f\", \"aY\": \"%4.2f\", \"aZ\": \"%4.2f\"}",
 				acceleration_mg[0], acceleration_mg[1], acceleration_mg[2], pressure_hPa, angular_rate_dps[0], angular_rate_dps[1], angular_rate_dps[2]);
 
+#ifdef ENABLE_LSM6DSO_TIMESTAMP
+			// Replace the closing brace with the UTC capture time of the newest sample
+			size_t used = strlen(pjsonBuffer);
+			if ((sampleTimeNs != 0) && (used > 0)) {
+				uint64_t utcNs = lsm6dsoTimestampToUtcNs(sampleTimeNs);
+				time_t utcSeconds = (time_t)(utcNs / 1000000000ULL);
+				struct tm utc;
+				char sampleTime[32];
+				gmtime_r(&utcSeconds, &utc);
+				strftime(sampleTime, sizeof(sampleTime), "%Y-%m-%dT%H:%M:%S", &utc);
+				snprintf(&pjsonBuffer[used - 1], IMU_TELEMETRY_BUFFER_SIZE - (used - 1), ", \"sampleTime\": \"%s.%03uZ\"}",
+					sampleTime, (unsigned)((utcNs / 1000000ULL) % 1000));
+			}
+#endif
+
 			Log_Debug("\n[Info] Sending telemetry: %s\n", pjsonBuffer);
-			AzureIoT_SendMessage(pjsonBuffer);
+			SendMessage(pjsonBuffer);
 			free(pjsonBuffer);
+			ReportBootPhases();
 
 		}
 
 		firstPass = false;
 
+#ifdef ENABLE_I2C_STATS_TELEMETRY
+		// Every I2C_STATS_TELEMETRY_PASSES passes send the bus statistics and start a new window
+		static int i2cStatsPasses = 0;
+		if (++i2cStatsPasses >= I2C_STATS_TELEMETRY_PASSES) {
+
+			char *pStatsBuffer = (char *)malloc(I2C_STATS_JSON_SIZE);
+			if (pStatsBuffer == NULL) {
+				Log_Debug("ERROR: not enough memory to send I2C statistics");
+			}
+			else {
+				if (i2cStatsToJson(pStatsBuffer, I2C_STATS_JSON_SIZE) > 0) {
+					SendMessage(pStatsBuffer);
+				}
+				free(pStatsBuffer);
+			}
+
+			i2cStatsReset();
+			i2cStatsPasses = 0;
+		}
+#endif
+
 #endif 
 
 }
@@ -228,8 +2377,16 @@ void AccelTimerEventHandler(EventData *eventData)
 /// <returns>0 on success, or -1 on failure</returns>
 int initI2c(void) {
 
+	BootPhase(BOOT_PHASE_START);
+
 	// Begin MT3620 I2C init 
 
+#ifdef ENABLE_I2C_SIMULATOR
+	// The registers are served by the model in i2c_sim.c, ISU2 isn't opened
+	if (i2cSimInit(lsm6dsOAddress) != 0) {
+		return -1;
+	}
+#else
 	i2cFd = I2CMaster_Open(AVNET_MT3620_SK_ISU2_I2C);
 	if (i2cFd < 0) {
 		Log_Debug("ERROR: I2CMaster_Open: errno=%d (%s)\n", errno, strerror(errno));
@@ -247,6 +2404,19 @@ int initI2c(void) {
 		Log_Debug("ERROR: I2CMaster_SetTimeout: errno=%d (%s)\n", errno, strerror(errno));
 		return -1;
 	}
+#endif
+
+#ifdef ENABLE_I2C_QUEUE
+	// From here on the bus is driven by the I2C worker thread
+	if (initI2cQueue(epollFd, RegisterTransfer) != 0) {
+		return -1;
+	}
+	i2cQueueSetDevicePriority(lsm6dsOAddress, I2C_PRIORITY_HIGH);
+#endif
+
+#ifdef ENABLE_I2C_STATS
+	i2cStatsReset();
+#endif
 
 	// Start lsm6dso specific init
 
@@ -255,6 +2425,13 @@ int initI2c(void) {
 	dev_ctx.read_reg = platform_read;
 	dev_ctx.handle = &i2cFd;
 
+#ifdef ENABLE_LSM6DSO_SHADOW
+	// Setters only write the bus once the control registers have been read or written
+	if (initLsm6dsoShadow(&dev_ctx) != 0) {
+		return -1;
+	}
+#endif
+
 	// Check device ID
 	lsm6dso_device_id_get(&dev_ctx, &whoamI);
 	if (whoamI != LSM6DSO_ID) {
@@ -271,24 +2448,43 @@ int initI2c(void) {
 		lsm6dso_reset_get(&dev_ctx, &rst);
 	} while (rst);
 
+	// Build the configuration image and write it with a handful of burst writes
+	lsm6dsoConfigDefaults(&imuConfig);
+
 	 // Disable I3C interface
-	lsm6dso_i3c_disable_set(&dev_ctx, LSM6DSO_I3C_DISABLE);
+	lsm6dsoConfigI3cDisable(&imuConfig, LSM6DSO_I3C_DISABLE);
 
 	// Enable Block Data Update
-	lsm6dso_block_data_update_set(&dev_ctx, PROPERTY_ENABLE);
+	lsm6dsoConfigBlockDataUpdate(&imuConfig, PROPERTY_ENABLE);
+
+#ifdef ENABLE_IMU_CAPTURE
+	// ConfigImuSettings sizes the capture window
+	initImuCapture(&imuCapture);
+#endif
 
-	 // Set Output Data Rate
-	lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_12Hz5);
-	lsm6dso_gy_data_rate_set(&dev_ctx, LSM6DSO_GY_ODR_12Hz5);
+	 // Set Output Data Rate and full scale
+	ConfigImuSettings();
 
-	 // Set full scale
-	lsm6dso_xl_full_scale_set(&dev_ctx, LSM6DSO_4g);
-	lsm6dso_gy_full_scale_set(&dev_ctx, LSM6DSO_2000dps);
+#ifdef ENABLE_IMU_AUTORANGE
+	initAutorange(&accelAutorange, IMU_AUTORANGE_UP_PERCENT, IMU_AUTORANGE_DOWN_PERCENT, IMU_AUTORANGE_DOWN_PASSES);
+	initAutorange(&gyroAutorange, IMU_AUTORANGE_UP_PERCENT, IMU_AUTORANGE_DOWN_PERCENT, IMU_AUTORANGE_DOWN_PASSES);
+#endif
 
 	 // Configure filtering chain(No aux interface)
 	// Accelerometer - LPF1 + LPF2 path	
-	lsm6dso_xl_hp_path_on_out_set(&dev_ctx, LSM6DSO_LP_ODR_DIV_100);
-	lsm6dso_xl_filter_lp2_set(&dev_ctx, PROPERTY_ENABLE);
+	lsm6dsoConfigXlHpPathOnOut(&imuConfig, LSM6DSO_LP_ODR_DIV_100);
+	lsm6dsoConfigXlFilterLp2(&imuConfig, PROPERTY_ENABLE);
+
+#ifdef ENABLE_CALIBRATION_STORE
+	// Accelerometer offsets from an earlier calibrateAccelerometer go out with the configuration
+	LoadStoredCalibration();
+#endif
+
+	int bursts = lsm6dsoConfigFlush(&dev_ctx, &imuConfig);
+	if (bursts < 0) {
+		return -1;
+	}
+	Log_Debug("LSM6DSO: Configuration written with %d burst writes\n", bursts);
 
 	// lps22hh specific init
 
@@ -297,10 +2493,15 @@ int initI2c(void) {
 	lps22hhDetected = false;
 
 	// Initialize lps22hh mems driver interface
-	pressure_ctx.read_reg = lsm6dso_read_lps22hh_cx;
-	pressure_ctx.write_reg = lsm6dso_write_lps22hh_cx;
+	pressure_ctx.read_reg = sensorHubReadSync;
+	pressure_ctx.write_reg = sensorHubWriteSync;
 	pressure_ctx.handle = &i2cFd;
 
+	// The sensor hub timer drives the non-blocking LPS22HH reads once we're in the epoll loop
+	if (initSensorHub(&dev_ctx, epollFd) != 0) {
+		return -1;
+	}
+
 	int failCount = 10;
 
 	while (!lps22hhDetected) {
@@ -336,63 +2537,74 @@ int initI2c(void) {
 		}
 
 		if (failCount-- == 0) {
-			bool lps22hhDetected = false;
+			lps22hhDetected = false;
 			Log_Debug("Failed to read LPS22HH device ID, disabling all access to LPS22HH device!\n");
 			Log_Debug("Usually a power cycle will correct this issue\n");
 			break;
 		}
 	}
 
-	// Read the raw angular rate data from the device to use as offsets.  We're making the assumption that the device
-	// is stationary.
-
-	uint8_t reg;
-	
-	Log_Debug("LSM6DSO: Calibrating angular rate . . .\n"); 
-	Log_Debug("LSM6DSO: Please make sure the device is stationary.\n");
-
-	do {
-
-		// Delay and read the device until we have data!
-		do {
-			// Read the calibration values
-			HAL_Delay(5000);
-			lsm6dso_gy_flag_data_ready_get(&dev_ctx, &reg);
-		} while (!reg);
-
-		if (reg)
-		{
-			// Read angular rate field data to use for calibration offsets
-			memset(data_raw_angular_rate.u8bit, 0x00, 3 * sizeof(int16_t));
-			lsm6dso_angular_rate_raw_get(&dev_ctx, raw_angular_rate_calibration.u8bit);
-		}
+	// Measure the gyroscope offsets, we're making the assumption that the device is stationary
+	BootPhase(BOOT_PHASE_CONFIGURED);
+	CalibrateGyroBias();
+	BootPhase(BOOT_PHASE_CALIBRATED);
+
+#ifdef ENABLE_GYRO_BIAS_TRACKING
+	// Keep refining the offsets whenever the board is at rest
+#ifdef ENABLE_GYRO_BIAS_TEMPERATURE
+	float biasSlopeGain = IMU_GYRO_BIAS_SLOPE_GAIN;
+#else
+	float biasSlopeGain = 0.0f;
+#endif
+	initGyroBias(&gyroBiasTracker, gyroBiasDps, gyroBiasValid, lsm6dsoTemperature_degC, IMU_GYRO_BIAS_WINDOW_SAMPLES, IMU_GYRO_BIAS_GAIN,
+		IMU_GYRO_BIAS_STILL_ACCEL_MG, IMU_GYRO_BIAS_STILL_GYRO_DPS, IMU_GYRO_BIAS_MAX_RESIDUAL_DPS, biasSlopeGain,
+		IMU_GYRO_BIAS_MIN_SPAN_DEGC);
+#endif
 
-		// Delay and read the device until we have data!
-		do {
-			// Read the calibration values
-			HAL_Delay(5000);
-			lsm6dso_gy_flag_data_ready_get(&dev_ctx, &reg);
-		} while (!reg);
+#ifdef ENABLE_LSM6DSO_FIFO
+	// Start batching samples at the output data rates
+#ifdef ENABLE_LSM6DSO_TIMESTAMP
+	if (initLsm6dsoTimestamp(&dev_ctx, LSM6DSO_TIMESTAMP_DECIMATION, ImuBatchHz()) != 0) {
+		Log_Debug("ERROR: Could not enable LSM6DSO timestamps\n");
+		return -1;
+	}
+	fifoTimestampOverruns = 0;
+#endif
 
-		// Read the angular data rate again and verify that after applying the calibration, we have 0 angular rate in all directions
-		if (reg)
-		{
+#ifdef ENABLE_LSM6DSO_FIFO_COMPRESSION
+	if (lsm6dsoFifoCompressionSet(&dev_ctx, LSM6DSO_FIFO_COMPRESSION_RATE) != 0) {
+		Log_Debug("ERROR: Could not enable LSM6DSO FIFO compression\n");
+		return -1;
+	}
+#ifdef ENABLE_LSM6DSO_TIMESTAMP
+	initLsm6dsoFifoDecoder(&fifoDecoder, lsm6dsoTimestampSlotPeriodNs());
+#else
+	initLsm6dsoFifoDecoder(&fifoDecoder, 0);
+#endif
+	fifoDecoderOverruns = 0;
+#endif
 
-			// Read angular rate field data
-			memset(data_raw_angular_rate.u8bit, 0x00, 3 * sizeof(int16_t));
-			lsm6dso_angular_rate_raw_get(&dev_ctx, data_raw_angular_rate.u8bit);
+	if (initLsm6dsoFifo(&dev_ctx, LSM6DSO_FIFO_WATERMARK, imuAccelRate->xlBatch, imuGyroRate->gyBatch) != 0) {
+		Log_Debug("ERROR: Could not configure the LSM6DSO FIFO\n");
+		return -1;
+	}
+#endif
 
-			// Before we store the mdps values subtract the calibration data we captured at startup.
-			angular_rate_dps[0] = lsm6dso_from_fs2000_to_mdps(data_raw_angular_rate.i16bit[0] - raw_angular_rate_calibration.i16bit[0]);
-			angular_rate_dps[1] = lsm6dso_from_fs2000_to_mdps(data_raw_angular_rate.i16bit[1] - raw_angular_rate_calibration.i16bit[1]);
-			angular_rate_dps[2] = lsm6dso_from_fs2000_to_mdps(data_raw_angular_rate.i16bit[2] - raw_angular_rate_calibration.i16bit[2]);
+#ifdef ENABLE_LSM6DSO_PEDOMETER
+	// Count steps on the device, with the FIFO running they are batched from the start
+	if (ConfigPedometer() != 0) {
+		return -1;
+	}
+#endif
 
+#ifdef ENABLE_SENSOR_HUB_FIFO
+	// Configure the sensor hub once, from here on the LPS22HH samples arrive through the FIFO
+	if (lps22hhDetected) {
+		if (startSensorHubContinuous(LPS22HH_STATUS, LPS22HH_READ_LEN, SENSOR_HUB_FIFO_ODR) != 0) {
+			return -1;
 		}
-
-	// If the angular values after applying the offset are not all 0.0s, then do it again!
-	} while ((angular_rate_dps[0] != 0.0) || (angular_rate_dps[1] != 0.0) || (angular_rate_dps[2] != 0.0));
-
-	Log_Debug("LSM6DSO: Calibrating angular rate complete!\n");
+	}
+#endif
 
 	// Init the epoll interface to periodically run the AccelTimerEventHandler routine where we read the sensors
 
@@ -405,6 +2617,60 @@ int initI2c(void) {
 	if (accelTimerFd < 0) {
 		return -1;
 	}
+
+	clock_gettime(CLOCK_MONOTONIC, &imuStatsStart);
+#ifdef ENABLE_LSM6DSO_ACTIVITY
+	activityStateStart = imuStatsStart;
+#endif
+
+#ifdef ENABLE_LSM6DSO_INT1
+	// If INT1 can't be used we keep reading the device from AccelTimerEventHandler
+	if (initLsm6dsoInt1() != 0) {
+		Log_Debug("LSM6DSO: INT1 not available, falling back to timer driven reads\n");
+	}
+#endif
+
+#ifdef ENABLE_LSM6DSO_EVENTS
+	// Without INT1 the latched taps and captures are picked up by polling the event sources
+	struct timespec eventPollPeriod = { .tv_sec = 0,.tv_nsec = 0 };
+	static EventData eventPollEventData = { .eventHandler = &EventPollTimerEventHandler };
+	eventPollTimerFd = CreateTimerFdAndAddToEpoll(epollFd, &eventPollPeriod, &eventPollEventData, EPOLLIN);
+	if (eventPollTimerFd < 0) {
+		return -1;
+	}
+	ArmEventPoll();
+#endif
+
+	// The FIFO and interrupt setup above went through the lsm6dso_*_set functions, pick up their
+	// changes so runtime reconfiguration through the image doesn't write stale values back
+	if (lsm6dsoConfigLoad(&dev_ctx, &imuConfig) != 0) {
+		return -1;
+	}
+
+#ifdef ENABLE_LSM6DSO_ORIENTATION
+	// Tilt detection is in the embedded functions bank, set up once INT1 is known
+	if (ConfigTilt() != 0) {
+		return -1;
+	}
+#endif
+
+#if (defined(ENABLE_LSM6DSO_FSM) && defined(LSM6DSO_FSM_IMAGE_HEX))
+	// Through the image, which is in step with the device from here on.  The application runs
+	// without the programs if they can't be loaded.
+	char fsmJson[LSM6DSO_FSM_RESPONSE_JSON_SIZE];
+	loadFsmProgram(LSM6DSO_FSM_IMAGE_HEX, fsmJson, sizeof(fsmJson));
+#endif
+
+#ifdef ENABLE_LSM6DSO_SHADOW
+	// Without the shadow every read answered from it would have been a bus transaction
+	const lsm6dso_shadow_stats_t *shadowStats = getLsm6dsoShadowStats();
+	uint32_t busTransactions = shadowStats->busReads + shadowStats->busWrites;
+	Log_Debug("LSM6DSO: init used %d bus transactions, %d without the register shadow\n",
+		busTransactions, busTransactions + shadowStats->shadowReads);
+	resetLsm6dsoShadowStats();
+#endif
+
+	BootPhase(BOOT_PHASE_INIT_DONE);
 	
 	return 0;
 }
@@ -414,166 +2680,150 @@ int initI2c(void) {
 /// </summary>
 void closeI2c(void) {
 
+#ifdef ENABLE_I2C_QUEUE
+	// Stop the worker before the bus goes away
+	closeI2cQueue();
+#endif
 	CloseFdAndPrintError(i2cFd, "i2c");
 	CloseFdAndPrintError(accelTimerFd, "accelTimer");
+	closeSensorHub();
+#ifdef ENABLE_LSM6DSO_INT1
+	CloseFdAndPrintError(int1PollTimerFd, "lsm6dsoInt1Poll");
+	CloseFdAndPrintError(int1GpioFd, "lsm6dsoInt1");
+#endif
+#ifdef ENABLE_LSM6DSO_EVENTS
+	CloseFdAndPrintError(eventPollTimerFd, "lsm6dsoEventPoll");
+#endif
 }
 
 /// <summary>
-///     Writes data to the lsm6dso i2c device
+///     Runs one I2C transaction: the write segments are sent back to back and, if readLen is
+///     not 0, followed by a repeated start and a read.  This is a single I2CMaster call whatever
+///     the number of segments.  Several segments are gathered into a buffer on the stack, so
+///     they can't add up to more than I2C_MAX_WRITE_LEN bytes.
 /// </summary>
-/// <returns>0</returns>
-
-static int32_t platform_write(int *fD, uint8_t reg, uint8_t *bufp,
-	uint16_t len)
+/// <returns>0 on success, or -1 on failure</returns>
+static int32_t I2cTransfer(int fd, I2C_DeviceAddress address, const i2c_segment_t *segments, size_t segmentCount,
+	uint8_t *readBuf, size_t readLen)
 {
-
-#ifdef ENABLE_READ_WRITE_DEBUG
-	Log_Debug("platform_write()\n");
-	Log_Debug("reg: %0x\n", reg);
-	Log_Debug("len: %0x\n", len);
-	Log_Debug("bufp contents: ");
-	for (int i = 0; i < len; i++) {
-
-		Log_Debug("%0x: ", bufp[i]);
+	uint8_t gatherBuf[I2C_MAX_WRITE_LEN];
+	const uint8_t *writeBuf;
+	size_t writeLen = 0;
+
+	if (segmentCount == 1) {
+		// Nothing to gather, send the caller's buffer as is
+		writeBuf = segments[0].data;
+		writeLen = segments[0].len;
 	}
-	Log_Debug("\n");
-#endif 
-
-	// Construct a new command buffer that contains the register to write to, then the data to write
-	uint8_t cmdBuffer[len + 1];
-	cmdBuffer[0] = reg;
-	for (int i = 0; i < len; i++) {
-		cmdBuffer[i + 1] = bufp[i];
+	else {
+		for (size_t i = 0; i < segmentCount; i++) {
+			if (writeLen + segments[i].len > sizeof(gatherBuf)) {
+				Log_Debug("ERROR: I2C write of more than %d bytes\n", (int)sizeof(gatherBuf));
+				return -1;
+			}
+			memcpy(&gatherBuf[writeLen], segments[i].data, segments[i].len);
+			writeLen += segments[i].len;
+		}
+		writeBuf = gatherBuf;
 	}
 
-#ifdef ENABLE_READ_WRITE_DEBUG
-	Log_Debug("cmdBuffer contents: ");
-	for (int i = 0; i < len + 1; i++) {
-
-		Log_Debug("%0x: ", cmdBuffer[i]);
+	ssize_t retVal;
+	atomic_fetch_add(&i2cSyscalls, 1);
+#ifdef ENABLE_I2C_SIMULATOR
+	(void)fd;
+	if (readLen == 0) {
+		retVal = i2cSimWrite(address, writeBuf, writeLen);
+	}
+	else {
+		retVal = i2cSimWriteThenRead(address, writeBuf, writeLen, readBuf, readLen);
+	}
+#else
+	if (readLen == 0) {
+		retVal = I2CMaster_Write(fd, address, writeBuf, writeLen);
+	}
+	else {
+		retVal = I2CMaster_WriteThenRead(fd, address, writeBuf, writeLen, readBuf, readLen);
 	}
-	Log_Debug("\n");
 #endif
 
-	// Write the data to the device
-	int32_t retVal = I2CMaster_Write(*fD, lsm6dsOAddress, cmdBuffer, (size_t)len + 1);
 	if (retVal < 0) {
-		Log_Debug("ERROR: platform_write: errno=%d (%s)\n", errno, strerror(errno));
+		Log_Debug("ERROR: I2cTransfer: errno=%d (%s)\n", errno, strerror(errno));
 		return -1;
 	}
-#ifdef ENABLE_READ_WRITE_DEBUG
-	Log_Debug("Wrote %d bytes to device.\n\n", retVal);
-#endif
+
 	return 0;
 }
 
 /// <summary>
-///     Reads generic device register from the i2c interface
+///     Register read or write on the I2C bus opened as fd.  Reads write the register address and
+///     read the data after a repeated start, writes send the register address followed by the data.
 /// </summary>
-/// <returns>0</returns>
-
-/*
- * @brief  Read generic device register (platform dependent)
- *
- * @param  handle    customizable argument. In this examples is used in
- *                   order to select the correct sensor bus handler.
- * @param  reg       register to read
- * @param  bufp      pointer to buffer that store the data read
- * @param  len       number of consecutive register to read
- *
- */
-static int32_t platform_read(int *fD, uint8_t reg, uint8_t *bufp,
-	uint16_t len)
+/// <returns>0 on success, or -1 on failure</returns>
+static int32_t BusTransfer(int fd, I2C_DeviceAddress address, uint8_t reg, uint8_t *data, uint16_t len, bool isRead)
 {
+	int32_t retVal;
 
-#ifdef ENABLE_READ_WRITE_DEBUG
-	Log_Debug("platform_read()\n");
-	Log_Debug("reg: %0x\n", reg);
-	Log_Debug("len: %d\n", len);
-;
+#ifdef ENABLE_I2C_STATS
+	struct timespec start;
+	clock_gettime(CLOCK_MONOTONIC, &start);
 #endif
 
-	// Set the register address to read
-	int32_t retVal = I2CMaster_Write(i2cFd, lsm6dsOAddress, &reg, 1);
-	if (retVal < 0) {
-		Log_Debug("ERROR: platform_read(write step): errno=%d (%s)\n", errno, strerror(errno));
-		return -1;
+	if (isRead) {
+		i2c_segment_t segment = { &reg, 1 };
+		retVal = I2cTransfer(fd, address, &segment, 1, data, len);
 	}
-
-	// Read the data into the provided buffer
-	retVal = I2CMaster_Read(i2cFd, lsm6dsOAddress, bufp, len);
-	if (retVal < 0) {
-		Log_Debug("ERROR: platform_read(read step): errno=%d (%s)\n", errno, strerror(errno));
-		return -1;
+	else {
+		i2c_segment_t segments[] = { {&reg, 1}, {data, len} };
+		retVal = I2cTransfer(fd, address, segments, 2, NULL, 0);
 	}
 
-#ifdef ENABLE_READ_WRITE_DEBUG
-	Log_Debug("Read returned: ");
-	for (int i = 0; i < len; i++) {
-		Log_Debug("%0x: ", bufp[i]);
-	}
-	Log_Debug("\n\n");
-#endif 	   
+#ifdef ENABLE_I2C_STATS
+	i2cStatsRecord(address, reg, len, isRead, retVal, &start);
+#endif
 
-	return 0;
+	return retVal;
 }
-/*
- * @brief  Write lsm2mdl device register (used by configuration functions)
- *
- * @param  handle    customizable argument. In this examples is used in
- *                   order to select the correct sensor bus handler.
- * @param  reg       register to write
- * @param  bufp      pointer to data to write in register reg
- * @param  len       number of consecutive register to write
- *
- */
-static int32_t lsm6dso_write_lps22hh_cx(void* ctx, uint8_t reg, uint8_t* data,
-	uint16_t len)
-{
-	axis3bit16_t data_raw_acceleration;
-	int32_t ret;
-	uint8_t drdy;
-	lsm6dso_status_master_t master_status;
-	lsm6dso_sh_cfg_write_t sh_cfg_write;
-
-	// Configure Sensor Hub to write to the LPS22HH, and send the write data
-	sh_cfg_write.slv0_add = (LPS22HH_I2C_ADD_L & 0xFEU) >> 1; // 7bit I2C address
-	sh_cfg_write.slv0_subadd = reg,
-	sh_cfg_write.slv0_data = *data,
-	ret = lsm6dso_sh_cfg_write(&dev_ctx, &sh_cfg_write);
-
-	/* Disable accelerometer. */
-	lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_OFF);
-
-	/* Enable I2C Master. */
-	lsm6dso_sh_master_set(&dev_ctx, PROPERTY_ENABLE);
-
-	/* Enable accelerometer to trigger Sensor Hub operation. */
-	lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_104Hz);
 
-	/* Wait Sensor Hub operation flag set. */
-	lsm6dso_acceleration_raw_get(&dev_ctx, data_raw_acceleration.u8bit);
-	do
-	{
-		HAL_Delay(20);
-		lsm6dso_xl_flag_data_ready_get(&dev_ctx, &drdy);
-	} while (!drdy);
-
-	do
-	{
-		HAL_Delay(20);
-		lsm6dso_sh_status_get(&dev_ctx, &master_status);
-	} while (!master_status.sens_hub_endop);
+#ifdef ENABLE_I2C_QUEUE
+/// <summary>
+///     Register read or write on the ISU2 I2C bus, the routine the I2C queue worker runs.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+static int32_t RegisterTransfer(I2C_DeviceAddress address, uint8_t reg, uint8_t *data, uint16_t len, bool isRead)
+{
+	return BusTransfer(i2cFd, address, reg, data, len, isRead);
+}
+#endif
 
-	/* Disable I2C master and XL (trigger). */
-	lsm6dso_sh_master_set(&dev_ctx, PROPERTY_DISABLE);
-	lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_OFF);
+/// <summary>
+///     Writes data to the lsm6dso i2c device
+/// </summary>
+/// <returns>0</returns>
 
-	return ret;
+static int32_t platform_write(int *fD, uint8_t reg, uint8_t *bufp,
+	uint16_t len)
+{
+#ifdef ENABLE_I2C_QUEUE
+	// The queue worker owns the bus, it runs on i2cFd, the fd dev_ctx.handle points at
+	(void)fD;
+	int32_t retVal = i2cQueueWriteSync(lsm6dsOAddress, reg, bufp, len);
+#else
+	int32_t retVal = BusTransfer(*fD, lsm6dsOAddress, reg, bufp, len, false);
+#endif
+	if (retVal != 0) {
+		Log_Debug("ERROR: platform_write failed\n");
+		return -1;
+	}
+	return 0;
 }
 
+/// <summary>
+///     Reads generic device register from the i2c interface
+/// </summary>
+/// <returns>0</returns>
+
 /*
- * @brief  Read lsm2mdl device register (used by configuration functions)
+ * @brief  Read generic device register (platform dependent)
  *
  * @param  handle    customizable argument. In this examples is used in
  *                   order to select the correct sensor bus handler.
@@ -582,67 +2832,20 @@ static int32_t lsm6dso_write_lps22hh_cx(void* ctx, uint8_t reg, uint8_t* data,
  * @param  len       number of consecutive register to read
  *
  */
-static int32_t lsm6dso_read_lps22hh_cx(void* ctx, uint8_t reg, uint8_t* data, uint16_t len)
+static int32_t platform_read(int *fD, uint8_t reg, uint8_t *bufp,
+	uint16_t len)
 {
-	lsm6dso_sh_cfg_read_t sh_cfg_read;
-	uint8_t buf_raw[6];
-	int32_t ret;
-	uint8_t drdy;
-	lsm6dso_status_master_t master_status;
-
-	/* Disable accelerometer. */
-	lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_OFF);
-
-	/* Configure Sensor Hub to read LPS22HH. */
-	sh_cfg_read.slv_add = (LPS22HH_I2C_ADD_L & 0xFEU) >> 1; /* 7bit I2C address */
-	sh_cfg_read.slv_subadd = reg;
-	sh_cfg_read.slv_len = (uint8_t)len;
-
-	// Call the command to read the data from the sensor hub.
-	// This data will be read from the device connected to the 
-	// sensor hub, and saved into a register for us to read.
-	ret = lsm6dso_sh_slv0_cfg_read(&dev_ctx, &sh_cfg_read);
-
-	// Using slave 0 only
-	lsm6dso_sh_slave_connected_set(&dev_ctx, LSM6DSO_SLV_0);
-
-	/* Enable I2C Master */
-	lsm6dso_sh_master_set(&dev_ctx, PROPERTY_ENABLE);
-
-	/* Enable accelerometer to trigger Sensor Hub operation. */
-	lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_104Hz);
-
-	/* Wait Sensor Hub operation flag set. */
-	lsm6dso_acceleration_raw_get(&dev_ctx, buf_raw);
-	do {
-		HAL_Delay(20);
-		lsm6dso_xl_flag_data_ready_get(&dev_ctx, &drdy);
-	} while (!drdy);
-
-	do {
-		HAL_Delay(20);
-		lsm6dso_sh_status_get(&dev_ctx, &master_status);
-	} while (!master_status.sens_hub_endop);
-
-	/* Disable I2C master and XL(trigger). */
-	lsm6dso_sh_master_set(&dev_ctx, PROPERTY_DISABLE);
-	lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_OFF);
-
-	// Read the data from the device
-	lsm6dso_sh_read_data_raw_get(&dev_ctx, data, (uint8_t)len);
-
-#ifdef ENABLE_READ_WRITE_DEBUG
-	Log_Debug("Read %d bytes: ", len);
-	for (int i = 0; i < len; i++) {
-		Log_Debug("[%0x] ", data[i]);
+#ifdef ENABLE_I2C_QUEUE
+	// The queue worker owns the bus, it runs on i2cFd, the fd dev_ctx.handle points at
+	(void)fD;
+	int32_t retVal = i2cQueueReadSync(lsm6dsOAddress, reg, bufp, len);
+#else
+	int32_t retVal = BusTransfer(*fD, lsm6dsOAddress, reg, bufp, len, true);
+#endif
+	if (retVal != 0) {
+		Log_Debug("ERROR: platform_read failed\n");
+		return -1;
 	}
-	Log_Debug("\n", len);
-#endif 
 
-	/* Re-enable accelerometer */
-	lsm6dso_xl_data_rate_set(&dev_ctx, LSM6DSO_XL_ODR_104Hz);
-
-	return ret;
+	return 0;
 }
-
-
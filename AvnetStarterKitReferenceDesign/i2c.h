@@ -1,10 +1,106 @@
 #pragma once
 
 #include <stdbool.h>
+#include <stddef.h>
 #include "epoll_timerfd_utilities.h"
 
 #define LSM6DSO_ID         0x6C   // register value
 #define LSM6DSO_ADDRESS	   0x6A	  // I2C Address
 
+// Accelerometer and gyroscope settings, the device twin writes them directly.  imuSettingsChanged
+// rounds each one up to a setting the LSM6DSO supports and reconfigures it.
+typedef struct {
+	float accelOdrHz;
+	int accelFullScaleG;
+	float gyroOdrHz;
+	int gyroFullScaleDps;
+} imu_settings_t;
+
+extern imu_settings_t imuSettings;
+
+// Tap detection settings, the device twin writes them directly.  tapSettingsChanged rounds them to
+// what the LSM6DSO supports and reconfigures it.
+typedef enum {
+	TAP_MODE_OFF = 0,
+	TAP_MODE_SINGLE = 1,
+	TAP_MODE_SINGLE_DOUBLE = 2
+} tap_mode_t;
+
+typedef struct {
+	int mode;
+	int axes;
+	float thresholdMg;
+	float shockMs;
+	float quietMs;
+	float durationMs;
+} tap_settings_t;
+
+extern tap_settings_t tapSettings;
+
+// Activity gating settings, the device twin writes them directly.  activitySettingsChanged rounds
+// them to what the LSM6DSO supports and reconfigures it.  mode 0 is off and 1 on.
+typedef struct {
+	int mode;
+	float thresholdMg;
+	float sleepSeconds;
+} activity_settings_t;
+
+extern activity_settings_t activitySettings;
+
+// Capture settings, the device twin writes them directly.  captureSettingsChanged rounds them to
+// what the LSM6DSO and the capture buffer support and reconfigures the device.
+#define CAPTURE_MODE_FREE_FALL 0x01
+#define CAPTURE_MODE_SHOCK 0x02
+
+typedef struct {
+	int mode;
+	float freeFallMg;
+	float freeFallMs;
+	float shockMg;
+	float beforeMs;
+	float afterMs;
+} capture_settings_t;
+
+extern capture_settings_t captureSettings;
+
+// Pedometer settings, the device twin writes them directly.  pedometerSettingsChanged reconfigures
+// the LSM6DSO and restarts the step count.
+typedef enum {
+	PEDOMETER_MODE_OFF = 0,
+	PEDOMETER_MODE_STEPS = 1,
+	PEDOMETER_MODE_FALSE_STEP_REJECTION = 2
+} pedometer_mode_t;
+
+typedef struct {
+	int mode;
+} pedometer_settings_t;
+
+extern pedometer_settings_t pedometerSettings;
+
+// Orientation settings, the device twin writes them directly.  orientationSettingsChanged rounds
+// them to what the LSM6DSO supports and reconfigures it.  tilt 0 is off and 1 on.
+typedef enum {
+	ORIENTATION_MODE_OFF = 0,
+	ORIENTATION_MODE_6D = 1,
+	ORIENTATION_MODE_4D = 2
+} orientation_mode_t;
+
+typedef struct {
+	int mode;
+	float thresholdDeg;
+	int tilt;
+} orientation_settings_t;
+
+extern orientation_settings_t orientationSettings;
+
 int initI2c(void);
-void closeI2c(void);
\ No newline at end of file
+void closeI2c(void);
+void HAL_Delay(int delayTime);
+void imuSettingsChanged(void);
+void tapSettingsChanged(void);
+void activitySettingsChanged(void);
+void captureSettingsChanged(void);
+void pedometerSettingsChanged(void);
+void orientationSettingsChanged(void);
+int calibrateAccelerometer(char *json, size_t size);
+int loadFsmProgram(const char *hex, char *json, size_t size);
\ No newline at end of file
@@ -0,0 +1,433 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdbool.h>
+#include <string.h>
+#include <sys/eventfd.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "i2c_queue.h"
+
+// Number of devices that can be given a priority
+#define I2C_QUEUE_MAX_DEVICES 4
+
+typedef enum {
+	REQUEST_FREE,
+	REQUEST_PENDING,
+	REQUEST_RUNNING,
+	REQUEST_DONE
+} request_state_t;
+
+typedef struct {
+	request_state_t state;
+	// Submission order, used to keep requests of the same priority first in first out
+	uint32_t sequence;
+	i2c_priority_t priority;
+	bool isAsync;
+
+	I2C_DeviceAddress address;
+	uint8_t reg;
+	bool isRead;
+	uint16_t len;
+	// Points to the caller's buffer for sync requests, to asyncData otherwise
+	uint8_t *data;
+	uint8_t asyncData[I2C_QUEUE_MAX_DATA];
+
+	int32_t status;
+	I2cCompletionHandler handler;
+	void *context;
+} i2c_request_t;
+
+typedef struct {
+	I2C_DeviceAddress address;
+	i2c_priority_t priority;
+} device_priority_t;
+
+static i2c_request_t requests[I2C_QUEUE_DEPTH];
+static uint32_t nextSequence;
+
+static device_priority_t devicePriorities[I2C_QUEUE_MAX_DEVICES];
+static int devicePriorityCount;
+
+static I2cTransferFunction transferFunction = NULL;
+
+static pthread_t workerThread;
+static pthread_mutex_t queueMutex = PTHREAD_MUTEX_INITIALIZER;
+// Signalled when a request is queued or the worker must stop
+static pthread_cond_t workCond = PTHREAD_COND_INITIALIZER;
+// Signalled when a request completes or a slot is freed
+static pthread_cond_t doneCond = PTHREAD_COND_INITIALIZER;
+static bool workerRunning = false;
+static bool workerStop = false;
+
+static int queueEpollFd = -1;
+static int completionEventFd = -1;
+
+static i2c_queue_stats_t queueStats;
+
+/// <summary>
+///     Returns the priority of a device.
+/// </summary>
+static i2c_priority_t DevicePriority(I2C_DeviceAddress address)
+{
+	for (int i = 0; i < devicePriorityCount; i++) {
+		if (devicePriorities[i].address == address) {
+			return devicePriorities[i].priority;
+		}
+	}
+
+	return I2C_PRIORITY_NORMAL;
+}
+
+/// <summary>
+///     Finds a free request slot and fills in the common fields.  Must be called with the lock held.
+///     The last free slot is kept for sync requests: completed async requests are only freed from
+///     the epoll loop, which can't run while the main thread waits for a sync request.
+/// </summary>
+/// <returns>The request, or NULL if the queue is full</returns>
+static i2c_request_t *AllocateRequest(I2C_DeviceAddress address, uint8_t reg, bool isRead, uint16_t len, bool isAsync)
+{
+	int queued = 0;
+	i2c_request_t *request = NULL;
+
+	for (int i = 0; i < I2C_QUEUE_DEPTH; i++) {
+		if (requests[i].state == REQUEST_FREE) {
+			if (request == NULL) {
+				request = &requests[i];
+			}
+		}
+		else {
+			queued++;
+		}
+	}
+
+	if ((request == NULL) || (isAsync && (queued >= I2C_QUEUE_DEPTH - 1))) {
+		return NULL;
+	}
+
+	if ((uint32_t)(queued + 1) > queueStats.maxQueued) {
+		queueStats.maxQueued = (uint32_t)(queued + 1);
+	}
+
+	memset(request, 0, sizeof(*request));
+	request->sequence = nextSequence++;
+	request->priority = DevicePriority(address);
+	request->address = address;
+	request->reg = reg;
+	request->isRead = isRead;
+	request->len = len;
+	request->isAsync = isAsync;
+
+	return request;
+}
+
+/// <summary>
+///     Picks the next request to run.  Must be called with the lock held.
+/// </summary>
+/// <returns>The request, or NULL if nothing is pending</returns>
+static i2c_request_t *NextPendingRequest(void)
+{
+	i2c_request_t *next = NULL;
+
+	for (int i = 0; i < I2C_QUEUE_DEPTH; i++) {
+		i2c_request_t *request = &requests[i];
+		if (request->state != REQUEST_PENDING) {
+			continue;
+		}
+		if ((next == NULL) || (request->priority > next->priority) ||
+			((request->priority == next->priority) && ((int32_t)(request->sequence - next->sequence) < 0))) {
+			next = request;
+		}
+	}
+
+	return next;
+}
+
+/// <summary>
+///     Runs the queued transactions until closeI2cQueue is called.
+/// </summary>
+static void *I2cQueueWorker(void *arg)
+{
+	(void)arg;
+
+	pthread_mutex_lock(&queueMutex);
+
+	while (!workerStop) {
+
+		i2c_request_t *request = NextPendingRequest();
+		if (request == NULL) {
+			pthread_cond_wait(&workCond, &queueMutex);
+			continue;
+		}
+
+		request->state = REQUEST_RUNNING;
+		pthread_mutex_unlock(&queueMutex);
+
+		// The bus is only touched from this thread while the worker is running
+		int32_t status = transferFunction(request->address, request->reg, request->data, request->len, request->isRead);
+
+		pthread_mutex_lock(&queueMutex);
+		request->status = status;
+		request->state = REQUEST_DONE;
+		if (status != 0) {
+			queueStats.failedRequests++;
+		}
+
+		if (request->isAsync) {
+			// Wake the epoll loop, I2cQueueEventHandler calls the handler
+			uint64_t one = 1;
+			if (write(completionEventFd, &one, sizeof(one)) < 0) {
+				Log_Debug("ERROR: Could not signal I2C completion: %s (%d)\n", strerror(errno), errno);
+			}
+		}
+		else {
+			pthread_cond_broadcast(&doneCond);
+		}
+	}
+
+	pthread_mutex_unlock(&queueMutex);
+	return NULL;
+}
+
+/// <summary>
+///     Calls the handlers of the completed asynchronous transactions, in submission order.
+/// </summary>
+static void I2cQueueEventHandler(EventData *eventData)
+{
+	(void)eventData;
+
+	uint64_t count;
+	if (read(completionEventFd, &count, sizeof(count)) < 0) {
+		Log_Debug("ERROR: Could not read the I2C completion event: %s (%d)\n", strerror(errno), errno);
+		return;
+	}
+
+	// Copy the completed requests out so the handlers run without the lock and can queue more work
+	i2c_request_t completed[I2C_QUEUE_DEPTH];
+	int completedCount = 0;
+
+	pthread_mutex_lock(&queueMutex);
+	for (int i = 0; i < I2C_QUEUE_DEPTH; i++) {
+		if ((requests[i].state == REQUEST_DONE) && requests[i].isAsync) {
+
+			// Insertion sort on the sequence number
+			int j = completedCount++;
+			while ((j > 0) && ((int32_t)(completed[j - 1].sequence - requests[i].sequence) > 0)) {
+				completed[j] = completed[j - 1];
+				j--;
+			}
+			completed[j] = requests[i];
+
+			requests[i].state = REQUEST_FREE;
+		}
+	}
+	pthread_cond_broadcast(&doneCond);
+	pthread_mutex_unlock(&queueMutex);
+
+	for (int i = 0; i < completedCount; i++) {
+		if (completed[i].handler != NULL) {
+			completed[i].handler(completed[i].status, completed[i].asyncData, completed[i].len, completed[i].context);
+		}
+	}
+}
+
+static EventData i2cQueueEventData = { .eventHandler = &I2cQueueEventHandler };
+
+/// <summary>
+///     Starts the worker thread and registers the completion eventfd with the epoll.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int initI2cQueue(int epollFd, I2cTransferFunction transfer)
+{
+	transferFunction = transfer;
+	queueEpollFd = epollFd;
+	memset(requests, 0, sizeof(requests));
+	memset(&queueStats, 0, sizeof(queueStats));
+
+	completionEventFd = eventfd(0, EFD_NONBLOCK);
+	if (completionEventFd < 0) {
+		Log_Debug("ERROR: Could not create the I2C completion eventfd: %s (%d)\n", strerror(errno), errno);
+		return -1;
+	}
+
+	if (RegisterEventHandlerToEpoll(epollFd, completionEventFd, &i2cQueueEventData, EPOLLIN) != 0) {
+		CloseFdAndPrintError(completionEventFd, "i2cQueueEvent");
+		completionEventFd = -1;
+		return -1;
+	}
+
+	workerStop = false;
+	int result = pthread_create(&workerThread, NULL, I2cQueueWorker, NULL);
+	if (result != 0) {
+		Log_Debug("ERROR: Could not start the I2C worker thread: %s (%d)\n", strerror(result), result);
+		UnregisterEventHandlerFromEpoll(epollFd, completionEventFd);
+		CloseFdAndPrintError(completionEventFd, "i2cQueueEvent");
+		completionEventFd = -1;
+		return -1;
+	}
+	workerRunning = true;
+
+	return 0;
+}
+
+/// <summary>
+///     Stops the worker thread and closes the completion eventfd.
+/// </summary>
+void closeI2cQueue(void)
+{
+	if (workerRunning) {
+		pthread_mutex_lock(&queueMutex);
+		workerStop = true;
+		pthread_cond_signal(&workCond);
+		pthread_mutex_unlock(&queueMutex);
+
+		pthread_join(workerThread, NULL);
+		workerRunning = false;
+	}
+
+	if (completionEventFd >= 0) {
+		UnregisterEventHandlerFromEpoll(queueEpollFd, completionEventFd);
+	}
+	CloseFdAndPrintError(completionEventFd, "i2cQueueEvent");
+	completionEventFd = -1;
+}
+
+/// <summary>
+///     Sets the priority used for every transaction to the device.
+/// </summary>
+void i2cQueueSetDevicePriority(I2C_DeviceAddress address, i2c_priority_t priority)
+{
+	pthread_mutex_lock(&queueMutex);
+
+	int i;
+	for (i = 0; i < devicePriorityCount; i++) {
+		if (devicePriorities[i].address == address) {
+			break;
+		}
+	}
+
+	if (i < I2C_QUEUE_MAX_DEVICES) {
+		devicePriorities[i].address = address;
+		devicePriorities[i].priority = priority;
+		if (i == devicePriorityCount) {
+			devicePriorityCount++;
+		}
+	}
+	else {
+		Log_Debug("ERROR: No room for the priority of I2C device 0x%02X\n", address);
+	}
+
+	pthread_mutex_unlock(&queueMutex);
+}
+
+/// <summary>
+///     Queues a transaction and waits for the worker to run it.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+static int32_t RunSync(I2C_DeviceAddress address, uint8_t reg, uint8_t *data, uint16_t len, bool isRead)
+{
+	if (transferFunction == NULL) {
+		return -1;
+	}
+
+	if (!workerRunning) {
+		return transferFunction(address, reg, data, len, isRead);
+	}
+
+	pthread_mutex_lock(&queueMutex);
+
+	i2c_request_t *request;
+	while ((request = AllocateRequest(address, reg, isRead, len, false)) == NULL) {
+		pthread_cond_wait(&doneCond, &queueMutex);
+	}
+
+	// The caller is blocked until the transaction is done, so the worker can use its buffer
+	request->data = data;
+	request->state = REQUEST_PENDING;
+	queueStats.syncRequests++;
+	pthread_cond_signal(&workCond);
+
+	while (request->state != REQUEST_DONE) {
+		pthread_cond_wait(&doneCond, &queueMutex);
+	}
+
+	int32_t status = request->status;
+	request->state = REQUEST_FREE;
+	pthread_cond_broadcast(&doneCond);
+
+	pthread_mutex_unlock(&queueMutex);
+
+	return status;
+}
+
+/// <summary>
+///     Queues a transaction to be completed from the epoll loop.
+/// </summary>
+/// <returns>0 if the transaction was queued, or -1 on failure</returns>
+static int QueueAsync(I2C_DeviceAddress address, uint8_t reg, const uint8_t *data, uint16_t len, bool isRead,
+	I2cCompletionHandler handler, void *context)
+{
+	if (!workerRunning || (len > I2C_QUEUE_MAX_DATA)) {
+		return -1;
+	}
+
+	pthread_mutex_lock(&queueMutex);
+
+	i2c_request_t *request = AllocateRequest(address, reg, isRead, len, true);
+	if (request == NULL) {
+		queueStats.rejectedRequests++;
+		pthread_mutex_unlock(&queueMutex);
+		return -1;
+	}
+
+	if (!isRead) {
+		memcpy(request->asyncData, data, len);
+	}
+	request->data = request->asyncData;
+	request->handler = handler;
+	request->context = context;
+	request->state = REQUEST_PENDING;
+	queueStats.asyncRequests++;
+	pthread_cond_signal(&workCond);
+
+	pthread_mutex_unlock(&queueMutex);
+
+	return 0;
+}
+
+int32_t i2cQueueReadSync(I2C_DeviceAddress address, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	return RunSync(address, reg, data, len, true);
+}
+
+int32_t i2cQueueWriteSync(I2C_DeviceAddress address, uint8_t reg, const uint8_t *data, uint16_t len)
+{
+	// Writes only read from the buffer
+	return RunSync(address, reg, (uint8_t *)data, len, false);
+}
+
+int i2cQueueReadAsync(I2C_DeviceAddress address, uint8_t reg, uint16_t len, I2cCompletionHandler handler, void *context)
+{
+	return QueueAsync(address, reg, NULL, len, true, handler, context);
+}
+
+int i2cQueueWriteAsync(I2C_DeviceAddress address, uint8_t reg, const uint8_t *data, uint16_t len,
+	I2cCompletionHandler handler, void *context)
+{
+	return QueueAsync(address, reg, data, len, false, handler, context);
+}
+
+/// <summary>
+///     Returns the queue statistics.
+/// </summary>
+const i2c_queue_stats_t *getI2cQueueStats(void)
+{
+	return &queueStats;
+}
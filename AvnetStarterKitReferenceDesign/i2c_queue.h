@@ -0,0 +1,91 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+#include <applibs/i2c.h>
+
+// Number of transactions that can be queued at once
+#define I2C_QUEUE_DEPTH 16
+
+// Largest asynchronous transfer, the data is held in the queue until the handler runs
+#define I2C_QUEUE_MAX_DATA 32
+
+// How the drivers use the queue.  The LSM6DSO read_reg/write_reg hooks, platform_read and
+// platform_write in i2c.c, are the sync flavor, i2cQueueReadAsync and i2cQueueWriteAsync on the
+// LSM6DSO address the async one.  The LPS22HH sits behind the LSM6DSO sensor hub and has no address
+// of its own on the bus, so it never appears in the queue.  Its hooks, sensorHubReadSync and
+// sensorHubWriteSync, and their async flavor, sensorHubReadAsync and sensorHubWriteAsync, run
+// LSM6DSO register transactions, which are queued like any other.
+
+// Transactions for higher priority devices are run first, in submission order within a priority
+typedef enum {
+	I2C_PRIORITY_LOW = 0,
+	I2C_PRIORITY_NORMAL = 1,
+	I2C_PRIORITY_HIGH = 2,
+} i2c_priority_t;
+
+typedef struct {
+	uint32_t syncRequests;
+	uint32_t asyncRequests;
+	uint32_t failedRequests;
+	// Async requests refused because the queue was full
+	uint32_t rejectedRequests;
+	uint32_t maxQueued;
+} i2c_queue_stats_t;
+
+/// <summary>
+///     Function signature for the routine that runs a register transaction on the bus.  It
+///     is called from the worker thread.
+/// </summary>
+typedef int32_t (*I2cTransferFunction)(I2C_DeviceAddress address, uint8_t reg, uint8_t *data, uint16_t len, bool isRead);
+
+/// <summary>
+///     Function signature for the handler called from the epoll loop when an asynchronous
+///     transaction completes.  status is 0 on success, data is only valid for reads.
+/// </summary>
+typedef void (*I2cCompletionHandler)(int32_t status, const uint8_t *data, uint16_t len, void *context);
+
+/// <summary>
+///     Starts the worker thread and registers the completion eventfd with the epoll.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int initI2cQueue(int epollFd, I2cTransferFunction transfer);
+
+/// <summary>
+///     Stops the worker thread and closes the completion eventfd.  Pending asynchronous
+///     transactions are dropped without calling their handlers.
+/// </summary>
+void closeI2cQueue(void);
+
+/// <summary>
+///     Sets the priority used for every transaction to the device, the default is I2C_PRIORITY_NORMAL.
+/// </summary>
+void i2cQueueSetDevicePriority(I2C_DeviceAddress address, i2c_priority_t priority);
+
+/// <summary>
+///     Queues a register read/write and waits for it to complete.  If the worker isn't running
+///     the transaction is run on the calling thread.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int32_t i2cQueueReadSync(I2C_DeviceAddress address, uint8_t reg, uint8_t *data, uint16_t len);
+int32_t i2cQueueWriteSync(I2C_DeviceAddress address, uint8_t reg, const uint8_t *data, uint16_t len);
+
+/// <summary>
+///     Queues a register read/write and returns straight away.  The handler is called from
+///     the epoll loop once the transaction has run.
+/// </summary>
+/// <returns>0 if the transaction was queued, or -1 if the queue is full or not running</returns>
+int i2cQueueReadAsync(I2C_DeviceAddress address, uint8_t reg, uint16_t len, I2cCompletionHandler handler, void *context);
+int i2cQueueWriteAsync(I2C_DeviceAddress address, uint8_t reg, const uint8_t *data, uint16_t len,
+	I2cCompletionHandler handler, void *context);
+
+/// <summary>
+///     Returns the queue statistics.
+/// </summary>
+const i2c_queue_stats_t *getI2cQueueStats(void);
@@ -0,0 +1,1570 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+
+#include "i2c_sim.h"
+
+// Register level model of the LSM6DSO and of the LPS22HH on its sensor hub.  It covers what this
+// application uses: the register banks, software reset, the accelerometer, gyroscope and temperature
+// outputs with their data-ready flags, the accelerometer user offsets, the FIFO, sensor hub slave 0, the
+// tap, wake-up and free-fall sources and the inactive state, which are set by i2cSimTap, i2cSimShock,
+// i2cSimFreeFall and i2cSimActivity rather than detected, and the INT1 pin they are routed to.
+// Samples are produced at the configured output data rate from CLOCK_MONOTONIC, their values come from
+// simulated motion or from a recorded trace.
+
+#define PI 3.14159265358979
+
+// LSM6DSO registers
+#define SIM_FUNC_CFG_ACCESS 0x01
+#define SIM_FIFO_CTRL1 0x07
+#define SIM_FIFO_CTRL2 0x08
+#define SIM_FIFO_CTRL3 0x09
+#define SIM_FIFO_CTRL4 0x0A
+#define SIM_INT1_CTRL 0x0D
+#define SIM_WHO_AM_I 0x0F
+#define SIM_CTRL1_XL 0x10
+#define SIM_CTRL2_G 0x11
+#define SIM_CTRL3_C 0x12
+#define SIM_CTRL6_C 0x15
+#define SIM_CTRL7_G 0x16
+#define SIM_CTRL9_XL 0x18
+#define SIM_CTRL10_C 0x19
+#define SIM_ALL_INT_SRC 0x1A
+#define SIM_WAKE_UP_SRC 0x1B
+#define SIM_TAP_SRC 0x1C
+#define SIM_D6D_SRC 0x1D
+#define SIM_STATUS_REG 0x1E
+#define SIM_OUT_TEMP_L 0x20
+#define SIM_OUTX_L_G 0x22
+#define SIM_OUTX_L_A 0x28
+#define SIM_OUTZ_H_A 0x2D
+#define SIM_STATUS_MASTER_MAINPAGE 0x39
+#define SIM_TIMESTAMP0 0x40
+#define SIM_TIMESTAMP3 0x43
+#define SIM_FIFO_STATUS1 0x3A
+#define SIM_FIFO_STATUS2 0x3B
+#define SIM_TAP_CFG0 0x56
+#define SIM_TAP_CFG2 0x58
+#define SIM_WAKE_UP_THS 0x5B
+#define SIM_MD1_CFG 0x5E
+#define SIM_X_OFS_USR 0x73
+#define SIM_FIFO_DATA_OUT_TAG 0x78
+#define SIM_FIFO_DATA_OUT_Z_H 0x7E
+
+// LSM6DSO sensor hub bank registers
+#define SIM_SENSOR_HUB_1 0x02
+#define SIM_MASTER_CONFIG 0x14
+#define SIM_SLV0_ADD 0x15
+#define SIM_SLV0_SUBADD 0x16
+#define SIM_SLV0_CONFIG 0x17
+#define SIM_DATAWRITE_SLV0 0x21
+#define SIM_STATUS_MASTER 0x22
+
+#define SIM_LSM6DSO_ID 0x6C
+#define SIM_CTRL3_C_SW_RESET 0x01
+#define SIM_CTRL3_C_IF_INC 0x04
+#define SIM_CTRL3_C_BOOT 0x80
+#define SIM_STATUS_XLDA 0x01
+#define SIM_STATUS_GDA 0x02
+#define SIM_STATUS_TDA 0x04
+#define SIM_TIMESTAMP_EN 0x20
+#define SIM_USR_OFF_W 0x08
+#define SIM_USR_OFF_ON_OUT 0x02
+#define SIM_MASTER_ON 0x04
+#define SIM_WRITE_ONCE 0x40
+#define SIM_SENS_HUB_ENDOP 0x01
+#define SIM_BATCH_EXT_SENS_0_EN 0x08
+#define SIM_INTERRUPTS_ENABLE 0x80
+#define SIM_SINGLE_DOUBLE_TAP 0x80
+#define SIM_TAP_SIGN 0x08
+#define SIM_TAP_DOUBLE 0x10
+#define SIM_TAP_SINGLE 0x20
+#define SIM_TAP_IA 0x40
+#define SIM_ALL_INT_SINGLE_TAP 0x04
+#define SIM_ALL_INT_DOUBLE_TAP 0x08
+#define SIM_INACT_EN_SHIFT 5
+#define SIM_INACT_EN_MASK 0x60
+#define SIM_WU_IA 0x08
+#define SIM_SLEEP_STATE 0x10
+#define SIM_SLEEP_CHANGE_IA 0x40
+#define SIM_FF_IA 0x20
+#define SIM_ALL_INT_FF 0x01
+#define SIM_ALL_INT_WU 0x02
+#define SIM_ALL_INT_SLEEP_CHANGE 0x20
+
+// 6D orientation, TAP_THS_6D d4d_en and the D6D_SRC flags
+#define SIM_TAP_THS_6D 0x59
+#define SIM_D4D_EN 0x80
+#define SIM_D6D_POSITION_MASK 0x3F
+#define SIM_D6D_IA 0x40
+#define SIM_ALL_INT_D6D 0x10
+
+// INT1_CTRL routes
+#define SIM_INT1_DRDY_XL 0x01
+#define SIM_INT1_DRDY_G 0x02
+#define SIM_INT1_FIFO_TH 0x08
+#define SIM_INT1_FIFO_OVR 0x10
+#define SIM_INT1_FIFO_FULL 0x20
+
+// MD1_CFG routes, the basic interrupts follow their ALL_INT_SRC flags
+#define SIM_MD1_SHUB 0x01
+#define SIM_MD1_EMB_FUNC 0x02
+#define SIM_MD1_ALL_INT_MASK 0xFC
+
+// Rate the accelerometer drops to in the inactive state, and the inact_en values that also stop the gyroscope
+#define SIM_XL_ODR_12HZ5 1
+#define SIM_INACT_GY_SLEEP 2
+
+// FIFO word tags
+#define SIM_TAG_TIMESTAMP 0x04
+#define SIM_TAG_SENSORHUB_SLAVE0 0x0E
+#define SIM_TAG_STEP_COUNTER 0x12
+
+// FIFO compression, EMB_FUNC_EN_B and EMB_FUNC_INIT_B are in the embedded functions bank
+#define SIM_EMB_FUNC_EN_B 0x05
+#define SIM_EMB_FUNC_INIT_B 0x67
+#define SIM_FIFO_COMPR_EN 0x08
+#define SIM_FIFO_COMPR_INIT 0x08
+#define SIM_FIFO_COMPR_RT_EN 0x40
+
+// Pedometer, EMB_FUNC_EN_A, EMB_FUNC_FIFO_CFG, STEP_COUNTER and EMB_FUNC_SRC are in the embedded functions bank
+#define SIM_EMB_FUNC_EN_A 0x04
+#define SIM_EMB_FUNC_FIFO_CFG 0x44
+#define SIM_STEP_COUNTER_L 0x62
+#define SIM_STEP_COUNTER_H 0x63
+#define SIM_EMB_FUNC_SRC 0x64
+#define SIM_PEDO_EN 0x08
+#define SIM_PEDO_FIFO_EN 0x40
+#define SIM_PEDO_RST_STEP 0x80
+
+// Finite state machines, FSM_STATUS_A/B_MAINPAGE are in the user bank, the rest in the embedded
+// functions bank.  Programs are written to the advanced pages through PAGE_SEL, PAGE_ADDRESS and
+// PAGE_VALUE, PAGE_RW selects reading or writing.
+#define SIM_FSM_STATUS_A_MAINPAGE 0x36
+#define SIM_FSM_STATUS_B_MAINPAGE 0x37
+#define SIM_PAGE_SEL 0x02
+#define SIM_PAGE_ADDRESS 0x08
+#define SIM_PAGE_VALUE 0x09
+#define SIM_FSM_STATUS_A 0x13
+#define SIM_FSM_STATUS_B 0x14
+#define SIM_PAGE_RW 0x17
+#define SIM_FSM_ENABLE_A 0x46
+#define SIM_FSM_ENABLE_B 0x47
+#define SIM_FSM_OUTS1 0x4C
+#define SIM_FSM_EN 0x01
+#define SIM_FSM_INIT 0x01
+#define SIM_PAGE_READ 0x20
+#define SIM_PAGE_WRITE 0x40
+#define SIM_PAGE_MEMORY_SIZE 0x800
+
+// Tilt, EMB_FUNC_STATUS_MAINPAGE is in the user bank and EMB_FUNC_STATUS in the embedded functions bank
+#define SIM_EMB_FUNC_STATUS_MAINPAGE 0x35
+#define SIM_EMB_FUNC_STATUS 0x12
+#define SIM_TILT_EN 0x10
+#define SIM_IS_TILT 0x10
+
+// FIFO_CTRL4 fifo_mode values
+#define SIM_FIFO_MODE_BYPASS 0
+#define SIM_FIFO_MODE_FIFO 1
+
+// Register banks selected by FUNC_CFG_ACCESS reg_access
+#define SIM_BANK_USER 0
+#define SIM_BANK_SENSOR_HUB 1
+#define SIM_BANK_EMBEDDED 2
+
+// LPS22HH registers
+#define SIM_LPS22HH_ADDRESS 0x5C
+#define SIM_LPS22HH_WHO_AM_I 0x0F
+#define SIM_LPS22HH_CTRL_REG1 0x10
+#define SIM_LPS22HH_CTRL_REG2 0x11
+#define SIM_LPS22HH_STATUS 0x27
+#define SIM_LPS22HH_PRESS_OUT_XL 0x28
+#define SIM_LPS22HH_PRESS_OUT_H 0x2A
+#define SIM_LPS22HH_TEMP_OUT_L 0x2B
+#define SIM_LPS22HH_TEMP_OUT_H 0x2C
+#define SIM_LPS22HH_ID 0xB3
+#define SIM_LPS22HH_SWRESET 0x04
+#define SIM_LPS22HH_CTRL_REG2_DEFAULT 0x10
+#define SIM_LPS22HH_P_DA 0x01
+#define SIM_LPS22HH_T_DA 0x02
+
+#define SIM_FIFO_WORD_LEN 7
+
+// Timestamp counter period
+#define SIM_TIMESTAMP_TICK_NS (25000.0 * (1.0 + I2C_SIM_TIMESTAMP_ERROR_PPM / 1e6))
+
+// Samples generated per call at most, a longer gap between transactions skips ahead
+#define SIM_MAX_CATCH_UP_SAMPLES (2 * I2C_SIM_FIFO_WORDS)
+
+typedef struct {
+	int odr;
+	double hz;
+	uint64_t periodNs;
+	uint64_t nextSampleNs;
+	uint32_t sampleIndex;
+	// When the sample in the output registers was produced
+	uint64_t outputNs;
+
+	// FIFO compression: samples waiting to be packed and the last sample written to the FIFO
+	int16_t pending[3][3];
+	int pendingCount;
+	int16_t reference[3];
+	bool referenceValid;
+	uint32_t sinceUncompressed;
+} sim_sensor_t;
+
+// FIFO tags used for a sensor's words
+typedef struct {
+	uint8_t nc;
+	uint8_t ncT2;
+	uint8_t compressed2x;
+	uint8_t compressed3x;
+} sim_fifo_tags_t;
+
+static const sim_fifo_tags_t accelTags = { 0x02, 0x06, 0x08, 0x09 };
+static const sim_fifo_tags_t gyroTags = { 0x01, 0x0A, 0x0C, 0x0D };
+
+static I2C_DeviceAddress simLsm6dsoAddress;
+static uint8_t userRegs[0x80];
+static uint8_t sensorHubRegs[0x80];
+static uint8_t embeddedRegs[0x80];
+static uint8_t pageMemory[SIM_PAGE_MEMORY_SIZE];
+static uint8_t lps22hhRegs[0x80];
+
+// Register address the next I2CMaster_Read starts at
+static uint8_t registerPointer;
+
+static sim_sensor_t accel;
+static sim_sensor_t gyro;
+static sim_sensor_t pressure;
+
+static uint8_t fifo[I2C_SIM_FIFO_WORDS][SIM_FIFO_WORD_LEN];
+// When each FIFO word was batched
+static uint64_t fifoTimeNs[I2C_SIM_FIFO_WORDS];
+static int fifoHead;
+static int fifoCount;
+static bool fifoOverrun;
+static uint8_t fifoTagCount;
+static uint32_t fifoTimeSlots;
+
+// The FIFO word being read out through FIFO_DATA_OUT_TAG..FIFO_DATA_OUT_Z_H
+static uint8_t fifoOutput[SIM_FIFO_WORD_LEN];
+
+// Timestamp counter start and the value latched when TIMESTAMP0 is read
+static uint64_t timestampStartNs;
+static uint8_t timestampLatch[4];
+
+static bool sensorHubWriteDone;
+static uint32_t sensorHubTriggers;
+
+// When the sample being produced is due, and when the model was last brought up to date
+static uint64_t sampleNs;
+static uint64_t updateNs;
+
+static bool int1Level;
+
+static const i2c_sim_trace_sample_t *simTrace;
+static size_t simTraceCount;
+
+// Noise generator state, a fixed seed keeps runs repeatable
+static uint32_t noiseState;
+
+static i2c_sim_stats_t simStats;
+
+/// <summary>
+///     Returns CLOCK_MONOTONIC in nanoseconds.
+/// </summary>
+static uint64_t NowNs(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/// <summary>
+///     Returns a few LSBs of noise, -2 to 2.
+/// </summary>
+static int Noise(void)
+{
+	noiseState = noiseState * 1664525U + 1013904223U;
+	return (int)((noiseState >> 24) % 5) - 2;
+}
+
+/// <summary>
+///     Rounds a value to an int16_t, saturating like the device output registers.
+/// </summary>
+static int16_t ToRaw(double value)
+{
+	if (value > 32767.0) {
+		return 32767;
+	}
+	if (value < -32768.0) {
+		return -32768;
+	}
+	return (int16_t)lround(value);
+}
+
+/// <summary>
+///     Stores a value in a little endian register pair.
+/// </summary>
+static void PutInt16(uint8_t *dest, int16_t value)
+{
+	dest[0] = (uint8_t)((uint16_t)value & 0xFF);
+	dest[1] = (uint8_t)((uint16_t)value >> 8);
+}
+
+/// <summary>
+///     Output data rate in Hz for the 4 bit ODR codes used by CTRL1_XL, CTRL2_G and the FIFO batch
+///     rates.  11 is the accelerometer 1.6 Hz low power rate.
+/// </summary>
+static double OdrHz(int odr)
+{
+	static const double hz[] = { 0.0, 12.5, 26.0, 52.0, 104.0, 208.0, 416.0, 833.0, 1660.0, 3330.0, 6660.0, 1.6 };
+	return (odr < (int)(sizeof(hz) / sizeof(hz[0]))) ? hz[odr] : 0.0;
+}
+
+/// <summary>
+///     LPS22HH output data rate in Hz for the CTRL_REG1 odr codes, 0 is power down.
+/// </summary>
+static double Lps22hhOdrHz(int odr)
+{
+	static const double hz[] = { 0.0, 1.0, 10.0, 25.0, 50.0, 75.0, 100.0, 200.0 };
+	return hz[odr & 0x07];
+}
+
+/// <summary>
+///     Accelerometer sensitivity in mg/LSB for the CTRL1_XL fs_xl setting.
+/// </summary>
+static double AccelSensitivity(void)
+{
+	static const double sensitivity[] = { 0.061, 0.488, 0.122, 0.244 };
+	return sensitivity[(userRegs[SIM_CTRL1_XL] >> 2) & 0x03];
+}
+
+/// <summary>
+///     Gyroscope sensitivity in mdps/LSB for the CTRL2_G fs_g and fs_125 settings.
+/// </summary>
+static double GyroSensitivity(void)
+{
+	static const double sensitivity[] = { 8.75, 17.5, 35.0, 70.0 };
+	uint8_t ctrl2 = userRegs[SIM_CTRL2_G];
+	if ((ctrl2 & 0x02) != 0) {
+		return 4.375;
+	}
+	return sensitivity[(ctrl2 >> 2) & 0x03];
+}
+
+/// <summary>
+///     Resets the LSM6DSO registers and FIFO to their power-on values.
+/// </summary>
+static void ResetLsm6dso(void)
+{
+	memset(userRegs, 0, sizeof(userRegs));
+	memset(sensorHubRegs, 0, sizeof(sensorHubRegs));
+	memset(embeddedRegs, 0, sizeof(embeddedRegs));
+	memset(pageMemory, 0, sizeof(pageMemory));
+
+	userRegs[SIM_WHO_AM_I] = SIM_LSM6DSO_ID;
+	userRegs[SIM_CTRL3_C] = SIM_CTRL3_C_IF_INC;
+	userRegs[SIM_CTRL9_XL] = 0xE0;
+
+	memset(&accel, 0, sizeof(accel));
+	memset(&gyro, 0, sizeof(gyro));
+
+	fifoHead = 0;
+	fifoCount = 0;
+	fifoOverrun = false;
+	fifoTagCount = 0;
+	fifoTimeSlots = 0;
+	memset(fifoOutput, 0, sizeof(fifoOutput));
+
+	timestampStartNs = 0;
+	int1Level = false;
+
+	sensorHubWriteDone = false;
+	sensorHubTriggers = 0;
+}
+
+/// <summary>
+///     Resets the LPS22HH registers to their power-on values.
+/// </summary>
+static void ResetLps22hh(void)
+{
+	memset(lps22hhRegs, 0, sizeof(lps22hhRegs));
+	lps22hhRegs[SIM_LPS22HH_WHO_AM_I] = SIM_LPS22HH_ID;
+	lps22hhRegs[SIM_LPS22HH_CTRL_REG2] = SIM_LPS22HH_CTRL_REG2_DEFAULT;
+	memset(&pressure, 0, sizeof(pressure));
+}
+
+/// <summary>
+///     Timestamp counter value at a CLOCK_MONOTONIC time.
+/// </summary>
+static uint32_t TimestampAt(uint64_t timeNs)
+{
+	if (((userRegs[SIM_CTRL10_C] & SIM_TIMESTAMP_EN) == 0) || (timeNs < timestampStartNs)) {
+		return 0;
+	}
+	return (uint32_t)(uint64_t)((double)(timeNs - timestampStartNs) / SIM_TIMESTAMP_TICK_NS);
+}
+
+/// <summary>
+///     Adds a word to the FIFO.  In FIFO mode batching stops when it's full, in the continuous
+///     modes the oldest word is overwritten.
+/// </summary>
+static void FifoPush(uint8_t tag, const uint8_t *data)
+{
+	int mode = userRegs[SIM_FIFO_CTRL4] & 0x07;
+
+	if (mode == SIM_FIFO_MODE_BYPASS) {
+		return;
+	}
+
+	if (fifoCount == I2C_SIM_FIFO_WORDS) {
+		fifoOverrun = true;
+		simStats.fifoOverruns++;
+		if (mode == SIM_FIFO_MODE_FIFO) {
+			return;
+		}
+		fifoHead = (fifoHead + 1) % I2C_SIM_FIFO_WORDS;
+		fifoCount--;
+	}
+
+	int index = (fifoHead + fifoCount) % I2C_SIM_FIFO_WORDS;
+	uint8_t *word = fifo[index];
+	fifoTimeNs[index] = sampleNs;
+	word[0] = (uint8_t)((tag << 3) | ((fifoTagCount & 0x03) << 1));
+	memcpy(&word[1], data, SIM_FIFO_WORD_LEN - 1);
+	fifoCount++;
+	simStats.fifoWords++;
+}
+
+/// <summary>
+///     Resets a sensor's FIFO compression state.
+/// </summary>
+static void ResetCompression(sim_sensor_t *sensor)
+{
+	sensor->pendingCount = 0;
+	sensor->referenceValid = false;
+	sensor->sinceUncompressed = 0;
+}
+
+/// <summary>
+///     True if every axis of each pending sample, up to count, differs from the sample before it
+///     by no more than the limit.
+/// </summary>
+static bool DiffsFit(const sim_sensor_t *sensor, int count, int limit)
+{
+	const int16_t *previous = sensor->reference;
+
+	for (int i = 0; i < count; i++) {
+		for (int axis = 0; axis < 3; axis++) {
+			int diff = sensor->pending[i][axis] - previous[axis];
+			if ((diff < -limit) || (diff > limit - 1)) {
+				return false;
+			}
+		}
+		previous = sensor->pending[i];
+	}
+
+	return true;
+}
+
+/// <summary>
+///     Drops the first count pending samples, the last one dropped becomes the reference.
+/// </summary>
+static void ConsumePending(sim_sensor_t *sensor, int count)
+{
+	memcpy(sensor->reference, sensor->pending[count - 1], sizeof(sensor->reference));
+	sensor->referenceValid = true;
+	sensor->pendingCount -= count;
+	memmove(sensor->pending[0], sensor->pending[count], (size_t)sensor->pendingCount * sizeof(sensor->pending[0]));
+}
+
+/// <summary>
+///     Batches a sample.  With compression on, samples are packed three at a time into 3xC words
+///     when every difference fits in 5 bits, two at a time into 2xC words when they fit in 8 bits,
+///     and written uncompressed otherwise or when FIFO_CTRL2 uncoptr_rate forces it.
+/// </summary>
+static void BatchSample(sim_sensor_t *sensor, const sim_fifo_tags_t *tags, const int16_t *raw)
+{
+	uint8_t data[6];
+	bool compression = ((embeddedRegs[SIM_EMB_FUNC_EN_B] & SIM_FIFO_COMPR_EN) != 0) &&
+		((userRegs[SIM_FIFO_CTRL2] & SIM_FIFO_COMPR_RT_EN) != 0);
+
+	if (!compression) {
+		for (int axis = 0; axis < 3; axis++) {
+			PutInt16(&data[2 * axis], raw[axis]);
+		}
+		FifoPush(tags->nc, data);
+		return;
+	}
+
+	memcpy(sensor->pending[sensor->pendingCount++], raw, sizeof(sensor->pending[0]));
+	if (sensor->pendingCount < 3) {
+		return;
+	}
+
+	int uncompressedRate = (userRegs[SIM_FIFO_CTRL2] >> 1) & 0x03;
+	uint32_t forceEvery = (uncompressedRate != 0) ? (4U << uncompressedRate) : 0;
+	bool forceUncompressed = (forceEvery != 0) && (sensor->sinceUncompressed >= forceEvery);
+
+	if (sensor->referenceValid && !forceUncompressed && DiffsFit(sensor, 3, 16)) {
+		for (int i = 0; i < 3; i++) {
+			uint16_t packed = 0;
+			const int16_t *previous = (i == 0) ? sensor->reference : sensor->pending[i - 1];
+			for (int axis = 0; axis < 3; axis++) {
+				packed |= (uint16_t)(((sensor->pending[i][axis] - previous[axis]) & 0x1F) << (5 * axis));
+			}
+			data[2 * i] = (uint8_t)(packed & 0xFF);
+			data[2 * i + 1] = (uint8_t)(packed >> 8);
+		}
+		FifoPush(tags->compressed3x, data);
+		ConsumePending(sensor, 3);
+		sensor->sinceUncompressed += 3;
+	}
+	else if (sensor->referenceValid && !forceUncompressed && DiffsFit(sensor, 2, 128)) {
+		for (int i = 0; i < 2; i++) {
+			const int16_t *previous = (i == 0) ? sensor->reference : sensor->pending[i - 1];
+			for (int axis = 0; axis < 3; axis++) {
+				data[3 * i + axis] = (uint8_t)(sensor->pending[i][axis] - previous[axis]);
+			}
+		}
+		FifoPush(tags->compressed2x, data);
+		ConsumePending(sensor, 2);
+		sensor->sinceUncompressed += 2;
+	}
+	else {
+		// The oldest pending sample is two samples behind the newest
+		for (int axis = 0; axis < 3; axis++) {
+			PutInt16(&data[2 * axis], sensor->pending[0][axis]);
+		}
+		FifoPush(tags->ncT2, data);
+		ConsumePending(sensor, 1);
+		sensor->sinceUncompressed = 0;
+	}
+}
+
+/// <summary>
+///     True if a sample with this index is batched at the FIFO batch rate bdr when the sensor
+///     runs at odr.
+/// </summary>
+static bool Batched(int bdr, int odr, uint32_t sampleIndex)
+{
+	if ((bdr == 0) || (bdr > odr) || (odr == 11)) {
+		return false;
+	}
+	return (sampleIndex % (1U << (odr - bdr))) == 0;
+}
+
+/// <summary>
+///     Produces the next LPS22HH sample.
+/// </summary>
+static void Lps22hhSample(void)
+{
+	double t = (double)pressure.sampleIndex / pressure.hz;
+	double hPa = I2C_SIM_PRESSURE_HPA + I2C_SIM_PRESSURE_AMPLITUDE_HPA * sin(2.0 * PI * 0.01 * t);
+	int32_t rawPressure = (int32_t)lround(hPa * 4096.0);
+	int16_t rawTemperature = ToRaw(I2C_SIM_LPS22HH_TEMPERATURE_DEGC * 100.0);
+
+	lps22hhRegs[SIM_LPS22HH_PRESS_OUT_XL] = (uint8_t)(rawPressure & 0xFF);
+	lps22hhRegs[SIM_LPS22HH_PRESS_OUT_XL + 1] = (uint8_t)((rawPressure >> 8) & 0xFF);
+	lps22hhRegs[SIM_LPS22HH_PRESS_OUT_H] = (uint8_t)((rawPressure >> 16) & 0xFF);
+	PutInt16(&lps22hhRegs[SIM_LPS22HH_TEMP_OUT_L], rawTemperature);
+	lps22hhRegs[SIM_LPS22HH_STATUS] |= SIM_LPS22HH_P_DA | SIM_LPS22HH_T_DA;
+
+	simStats.lps22hhSamples++;
+}
+
+/// <summary>
+///     Reads an LPS22HH register, reading the output registers clears the data-ready flags.
+/// </summary>
+static uint8_t Lps22hhRead(uint8_t reg)
+{
+	uint8_t value = lps22hhRegs[reg & 0x7F];
+
+	if (reg == SIM_LPS22HH_PRESS_OUT_H) {
+		lps22hhRegs[SIM_LPS22HH_STATUS] &= (uint8_t)~SIM_LPS22HH_P_DA;
+	}
+	else if (reg == SIM_LPS22HH_TEMP_OUT_H) {
+		lps22hhRegs[SIM_LPS22HH_STATUS] &= (uint8_t)~SIM_LPS22HH_T_DA;
+	}
+
+	return value;
+}
+
+/// <summary>
+///     Writes an LPS22HH register, a software reset restores the power-on values.
+/// </summary>
+static void Lps22hhWrite(uint8_t reg, uint8_t value)
+{
+	if ((reg == SIM_LPS22HH_CTRL_REG2) && ((value & SIM_LPS22HH_SWRESET) != 0)) {
+		ResetLps22hh();
+		return;
+	}
+
+	if ((reg == SIM_LPS22HH_WHO_AM_I) || (reg >= SIM_LPS22HH_STATUS)) {
+		// Read only
+		return;
+	}
+
+	lps22hhRegs[reg & 0x7F] = value;
+}
+
+/// <summary>
+///     Runs sensor hub slave 0, the master runs after each accelerometer sample and slave 0 at
+///     the slower of the accelerometer rate and the shub_odr rate.
+/// </summary>
+static void SensorHubTrigger(void)
+{
+	if ((sensorHubRegs[SIM_MASTER_CONFIG] & SIM_MASTER_ON) == 0) {
+		return;
+	}
+
+	// shub_odr 0 is 104 Hz and each step halves it, roughly
+	double shubHz = 104.0 / (double)(1 << (sensorHubRegs[SIM_SLV0_CONFIG] >> 6));
+	uint32_t divider = (uint32_t)(accel.hz / shubHz + 0.5);
+	if ((divider > 1) && ((sensorHubTriggers++ % divider) != 0)) {
+		return;
+	}
+
+	uint8_t slaveAddress = sensorHubRegs[SIM_SLV0_ADD] >> 1;
+	bool read = (sensorHubRegs[SIM_SLV0_ADD] & 0x01) != 0;
+	uint8_t subAddress = sensorHubRegs[SIM_SLV0_SUBADD];
+	int numop = sensorHubRegs[SIM_SLV0_CONFIG] & 0x07;
+
+	if (slaveAddress == SIM_LPS22HH_ADDRESS) {
+		if (read) {
+			for (int i = 0; i < numop; i++) {
+				sensorHubRegs[SIM_SENSOR_HUB_1 + i] = Lps22hhRead((uint8_t)(subAddress + i));
+			}
+			if ((sensorHubRegs[SIM_SLV0_CONFIG] & SIM_BATCH_EXT_SENS_0_EN) != 0) {
+				FifoPush(SIM_TAG_SENSORHUB_SLAVE0, &sensorHubRegs[SIM_SENSOR_HUB_1]);
+			}
+		}
+		else if (!sensorHubWriteDone) {
+			Lps22hhWrite(subAddress, sensorHubRegs[SIM_DATAWRITE_SLV0]);
+			sensorHubWriteDone = (sensorHubRegs[SIM_MASTER_CONFIG] & SIM_WRITE_ONCE) != 0;
+		}
+	}
+
+	sensorHubRegs[SIM_STATUS_MASTER] |= SIM_SENS_HUB_ENDOP;
+	userRegs[SIM_STATUS_MASTER_MAINPAGE] |= SIM_SENS_HUB_ENDOP;
+	simStats.sensorHubOperations++;
+}
+
+/// <summary>
+///     Produces the next accelerometer sample.
+/// </summary>
+static void AccelSample(void)
+{
+	int16_t raw[3];
+
+	// Each accelerometer sample batched, or each sample when the accelerometer isn't batched, starts
+	// a new FIFO time slot.  FIFO_CTRL4 odr_ts_batch batches the timestamp every 1, 8 or 32 slots.
+	static const uint32_t timestampDecimation[] = { 0, 1, 8, 32 };
+	uint32_t decimation = timestampDecimation[userRegs[SIM_FIFO_CTRL4] >> 6];
+	int batchRate = userRegs[SIM_FIFO_CTRL3] & 0x0F;
+	bool batched = Batched(batchRate, accel.odr, accel.sampleIndex);
+	if (batched || (batchRate == 0)) {
+		fifoTagCount++;
+		if ((decimation != 0) && ((userRegs[SIM_CTRL10_C] & SIM_TIMESTAMP_EN) != 0) &&
+			((fifoTimeSlots % decimation) == 0)) {
+			uint8_t timestamp[6] = { 0 };
+			uint32_t ticks = TimestampAt(accel.nextSampleNs);
+			memcpy(timestamp, &ticks, sizeof(ticks));
+			FifoPush(SIM_TAG_TIMESTAMP, timestamp);
+		}
+		fifoTimeSlots++;
+	}
+
+	if (simTrace != NULL) {
+		memcpy(raw, simTrace[accel.sampleIndex % simTraceCount].accel, sizeof(raw));
+	}
+	else {
+		double t = (double)accel.sampleIndex / accel.hz;
+		double phase = 2.0 * PI * I2C_SIM_MOTION_HZ * t;
+		double sensitivity = AccelSensitivity();
+		raw[0] = ToRaw(I2C_SIM_ACCEL_AMPLITUDE_MG * sin(phase) / sensitivity + Noise());
+		raw[1] = ToRaw(I2C_SIM_ACCEL_AMPLITUDE_MG * cos(phase) / sensitivity + Noise());
+		raw[2] = ToRaw(1000.0 / sensitivity + Noise());
+	}
+
+	// The user offsets are subtracted before the data reaches the output registers and the FIFO
+	if ((userRegs[SIM_CTRL7_G] & SIM_USR_OFF_ON_OUT) != 0) {
+		double weightMg = ((userRegs[SIM_CTRL6_C] & SIM_USR_OFF_W) != 0) ? 15.625 : 0.9765625;
+		for (int axis = 0; axis < 3; axis++) {
+			double offsetMg = (int8_t)userRegs[SIM_X_OFS_USR + axis] * weightMg;
+			raw[axis] = ToRaw((double)raw[axis] - offsetMg / AccelSensitivity());
+		}
+	}
+
+	uint8_t data[6];
+	for (int axis = 0; axis < 3; axis++) {
+		PutInt16(&data[2 * axis], raw[axis]);
+	}
+
+	memcpy(&userRegs[SIM_OUTX_L_A], data, sizeof(data));
+	accel.outputNs = sampleNs;
+	userRegs[SIM_STATUS_REG] |= SIM_STATUS_XLDA | SIM_STATUS_TDA;
+
+	// Temperature follows the accelerometer, 25 degC reads 0
+	PutInt16(&userRegs[SIM_OUT_TEMP_L], (int16_t)Noise());
+
+	if (batched) {
+		BatchSample(&accel, &accelTags, raw);
+	}
+
+	simStats.accelSamples++;
+
+	SensorHubTrigger();
+}
+
+/// <summary>
+///     Produces the next gyroscope sample.
+/// </summary>
+static void GyroSample(void)
+{
+	int16_t raw[3];
+
+	if (simTrace != NULL) {
+		memcpy(raw, simTrace[gyro.sampleIndex % simTraceCount].gyro, sizeof(raw));
+	}
+	else {
+		double t = (double)gyro.sampleIndex / gyro.hz;
+		double mdps = I2C_SIM_GYRO_AMPLITUDE_DPS * 1000.0 * cos(2.0 * PI * I2C_SIM_MOTION_HZ * t);
+		double sensitivity = GyroSensitivity();
+		raw[0] = ToRaw(mdps / sensitivity + Noise());
+		raw[1] = ToRaw(-mdps / sensitivity + Noise());
+		raw[2] = ToRaw(Noise());
+	}
+
+	uint8_t data[6];
+	for (int axis = 0; axis < 3; axis++) {
+		PutInt16(&data[2 * axis], raw[axis]);
+	}
+
+	memcpy(&userRegs[SIM_OUTX_L_G], data, sizeof(data));
+	gyro.outputNs = sampleNs;
+	userRegs[SIM_STATUS_REG] |= SIM_STATUS_GDA;
+
+	if (Batched(userRegs[SIM_FIFO_CTRL3] >> 4, gyro.odr, gyro.sampleIndex)) {
+		BatchSample(&gyro, &gyroTags, raw);
+	}
+
+	simStats.gyroSamples++;
+}
+
+/// <summary>
+///     Applies a new output data rate.  Sampling starts on a grid shared by every sensor, so
+///     sensors running at the same rate sample together and share FIFO time slots.
+/// </summary>
+static void SetSensorRate(sim_sensor_t *sensor, int odr, double hz, uint64_t now)
+{
+	if (odr == sensor->odr) {
+		return;
+	}
+
+	sensor->odr = odr;
+	sensor->hz = hz;
+	if (hz > 0.0) {
+		sensor->periodNs = (uint64_t)(1e9 / hz);
+		sensor->nextSampleNs = (now / sensor->periodNs + 1) * sensor->periodNs;
+	}
+}
+
+/// <summary>
+///     Applies the output data rates the registers select.  Called before a transaction, to
+///     produce the samples due up to now at the old rates, and after it, so a new rate starts
+///     when it is written rather than on the next transaction.
+/// </summary>
+static void UpdateRates(uint64_t now)
+{
+	int xlOdr = userRegs[SIM_CTRL1_XL] >> 4;
+	int gyOdr = userRegs[SIM_CTRL2_G] >> 4;
+
+	// Switching inactivity detection off wakes the device up, in the inactive state the
+	// accelerometer runs at 12.5 Hz and, depending on inact_en, the gyroscope is stopped
+	int inactEn = (userRegs[SIM_TAP_CFG2] & SIM_INACT_EN_MASK) >> SIM_INACT_EN_SHIFT;
+	if (inactEn == 0) {
+		userRegs[SIM_WAKE_UP_SRC] &= (uint8_t)~SIM_SLEEP_STATE;
+	}
+	if ((userRegs[SIM_WAKE_UP_SRC] & SIM_SLEEP_STATE) != 0) {
+		xlOdr = (xlOdr != 0) ? SIM_XL_ODR_12HZ5 : 0;
+		gyOdr = (inactEn >= SIM_INACT_GY_SLEEP) ? 0 : gyOdr;
+	}
+	int lpsOdr = (lps22hhRegs[SIM_LPS22HH_CTRL_REG1] >> 4) & 0x07;
+	SetSensorRate(&accel, xlOdr, OdrHz(xlOdr), now);
+	SetSensorRate(&gyro, gyOdr, OdrHz(gyOdr), now);
+	SetSensorRate(&pressure, lpsOdr, Lps22hhOdrHz(lpsOdr), now);
+}
+
+/// <summary>
+///     Brings the model up to date before a transaction.  Samples are produced in time order
+///     across the sensors, the accelerometer first when they're due together.
+/// </summary>
+static void Update(void)
+{
+	uint64_t now = NowNs();
+	updateNs = now;
+
+	UpdateRates(now);
+
+	sim_sensor_t *sensors[] = { &accel, &gyro, &pressure };
+	void (*sample[])(void) = { AccelSample, GyroSample, Lps22hhSample };
+
+	for (int samples = 0;; samples++) {
+
+		int due = -1;
+		for (int i = 0; i < 3; i++) {
+			if ((sensors[i]->hz > 0.0) && (sensors[i]->nextSampleNs <= now) &&
+				((due < 0) || (sensors[i]->nextSampleNs < sensors[due]->nextSampleNs))) {
+				due = i;
+			}
+		}
+
+		if (due < 0) {
+			break;
+		}
+
+		if (samples == SIM_MAX_CATCH_UP_SAMPLES) {
+			// Skip ahead rather than replay a long gap
+			for (int i = 0; i < 3; i++) {
+				if (sensors[i]->hz > 0.0) {
+					sensors[i]->nextSampleNs = (now / sensors[i]->periodNs + 1) * sensors[i]->periodNs;
+				}
+			}
+			break;
+		}
+
+		sampleNs = sensors[due]->nextSampleNs;
+		sample[due]();
+		sensors[due]->sampleIndex++;
+		sensors[due]->nextSampleNs += sensors[due]->periodNs;
+	}
+}
+
+/// <summary>
+///     Returns the register bank selected by FUNC_CFG_ACCESS.
+/// </summary>
+static uint8_t *Bank(void)
+{
+	switch (userRegs[SIM_FUNC_CFG_ACCESS] >> 6) {
+	case SIM_BANK_SENSOR_HUB:
+		return sensorHubRegs;
+	case SIM_BANK_EMBEDDED:
+		return embeddedRegs;
+	default:
+		return userRegs;
+	}
+}
+
+/// <summary>
+///     Reads or writes the advanced page byte at PAGE_SEL and PAGE_ADDRESS, if PAGE_RW allows it,
+///     and moves PAGE_ADDRESS on.  The address wraps within the page, the driver selects the next.
+/// </summary>
+/// <returns>The byte read, or 0</returns>
+static uint8_t PageAccess(uint8_t value, bool write)
+{
+	size_t address = (size_t)(((embeddedRegs[SIM_PAGE_SEL] >> 4) << 8) | embeddedRegs[SIM_PAGE_ADDRESS]);
+	uint8_t result = 0;
+
+	if (address < SIM_PAGE_MEMORY_SIZE) {
+		if (write && ((embeddedRegs[SIM_PAGE_RW] & SIM_PAGE_WRITE) != 0)) {
+			pageMemory[address] = value;
+		}
+		else if (!write && ((embeddedRegs[SIM_PAGE_RW] & SIM_PAGE_READ) != 0)) {
+			result = pageMemory[address];
+		}
+	}
+	embeddedRegs[SIM_PAGE_ADDRESS]++;
+	return result;
+}
+
+/// <summary>
+///     Adds the samples a FIFO word with this tag holds to count, if it is one of the sensor's tags.
+/// </summary>
+/// <returns>The number of samples added</returns>
+static uint32_t CountFifoSamples(uint8_t tag, const sim_fifo_tags_t *tags, uint32_t *count)
+{
+	uint32_t samples = 0;
+
+	if ((tag == tags->nc) || (tag == tags->ncT2)) {
+		samples = 1;
+	}
+	else if (tag == tags->compressed2x) {
+		samples = 2;
+	}
+	else if (tag == tags->compressed3x) {
+		samples = 3;
+	}
+
+	*count += samples;
+	return samples;
+}
+
+/// <summary>
+///     Adds the time from samples being produced at producedNs to them being read to the statistics.
+/// </summary>
+static void CountReadLatency(uint64_t producedNs, uint32_t samples)
+{
+	if (updateNs > producedNs) {
+		simStats.readLatencyNs += (updateNs - producedNs) * samples;
+	}
+}
+
+/// <summary>
+///     Returns the INT1 level: the data-ready flags, FIFO watermark, overrun and full conditions
+///     routed in INT1_CTRL and the events routed in MD1_CFG.  Data-ready and the events are latched
+///     until read, the FIFO conditions last until the FIFO is read below them.
+/// </summary>
+static bool Int1Level(void)
+{
+	uint8_t int1Ctrl = userRegs[SIM_INT1_CTRL];
+	uint8_t md1Cfg = userRegs[SIM_MD1_CFG];
+	uint8_t status = userRegs[SIM_STATUS_REG];
+	int watermark = userRegs[SIM_FIFO_CTRL1] | ((userRegs[SIM_FIFO_CTRL2] & 0x01) << 8);
+
+	bool level = ((int1Ctrl & SIM_INT1_DRDY_XL) != 0) && ((status & SIM_STATUS_XLDA) != 0);
+	level = level || (((int1Ctrl & SIM_INT1_DRDY_G) != 0) && ((status & SIM_STATUS_GDA) != 0));
+	level = level || (((int1Ctrl & SIM_INT1_FIFO_TH) != 0) && (watermark > 0) && (fifoCount >= watermark));
+	level = level || (((int1Ctrl & SIM_INT1_FIFO_OVR) != 0) && fifoOverrun);
+	level = level || (((int1Ctrl & SIM_INT1_FIFO_FULL) != 0) && (fifoCount == I2C_SIM_FIFO_WORDS));
+
+	// The ALL_INT_SRC flags sit at the MD1_CFG positions of their routes, apart from sleep change
+	uint8_t allInt = userRegs[SIM_ALL_INT_SRC];
+	uint8_t basic = (uint8_t)(((allInt & SIM_ALL_INT_FF) << 4) | ((allInt & SIM_ALL_INT_WU) << 4) |
+		((allInt & SIM_ALL_INT_SINGLE_TAP) << 4) | (allInt & SIM_ALL_INT_DOUBLE_TAP) |
+		((allInt & SIM_ALL_INT_D6D) >> 2) | ((allInt & SIM_ALL_INT_SLEEP_CHANGE) << 2));
+	level = level || ((md1Cfg & basic & SIM_MD1_ALL_INT_MASK) != 0);
+
+	// The embedded functions and FSMs have their own INT1 routes behind int1_emb_func, the model
+	// treats them as routed
+	bool embedded = (userRegs[SIM_EMB_FUNC_STATUS_MAINPAGE] != 0) || (userRegs[SIM_FSM_STATUS_A_MAINPAGE] != 0) ||
+		(userRegs[SIM_FSM_STATUS_B_MAINPAGE] != 0);
+	level = level || (((md1Cfg & SIM_MD1_EMB_FUNC) != 0) && embedded);
+	level = level || (((md1Cfg & SIM_MD1_SHUB) != 0) && ((userRegs[SIM_STATUS_MASTER_MAINPAGE] & SIM_SENS_HUB_ENDOP) != 0));
+
+	return level;
+}
+
+/// <summary>
+///     Brings the INT1 level up to date, counting rising edges.
+/// </summary>
+static void UpdateInt1(void)
+{
+	bool level = Int1Level();
+	if (level && !int1Level) {
+		simStats.int1Edges++;
+	}
+	int1Level = level;
+}
+
+/// <summary>
+///     Reads an LSM6DSO register, with the side effects of the read.
+/// </summary>
+static uint8_t Lsm6dsoRead(uint8_t reg)
+{
+	reg &= 0x7F;
+
+	if (reg == SIM_FUNC_CFG_ACCESS) {
+		return userRegs[reg];
+	}
+
+	if (Bank() == sensorHubRegs) {
+		uint8_t value = sensorHubRegs[reg];
+		if (reg == SIM_STATUS_MASTER) {
+			sensorHubRegs[reg] &= (uint8_t)~SIM_SENS_HUB_ENDOP;
+		}
+		return value;
+	}
+
+	if (Bank() == embeddedRegs) {
+		if (reg == SIM_PAGE_VALUE) {
+			return PageAccess(0, false);
+		}
+		uint8_t value = embeddedRegs[reg];
+		if (reg == SIM_EMB_FUNC_STATUS) {
+			// Latched embedded function interrupts clear when either status copy is read
+			embeddedRegs[reg] = 0;
+			userRegs[SIM_EMB_FUNC_STATUS_MAINPAGE] = 0;
+		}
+		if ((reg == SIM_FSM_STATUS_A) || (reg == SIM_FSM_STATUS_B)) {
+			// Latched FSM interrupts clear when either status copy is read
+			embeddedRegs[reg] = 0;
+			userRegs[reg - SIM_FSM_STATUS_A + SIM_FSM_STATUS_A_MAINPAGE] = 0;
+		}
+		return value;
+	}
+
+	uint8_t *status = &userRegs[SIM_STATUS_REG];
+
+	switch (reg) {
+	case SIM_FIFO_STATUS1:
+		return (uint8_t)(fifoCount & 0xFF);
+
+	case SIM_FIFO_STATUS2: {
+		int watermark = userRegs[SIM_FIFO_CTRL1] | ((userRegs[SIM_FIFO_CTRL2] & 0x01) << 8);
+		uint8_t value = (uint8_t)((fifoCount >> 8) & 0x03);
+		if (fifoOverrun) {
+			value |= 0x48;  // over_run_latched and fifo_ovr_ia
+		}
+		if (fifoCount == I2C_SIM_FIFO_WORDS) {
+			value |= 0x20;  // fifo_full_ia
+		}
+		if ((watermark > 0) && (fifoCount >= watermark)) {
+			value |= 0x80;  // fifo_wtm_ia
+		}
+		fifoOverrun = false;
+		return value;
+	}
+
+	case SIM_FIFO_DATA_OUT_TAG:
+		// Latch the oldest word, the rest of the word is read from the latch
+		if (fifoCount > 0) {
+			memcpy(fifoOutput, fifo[fifoHead], SIM_FIFO_WORD_LEN);
+			uint32_t samples = CountFifoSamples(fifoOutput[0] >> 3, &accelTags, &simStats.accelSamplesRead);
+			samples += CountFifoSamples(fifoOutput[0] >> 3, &gyroTags, &simStats.gyroSamplesRead);
+			CountReadLatency(fifoTimeNs[fifoHead], samples);
+			fifoHead = (fifoHead + 1) % I2C_SIM_FIFO_WORDS;
+			fifoCount--;
+		}
+		else {
+			memset(fifoOutput, 0, sizeof(fifoOutput));
+		}
+		return fifoOutput[0];
+
+	case SIM_WAKE_UP_SRC: {
+		// The change flags stay latched until WAKE_UP_SRC is read, sleep_state follows the device
+		uint8_t value = userRegs[reg];
+		userRegs[reg] &= SIM_SLEEP_STATE;
+		userRegs[SIM_ALL_INT_SRC] &= (uint8_t)~(SIM_ALL_INT_FF | SIM_ALL_INT_WU | SIM_ALL_INT_SLEEP_CHANGE);
+		return value;
+	}
+
+	case SIM_TAP_SRC: {
+		// Taps stay latched until TAP_SRC is read
+		uint8_t value = userRegs[reg];
+		userRegs[reg] = 0;
+		userRegs[SIM_ALL_INT_SRC] &= (uint8_t)~(SIM_ALL_INT_SINGLE_TAP | SIM_ALL_INT_DOUBLE_TAP);
+		return value;
+	}
+
+	case SIM_OUT_TEMP_L + 1:
+		*status &= (uint8_t)~SIM_STATUS_TDA;
+		break;
+
+	case SIM_OUTX_L_G + 5:
+		if ((*status & SIM_STATUS_GDA) != 0) {
+			simStats.gyroSamplesRead++;
+			CountReadLatency(gyro.outputNs, 1);
+		}
+		*status &= (uint8_t)~SIM_STATUS_GDA;
+		break;
+
+	case SIM_OUTZ_H_A:
+		if ((*status & SIM_STATUS_XLDA) != 0) {
+			simStats.accelSamplesRead++;
+			CountReadLatency(accel.outputNs, 1);
+		}
+		*status &= (uint8_t)~SIM_STATUS_XLDA;
+		break;
+
+	case SIM_TIMESTAMP0: {
+		// Latch the counter so a burst read of the four bytes is consistent
+		uint32_t ticks = TimestampAt(NowNs());
+		memcpy(timestampLatch, &ticks, sizeof(ticks));
+		return timestampLatch[0];
+	}
+
+	case SIM_STATUS_MASTER_MAINPAGE: {
+		uint8_t value = userRegs[reg];
+		userRegs[reg] &= (uint8_t)~SIM_SENS_HUB_ENDOP;
+		return value;
+	}
+
+	case SIM_D6D_SRC: {
+		// The change flag stays latched until D6D_SRC is read, the position follows the device
+		uint8_t value = userRegs[reg];
+		userRegs[reg] &= SIM_D6D_POSITION_MASK;
+		userRegs[SIM_ALL_INT_SRC] &= (uint8_t)~SIM_ALL_INT_D6D;
+		return value;
+	}
+
+	case SIM_EMB_FUNC_STATUS_MAINPAGE: {
+		uint8_t value = userRegs[reg];
+		userRegs[reg] = 0;
+		embeddedRegs[SIM_EMB_FUNC_STATUS] = 0;
+		return value;
+	}
+
+	case SIM_FSM_STATUS_A_MAINPAGE:
+	case SIM_FSM_STATUS_B_MAINPAGE: {
+		uint8_t value = userRegs[reg];
+		userRegs[reg] = 0;
+		embeddedRegs[reg - SIM_FSM_STATUS_A_MAINPAGE + SIM_FSM_STATUS_A] = 0;
+		return value;
+	}
+
+	default:
+		break;
+	}
+
+	if ((reg > SIM_FIFO_DATA_OUT_TAG) && (reg <= SIM_FIFO_DATA_OUT_Z_H)) {
+		return fifoOutput[reg - SIM_FIFO_DATA_OUT_TAG];
+	}
+
+	if ((reg > SIM_TIMESTAMP0) && (reg <= SIM_TIMESTAMP3)) {
+		return timestampLatch[reg - SIM_TIMESTAMP0];
+	}
+
+	return userRegs[reg];
+}
+
+/// <summary>
+///     Writes an LSM6DSO register, with the side effects of the write.
+/// </summary>
+static void Lsm6dsoWrite(uint8_t reg, uint8_t value)
+{
+	reg &= 0x7F;
+
+	if (reg == SIM_FUNC_CFG_ACCESS) {
+		userRegs[reg] = value;
+		return;
+	}
+
+	if (Bank() == sensorHubRegs) {
+		if ((reg == SIM_MASTER_CONFIG) && ((value & SIM_MASTER_ON) != 0) &&
+			((sensorHubRegs[reg] & SIM_MASTER_ON) == 0)) {
+			// A new master session
+			sensorHubRegs[SIM_STATUS_MASTER] &= (uint8_t)~SIM_SENS_HUB_ENDOP;
+			userRegs[SIM_STATUS_MASTER_MAINPAGE] &= (uint8_t)~SIM_SENS_HUB_ENDOP;
+			sensorHubWriteDone = false;
+			sensorHubTriggers = 0;
+		}
+		if ((reg == SIM_SLV0_ADD) || (reg == SIM_SLV0_SUBADD) || (reg == SIM_DATAWRITE_SLV0)) {
+			sensorHubWriteDone = false;
+		}
+		if (reg != SIM_STATUS_MASTER) {
+			sensorHubRegs[reg] = value;
+		}
+		return;
+	}
+
+	if (Bank() == embeddedRegs) {
+		if ((reg == SIM_EMB_FUNC_INIT_B) && ((value & SIM_FIFO_COMPR_INIT) != 0)) {
+			// Restarts compression, the bit clears itself
+			ResetCompression(&accel);
+			ResetCompression(&gyro);
+			value &= (uint8_t)~SIM_FIFO_COMPR_INIT;
+		}
+		if ((reg == SIM_EMB_FUNC_INIT_B) && ((value & SIM_FSM_INIT) != 0)) {
+			// Resets the state machines, the bit clears itself
+			memset(&embeddedRegs[SIM_FSM_OUTS1], 0, 16);
+			value &= (uint8_t)~SIM_FSM_INIT;
+		}
+		if (reg == SIM_PAGE_VALUE) {
+			PageAccess(value, true);
+			return;
+		}
+		if ((reg == SIM_EMB_FUNC_SRC) && ((value & SIM_PEDO_RST_STEP) != 0)) {
+			// Clears the step counter, the bit clears itself
+			embeddedRegs[SIM_STEP_COUNTER_L] = 0;
+			embeddedRegs[SIM_STEP_COUNTER_H] = 0;
+			value &= (uint8_t)~SIM_PEDO_RST_STEP;
+		}
+		embeddedRegs[reg] = value;
+		return;
+	}
+
+	if ((reg == SIM_CTRL3_C) && ((value & (SIM_CTRL3_C_SW_RESET | SIM_CTRL3_C_BOOT)) != 0)) {
+		// Both bits clear themselves once the reset is done, which the model does immediately
+		ResetLsm6dso();
+		return;
+	}
+
+	if ((reg == SIM_FIFO_CTRL4) && ((value & 0x07) == SIM_FIFO_MODE_BYPASS)) {
+		fifoHead = 0;
+		fifoCount = 0;
+		fifoOverrun = false;
+		ResetCompression(&accel);
+		ResetCompression(&gyro);
+	}
+
+	if ((reg == SIM_CTRL10_C) && ((value & SIM_TIMESTAMP_EN) != 0) &&
+		((userRegs[reg] & SIM_TIMESTAMP_EN) == 0)) {
+		// The counter starts from 0 when enabled
+		timestampStartNs = NowNs();
+	}
+
+	switch (reg) {
+	case SIM_WHO_AM_I:
+	case SIM_ALL_INT_SRC:
+	case SIM_WAKE_UP_SRC:
+	case SIM_TAP_SRC:
+	case SIM_D6D_SRC:
+	case SIM_STATUS_REG:
+	case SIM_STATUS_MASTER_MAINPAGE:
+	case SIM_EMB_FUNC_STATUS_MAINPAGE:
+	case SIM_FSM_STATUS_A_MAINPAGE:
+	case SIM_FSM_STATUS_B_MAINPAGE:
+	case SIM_FIFO_STATUS1:
+	case SIM_FIFO_STATUS2:
+		// Read only
+		return;
+	default:
+		break;
+	}
+
+	if (((reg >= SIM_OUT_TEMP_L) && (reg <= SIM_OUTZ_H_A)) || ((reg >= SIM_TIMESTAMP0) && (reg <= SIM_TIMESTAMP3))) {
+		return;
+	}
+
+	userRegs[reg] = value;
+}
+
+/// <summary>
+///     Returns the register address after a byte of a multi-byte access.  Without if_inc the
+///     address stays put, reading past FIFO_DATA_OUT_Z_H wraps to the next FIFO word.
+/// </summary>
+static uint8_t NextRegister(uint8_t reg)
+{
+	if ((userRegs[SIM_CTRL3_C] & SIM_CTRL3_C_IF_INC) == 0) {
+		return reg;
+	}
+	if ((reg == SIM_FIFO_DATA_OUT_Z_H) && (Bank() == userRegs)) {
+		return SIM_FIFO_DATA_OUT_TAG;
+	}
+	return (uint8_t)((reg + 1) & 0x7F);
+}
+
+/// <summary>
+///     Resets the simulated devices to their power-on state.
+/// </summary>
+int i2cSimInit(I2C_DeviceAddress lsm6dsoAddress)
+{
+	simLsm6dsoAddress = lsm6dsoAddress;
+	registerPointer = 0;
+	noiseState = 1;
+	memset(&simStats, 0, sizeof(simStats));
+
+	ResetLsm6dso();
+	ResetLps22hh();
+
+	Log_Debug("I2C simulator: LSM6DSO at 0x%02X, LPS22HH on the sensor hub\n", lsm6dsoAddress);
+	return 0;
+}
+
+/// <summary>
+///     Replays recorded samples instead of the simulated motion.
+/// </summary>
+void i2cSimSetTrace(const i2c_sim_trace_sample_t *trace, size_t count)
+{
+	if ((trace == NULL) || (count == 0)) {
+		simTrace = NULL;
+		simTraceCount = 0;
+		return;
+	}
+
+	simTrace = trace;
+	simTraceCount = count;
+}
+
+/// <summary>
+///     Flags a tap in TAP_SRC and ALL_INT_SRC if the tap engine is set up for it.
+/// </summary>
+void i2cSimTap(int axis, bool negative, bool doubleTap)
+{
+	// TAP_CFG0 tap_x/y/z_en and TAP_SRC x/y/z_tap
+	static const uint8_t axisEnable[3] = { 0x08, 0x04, 0x02 };
+	static const uint8_t axisFlag[3] = { 0x04, 0x02, 0x01 };
+
+	if ((axis < 0) || (axis > 2) || ((userRegs[SIM_TAP_CFG2] & SIM_INTERRUPTS_ENABLE) == 0) ||
+		((userRegs[SIM_TAP_CFG0] & axisEnable[axis]) == 0)) {
+		return;
+	}
+
+	// Without double tap detection the second tap is another single tap
+	doubleTap = doubleTap && ((userRegs[SIM_WAKE_UP_THS] & SIM_SINGLE_DOUBLE_TAP) != 0);
+
+	userRegs[SIM_TAP_SRC] |= (uint8_t)(SIM_TAP_IA | axisFlag[axis] | (doubleTap ? SIM_TAP_DOUBLE : SIM_TAP_SINGLE));
+	if (negative) {
+		userRegs[SIM_TAP_SRC] |= SIM_TAP_SIGN;
+	}
+	else {
+		userRegs[SIM_TAP_SRC] &= (uint8_t)~SIM_TAP_SIGN;
+	}
+	userRegs[SIM_ALL_INT_SRC] |= doubleTap ? SIM_ALL_INT_DOUBLE_TAP : SIM_ALL_INT_SINGLE_TAP;
+	simStats.taps++;
+}
+
+/// <summary>
+///     Flags a wake-up on one axis in WAKE_UP_SRC and ALL_INT_SRC if the basic interrupts are enabled.
+/// </summary>
+void i2cSimShock(int axis)
+{
+	// WAKE_UP_SRC x/y/z_wu
+	static const uint8_t axisFlag[3] = { 0x04, 0x02, 0x01 };
+
+	if ((axis < 0) || (axis > 2) || ((userRegs[SIM_TAP_CFG2] & SIM_INTERRUPTS_ENABLE) == 0)) {
+		return;
+	}
+
+	userRegs[SIM_WAKE_UP_SRC] |= (uint8_t)(SIM_WU_IA | axisFlag[axis]);
+	userRegs[SIM_ALL_INT_SRC] |= SIM_ALL_INT_WU;
+	simStats.wakeUps++;
+}
+
+/// <summary>
+///     Flags a free fall in WAKE_UP_SRC and ALL_INT_SRC if the basic interrupts are enabled.
+/// </summary>
+void i2cSimFreeFall(void)
+{
+	if ((userRegs[SIM_TAP_CFG2] & SIM_INTERRUPTS_ENABLE) == 0) {
+		return;
+	}
+
+	userRegs[SIM_WAKE_UP_SRC] |= SIM_FF_IA;
+	userRegs[SIM_ALL_INT_SRC] |= SIM_ALL_INT_FF;
+	simStats.freeFalls++;
+}
+
+/// <summary>
+///     Moves the position in D6D_SRC to the face given and flags the change if the basic
+///     interrupts are enabled.  In 4D mode the Z faces aren't detected.
+/// </summary>
+void i2cSimOrientation(int axis, bool negative)
+{
+	if ((axis < 0) || (axis > 2) || ((axis == 2) && ((userRegs[SIM_TAP_THS_6D] & SIM_D4D_EN) != 0))) {
+		return;
+	}
+
+	// XL, XH, YL, YH, ZL, ZH
+	uint8_t position = (uint8_t)(1 << (2 * axis + (negative ? 0 : 1)));
+	if ((userRegs[SIM_D6D_SRC] & SIM_D6D_POSITION_MASK) == position) {
+		return;
+	}
+
+	userRegs[SIM_D6D_SRC] = (uint8_t)((userRegs[SIM_D6D_SRC] & SIM_D6D_IA) | position);
+	if ((userRegs[SIM_TAP_CFG2] & SIM_INTERRUPTS_ENABLE) != 0) {
+		userRegs[SIM_D6D_SRC] |= SIM_D6D_IA;
+		userRegs[SIM_ALL_INT_SRC] |= SIM_ALL_INT_D6D;
+		simStats.orientationChanges++;
+	}
+}
+
+/// <summary>
+///     Flags a tilt in EMB_FUNC_STATUS if tilt detection is enabled.
+/// </summary>
+void i2cSimTilt(void)
+{
+	if ((embeddedRegs[SIM_EMB_FUNC_EN_A] & SIM_TILT_EN) == 0) {
+		return;
+	}
+
+	embeddedRegs[SIM_EMB_FUNC_STATUS] |= SIM_IS_TILT;
+	userRegs[SIM_EMB_FUNC_STATUS_MAINPAGE] |= SIM_IS_TILT;
+	simStats.tilts++;
+}
+
+/// <summary>
+///     Flags a change to or from the inactive state if the activity engine is set up for it.
+/// </summary>
+void i2cSimActivity(bool moving)
+{
+	bool asleep = ((userRegs[SIM_WAKE_UP_SRC] & SIM_SLEEP_STATE) != 0);
+
+	if (((userRegs[SIM_TAP_CFG2] & SIM_INTERRUPTS_ENABLE) == 0) || ((userRegs[SIM_TAP_CFG2] & SIM_INACT_EN_MASK) == 0) ||
+		(moving != asleep)) {
+		return;
+	}
+
+	if (moving) {
+		userRegs[SIM_WAKE_UP_SRC] &= (uint8_t)~SIM_SLEEP_STATE;
+		userRegs[SIM_WAKE_UP_SRC] |= SIM_WU_IA | SIM_SLEEP_CHANGE_IA;
+		userRegs[SIM_ALL_INT_SRC] |= SIM_ALL_INT_WU | SIM_ALL_INT_SLEEP_CHANGE;
+	}
+	else {
+		userRegs[SIM_WAKE_UP_SRC] |= SIM_SLEEP_STATE | SIM_SLEEP_CHANGE_IA;
+		userRegs[SIM_ALL_INT_SRC] |= SIM_ALL_INT_SLEEP_CHANGE;
+	}
+	simStats.sleepChanges++;
+}
+
+/// <summary>
+///     Counts steps if the pedometer is enabled, batching a step word for each when EMB_FUNC_FIFO_CFG
+///     asks for it.
+/// </summary>
+void i2cSimSteps(int count)
+{
+	if ((embeddedRegs[SIM_EMB_FUNC_EN_A] & SIM_PEDO_EN) == 0) {
+		return;
+	}
+
+	for (int i = 0; i < count; i++) {
+		uint16_t steps = (uint16_t)(embeddedRegs[SIM_STEP_COUNTER_L] | (embeddedRegs[SIM_STEP_COUNTER_H] << 8));
+		steps++;
+		embeddedRegs[SIM_STEP_COUNTER_L] = (uint8_t)(steps & 0xFF);
+		embeddedRegs[SIM_STEP_COUNTER_H] = (uint8_t)(steps >> 8);
+		simStats.steps++;
+
+		if ((embeddedRegs[SIM_EMB_FUNC_FIFO_CFG] & SIM_PEDO_FIFO_EN) != 0) {
+			uint32_t ticks = TimestampAt(NowNs());
+			uint8_t data[6] = { (uint8_t)(steps & 0xFF), (uint8_t)(steps >> 8), (uint8_t)(ticks & 0xFF),
+				(uint8_t)((ticks >> 8) & 0xFF), (uint8_t)((ticks >> 16) & 0xFF), (uint8_t)(ticks >> 24) };
+			FifoPush(SIM_TAG_STEP_COUNTER, data);
+		}
+	}
+}
+
+/// <summary>
+///     Flags program in FSM_STATUS_A/B, with output in its FSM_OUTS register, if the FSMs and the
+///     program are enabled.
+/// </summary>
+void i2cSimFsm(int program, uint8_t output)
+{
+	if ((program < 1) || (program > 16) || ((embeddedRegs[SIM_EMB_FUNC_EN_B] & SIM_FSM_EN) == 0)) {
+		return;
+	}
+
+	int index = program - 1;
+	uint8_t bit = (uint8_t)(1 << (index % 8));
+	if ((embeddedRegs[SIM_FSM_ENABLE_A + index / 8] & bit) == 0) {
+		return;
+	}
+
+	embeddedRegs[SIM_FSM_OUTS1 + index] = output;
+	embeddedRegs[SIM_FSM_STATUS_A + index / 8] |= bit;
+	userRegs[SIM_FSM_STATUS_A_MAINPAGE + index / 8] |= bit;
+	simStats.fsmEvents++;
+}
+
+/// <summary>
+///     Stand-in for I2CMaster_Write, the first byte is the register address.
+/// </summary>
+ssize_t i2cSimWrite(I2C_DeviceAddress address, const uint8_t *data, size_t len)
+{
+	if (address != simLsm6dsoAddress) {
+		errno = ENXIO;
+		return -1;
+	}
+
+	Update();
+	simStats.transactions++;
+	simStats.bytesWritten += (uint32_t)len;
+
+	if (len > 0) {
+		uint8_t reg = data[0];
+		for (size_t i = 1; i < len; i++) {
+			Lsm6dsoWrite(reg, data[i]);
+			reg = NextRegister(reg);
+		}
+		registerPointer = reg;
+	}
+
+	UpdateRates(NowNs());
+	UpdateInt1();
+	return (ssize_t)len;
+}
+
+/// <summary>
+///     Stand-in for I2CMaster_Read, reads from the register the last transaction left the
+///     register address at.
+/// </summary>
+ssize_t i2cSimRead(I2C_DeviceAddress address, uint8_t *data, size_t len)
+{
+	if (address != simLsm6dsoAddress) {
+		errno = ENXIO;
+		return -1;
+	}
+
+	Update();
+	simStats.transactions++;
+	simStats.bytesRead += (uint32_t)len;
+
+	for (size_t i = 0; i < len; i++) {
+		data[i] = Lsm6dsoRead(registerPointer);
+		registerPointer = NextRegister(registerPointer);
+	}
+
+	UpdateInt1();
+	return (ssize_t)len;
+}
+
+/// <summary>
+///     Stand-in for I2CMaster_WriteThenRead, the write sets the register address and may write
+///     registers before the read.
+/// </summary>
+ssize_t i2cSimWriteThenRead(I2C_DeviceAddress address, const uint8_t *writeData, size_t writeLen,
+	uint8_t *readData, size_t readLen)
+{
+	if ((address != simLsm6dsoAddress) || (writeLen == 0)) {
+		errno = (writeLen == 0) ? EINVAL : ENXIO;
+		return -1;
+	}
+
+	Update();
+	simStats.transactions++;
+	simStats.bytesWritten += (uint32_t)writeLen;
+	simStats.bytesRead += (uint32_t)readLen;
+
+	uint8_t reg = writeData[0];
+	for (size_t i = 1; i < writeLen; i++) {
+		Lsm6dsoWrite(reg, writeData[i]);
+		reg = NextRegister(reg);
+	}
+
+	for (size_t i = 0; i < readLen; i++) {
+		readData[i] = Lsm6dsoRead(reg);
+		reg = NextRegister(reg);
+	}
+	registerPointer = reg;
+
+	UpdateRates(NowNs());
+	UpdateInt1();
+	return (ssize_t)(writeLen + readLen);
+}
+
+/// <summary>
+///     Brings the model up to date and returns the INT1 level.
+/// </summary>
+bool i2cSimInt1(void)
+{
+	Update();
+	UpdateInt1();
+	return int1Level;
+}
+
+/// <summary>
+///     Returns when the next sample is due, 0 if every sensor is off.
+/// </summary>
+uint64_t i2cSimNextSampleNs(void)
+{
+	const sim_sensor_t *sensors[] = { &accel, &gyro, &pressure };
+	uint64_t next = 0;
+
+	for (int i = 0; i < 3; i++) {
+		if ((sensors[i]->hz > 0.0) && ((next == 0) || (sensors[i]->nextSampleNs < next))) {
+			next = sensors[i]->nextSampleNs;
+		}
+	}
+
+	return next;
+}
+
+/// <summary>
+///     Returns the simulator statistics.
+/// </summary>
+const i2c_sim_stats_t *getI2cSimStats(void)
+{
+	return &simStats;
+}
@@ -0,0 +1,151 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+#include <applibs/i2c.h>
+
+// Number of 7 byte words the simulated FIFO holds
+#define I2C_SIM_FIFO_WORDS 512
+
+// Simulated motion when no trace is loaded: the accelerometer X/Y axes and the gyroscope
+// turn at I2C_SIM_MOTION_HZ with these amplitudes, Z reads 1 g
+#define I2C_SIM_MOTION_HZ 0.5
+#define I2C_SIM_ACCEL_AMPLITUDE_MG 200.0
+#define I2C_SIM_GYRO_AMPLITUDE_DPS 5.0
+
+// Error of the simulated LSM6DSO timestamp counter against CLOCK_MONOTONIC
+#define I2C_SIM_TIMESTAMP_ERROR_PPM 200.0
+
+// Simulated LPS22HH readings
+#define I2C_SIM_PRESSURE_HPA 1013.25
+#define I2C_SIM_PRESSURE_AMPLITUDE_HPA 0.5
+#define I2C_SIM_LPS22HH_TEMPERATURE_DEGC 22.0
+
+// One recorded sample, raw output register values
+typedef struct {
+	int16_t accel[3];
+	int16_t gyro[3];
+} i2c_sim_trace_sample_t;
+
+typedef struct {
+	uint32_t transactions;
+	uint32_t bytesWritten;
+	uint32_t bytesRead;
+	uint32_t accelSamples;
+	uint32_t gyroSamples;
+	// Samples read out, from the output registers while their data-ready flag was set or from the FIFO
+	uint32_t accelSamplesRead;
+	uint32_t gyroSamplesRead;
+	// Sum over the samples read of the time from the sample being produced to it being read
+	uint64_t readLatencyNs;
+	uint32_t fifoWords;
+	uint32_t fifoOverruns;
+	uint32_t sensorHubOperations;
+	uint32_t lps22hhSamples;
+	uint32_t taps;
+	uint32_t sleepChanges;
+	uint32_t wakeUps;
+	uint32_t freeFalls;
+	uint32_t steps;
+	uint32_t fsmEvents;
+	uint32_t orientationChanges;
+	uint32_t tilts;
+	// Rising edges of INT1
+	uint32_t int1Edges;
+} i2c_sim_stats_t;
+
+/// <summary>
+///     Resets the simulated LSM6DSO, and the LPS22HH behind its sensor hub, to their power-on
+///     state.  lsm6dsoAddress is the address the LSM6DSO answers on, any other address NAKs.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int i2cSimInit(I2C_DeviceAddress lsm6dsoAddress);
+
+/// <summary>
+///     Replays recorded samples, in a loop, instead of the simulated motion.  The trace must stay
+///     in memory while it is in use, pass NULL to go back to the simulated motion.
+/// </summary>
+void i2cSimSetTrace(const i2c_sim_trace_sample_t *trace, size_t count);
+
+/// <summary>
+///     Simulates a tap, or the second tap of a double tap, on axis 0, 1 or 2 (X, Y or Z).  The
+///     model doesn't detect taps in the samples, it flags this one in TAP_SRC if the tap engine is
+///     enabled for the axis.  The flags stay set until TAP_SRC is read.
+/// </summary>
+void i2cSimTap(int axis, bool negative, bool doubleTap);
+
+/// <summary>
+///     Simulates a shock on axis 0, 1 or 2 (X, Y or Z), or a free fall.  As with taps the model
+///     doesn't look at the samples, it flags the event in WAKE_UP_SRC until it is read if the
+///     basic interrupts are enabled.
+/// </summary>
+void i2cSimShock(int axis);
+void i2cSimFreeFall(void);
+
+/// <summary>
+///     Simulates the board being put down (moving false) or picked up again.  The model doesn't
+///     time the inactivity or compare samples against the wake-up threshold, it enters or leaves
+///     the inactive state right away if inactivity detection is enabled, and flags the change in
+///     WAKE_UP_SRC until it is read.
+/// </summary>
+void i2cSimActivity(bool moving);
+
+/// <summary>
+///     Simulates the board being turned so that axis 0, 1 or 2 (X, Y or Z) points up, or down when
+///     negative, or tilted.  As with taps the model doesn't look at the samples, it moves the
+///     position in D6D_SRC and flags the change until it is read if the basic interrupts are
+///     enabled, or flags the tilt in EMB_FUNC_STATUS until it is read if tilt detection is enabled.
+/// </summary>
+void i2cSimOrientation(int axis, bool negative);
+void i2cSimTilt(void);
+
+/// <summary>
+///     Simulates count steps.  The model doesn't look for steps in the samples, it advances
+///     STEP_COUNTER if the pedometer is enabled and batches a step word with the timestamp counter
+///     for each step if step batching is enabled.
+/// </summary>
+void i2cSimSteps(int count);
+
+/// <summary>
+///     Simulates program 1 to 16 of the finite state machines signalling, with output as its
+///     FSM_OUTS register.  The model doesn't run the programs loaded in the advanced pages, it
+///     flags the program in FSM_STATUS_A/B until they are read if the program is enabled.
+/// </summary>
+void i2cSimFsm(int program, uint8_t output);
+
+/// <summary>
+///     Brings the model up to date and returns the level of the LSM6DSO INT1 pin.  INT1 follows the
+///     data-ready flags, FIFO watermark, overrun and full conditions routed in INT1_CTRL and the
+///     events routed in MD1_CFG, latched until they are read.  Data-ready is always latched, the
+///     model doesn't pulse it.
+/// </summary>
+bool i2cSimInt1(void);
+
+/// <summary>
+///     Returns the CLOCK_MONOTONIC time in nanoseconds the next sample is due, or 0 if every sensor
+///     is off.  Between transactions INT1 can only rise then, or when an event is simulated.
+/// </summary>
+uint64_t i2cSimNextSampleNs(void);
+
+/// <summary>
+///     Stand-ins for I2CMaster_Write, I2CMaster_Read and I2CMaster_WriteThenRead that talk to the
+///     model.  A read without a write starts at the register the last transaction ended on.
+/// </summary>
+/// <returns>The number of bytes transferred, or -1 with errno set on failure</returns>
+ssize_t i2cSimWrite(I2C_DeviceAddress address, const uint8_t *data, size_t len);
+ssize_t i2cSimRead(I2C_DeviceAddress address, uint8_t *data, size_t len);
+ssize_t i2cSimWriteThenRead(I2C_DeviceAddress address, const uint8_t *writeData, size_t writeLen,
+	uint8_t *readData, size_t readLen);
+
+/// <summary>
+///     Returns the simulator statistics.
+/// </summary>
+const i2c_sim_stats_t *getI2cSimStats(void);
@@ -0,0 +1,302 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+
+#include "i2c_stats.h"
+
+// Statistics are updated from the I2C queue worker and read from the epoll loop
+static pthread_mutex_t statsMutex = PTHREAD_MUTEX_INITIALIZER;
+
+static i2c_device_stats_t deviceStats[I2C_STATS_MAX_DEVICES];
+static int deviceCount;
+static uint32_t untrackedTransactions;
+static struct timespec windowStart;
+static bool windowStarted = false;
+
+/// <summary>
+///     Returns the time between two CLOCK_MONOTONIC readings in nanoseconds.
+/// </summary>
+static uint64_t ElapsedNs(const struct timespec *start, const struct timespec *end)
+{
+	int64_t elapsed = ((int64_t)end->tv_sec - (int64_t)start->tv_sec) * 1000000000LL + (end->tv_nsec - start->tv_nsec);
+	return (elapsed > 0) ? (uint64_t)elapsed : 0;
+}
+
+/// <summary>
+///     Returns the histogram bucket for a transaction duration, floor(log2(microseconds)) with
+///     anything under 2 microseconds in bucket 0.
+/// </summary>
+static int LatencyBucket(uint64_t durationNs)
+{
+	uint32_t us = (uint32_t)(durationNs / 1000);
+	int bucket = 0;
+
+	while ((us > 1) && (bucket < I2C_STATS_LATENCY_BUCKETS - 1)) {
+		us >>= 1;
+		bucket++;
+	}
+
+	return bucket;
+}
+
+/// <summary>
+///     Returns the upper bound in microseconds of the bucket holding the requested percentile.
+/// </summary>
+static uint32_t LatencyPercentileUs(const i2c_device_stats_t *device, uint32_t percent)
+{
+	uint64_t target = ((uint64_t)device->transactions * percent + 99) / 100;
+	uint64_t seen = 0;
+
+	for (int i = 0; i < I2C_STATS_LATENCY_BUCKETS; i++) {
+		seen += device->latencyHistogram[i];
+		if ((seen >= target) && (seen > 0)) {
+			return 1U << (i + 1);
+		}
+	}
+
+	return 0;
+}
+
+/// <summary>
+///     Finds the entry for a device, adding it if there's room.  Must be called with the lock held.
+/// </summary>
+static i2c_device_stats_t *FindDevice(I2C_DeviceAddress address)
+{
+	for (int i = 0; i < deviceCount; i++) {
+		if (deviceStats[i].address == address) {
+			return &deviceStats[i];
+		}
+	}
+
+	if (deviceCount == I2C_STATS_MAX_DEVICES) {
+		return NULL;
+	}
+
+	i2c_device_stats_t *device = &deviceStats[deviceCount++];
+	device->address = address;
+	return device;
+}
+
+/// <summary>
+///     Records one register transaction.
+/// </summary>
+void i2cStatsRecord(I2C_DeviceAddress address, uint8_t reg, uint16_t len, bool isRead, int32_t status,
+	const struct timespec *start)
+{
+	struct timespec end;
+	clock_gettime(CLOCK_MONOTONIC, &end);
+	uint64_t durationNs = ElapsedNs(start, &end);
+
+	pthread_mutex_lock(&statsMutex);
+
+	if (!windowStarted) {
+		windowStart = *start;
+		windowStarted = true;
+	}
+
+	i2c_device_stats_t *device = FindDevice(address);
+	if (device == NULL) {
+		untrackedTransactions++;
+		pthread_mutex_unlock(&statsMutex);
+		return;
+	}
+
+	i2c_register_stats_t *regStats =
+		&device->registers[(reg < I2C_STATS_MAX_REGISTERS) ? reg : (I2C_STATS_MAX_REGISTERS - 1)];
+
+	device->transactions++;
+	device->busyNs += durationNs;
+	device->latencyHistogram[LatencyBucket(durationNs)]++;
+
+	if (isRead) {
+		regStats->reads++;
+	}
+	else {
+		regStats->writes++;
+	}
+
+	if (status == 0) {
+		// The register address byte is sent on every transaction
+		device->bytes += (uint32_t)len + 1;
+		regStats->bytes += (uint32_t)len + 1;
+	}
+	else {
+		device->errors++;
+		regStats->errors++;
+	}
+
+	pthread_mutex_unlock(&statsMutex);
+}
+
+/// <summary>
+///     Utilization over the current window.  Must be called with the lock held.
+/// </summary>
+static float Utilization(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	uint64_t windowNs = windowStarted ? ElapsedNs(&windowStart, &now) : 0;
+	if (windowNs == 0) {
+		return 0.0f;
+	}
+
+	uint64_t busyNs = 0;
+	for (int i = 0; i < deviceCount; i++) {
+		busyNs += deviceStats[i].busyNs;
+	}
+
+	return (float)((double)busyNs * 100.0 / (double)windowNs);
+}
+
+/// <summary>
+///     Returns the percentage of the time since the last i2cStatsReset spent in I2C transactions.
+/// </summary>
+float i2cStatsUtilization(void)
+{
+	pthread_mutex_lock(&statsMutex);
+	float utilization = Utilization();
+	pthread_mutex_unlock(&statsMutex);
+
+	return utilization;
+}
+
+/// <summary>
+///     Appends formatted text to the JSON buffer.
+/// </summary>
+/// <returns>false once the buffer is full</returns>
+static bool Append(char *buffer, size_t size, size_t *used, const char *format, ...)
+{
+	if (*used >= size) {
+		return false;
+	}
+
+	va_list args;
+	va_start(args, format);
+	int written = vsnprintf(&buffer[*used], size - *used, format, args);
+	va_end(args);
+
+	if ((written < 0) || ((size_t)written >= size - *used)) {
+		*used = size;
+		return false;
+	}
+
+	*used += (size_t)written;
+	return true;
+}
+
+/// <summary>
+///     Writes the statistics as a JSON object, for example
+///     {"util":1.25,"devices":[{"addr":106,"txn":120,"bytes":960,"err":0,"p50us":256,"p99us":1024,
+///     "hist":[0,0,...],"regs":[[30,24,0,48,0],...]}]}
+///     Each regs entry is [register, reads, writes, bytes, errors] for the busiest registers.
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int i2cStatsToJson(char *buffer, size_t size)
+{
+	size_t used = 0;
+	bool ok;
+
+	pthread_mutex_lock(&statsMutex);
+
+	ok = Append(buffer, size, &used, "{\"util\":%.2f,\"untracked\":%u,\"devices\":[", Utilization(), untrackedTransactions);
+
+	for (int d = 0; ok && (d < deviceCount); d++) {
+
+		const i2c_device_stats_t *device = &deviceStats[d];
+
+		ok = Append(buffer, size, &used, "%s{\"addr\":%u,\"txn\":%u,\"bytes\":%u,\"err\":%u,\"p50us\":%u,\"p99us\":%u,\"hist\":[",
+			(d > 0) ? "," : "", device->address, device->transactions, device->bytes, device->errors,
+			LatencyPercentileUs(device, 50), LatencyPercentileUs(device, 99));
+
+		for (int i = 0; ok && (i < I2C_STATS_LATENCY_BUCKETS); i++) {
+			ok = Append(buffer, size, &used, "%s%u", (i > 0) ? "," : "", device->latencyHistogram[i]);
+		}
+
+		ok = ok && Append(buffer, size, &used, "],\"regs\":[");
+
+		// List the busiest registers without sorting the table, each pass picks the busiest register
+		// that comes after the previous pick in (count descending, register ascending) order
+		uint32_t previousCount = UINT32_MAX;
+		int previousReg = -1;
+		for (int listed = 0; ok && (listed < I2C_STATS_JSON_MAX_REGISTERS); listed++) {
+
+			int busiest = -1;
+			uint32_t busiestCount = 0;
+			for (int r = 0; r < I2C_STATS_MAX_REGISTERS; r++) {
+				uint32_t count = device->registers[r].reads + device->registers[r].writes;
+				bool afterPrevious = (count < previousCount) || ((count == previousCount) && (r > previousReg));
+				if ((count == 0) || !afterPrevious) {
+					continue;
+				}
+				if ((busiest < 0) || (count > busiestCount)) {
+					busiest = r;
+					busiestCount = count;
+				}
+			}
+
+			if (busiest < 0) {
+				break;
+			}
+
+			const i2c_register_stats_t *reg = &device->registers[busiest];
+			ok = Append(buffer, size, &used, "%s[%d,%u,%u,%u,%u]", (listed > 0) ? "," : "", busiest,
+				reg->reads, reg->writes, reg->bytes, reg->errors);
+
+			previousCount = busiestCount;
+			previousReg = busiest;
+		}
+
+		ok = ok && Append(buffer, size, &used, "]}");
+	}
+
+	ok = ok && Append(buffer, size, &used, "]}");
+
+	pthread_mutex_unlock(&statsMutex);
+
+	return ok ? (int)used : -1;
+}
+
+/// <summary>
+///     Logs a summary of the statistics.
+/// </summary>
+void i2cStatsLog(void)
+{
+	pthread_mutex_lock(&statsMutex);
+
+	Log_Debug("I2C: bus utilization %.2f%%\n", Utilization());
+	for (int d = 0; d < deviceCount; d++) {
+		const i2c_device_stats_t *device = &deviceStats[d];
+		Log_Debug("I2C: device 0x%02X, %u transactions, %u bytes, %u errors, p50 < %u us, p99 < %u us\n",
+			device->address, device->transactions, device->bytes, device->errors,
+			LatencyPercentileUs(device, 50), LatencyPercentileUs(device, 99));
+	}
+
+	pthread_mutex_unlock(&statsMutex);
+}
+
+/// <summary>
+///     Clears the statistics and starts a new utilization window.
+/// </summary>
+void i2cStatsReset(void)
+{
+	pthread_mutex_lock(&statsMutex);
+
+	memset(deviceStats, 0, sizeof(deviceStats));
+	deviceCount = 0;
+	untrackedTransactions = 0;
+	clock_gettime(CLOCK_MONOTONIC, &windowStart);
+	windowStarted = true;
+
+	pthread_mutex_unlock(&statsMutex);
+}
@@ -0,0 +1,74 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <time.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+#include <applibs/i2c.h>
+
+// Number of I2C device addresses tracked, traffic to any other address is not recorded.  The
+// LPS22HH sits behind the LSM6DSO sensor hub, so its traffic is counted as LSM6DSO (0x6A) register
+// transactions and it never appears as a device of its own.
+#define I2C_STATS_MAX_DEVICES 4
+
+// Registers tracked per device, higher register addresses are counted in the last entry
+#define I2C_STATS_MAX_REGISTERS 0x80
+
+// Latency histogram buckets.  Bucket 0 counts transactions that took under 2 microseconds and
+// bucket n from 1 up counts [2^n, 2^(n+1)) microseconds, the last bucket also counts everything
+// slower.
+#define I2C_STATS_LATENCY_BUCKETS 16
+
+// Busiest registers listed per device in the JSON report
+#define I2C_STATS_JSON_MAX_REGISTERS 8
+
+typedef struct {
+	uint32_t reads;
+	uint32_t writes;
+	uint32_t bytes;
+	uint32_t errors;
+} i2c_register_stats_t;
+
+typedef struct {
+	I2C_DeviceAddress address;
+	uint32_t transactions;
+	uint32_t bytes;
+	uint32_t errors;
+	uint64_t busyNs;
+	uint32_t latencyHistogram[I2C_STATS_LATENCY_BUCKETS];
+	i2c_register_stats_t registers[I2C_STATS_MAX_REGISTERS];
+} i2c_device_stats_t;
+
+/// <summary>
+///     Records one register transaction.  start is the CLOCK_MONOTONIC time the transaction
+///     started, it's taken as having ended now.  Safe to call from the I2C queue worker.
+/// </summary>
+void i2cStatsRecord(I2C_DeviceAddress address, uint8_t reg, uint16_t len, bool isRead, int32_t status,
+	const struct timespec *start);
+
+/// <summary>
+///     Returns the percentage of the time since the last i2cStatsReset spent in I2C transactions.
+/// </summary>
+float i2cStatsUtilization(void);
+
+/// <summary>
+///     Writes the statistics as a JSON object.
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int i2cStatsToJson(char *buffer, size_t size);
+
+/// <summary>
+///     Logs a summary of the statistics.
+/// </summary>
+void i2cStatsLog(void);
+
+/// <summary>
+///     Clears the statistics and starts a new utilization window.
+/// </summary>
+void i2cStatsReset(void);
@@ -0,0 +1,126 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdbool.h>
+#include <string.h>
+#include <time.h>
+
+#include "imu_autorange.h"
+
+// Largest magnitude a raw output can have
+#define RAW_FULL_SCALE 32768
+
+/// <summary>
+///     Clears the controller and its statistics.
+/// </summary>
+void initAutorange(autorange_t *autorange, int upPercent, int downPercent, uint32_t downWindows)
+{
+	memset(autorange, 0, sizeof(*autorange));
+	autorange->upThreshold = RAW_FULL_SCALE * upPercent / 100;
+	autorange->downThreshold = RAW_FULL_SCALE * downPercent / 100;
+	autorange->downWindows = downWindows;
+}
+
+/// <summary>
+///     Looks at one raw 3-axis sample.
+/// </summary>
+void autorangeSample(autorange_t *autorange, const axis3bit16_t *sample)
+{
+	int32_t peak = 0;
+	bool saturated = false;
+
+	for (int axis = 0; axis < 3; axis++) {
+		int32_t value = sample->i16bit[axis];
+		if ((value == INT16_MAX) || (value == INT16_MIN)) {
+			saturated = true;
+		}
+		if (value < 0) {
+			value = -value;
+		}
+		if (value > peak) {
+			peak = value;
+		}
+	}
+
+	if (saturated) {
+		autorange->stats.saturatedSamples++;
+	}
+	if (peak >= autorange->upThreshold) {
+		autorange->nearRail = true;
+	}
+	if (peak > autorange->peak) {
+		autorange->peak = peak;
+	}
+	autorange->samples++;
+}
+
+/// <summary>
+///     Ends the window and decides on the range step.
+/// </summary>
+/// <returns>The range step to take</returns>
+autorange_step_t autorangeEndWindow(autorange_t *autorange, float lowerRatio, bool canGoUp)
+{
+	autorange_step_t step = AUTORANGE_HOLD;
+
+	// A window without samples, e.g. with the sensor off, says nothing about the range
+	if (autorange->samples > 0) {
+
+		// The peak as it would read on the next smaller range
+		bool quiet = (lowerRatio > 0.0f) && ((float)autorange->peak < (float)autorange->downThreshold * lowerRatio);
+
+		if (autorange->nearRail) {
+			autorange->quietWindows = 0;
+			if (canGoUp) {
+				step = AUTORANGE_UP;
+			}
+		}
+		else if (quiet) {
+			if (++autorange->quietWindows >= autorange->downWindows) {
+				step = AUTORANGE_DOWN;
+			}
+		}
+		else {
+			autorange->quietWindows = 0;
+		}
+	}
+
+	autorange->peak = 0;
+	autorange->samples = 0;
+	autorange->nearRail = false;
+
+	return step;
+}
+
+/// <summary>
+///     Records a range switch.
+/// </summary>
+void autorangeSwitched(autorange_t *autorange, autorange_step_t step)
+{
+	struct timespec now;
+
+	if (step == AUTORANGE_HOLD) {
+		return;
+	}
+
+	if (step == AUTORANGE_UP) {
+		autorange->stats.rangeUps++;
+	}
+	else {
+		autorange->stats.rangeDowns++;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	autorange->stats.lastSwitchNs = (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+	autorange->peak = 0;
+	autorange->samples = 0;
+	autorange->nearRail = false;
+	autorange->quietWindows = 0;
+}
+
+/// <summary>
+///     Returns the controller statistics.
+/// </summary>
+const autorange_stats_t *getAutorangeStats(const autorange_t *autorange)
+{
+	return &autorange->stats;
+}
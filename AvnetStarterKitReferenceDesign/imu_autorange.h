@@ -0,0 +1,70 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+
+typedef enum {
+	AUTORANGE_HOLD = 0,
+	AUTORANGE_UP,
+	AUTORANGE_DOWN
+} autorange_step_t;
+
+typedef struct {
+	// Samples with an axis at the end of the output range, the reading is clipped
+	uint32_t saturatedSamples;
+	uint32_t rangeUps;
+	uint32_t rangeDowns;
+	// CLOCK_MONOTONIC time of the last range switch in nanoseconds, 0 if there hasn't been one
+	uint64_t lastSwitchNs;
+} autorange_stats_t;
+
+/// <summary>
+///     Full scale controller for one sensor.  Samples are fed in as they are acquired and a
+///     decision is taken at the end of each window.  The range goes up as soon as a window has a
+///     sample within upPercent of the rails, and down once downWindows windows in a row would have
+///     stayed below downPercent of the next smaller range.  upPercent must be above downPercent
+///     so a switch down is never followed by a switch straight back up.
+/// </summary>
+typedef struct {
+	int32_t upThreshold;
+	int32_t downThreshold;
+	uint32_t downWindows;
+	// Current window
+	int32_t peak;
+	uint32_t samples;
+	bool nearRail;
+	uint32_t quietWindows;
+	autorange_stats_t stats;
+} autorange_t;
+
+/// <summary>
+///     Clears the controller and its statistics.
+/// </summary>
+void initAutorange(autorange_t *autorange, int upPercent, int downPercent, uint32_t downWindows);
+
+/// <summary>
+///     Looks at one raw 3-axis sample.
+/// </summary>
+void autorangeSample(autorange_t *autorange, const axis3bit16_t *sample);
+
+/// <summary>
+///     Ends the window.  lowerRatio is the next smaller full scale divided by the current one, or
+///     0 if this is the smallest, canGoUp is false for the largest full scale.  The caller applies
+///     the step and reports it with autorangeSwitched.
+/// </summary>
+/// <returns>The range step to take</returns>
+autorange_step_t autorangeEndWindow(autorange_t *autorange, float lowerRatio, bool canGoUp);
+
+/// <summary>
+///     Records a range switch, the next window starts from scratch.
+/// </summary>
+void autorangeSwitched(autorange_t *autorange, autorange_step_t step);
+
+/// <summary>
+///     Returns the controller statistics.
+/// </summary>
+const autorange_stats_t *getAutorangeStats(const autorange_t *autorange);
@@ -0,0 +1,185 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "imu_capture.h"
+
+/// <summary>
+///     Clears the capture and its statistics.
+/// </summary>
+void initImuCapture(imu_capture_t *capture)
+{
+	memset(capture, 0, sizeof(*capture));
+}
+
+/// <summary>
+///     Sets the samples kept before and after the trigger.
+/// </summary>
+void imuCaptureSetWindow(imu_capture_t *capture, size_t before, size_t after)
+{
+	if (after > IMU_CAPTURE_MAX_SAMPLES) {
+		after = IMU_CAPTURE_MAX_SAMPLES;
+	}
+	if (before > IMU_CAPTURE_MAX_SAMPLES - after) {
+		before = IMU_CAPTURE_MAX_SAMPLES - after;
+	}
+
+	if ((before == capture->before) && (after == capture->after)) {
+		return;
+	}
+
+	capture->before = before;
+	capture->after = after;
+	capture->head = 0;
+	capture->count = 0;
+	capture->event = NULL;
+	capture->ready = false;
+}
+
+/// <summary>
+///     Rounds a value in mg to the int16_t the ring holds.
+/// </summary>
+static int16_t CaptureValue(float mg)
+{
+	if (mg >= (float)INT16_MAX) {
+		return INT16_MAX;
+	}
+	if (mg <= (float)INT16_MIN) {
+		return INT16_MIN;
+	}
+	return (int16_t)lroundf(mg);
+}
+
+/// <summary>
+///     Adds count samples, one per index of x, y and z.
+/// </summary>
+void imuCaptureAdd(imu_capture_t *capture, const float *x, const float *y, const float *z, size_t count)
+{
+	size_t size = capture->before + capture->after;
+
+	for (size_t i = 0; (i < count) && !capture->ready && (size > 0); i++) {
+		capture->mg[capture->head][0] = CaptureValue(x[i]);
+		capture->mg[capture->head][1] = CaptureValue(y[i]);
+		capture->mg[capture->head][2] = CaptureValue(z[i]);
+		capture->head = (capture->head + 1) % size;
+		if (capture->count < size) {
+			capture->count++;
+		}
+
+		if (capture->event != NULL) {
+			capture->afterLeft--;
+			capture->ready = (capture->afterLeft == 0);
+		}
+	}
+}
+
+/// <summary>
+///     Starts a capture at the newest sample.
+/// </summary>
+/// <returns>true if the capture started, false if one is already in progress</returns>
+bool imuCaptureTrigger(imu_capture_t *capture, const char *event)
+{
+	if ((capture->event != NULL) || ((capture->before + capture->after) == 0)) {
+		capture->stats.missedTriggers++;
+		return false;
+	}
+
+	capture->event = event;
+	capture->triggerBefore = (capture->count < capture->before) ? capture->count : capture->before;
+	capture->afterLeft = capture->after;
+	capture->ready = (capture->after == 0);
+	capture->stats.triggers++;
+	return true;
+}
+
+/// <summary>
+///     Returns true once the window after the trigger is complete.
+/// </summary>
+bool imuCaptureReady(const imu_capture_t *capture)
+{
+	return capture->ready;
+}
+
+/// <summary>
+///     Appends one axis of the capture as a JSON array member.
+/// </summary>
+/// <returns>The new length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+static int AxisToJson(const imu_capture_t *capture, int axis, const char *name, char *json, size_t size, size_t used)
+{
+	size_t ringSize = capture->before + capture->after;
+	size_t samples = capture->triggerBefore + capture->after;
+	size_t index = (capture->head + ringSize - samples) % ringSize;
+
+	int written = snprintf(&json[used], size - used, ",\"%s\":[", name);
+	if ((written < 0) || ((size_t)written >= size - used)) {
+		return -1;
+	}
+	used += (size_t)written;
+
+	for (size_t i = 0; i < samples; i++) {
+		written = snprintf(&json[used], size - used, (i == 0) ? "%d" : ",%d", capture->mg[index][axis]);
+		if ((written < 0) || ((size_t)written >= size - used)) {
+			return -1;
+		}
+		used += (size_t)written;
+		index = (index + 1) % ringSize;
+	}
+
+	written = snprintf(&json[used], size - used, "]");
+	if ((written < 0) || ((size_t)written >= size - used)) {
+		return -1;
+	}
+	return (int)(used + (size_t)written);
+}
+
+/// <summary>
+///     Writes a ready capture as a JSON object.
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int imuCaptureToJson(const imu_capture_t *capture, float rateHz, char *json, size_t size)
+{
+	static const char *const axisNames[3] = { "aX", "aY", "aZ" };
+
+	if (!capture->ready) {
+		return -1;
+	}
+
+	int used = snprintf(json, size, "{\"capture\":\"%s\",\"rateHz\":%.1f,\"before\":%u", capture->event, rateHz,
+		(unsigned)capture->triggerBefore);
+	if ((used < 0) || ((size_t)used >= size)) {
+		return -1;
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		used = AxisToJson(capture, axis, axisNames[axis], json, size, (size_t)used);
+		if (used < 0) {
+			return -1;
+		}
+	}
+
+	int written = snprintf(&json[used], size - (size_t)used, "}");
+	if ((written < 0) || ((size_t)written >= size - (size_t)used)) {
+		return -1;
+	}
+	return used + written;
+}
+
+/// <summary>
+///     Waits for the next trigger.
+/// </summary>
+void imuCaptureRearm(imu_capture_t *capture)
+{
+	capture->event = NULL;
+	capture->ready = false;
+}
+
+/// <summary>
+///     Returns the capture statistics.
+/// </summary>
+const imu_capture_stats_t *getImuCaptureStats(const imu_capture_t *capture)
+{
+	return &capture->stats;
+}
@@ -0,0 +1,88 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+// Samples the capture buffer holds, the windows before and after the trigger share them
+#define IMU_CAPTURE_MAX_SAMPLES 256
+
+typedef struct {
+	// Captures started
+	uint32_t triggers;
+	// Triggers that came while a capture was being completed or waited to be sent
+	uint32_t missedTriggers;
+} imu_capture_stats_t;
+
+/// <summary>
+///     Waveform capture around an event.  Accelerometer samples, in mg, are kept in a ring of the
+///     before + after most recent ones.  A trigger marks the newest sample and the capture is
+///     ready once after more samples have come in, it then holds up to before samples ahead of the
+///     trigger and after samples behind it.  Samples are ignored while a capture is ready, until
+///     imuCaptureRearm.  Everything is in this structure, nothing is allocated.
+/// </summary>
+typedef struct {
+	int16_t mg[IMU_CAPTURE_MAX_SAMPLES][3];
+	size_t before;
+	size_t after;
+	// Ring write position and the number of samples in the ring
+	size_t head;
+	size_t count;
+	// Set by the trigger: the event, the samples ahead of the trigger and the samples still to come
+	const char *event;
+	size_t triggerBefore;
+	size_t afterLeft;
+	bool ready;
+	imu_capture_stats_t stats;
+} imu_capture_t;
+
+/// <summary>
+///     Clears the capture and its statistics.  No samples are kept until imuCaptureSetWindow.
+/// </summary>
+void initImuCapture(imu_capture_t *capture);
+
+/// <summary>
+///     Sets the samples kept before and after the trigger.  after is limited to
+///     IMU_CAPTURE_MAX_SAMPLES and before to what is left, the applied values are in capture->before
+///     and capture->after.  A different window empties the ring and drops a capture in progress.
+/// </summary>
+void imuCaptureSetWindow(imu_capture_t *capture, size_t before, size_t after);
+
+/// <summary>
+///     Adds count samples, one per index of x, y and z.
+/// </summary>
+void imuCaptureAdd(imu_capture_t *capture, const float *x, const float *y, const float *z, size_t count);
+
+/// <summary>
+///     Starts a capture at the newest sample.  event must stay valid until the capture is sent,
+///     it is expected to be a string literal.
+/// </summary>
+/// <returns>true if the capture started, false if one is already in progress</returns>
+bool imuCaptureTrigger(imu_capture_t *capture, const char *event);
+
+/// <summary>
+///     Returns true once the window after the trigger is complete.
+/// </summary>
+bool imuCaptureReady(const imu_capture_t *capture);
+
+/// <summary>
+///     Writes a ready capture as a JSON object, for example
+///     {"capture":"freefall","rateHz":104.0,"before":2,"aX":[1,2,3],"aY":[4,5,6],"aZ":[998,1002,40]},
+///     oldest sample first.  before is the number of samples ahead of the trigger.
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int imuCaptureToJson(const imu_capture_t *capture, float rateHz, char *json, size_t size);
+
+/// <summary>
+///     Waits for the next trigger.  The ring keeps its samples, they are the start of the next
+///     window before.
+/// </summary>
+void imuCaptureRearm(imu_capture_t *capture);
+
+/// <summary>
+///     Returns the capture statistics.
+/// </summary>
+const imu_capture_stats_t *getImuCaptureStats(const imu_capture_t *capture);
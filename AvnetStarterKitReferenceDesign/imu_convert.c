@@ -0,0 +1,148 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdint.h>
+
+#ifdef __ARM_NEON
+#include <arm_neon.h>
+#endif
+
+#include "imu_convert.h"
+
+/// <summary>
+///     Saturates a 32 bit value to 16 bits.
+/// </summary>
+static int16_t Saturate16(int32_t value)
+{
+	if (value > INT16_MAX) {
+		return INT16_MAX;
+	}
+	if (value < INT16_MIN) {
+		return INT16_MIN;
+	}
+	return (int16_t)value;
+}
+
+/// <summary>
+///     Saturates a 64 bit value to 32 bits.
+/// </summary>
+static int32_t Saturate32(int64_t value)
+{
+	if (value > INT32_MAX) {
+		return INT32_MAX;
+	}
+	if (value < INT32_MIN) {
+		return INT32_MIN;
+	}
+	return (int32_t)value;
+}
+
+/// <summary>
+///     x[i] = raw.x * scale - offset[0], and likewise for y and z.
+/// </summary>
+void imuConvertFloat(const axis3bit16_t *samples, size_t count, float scale, const float offset[3],
+	float *restrict x, float *restrict y, float *restrict z)
+{
+	const int16_t *raw = samples[0].i16bit;
+	size_t i = 0;
+
+#ifdef __ARM_NEON
+	// vld3q_s16 loads eight samples and splits the axes
+	const float32x4_t vScale = vdupq_n_f32(scale);
+	const float32x4_t vOffset[3] = { vdupq_n_f32(offset[0]), vdupq_n_f32(offset[1]), vdupq_n_f32(offset[2]) };
+	float *out[3] = { x, y, z };
+
+	for (; i + 8 <= count; i += 8) {
+		int16x8x3_t axes = vld3q_s16(&raw[i * 3]);
+		for (int axis = 0; axis < 3; axis++) {
+			float32x4_t low = vcvtq_f32_s32(vmovl_s16(vget_low_s16(axes.val[axis])));
+			float32x4_t high = vcvtq_f32_s32(vmovl_s16(vget_high_s16(axes.val[axis])));
+			vst1q_f32(&out[axis][i], vsubq_f32(vmulq_f32(low, vScale), vOffset[axis]));
+			vst1q_f32(&out[axis][i + 4], vsubq_f32(vmulq_f32(high, vScale), vOffset[axis]));
+		}
+	}
+#endif
+
+	for (; i < count; i++) {
+		x[i] = (float)raw[i * 3] * scale - offset[0];
+		y[i] = (float)raw[i * 3 + 1] * scale - offset[1];
+		z[i] = (float)raw[i * 3 + 2] * scale - offset[2];
+	}
+}
+
+/// <summary>
+///     Q15 fraction of the largest full scale.
+/// </summary>
+void imuConvertQ15(const axis3bit16_t *samples, size_t count, int rangeShift, const int16_t offset[3],
+	int16_t *restrict x, int16_t *restrict y, int16_t *restrict z)
+{
+	const int16_t *raw = samples[0].i16bit;
+	size_t i = 0;
+
+#ifdef __ARM_NEON
+	// A negative shift count shifts right
+	const int16x8_t vShift = vdupq_n_s16((int16_t)-rangeShift);
+	const int16x8_t vOffset[3] = { vdupq_n_s16(offset[0]), vdupq_n_s16(offset[1]), vdupq_n_s16(offset[2]) };
+	int16_t *out[3] = { x, y, z };
+
+	for (; i + 8 <= count; i += 8) {
+		int16x8x3_t axes = vld3q_s16(&raw[i * 3]);
+		for (int axis = 0; axis < 3; axis++) {
+			vst1q_s16(&out[axis][i], vqsubq_s16(vshlq_s16(axes.val[axis], vShift), vOffset[axis]));
+		}
+	}
+#endif
+
+	for (; i < count; i++) {
+		x[i] = Saturate16((raw[i * 3] >> rangeShift) - offset[0]);
+		y[i] = Saturate16((raw[i * 3 + 1] >> rangeShift) - offset[1]);
+		z[i] = Saturate16((raw[i * 3 + 2] >> rangeShift) - offset[2]);
+	}
+}
+
+/// <summary>
+///     Q31 fraction of the largest full scale.
+/// </summary>
+void imuConvertQ31(const axis3bit16_t *samples, size_t count, int rangeShift, const int32_t offset[3],
+	int32_t *restrict x, int32_t *restrict y, int32_t *restrict z)
+{
+	const int16_t *raw = samples[0].i16bit;
+	int shift = 16 - rangeShift;
+	size_t i = 0;
+
+#ifdef __ARM_NEON
+	const int32x4_t vShift = vdupq_n_s32(shift);
+	const int32x4_t vOffset[3] = { vdupq_n_s32(offset[0]), vdupq_n_s32(offset[1]), vdupq_n_s32(offset[2]) };
+	int32_t *out[3] = { x, y, z };
+
+	for (; i + 8 <= count; i += 8) {
+		int16x8x3_t axes = vld3q_s16(&raw[i * 3]);
+		for (int axis = 0; axis < 3; axis++) {
+			int32x4_t low = vshlq_s32(vmovl_s16(vget_low_s16(axes.val[axis])), vShift);
+			int32x4_t high = vshlq_s32(vmovl_s16(vget_high_s16(axes.val[axis])), vShift);
+			vst1q_s32(&out[axis][i], vqsubq_s32(low, vOffset[axis]));
+			vst1q_s32(&out[axis][i + 4], vqsubq_s32(high, vOffset[axis]));
+		}
+	}
+#endif
+
+	for (; i < count; i++) {
+		x[i] = Saturate32(((int64_t)raw[i * 3] << shift) - offset[0]);
+		y[i] = Saturate32(((int64_t)raw[i * 3 + 1] << shift) - offset[1]);
+		z[i] = Saturate32(((int64_t)raw[i * 3 + 2] << shift) - offset[2]);
+	}
+}
+
+/// <summary>
+///     Returns log2(maxFullScale / fullScale).
+/// </summary>
+int imuConvertRangeShift(int fullScale, int maxFullScale)
+{
+	int shift = 0;
+
+	while ((fullScale > 0) && ((fullScale << shift) < maxFullScale) && (shift < 15)) {
+		shift++;
+	}
+
+	return shift;
+}
@@ -0,0 +1,42 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+
+/// <summary>
+///     Batch raw to physical conversion.  Each function converts an array of raw 3-axis samples
+///     into one output array per axis, subtracting a per-axis calibration offset in the same pass.
+///     On ARM the loops use NEON, elsewhere they are written so the compiler can vectorize them.
+///
+///     The fixed-point outputs are fractions of the sensor's largest full scale, so values taken
+///     at different full scales can be compared and summed directly.  Every LSM6DSO full scale is
+///     the largest one divided by a power of two, which makes the conversion a shift.
+/// </summary>
+
+/// <summary>
+///     x[i] = raw.x * scale - offset[0], and likewise for y and z.
+/// </summary>
+void imuConvertFloat(const axis3bit16_t *samples, size_t count, float scale, const float offset[3],
+	float *x, float *y, float *z);
+
+/// <summary>
+///     Q15 fraction of the largest full scale, x[i] = (raw.x >> rangeShift) - offset[0], saturated.
+/// </summary>
+void imuConvertQ15(const axis3bit16_t *samples, size_t count, int rangeShift, const int16_t offset[3],
+	int16_t *x, int16_t *y, int16_t *z);
+
+/// <summary>
+///     Q31 fraction of the largest full scale, x[i] = (raw.x << (16 - rangeShift)) - offset[0], saturated.
+/// </summary>
+void imuConvertQ31(const axis3bit16_t *samples, size_t count, int rangeShift, const int32_t offset[3],
+	int32_t *x, int32_t *y, int32_t *z);
+
+/// <summary>
+///     Returns the rangeShift for fullScale, log2(maxFullScale / fullScale).
+/// </summary>
+int imuConvertRangeShift(int fullScale, int maxFullScale);
+
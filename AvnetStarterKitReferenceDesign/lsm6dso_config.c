@@ -0,0 +1,351 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdbool.h>
+#include <string.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+
+#include "lsm6dso_config.h"
+
+// CTRL3_C bits that start a reset/reboot, they are never written from the image
+#define CTRL3_C_RESET_BITS 0x81
+
+typedef struct {
+	uint8_t first;
+	uint8_t last;
+} config_range_t;
+
+// Writable register ranges held in the image.  WHO_AM_I (0x0F) sits between INT2_CTRL and
+// CTRL1_XL, so the two ranges can't be written in one burst.
+static const config_range_t configRanges[] = {
+	{LSM6DSO_FIFO_CTRL1, LSM6DSO_INT2_CTRL},
+	{LSM6DSO_CTRL1_XL, LSM6DSO_CTRL10_C},
+	{LSM6DSO_TAP_CFG0, LSM6DSO_MD2_CFG},
+	{LSM6DSO_I3C_BUS_AVB, LSM6DSO_I3C_BUS_AVB},
+	{LSM6DSO_X_OFS_USR, LSM6DSO_Z_OFS_USR},
+};
+
+#define CONFIG_RANGE_COUNT (sizeof(configRanges) / sizeof(configRanges[0]))
+
+// Output data rates shared by the accelerometer and gyroscope, slowest first.  The 6.5 Hz
+// accelerometer rate is left out, it is only available in low power mode.
+static const lsm6dso_rate_t rates[] = {
+	{0.0f, LSM6DSO_XL_ODR_OFF, LSM6DSO_GY_ODR_OFF, LSM6DSO_XL_NOT_BATCHED, LSM6DSO_GY_NOT_BATCHED},
+	{12.5f, LSM6DSO_XL_ODR_12Hz5, LSM6DSO_GY_ODR_12Hz5, LSM6DSO_XL_BATCHED_AT_12Hz5, LSM6DSO_GY_BATCHED_AT_12Hz5},
+	{26.0f, LSM6DSO_XL_ODR_26Hz, LSM6DSO_GY_ODR_26Hz, LSM6DSO_XL_BATCHED_AT_26Hz, LSM6DSO_GY_BATCHED_AT_26Hz},
+	{52.0f, LSM6DSO_XL_ODR_52Hz, LSM6DSO_GY_ODR_52Hz, LSM6DSO_XL_BATCHED_AT_52Hz, LSM6DSO_GY_BATCHED_AT_52Hz},
+	{104.0f, LSM6DSO_XL_ODR_104Hz, LSM6DSO_GY_ODR_104Hz, LSM6DSO_XL_BATCHED_AT_104Hz, LSM6DSO_GY_BATCHED_AT_104Hz},
+	{208.0f, LSM6DSO_XL_ODR_208Hz, LSM6DSO_GY_ODR_208Hz, LSM6DSO_XL_BATCHED_AT_208Hz, LSM6DSO_GY_BATCHED_AT_208Hz},
+	{417.0f, LSM6DSO_XL_ODR_417Hz, LSM6DSO_GY_ODR_417Hz, LSM6DSO_XL_BATCHED_AT_417Hz, LSM6DSO_GY_BATCHED_AT_417Hz},
+	{833.0f, LSM6DSO_XL_ODR_833Hz, LSM6DSO_GY_ODR_833Hz, LSM6DSO_XL_BATCHED_AT_833Hz, LSM6DSO_GY_BATCHED_AT_833Hz},
+	{1667.0f, LSM6DSO_XL_ODR_1667Hz, LSM6DSO_GY_ODR_1667Hz, LSM6DSO_XL_BATCHED_AT_1667Hz, LSM6DSO_GY_BATCHED_AT_1667Hz},
+	{3333.0f, LSM6DSO_XL_ODR_3333Hz, LSM6DSO_GY_ODR_3333Hz, LSM6DSO_XL_BATCHED_AT_3333Hz, LSM6DSO_GY_BATCHED_AT_3333Hz},
+	{6667.0f, LSM6DSO_XL_ODR_6667Hz, LSM6DSO_GY_ODR_6667Hz, LSM6DSO_XL_BATCHED_AT_6667Hz, LSM6DSO_GY_BATCHED_AT_6667Hz},
+};
+
+#define RATE_COUNT (sizeof(rates) / sizeof(rates[0]))
+
+// Full scales, smallest first, with the sensitivities from the datasheet
+static const lsm6dso_xl_range_t xlRanges[] = {
+	{2, LSM6DSO_2g, 0.061f},
+	{4, LSM6DSO_4g, 0.122f},
+	{8, LSM6DSO_8g, 0.244f},
+	{16, LSM6DSO_16g, 0.488f},
+};
+
+#define XL_RANGE_COUNT (sizeof(xlRanges) / sizeof(xlRanges[0]))
+
+static const lsm6dso_gy_range_t gyRanges[] = {
+	{125, LSM6DSO_125dps, 4.375f},
+	{250, LSM6DSO_250dps, 8.75f},
+	{500, LSM6DSO_500dps, 17.50f},
+	{1000, LSM6DSO_1000dps, 35.0f},
+	{2000, LSM6DSO_2000dps, 70.0f},
+};
+
+#define GY_RANGE_COUNT (sizeof(gyRanges) / sizeof(gyRanges[0]))
+
+/// <summary>
+///     Returns true if the register has to be written to bring the device in line with the image.
+/// </summary>
+static bool IsDirty(const lsm6dso_config_t *config, uint8_t reg)
+{
+	return !config->deviceKnown[reg] || (config->image[reg] != config->device[reg]);
+}
+
+/// <summary>
+///     Sets the image and the known device contents to the power-on defaults.
+/// </summary>
+void lsm6dsoConfigDefaults(lsm6dso_config_t *config)
+{
+	memset(config, 0, sizeof(*config));
+
+	// Everything in the configuration ranges resets to 0 apart from these two
+	lsm6dso_ctrl3_c_t *ctrl3 = (lsm6dso_ctrl3_c_t *)&config->image[LSM6DSO_CTRL3_C];
+	ctrl3->if_inc = PROPERTY_ENABLE;
+
+	lsm6dso_ctrl9_xl_t *ctrl9 = (lsm6dso_ctrl9_xl_t *)&config->image[LSM6DSO_CTRL9_XL];
+	ctrl9->den_x = PROPERTY_ENABLE;
+	ctrl9->den_y = PROPERTY_ENABLE;
+	ctrl9->den_z = PROPERTY_ENABLE;
+
+	for (size_t i = 0; i < CONFIG_RANGE_COUNT; i++) {
+		for (uint8_t reg = configRanges[i].first; reg <= configRanges[i].last; reg++) {
+			config->device[reg] = config->image[reg];
+			config->deviceKnown[reg] = true;
+		}
+	}
+}
+
+/// <summary>
+///     Reads the configuration ranges from the device into the image, one burst per range.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoConfigLoad(lsm6dso_ctx_t *ctx, lsm6dso_config_t *config)
+{
+	for (size_t i = 0; i < CONFIG_RANGE_COUNT; i++) {
+
+		uint8_t first = configRanges[i].first;
+		uint16_t len = (uint16_t)(configRanges[i].last - first + 1);
+
+		if (lsm6dso_read_reg(ctx, first, &config->device[first], len) != 0) {
+			Log_Debug("ERROR: Could not read LSM6DSO registers 0x%02X - 0x%02X\n", first, configRanges[i].last);
+			return -1;
+		}
+
+		memcpy(&config->image[first], &config->device[first], len);
+		memset(&config->deviceKnown[first], true, len);
+	}
+
+	return 0;
+}
+
+/// <summary>
+///     Writes every register whose image differs from the device.  Dirty registers are grouped
+///     into runs within each range, runs separated by no more than LSM6DSO_CONFIG_MERGE_GAP clean
+///     registers are joined, and each run is written with one auto-increment burst.
+/// </summary>
+/// <returns>The number of burst writes issued, or -1 on failure</returns>
+int lsm6dsoConfigFlush(lsm6dso_ctx_t *ctx, lsm6dso_config_t *config)
+{
+	// Bursts rely on the register address incrementing, keep it on and never trigger a reset
+	lsm6dso_ctrl3_c_t *ctrl3 = (lsm6dso_ctrl3_c_t *)&config->image[LSM6DSO_CTRL3_C];
+	ctrl3->if_inc = PROPERTY_ENABLE;
+	config->image[LSM6DSO_CTRL3_C] &= (uint8_t)~CTRL3_C_RESET_BITS;
+
+	int bursts = 0;
+
+	// The device may still have auto-increment off, in which case a burst would keep rewriting the
+	// first register.  Turn it on with a single register write before anything else.
+	lsm6dso_ctrl3_c_t *deviceCtrl3 = (lsm6dso_ctrl3_c_t *)&config->device[LSM6DSO_CTRL3_C];
+	if (!config->deviceKnown[LSM6DSO_CTRL3_C] || !deviceCtrl3->if_inc) {
+		if (lsm6dso_auto_increment_set(ctx, PROPERTY_ENABLE) != 0) {
+			return -1;
+		}
+		bursts++;
+	}
+
+	for (size_t i = 0; i < CONFIG_RANGE_COUNT; i++) {
+
+		int reg = configRanges[i].first;
+		int last = configRanges[i].last;
+
+		while (reg <= last) {
+
+			if (!IsDirty(config, (uint8_t)reg)) {
+				reg++;
+				continue;
+			}
+
+			// Extend the run while the next dirty register is close enough
+			int runEnd = reg;
+			for (int next = reg + 1; (next <= last) && (next - runEnd <= LSM6DSO_CONFIG_MERGE_GAP + 1); next++) {
+				if (IsDirty(config, (uint8_t)next)) {
+					runEnd = next;
+				}
+			}
+
+			uint16_t len = (uint16_t)(runEnd - reg + 1);
+			if (lsm6dso_write_reg(ctx, (uint8_t)reg, &config->image[reg], len) != 0) {
+				Log_Debug("ERROR: Could not write LSM6DSO registers 0x%02X - 0x%02X\n", reg, runEnd);
+				memset(&config->deviceKnown[reg], false, len);
+				return -1;
+			}
+			bursts++;
+
+			memcpy(&config->device[reg], &config->image[reg], len);
+			memset(&config->deviceKnown[reg], true, len);
+
+			reg = runEnd + 1;
+		}
+	}
+
+	return bursts;
+}
+
+/// <summary>
+///     Returns the image byte for reg.
+/// </summary>
+uint8_t *lsm6dsoConfigReg(lsm6dso_config_t *config, uint8_t reg)
+{
+	return &config->image[reg & (LSM6DSO_CONFIG_SIZE - 1)];
+}
+
+void lsm6dsoConfigXlDataRate(lsm6dso_config_t *config, lsm6dso_odr_xl_t val)
+{
+	lsm6dso_ctrl1_xl_t *reg = (lsm6dso_ctrl1_xl_t *)lsm6dsoConfigReg(config, LSM6DSO_CTRL1_XL);
+	reg->odr_xl = (uint8_t)val;
+}
+
+void lsm6dsoConfigGyDataRate(lsm6dso_config_t *config, lsm6dso_odr_g_t val)
+{
+	lsm6dso_ctrl2_g_t *reg = (lsm6dso_ctrl2_g_t *)lsm6dsoConfigReg(config, LSM6DSO_CTRL2_G);
+	reg->odr_g = (uint8_t)val;
+}
+
+void lsm6dsoConfigXlFullScale(lsm6dso_config_t *config, lsm6dso_fs_xl_t val)
+{
+	lsm6dso_ctrl1_xl_t *reg = (lsm6dso_ctrl1_xl_t *)lsm6dsoConfigReg(config, LSM6DSO_CTRL1_XL);
+	reg->fs_xl = (uint8_t)val;
+}
+
+void lsm6dsoConfigGyFullScale(lsm6dso_config_t *config, lsm6dso_fs_g_t val)
+{
+	lsm6dso_ctrl2_g_t *reg = (lsm6dso_ctrl2_g_t *)lsm6dsoConfigReg(config, LSM6DSO_CTRL2_G);
+	reg->fs_g = (uint8_t)val;
+}
+
+void lsm6dsoConfigBlockDataUpdate(lsm6dso_config_t *config, uint8_t val)
+{
+	lsm6dso_ctrl3_c_t *reg = (lsm6dso_ctrl3_c_t *)lsm6dsoConfigReg(config, LSM6DSO_CTRL3_C);
+	reg->bdu = val;
+}
+
+void lsm6dsoConfigXlHpPathOnOut(lsm6dso_config_t *config, lsm6dso_hp_slope_xl_en_t val)
+{
+	lsm6dso_ctrl8_xl_t *reg = (lsm6dso_ctrl8_xl_t *)lsm6dsoConfigReg(config, LSM6DSO_CTRL8_XL);
+	reg->hp_slope_xl_en = ((uint8_t)val & 0x10U) >> 4;
+	reg->hp_ref_mode_xl = ((uint8_t)val & 0x20U) >> 5;
+	reg->hpcf_xl = (uint8_t)val & 0x07U;
+}
+
+void lsm6dsoConfigXlFilterLp2(lsm6dso_config_t *config, uint8_t val)
+{
+	lsm6dso_ctrl1_xl_t *reg = (lsm6dso_ctrl1_xl_t *)lsm6dsoConfigReg(config, LSM6DSO_CTRL1_XL);
+	reg->lpf2_xl_en = val;
+}
+
+void lsm6dsoConfigI3cDisable(lsm6dso_config_t *config, lsm6dso_i3c_disable_t val)
+{
+	lsm6dso_ctrl9_xl_t *ctrl9 = (lsm6dso_ctrl9_xl_t *)lsm6dsoConfigReg(config, LSM6DSO_CTRL9_XL);
+	ctrl9->i3c_disable = ((uint8_t)val & 0x80U) >> 7;
+
+	lsm6dso_i3c_bus_avb_t *i3cBusAvb = (lsm6dso_i3c_bus_avb_t *)lsm6dsoConfigReg(config, LSM6DSO_I3C_BUS_AVB);
+	i3cBusAvb->i3c_bus_avb_sel = (uint8_t)val & 0x03U;
+}
+
+void lsm6dsoConfigFifoBatch(lsm6dso_config_t *config, lsm6dso_bdr_xl_t xlBatch, lsm6dso_bdr_gy_t gyBatch)
+{
+	lsm6dso_fifo_ctrl3_t *reg = (lsm6dso_fifo_ctrl3_t *)lsm6dsoConfigReg(config, LSM6DSO_FIFO_CTRL3);
+	reg->bdr_xl = (uint8_t)xlBatch;
+	reg->bdr_gy = (uint8_t)gyBatch;
+}
+
+void lsm6dsoConfigFifoMode(lsm6dso_config_t *config, lsm6dso_fifo_mode_t val)
+{
+	lsm6dso_fifo_ctrl4_t *reg = (lsm6dso_fifo_ctrl4_t *)lsm6dsoConfigReg(config, LSM6DSO_FIFO_CTRL4);
+	reg->fifo_mode = (uint8_t)val;
+}
+
+void lsm6dsoConfigXlOffsetWeight(lsm6dso_config_t *config, lsm6dso_usr_off_w_t val)
+{
+	lsm6dso_ctrl6_c_t *reg = (lsm6dso_ctrl6_c_t *)lsm6dsoConfigReg(config, LSM6DSO_CTRL6_C);
+	reg->usr_off_w = (uint8_t)val;
+}
+
+void lsm6dsoConfigXlUsrOffset(lsm6dso_config_t *config, uint8_t val)
+{
+	lsm6dso_ctrl7_g_t *reg = (lsm6dso_ctrl7_g_t *)lsm6dsoConfigReg(config, LSM6DSO_CTRL7_G);
+	reg->usr_off_on_out = val;
+}
+
+void lsm6dsoConfigXlUsrOffsetOnWkup(lsm6dso_config_t *config, uint8_t val)
+{
+	lsm6dso_wake_up_ths_t *reg = (lsm6dso_wake_up_ths_t *)lsm6dsoConfigReg(config, LSM6DSO_WAKE_UP_THS);
+	reg->usr_off_on_wu = val;
+}
+
+void lsm6dsoConfigXlUsrOffsetXyz(lsm6dso_config_t *config, const int8_t offset[3])
+{
+	*lsm6dsoConfigReg(config, LSM6DSO_X_OFS_USR) = (uint8_t)offset[0];
+	*lsm6dsoConfigReg(config, LSM6DSO_Y_OFS_USR) = (uint8_t)offset[1];
+	*lsm6dsoConfigReg(config, LSM6DSO_Z_OFS_USR) = (uint8_t)offset[2];
+}
+
+/// <summary>
+///     Returns the slowest output data rate of at least hz.
+/// </summary>
+const lsm6dso_rate_t *lsm6dsoConfigFindRate(float hz, bool allowOff)
+{
+	if (hz <= 0.0f) {
+		return allowOff ? &rates[0] : &rates[1];
+	}
+
+	for (size_t i = 1; i < RATE_COUNT; i++) {
+		if (rates[i].hz >= hz) {
+			return &rates[i];
+		}
+	}
+
+	return &rates[RATE_COUNT - 1];
+}
+
+/// <summary>
+///     Returns the smallest accelerometer full scale of at least fullScaleG.
+/// </summary>
+const lsm6dso_xl_range_t *lsm6dsoConfigFindXlRange(int fullScaleG)
+{
+	for (size_t i = 0; i < XL_RANGE_COUNT; i++) {
+		if (xlRanges[i].fullScaleG >= fullScaleG) {
+			return &xlRanges[i];
+		}
+	}
+
+	return &xlRanges[XL_RANGE_COUNT - 1];
+}
+
+/// <summary>
+///     Returns the smallest gyroscope full scale of at least fullScaleDps.
+/// </summary>
+const lsm6dso_gy_range_t *lsm6dsoConfigFindGyRange(int fullScaleDps)
+{
+	for (size_t i = 0; i < GY_RANGE_COUNT; i++) {
+		if (gyRanges[i].fullScaleDps >= fullScaleDps) {
+			return &gyRanges[i];
+		}
+	}
+
+	return &gyRanges[GY_RANGE_COUNT - 1];
+}
+
+/// <summary>
+///     Returns the accelerometer full scale step places away from fullScaleG.
+/// </summary>
+const lsm6dso_xl_range_t *lsm6dsoConfigStepXlRange(int fullScaleG, int step)
+{
+	int index = (int)(lsm6dsoConfigFindXlRange(fullScaleG) - xlRanges) + step;
+	return ((index >= 0) && (index < (int)XL_RANGE_COUNT)) ? &xlRanges[index] : NULL;
+}
+
+/// <summary>
+///     Returns the gyroscope full scale step places away from fullScaleDps.
+/// </summary>
+const lsm6dso_gy_range_t *lsm6dsoConfigStepGyRange(int fullScaleDps, int step)
+{
+	int index = (int)(lsm6dsoConfigFindGyRange(fullScaleDps) - gyRanges) + step;
+	return ((index >= 0) && (index < (int)GY_RANGE_COUNT)) ? &gyRanges[index] : NULL;
+}
@@ -0,0 +1,115 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+
+// The image is indexed by user bank register address
+#define LSM6DSO_CONFIG_SIZE 0x80
+
+// Unchanged registers between two dirty ones are rewritten rather than starting a new burst
+// if the gap is at most this many registers
+#define LSM6DSO_CONFIG_MERGE_GAP 2
+
+/// <summary>
+///     Configuration image of the LSM6DSO control registers.  The lsm6dsoConfig* functions
+///     only edit the image, lsm6dsoConfigFlush writes the registers that differ from the
+///     device with one auto-increment burst per contiguous range.
+/// </summary>
+typedef struct {
+	// Contents we want the device to have
+	uint8_t image[LSM6DSO_CONFIG_SIZE];
+	// Contents we last wrote to or read from the device
+	uint8_t device[LSM6DSO_CONFIG_SIZE];
+	bool deviceKnown[LSM6DSO_CONFIG_SIZE];
+} lsm6dso_config_t;
+
+// An output data rate, with the FIFO batch rates that go with it
+typedef struct {
+	float hz;
+	lsm6dso_odr_xl_t xlOdr;
+	lsm6dso_odr_g_t gyOdr;
+	lsm6dso_bdr_xl_t xlBatch;
+	lsm6dso_bdr_gy_t gyBatch;
+} lsm6dso_rate_t;
+
+// An accelerometer full scale and its sensitivity
+typedef struct {
+	int fullScaleG;
+	lsm6dso_fs_xl_t fs;
+	float mgPerLsb;
+} lsm6dso_xl_range_t;
+
+// A gyroscope full scale and its sensitivity
+typedef struct {
+	int fullScaleDps;
+	lsm6dso_fs_g_t fs;
+	float mdpsPerLsb;
+} lsm6dso_gy_range_t;
+
+/// <summary>
+///     Sets the image and the known device contents to the power-on defaults.  Only valid
+///     right after a software reset.
+/// </summary>
+void lsm6dsoConfigDefaults(lsm6dso_config_t *config);
+
+/// <summary>
+///     Reads the configuration ranges from the device into the image.  Use after registers
+///     have been changed through the lsm6dso_*_set functions.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoConfigLoad(lsm6dso_ctx_t *ctx, lsm6dso_config_t *config);
+
+/// <summary>
+///     Writes every register whose image differs from the device.
+/// </summary>
+/// <returns>The number of burst writes issued, or -1 on failure</returns>
+int lsm6dsoConfigFlush(lsm6dso_ctx_t *ctx, lsm6dso_config_t *config);
+
+/// <summary>
+///     Returns the image byte for reg, for fields without a helper below.  Cast it to the
+///     register type from lsm6dso_reg.h, e.g. (lsm6dso_ctrl4_c_t *).
+/// </summary>
+uint8_t *lsm6dsoConfigReg(lsm6dso_config_t *config, uint8_t reg);
+
+/// <summary>
+///     Image counterparts of the lsm6dso_*_set functions used to set up the device.
+/// </summary>
+void lsm6dsoConfigXlDataRate(lsm6dso_config_t *config, lsm6dso_odr_xl_t val);
+void lsm6dsoConfigGyDataRate(lsm6dso_config_t *config, lsm6dso_odr_g_t val);
+void lsm6dsoConfigXlFullScale(lsm6dso_config_t *config, lsm6dso_fs_xl_t val);
+void lsm6dsoConfigGyFullScale(lsm6dso_config_t *config, lsm6dso_fs_g_t val);
+void lsm6dsoConfigBlockDataUpdate(lsm6dso_config_t *config, uint8_t val);
+void lsm6dsoConfigXlHpPathOnOut(lsm6dso_config_t *config, lsm6dso_hp_slope_xl_en_t val);
+void lsm6dsoConfigXlFilterLp2(lsm6dso_config_t *config, uint8_t val);
+void lsm6dsoConfigI3cDisable(lsm6dso_config_t *config, lsm6dso_i3c_disable_t val);
+void lsm6dsoConfigFifoBatch(lsm6dso_config_t *config, lsm6dso_bdr_xl_t xlBatch, lsm6dso_bdr_gy_t gyBatch);
+void lsm6dsoConfigFifoMode(lsm6dso_config_t *config, lsm6dso_fifo_mode_t val);
+void lsm6dsoConfigXlOffsetWeight(lsm6dso_config_t *config, lsm6dso_usr_off_w_t val);
+void lsm6dsoConfigXlUsrOffset(lsm6dso_config_t *config, uint8_t val);
+void lsm6dsoConfigXlUsrOffsetOnWkup(lsm6dso_config_t *config, uint8_t val);
+void lsm6dsoConfigXlUsrOffsetXyz(lsm6dso_config_t *config, const int8_t offset[3]);
+
+/// <summary>
+///     Return the slowest output data rate of at least hz, or the fastest one if hz is above
+///     them all.  Power-down is only returned for hz <= 0 when allowOff is set, otherwise the
+///     slowest rate is.
+/// </summary>
+const lsm6dso_rate_t *lsm6dsoConfigFindRate(float hz, bool allowOff);
+
+/// <summary>
+///     Return the smallest full scale of at least fullScaleG/fullScaleDps, or the largest one
+///     if the request is above them all.
+/// </summary>
+const lsm6dso_xl_range_t *lsm6dsoConfigFindXlRange(int fullScaleG);
+const lsm6dso_gy_range_t *lsm6dsoConfigFindGyRange(int fullScaleDps);
+
+/// <summary>
+///     Return the full scale step places above (step > 0) or below (step < 0) a supported full
+///     scale, or NULL if there is none.
+/// </summary>
+const lsm6dso_xl_range_t *lsm6dsoConfigStepXlRange(int fullScaleG, int step);
+const lsm6dso_gy_range_t *lsm6dsoConfigStepGyRange(int fullScaleDps, int step);
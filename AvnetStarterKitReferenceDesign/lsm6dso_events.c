@@ -0,0 +1,342 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "lsm6dso_events.h"
+
+// Tap threshold steps per full scale, TAP_THS_X/Y/Z are 5 bits
+#define TAP_THRESHOLD_STEPS 32
+#define TAP_THRESHOLD_MAX 31
+
+// INT_DUR2 fields: samples per LSB, samples a 0 stands for, and the largest value
+#define TAP_SHOCK_STEP 8.0f
+#define TAP_SHOCK_ZERO 4.0f
+#define TAP_SHOCK_MAX 3
+#define TAP_QUIET_STEP 4.0f
+#define TAP_QUIET_ZERO 2.0f
+#define TAP_QUIET_MAX 3
+#define TAP_DUR_STEP 32.0f
+#define TAP_DUR_ZERO 16.0f
+#define TAP_DUR_MAX 15
+
+// WAKE_UP_THS wk_ths is 6 bits, in steps of 1/256 or 1/64 of the full scale
+#define WAKE_THRESHOLD_FINE_STEPS 256
+#define WAKE_THRESHOLD_COARSE_STEPS 64
+#define WAKE_THRESHOLD_MAX 63
+
+// WAKE_UP_DUR fields, sleep_dur is in samples like the INT_DUR2 fields
+#define WAKE_DUR_MAX 3
+#define SLEEP_DUR_STEP 512.0f
+#define SLEEP_DUR_ZERO 16.0f
+#define SLEEP_DUR_MAX 15
+
+// FREE_FALL ff_ths thresholds, and the largest ff_dur which is split over FREE_FALL and WAKE_UP_DUR
+static const float freeFallThresholdsMg[] = { 156.0f, 219.0f, 250.0f, 312.0f, 344.0f, 406.0f, 469.0f, 500.0f };
+#define FREE_FALL_DUR_MAX 63
+#define FREE_FALL_DUR_LOW_BITS 5
+
+// TAP_THS_6D sixd_ths thresholds, LSM6DSO_DEG_80 to LSM6DSO_DEG_50
+static const float orientationThresholdsDeg[] = { 80.0f, 70.0f, 60.0f, 50.0f };
+
+/// <summary>
+///     Reads WAKE_UP_SRC, TAP_SRC and D6D_SRC.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoEventSourcesGet(lsm6dso_ctx_t *ctx, lsm6dso_event_sources_t *sources)
+{
+	uint8_t data[LSM6DSO_D6D_SRC - LSM6DSO_WAKE_UP_SRC + 1];
+
+	if (lsm6dso_read_reg(ctx, LSM6DSO_WAKE_UP_SRC, data, sizeof(data)) != 0) {
+		return -1;
+	}
+
+	memcpy(&sources->wakeUpSrc, &data[LSM6DSO_WAKE_UP_SRC - LSM6DSO_WAKE_UP_SRC], 1);
+	memcpy(&sources->tapSrc, &data[LSM6DSO_TAP_SRC - LSM6DSO_WAKE_UP_SRC], 1);
+	memcpy(&sources->d6dSrc, &data[LSM6DSO_D6D_SRC - LSM6DSO_WAKE_UP_SRC], 1);
+	return 0;
+}
+
+/// <summary>
+///     Latches the basic interrupts and enables their generation.
+/// </summary>
+void lsm6dsoEventsConfigLatch(lsm6dso_config_t *config, bool enable)
+{
+	lsm6dso_tap_cfg0_t *tapCfg0 = (lsm6dso_tap_cfg0_t *)lsm6dsoConfigReg(config, LSM6DSO_TAP_CFG0);
+	lsm6dso_tap_cfg2_t *tapCfg2 = (lsm6dso_tap_cfg2_t *)lsm6dsoConfigReg(config, LSM6DSO_TAP_CFG2);
+
+	tapCfg0->lir = enable ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+	tapCfg0->int_clr_on_read = enable ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+	tapCfg2->interrupts_enable = enable ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+}
+
+/// <summary>
+///     Latches the embedded function interrupts until their status is read.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoEventsLatchEmbedded(lsm6dso_ctx_t *ctx)
+{
+	lsm6dso_page_rw_t pageRw;
+
+	int32_t ret = lsm6dso_mem_bank_set(ctx, LSM6DSO_EMBEDDED_FUNC_BANK);
+	if (ret == 0) {
+		ret = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_RW, (uint8_t *)&pageRw, 1);
+	}
+	if (ret == 0) {
+		pageRw.emb_func_lir = PROPERTY_ENABLE;
+		ret = lsm6dso_write_reg(ctx, LSM6DSO_PAGE_RW, (uint8_t *)&pageRw, 1);
+	}
+	// Back to the user bank even if the write failed
+	if (lsm6dso_mem_bank_set(ctx, LSM6DSO_USER_BANK) != 0) {
+		ret = -1;
+	}
+	return (ret == 0) ? 0 : -1;
+}
+
+/// <summary>
+///     Rounds a window in ms to an INT_DUR2 field that counts step samples per LSB, where 0
+///     stands for zero samples.  ms is updated to the window applied.
+/// </summary>
+static uint8_t WindowRegister(float *ms, float odrHz, float step, float zero, int max)
+{
+	long value = lroundf(*ms * odrHz / 1000.0f / step);
+
+	if (value < 0) {
+		value = 0;
+	}
+	else if (value > max) {
+		value = max;
+	}
+
+	*ms = ((value == 0) ? zero : (float)value * step) * 1000.0f / odrHz;
+	return (uint8_t)value;
+}
+
+/// <summary>
+///     Puts the tap detection settings in the configuration image.
+/// </summary>
+void lsm6dsoEventsConfigTap(lsm6dso_config_t *config, lsm6dso_tap_config_t *tap, float odrHz, int fullScaleG)
+{
+	lsm6dso_tap_cfg0_t *tapCfg0 = (lsm6dso_tap_cfg0_t *)lsm6dsoConfigReg(config, LSM6DSO_TAP_CFG0);
+	lsm6dso_tap_cfg1_t *tapCfg1 = (lsm6dso_tap_cfg1_t *)lsm6dsoConfigReg(config, LSM6DSO_TAP_CFG1);
+	lsm6dso_tap_cfg2_t *tapCfg2 = (lsm6dso_tap_cfg2_t *)lsm6dsoConfigReg(config, LSM6DSO_TAP_CFG2);
+	lsm6dso_tap_ths_6d_t *tapThs6d = (lsm6dso_tap_ths_6d_t *)lsm6dsoConfigReg(config, LSM6DSO_TAP_THS_6D);
+	lsm6dso_int_dur2_t *intDur2 = (lsm6dso_int_dur2_t *)lsm6dsoConfigReg(config, LSM6DSO_INT_DUR2);
+	lsm6dso_wake_up_ths_t *wakeUpThs = (lsm6dso_wake_up_ths_t *)lsm6dsoConfigReg(config, LSM6DSO_WAKE_UP_THS);
+
+	// The same threshold on every axis, never 0 which would flag every sample
+	float stepMg = (float)fullScaleG * 1000.0f / TAP_THRESHOLD_STEPS;
+	long threshold = lroundf(tap->thresholdMg / stepMg);
+	if (threshold < 1) {
+		threshold = 1;
+	}
+	else if (threshold > TAP_THRESHOLD_MAX) {
+		threshold = TAP_THRESHOLD_MAX;
+	}
+	tap->thresholdMg = (float)threshold * stepMg;
+
+	tapCfg1->tap_ths_x = (uint8_t)threshold;
+	tapCfg1->tap_priority = LSM6DSO_XYZ;
+	tapCfg2->tap_ths_y = (uint8_t)threshold;
+	tapThs6d->tap_ths_z = (uint8_t)threshold;
+
+	intDur2->shock = WindowRegister(&tap->shockMs, odrHz, TAP_SHOCK_STEP, TAP_SHOCK_ZERO, TAP_SHOCK_MAX);
+	intDur2->quiet = WindowRegister(&tap->quietMs, odrHz, TAP_QUIET_STEP, TAP_QUIET_ZERO, TAP_QUIET_MAX);
+	intDur2->dur = WindowRegister(&tap->durationMs, odrHz, TAP_DUR_STEP, TAP_DUR_ZERO, TAP_DUR_MAX);
+
+	tapCfg0->tap_x_en = (tap->enabled && ((tap->axes & LSM6DSO_TAP_AXIS_X) != 0)) ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+	tapCfg0->tap_y_en = (tap->enabled && ((tap->axes & LSM6DSO_TAP_AXIS_Y) != 0)) ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+	tapCfg0->tap_z_en = (tap->enabled && ((tap->axes & LSM6DSO_TAP_AXIS_Z) != 0)) ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+	wakeUpThs->single_double_tap = (tap->enabled && tap->doubleTap) ? LSM6DSO_BOTH_SINGLE_DOUBLE : LSM6DSO_ONLY_SINGLE;
+}
+
+/// <summary>
+///     Rounds a wake-up threshold in mg to WAKE_UP_THS wk_ths and its weight in WAKE_UP_DUR, and
+///     sets the samples it has to be exceeded for.  thresholdMg and samples are updated to the
+///     values applied.
+/// </summary>
+static void WakeUpThreshold(lsm6dso_config_t *config, float *thresholdMg, uint8_t *samples, int fullScaleG)
+{
+	lsm6dso_wake_up_ths_t *wakeUpThs = (lsm6dso_wake_up_ths_t *)lsm6dsoConfigReg(config, LSM6DSO_WAKE_UP_THS);
+	lsm6dso_wake_up_dur_t *wakeUpDur = (lsm6dso_wake_up_dur_t *)lsm6dsoConfigReg(config, LSM6DSO_WAKE_UP_DUR);
+
+	// The fine weight unless the threshold is out of its range, never 0 which would wake on noise
+	float stepMg = (float)fullScaleG * 1000.0f / WAKE_THRESHOLD_FINE_STEPS;
+	wakeUpDur->wake_ths_w = 1;
+	long threshold = lroundf(*thresholdMg / stepMg);
+	if (threshold > WAKE_THRESHOLD_MAX) {
+		stepMg = (float)fullScaleG * 1000.0f / WAKE_THRESHOLD_COARSE_STEPS;
+		wakeUpDur->wake_ths_w = 0;
+		threshold = lroundf(*thresholdMg / stepMg);
+	}
+	if (threshold < 1) {
+		threshold = 1;
+	}
+	else if (threshold > WAKE_THRESHOLD_MAX) {
+		threshold = WAKE_THRESHOLD_MAX;
+	}
+	*thresholdMg = (float)threshold * stepMg;
+	wakeUpThs->wk_ths = (uint8_t)threshold;
+
+	if (*samples > WAKE_DUR_MAX) {
+		*samples = WAKE_DUR_MAX;
+	}
+	wakeUpDur->wake_dur = *samples;
+}
+
+/// <summary>
+///     Puts the activity/inactivity settings in the configuration image.
+/// </summary>
+void lsm6dsoEventsConfigActivity(lsm6dso_config_t *config, lsm6dso_activity_config_t *activity, float odrHz,
+	int fullScaleG)
+{
+	lsm6dso_tap_cfg2_t *tapCfg2 = (lsm6dso_tap_cfg2_t *)lsm6dsoConfigReg(config, LSM6DSO_TAP_CFG2);
+	lsm6dso_wake_up_dur_t *wakeUpDur = (lsm6dso_wake_up_dur_t *)lsm6dsoConfigReg(config, LSM6DSO_WAKE_UP_DUR);
+
+	WakeUpThreshold(config, &activity->thresholdMg, &activity->wakeSamples, fullScaleG);
+
+	float sleepMs = activity->sleepSeconds * 1000.0f;
+	wakeUpDur->sleep_dur = WindowRegister(&sleepMs, odrHz, SLEEP_DUR_STEP, SLEEP_DUR_ZERO, SLEEP_DUR_MAX);
+	activity->sleepSeconds = sleepMs / 1000.0f;
+
+	tapCfg2->inact_en = activity->enabled ? (uint8_t)activity->inactiveMode : (uint8_t)LSM6DSO_XL_AND_GY_NOT_AFFECTED;
+}
+
+/// <summary>
+///     Puts the free-fall settings in the configuration image.
+/// </summary>
+void lsm6dsoEventsConfigFreeFall(lsm6dso_config_t *config, lsm6dso_free_fall_config_t *freeFall, float odrHz)
+{
+	lsm6dso_free_fall_t *freeFallReg = (lsm6dso_free_fall_t *)lsm6dsoConfigReg(config, LSM6DSO_FREE_FALL);
+	lsm6dso_wake_up_dur_t *wakeUpDur = (lsm6dso_wake_up_dur_t *)lsm6dsoConfigReg(config, LSM6DSO_WAKE_UP_DUR);
+
+	// The nearest of the supported thresholds
+	uint8_t threshold = 0;
+	for (uint8_t i = 1; i < sizeof(freeFallThresholdsMg) / sizeof(freeFallThresholdsMg[0]); i++) {
+		if (fabsf(freeFallThresholdsMg[i] - freeFall->thresholdMg) <
+			fabsf(freeFallThresholdsMg[threshold] - freeFall->thresholdMg)) {
+			threshold = i;
+		}
+	}
+	freeFall->thresholdMg = freeFallThresholdsMg[threshold];
+	freeFallReg->ff_ths = threshold;
+
+	long samples = lroundf(freeFall->durationMs * odrHz / 1000.0f);
+	if (samples < 0) {
+		samples = 0;
+	}
+	else if (samples > FREE_FALL_DUR_MAX) {
+		samples = FREE_FALL_DUR_MAX;
+	}
+	freeFall->durationMs = (float)samples * 1000.0f / odrHz;
+	freeFallReg->ff_dur = (uint8_t)samples & ((1U << FREE_FALL_DUR_LOW_BITS) - 1U);
+	wakeUpDur->ff_dur = (uint8_t)samples >> FREE_FALL_DUR_LOW_BITS;
+}
+
+/// <summary>
+///     Puts the shock settings in the wake-up engine of the configuration image.
+/// </summary>
+void lsm6dsoEventsConfigShock(lsm6dso_config_t *config, lsm6dso_shock_config_t *shock, int fullScaleG)
+{
+	WakeUpThreshold(config, &shock->thresholdMg, &shock->samples, fullScaleG);
+}
+
+/// <summary>
+///     Puts the 6D/4D orientation settings in the configuration image.
+/// </summary>
+void lsm6dsoEventsConfigOrientation(lsm6dso_config_t *config, lsm6dso_orientation_config_t *orientation)
+{
+	lsm6dso_tap_ths_6d_t *tapThs6d = (lsm6dso_tap_ths_6d_t *)lsm6dsoConfigReg(config, LSM6DSO_TAP_THS_6D);
+
+	// The nearest of the supported thresholds
+	uint8_t threshold = 0;
+	for (uint8_t i = 1; i < sizeof(orientationThresholdsDeg) / sizeof(orientationThresholdsDeg[0]); i++) {
+		if (fabsf(orientationThresholdsDeg[i] - orientation->thresholdDeg) <
+			fabsf(orientationThresholdsDeg[threshold] - orientation->thresholdDeg)) {
+			threshold = i;
+		}
+	}
+	orientation->thresholdDeg = orientationThresholdsDeg[threshold];
+
+	// TAP_THS_6D has no enable bit, only the interrupt routing and the 4D mode follow enabled
+	tapThs6d->sixd_ths = threshold;
+	tapThs6d->d4d_en = (orientation->enabled && orientation->fourD) ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+}
+
+/// <summary>
+///     Decodes the tap in TAP_SRC.
+/// </summary>
+/// <returns>true if a tap was flagged</returns>
+bool lsm6dsoEventsTap(const lsm6dso_event_sources_t *sources, lsm6dso_tap_event_t *event)
+{
+	const lsm6dso_tap_src_t *tapSrc = &sources->tapSrc;
+
+	if (!tapSrc->single_tap && !tapSrc->double_tap) {
+		return false;
+	}
+
+	event->doubleTap = (tapSrc->double_tap != 0);
+	event->negative = (tapSrc->tap_sign != 0);
+	event->axis = tapSrc->x_tap ? 0 : (tapSrc->y_tap ? 1 : 2);
+	return true;
+}
+
+/// <summary>
+///     Writes a tap as a JSON object.
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int lsm6dsoEventsTapToJson(const lsm6dso_tap_event_t *event, char *json, size_t size)
+{
+	int written = snprintf(json, size, "{\"tap\":\"%s\",\"axis\":\"%c\",\"sign\":\"%c\"}",
+		event->doubleTap ? "double" : "single", "xyz"[event->axis], event->negative ? '-' : '+');
+
+	return ((written < 0) || ((size_t)written >= size)) ? -1 : written;
+}
+
+/// <summary>
+///     Decodes the orientation in D6D_SRC.
+/// </summary>
+/// <returns>true if an orientation change was flagged</returns>
+bool lsm6dsoEventsOrientation(const lsm6dso_event_sources_t *sources, lsm6dso_orientation_event_t *event)
+{
+	const lsm6dso_d6d_src_t *d6dSrc = &sources->d6dSrc;
+
+	event->tilt = false;
+	event->axis = -1;
+	event->negative = false;
+	if (d6dSrc->xl || d6dSrc->xh) {
+		event->axis = 0;
+		event->negative = (d6dSrc->xl != 0);
+	}
+	else if (d6dSrc->yl || d6dSrc->yh) {
+		event->axis = 1;
+		event->negative = (d6dSrc->yl != 0);
+	}
+	else if (d6dSrc->zl || d6dSrc->zh) {
+		event->axis = 2;
+		event->negative = (d6dSrc->zl != 0);
+	}
+
+	return d6dSrc->d6d_ia != 0;
+}
+
+/// <summary>
+///     Writes an orientation change or a tilt as a JSON object.
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int lsm6dsoEventsOrientationToJson(const lsm6dso_orientation_event_t *event, char *json, size_t size)
+{
+	int written;
+
+	if (event->axis >= 0) {
+		written = snprintf(json, size, "{\"orientation\":\"%c%c\",\"tilt\":%s}", "xyz"[event->axis],
+			event->negative ? '-' : '+', event->tilt ? "true" : "false");
+	}
+	else {
+		written = snprintf(json, size, "{\"orientation\":\"none\",\"tilt\":%s}", event->tilt ? "true" : "false");
+	}
+
+	return ((written < 0) || ((size_t)written >= size)) ? -1 : written;
+}
@@ -0,0 +1,169 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+#include "lsm6dso_config.h"
+
+// Tap axes, lsm6dso_tap_config_t axes is a mask of these
+#define LSM6DSO_TAP_AXIS_X 0x01
+#define LSM6DSO_TAP_AXIS_Y 0x02
+#define LSM6DSO_TAP_AXIS_Z 0x04
+
+// Source registers of the basic interrupts, WAKE_UP_SRC to D6D_SRC.  ALL_INT_SRC is left out,
+// each of these carries its own interrupt active flags.
+typedef struct {
+	lsm6dso_wake_up_src_t wakeUpSrc;
+	lsm6dso_tap_src_t tapSrc;
+	lsm6dso_d6d_src_t d6dSrc;
+} lsm6dso_event_sources_t;
+
+// Tap detection settings in physical units
+typedef struct {
+	bool enabled;
+	bool doubleTap;
+	uint8_t axes;
+	float thresholdMg;
+	float shockMs;
+	float quietMs;
+	float durationMs;
+} lsm6dso_tap_config_t;
+
+// Activity/inactivity detection settings.  The device goes to inactiveMode once the acceleration
+// has stayed within thresholdMg for sleepSeconds, and back when it exceeds thresholdMg for
+// wakeSamples + 1 samples.
+typedef struct {
+	bool enabled;
+	lsm6dso_inact_en_t inactiveMode;
+	float thresholdMg;
+	uint8_t wakeSamples;
+	float sleepSeconds;
+} lsm6dso_activity_config_t;
+
+// Free-fall detection settings.  A free fall is flagged once the acceleration has stayed below
+// thresholdMg on every axis for durationMs.
+typedef struct {
+	float thresholdMg;
+	float durationMs;
+} lsm6dso_free_fall_config_t;
+
+// Shock detection on the wake-up engine, flagged when the acceleration exceeds thresholdMg for
+// samples + 1 samples
+typedef struct {
+	float thresholdMg;
+	uint8_t samples;
+} lsm6dso_shock_config_t;
+
+// 6D orientation detection settings.  A new orientation is flagged when the board turns further
+// than thresholdDeg from the axis it was closest to, fourD leaves the Z axis out.
+typedef struct {
+	bool enabled;
+	bool fourD;
+	float thresholdDeg;
+} lsm6dso_orientation_config_t;
+
+// A tap read from TAP_SRC
+typedef struct {
+	bool doubleTap;
+	// 0, 1 or 2 for X, Y or Z
+	int axis;
+	bool negative;
+} lsm6dso_tap_event_t;
+
+// An orientation change read from D6D_SRC, or a tilt.  The face is the axis pointing up.
+typedef struct {
+	bool tilt;
+	// 0, 1 or 2 for X, Y or Z, or -1 if D6D_SRC doesn't flag one
+	int axis;
+	bool negative;
+} lsm6dso_orientation_event_t;
+
+/// <summary>
+///     Reads the event source registers with one burst.  With latched interrupts and
+///     int_clr_on_read set the read also clears them.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoEventSourcesGet(lsm6dso_ctx_t *ctx, lsm6dso_event_sources_t *sources);
+
+/// <summary>
+///     Latches the basic interrupts until their source register is read and enables or disables
+///     their generation.  The image still has to be flushed.
+/// </summary>
+void lsm6dsoEventsConfigLatch(lsm6dso_config_t *config, bool enable);
+
+/// <summary>
+///     Latches the embedded function interrupts, the tilt and the FSM ones, until their status
+///     is read.  PAGE_RW is in the embedded functions bank, so this goes straight to the device.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoEventsLatchEmbedded(lsm6dso_ctx_t *ctx);
+
+/// <summary>
+///     Puts the tap detection settings in the configuration image.  The threshold is in steps of
+///     1/32 of the full scale and the windows in steps of a few samples at odrHz, so the settings
+///     are rounded to what the device can do and tap holds the values applied on return.  The
+///     image still has to be flushed.
+/// </summary>
+void lsm6dsoEventsConfigTap(lsm6dso_config_t *config, lsm6dso_tap_config_t *tap, float odrHz, int fullScaleG);
+
+/// <summary>
+///     Puts the activity/inactivity settings in the configuration image.  The threshold is in
+///     steps of 1/256 or, above 63 of those, 1/64 of the full scale, and the inactivity time in
+///     steps of 512 samples at odrHz, so the settings are rounded to what the device can do and
+///     activity holds the values applied on return.  The image still has to be flushed.
+/// </summary>
+void lsm6dsoEventsConfigActivity(lsm6dso_config_t *config, lsm6dso_activity_config_t *activity, float odrHz,
+	int fullScaleG);
+
+/// <summary>
+///     Puts the free-fall settings in the configuration image.  The threshold is one of eight
+///     steps from 156 to 500 mg and the duration is counted in samples at odrHz, so the settings
+///     are rounded to what the device can do and freeFall holds the values applied on return.  The
+///     image still has to be flushed.
+/// </summary>
+void lsm6dsoEventsConfigFreeFall(lsm6dso_config_t *config, lsm6dso_free_fall_config_t *freeFall, float odrHz);
+
+/// <summary>
+///     Puts the shock settings in the wake-up engine of the configuration image, rounding the
+///     threshold like lsm6dsoEventsConfigActivity.  The wake-up engine can't serve shock detection
+///     and activity detection with different thresholds.  The image still has to be flushed.
+/// </summary>
+void lsm6dsoEventsConfigShock(lsm6dso_config_t *config, lsm6dso_shock_config_t *shock, int fullScaleG);
+
+/// <summary>
+///     Puts the 6D/4D orientation settings in the configuration image.  The threshold is one of
+///     50, 60, 70 or 80 degrees, orientation holds the values applied on return.  The image
+///     still has to be flushed.
+/// </summary>
+void lsm6dsoEventsConfigOrientation(lsm6dso_config_t *config, lsm6dso_orientation_config_t *orientation);
+
+/// <summary>
+///     Decodes the tap in TAP_SRC.  When single and double taps are both flagged only the
+///     double tap is returned, and the axis is the first flagged in X, Y, Z order.
+/// </summary>
+/// <returns>true if a tap was flagged</returns>
+bool lsm6dsoEventsTap(const lsm6dso_event_sources_t *sources, lsm6dso_tap_event_t *event);
+
+/// <summary>
+///     Writes a tap as a JSON object, for example {"tap":"double","axis":"z","sign":"-"}
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int lsm6dsoEventsTapToJson(const lsm6dso_tap_event_t *event, char *json, size_t size);
+
+/// <summary>
+///     Decodes the orientation in D6D_SRC, the first axis flagged in X, Y, Z order.  tilt is
+///     cleared, the tilt flag isn't in the basic event sources.
+/// </summary>
+/// <returns>true if an orientation change was flagged</returns>
+bool lsm6dsoEventsOrientation(const lsm6dso_event_sources_t *sources, lsm6dso_orientation_event_t *event);
+
+/// <summary>
+///     Writes an orientation change or a tilt as a JSON object, for example
+///     {"orientation":"z+","tilt":false}.  The orientation is "none" when no axis is flagged.
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int lsm6dsoEventsOrientationToJson(const lsm6dso_orientation_event_t *event, char *json, size_t size);
@@ -0,0 +1,224 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <errno.h>
+#include <math.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+
+#include "lsm6dso_fifo.h"
+
+// Burst buffer, sized for the largest read we issue on the bus
+static uint8_t fifoBurstBuffer[LSM6DSO_FIFO_WORDS_PER_BURST * LSM6DSO_FIFO_WORD_SIZE];
+static fifo_stats_t fifoStats;
+
+// Extra time allowed for a capture to fill, in percent of the nominal capture time
+#define CAPTURE_MARGIN_PERCENT 10
+
+// Running mean and variance (Welford) of the capture in progress
+static lsm6dso_fifo_tag_t captureTag;
+static uint32_t captureLimit;
+static double captureM2[3];
+static fifo_capture_t *captureResult;
+
+/// <summary>
+///     Configures the LSM6DSO FIFO in continuous (stream) mode.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int initLsm6dsoFifo(lsm6dso_ctx_t *ctx, uint16_t watermark, lsm6dso_bdr_xl_t xlBatch, lsm6dso_bdr_gy_t gyBatch)
+{
+	// Start from an empty FIFO, switching to bypass mode flushes any queued data
+	if (lsm6dso_fifo_mode_set(ctx, LSM6DSO_BYPASS_MODE) != 0) {
+		return -1;
+	}
+
+	if (lsm6dso_fifo_watermark_set(ctx, watermark) != 0) {
+		return -1;
+	}
+
+	// Batch the accelerometer and gyroscope at the requested rates
+	if (lsm6dso_fifo_xl_batch_set(ctx, xlBatch) != 0) {
+		return -1;
+	}
+	if (lsm6dso_fifo_gy_batch_set(ctx, gyBatch) != 0) {
+		return -1;
+	}
+
+	// Stream mode, the oldest samples are overwritten if we fall behind
+	if (lsm6dso_fifo_mode_set(ctx, LSM6DSO_STREAM_MODE) != 0) {
+		return -1;
+	}
+
+	memset(&fifoStats, 0, sizeof(fifoStats));
+	Log_Debug("LSM6DSO: FIFO enabled, watermark %d words\n", watermark);
+
+	return 0;
+}
+
+/// <summary>
+///     Enables FIFO compression.  lsm6dso_compression_algo_set also sets fifo_compr_rt_en, so the
+///     compressed words are written to the FIFO as the samples arrive.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoFifoCompressionSet(lsm6dso_ctx_t *ctx, lsm6dso_uncoptr_rate_t rate)
+{
+	if (lsm6dso_compression_algo_set(ctx, rate) != 0) {
+		return -1;
+	}
+
+	if (rate == LSM6DSO_CMP_DISABLE) {
+		Log_Debug("LSM6DSO: FIFO compression disabled\n");
+		return 0;
+	}
+
+	// Restart the algorithm so the first word is uncompressed
+	if (lsm6dso_compression_algo_init_set(ctx, PROPERTY_ENABLE) != 0) {
+		return -1;
+	}
+
+	Log_Debug("LSM6DSO: FIFO compression enabled\n");
+	return 0;
+}
+
+/// <summary>
+///     Drains every word currently queued in the FIFO.
+///
+///     FIFO_STATUS1/FIFO_STATUS2 are read in a single transaction to get the number of
+///     unread words, then the words are pulled in bursts starting at FIFO_DATA_OUT_TAG.
+///     The device rolls the register address back from FIFO_DATA_OUT_Z_H to
+///     FIFO_DATA_OUT_TAG during a burst, so each burst returns consecutive FIFO words.
+///     Tags are decoded from the burst buffer instead of re-reading FIFO_DATA_OUT_TAG
+///     with lsm6dso_fifo_sensor_tag_get() for every word.
+/// </summary>
+/// <returns>The number of words drained, or -1 on failure</returns>
+int drainLsm6dsoFifo(lsm6dso_ctx_t *ctx, FifoWordHandler handler)
+{
+	uint8_t fifoStatus[2];
+	lsm6dso_fifo_status2_t *fifoStatus2 = (lsm6dso_fifo_status2_t *)&fifoStatus[1];
+
+	if (lsm6dso_read_reg(ctx, LSM6DSO_FIFO_STATUS1, fifoStatus, 2) != 0) {
+		return -1;
+	}
+
+	uint16_t wordsQueued = (uint16_t)(((uint16_t)fifoStatus2->diff_fifo << 8) | fifoStatus[0]);
+
+	if (fifoStatus2->fifo_ovr_ia) {
+		fifoStats.overruns++;
+		Log_Debug("LSM6DSO: FIFO overrun, samples were lost\n");
+	}
+
+	int wordsDrained = 0;
+
+	while (wordsQueued > 0) {
+
+		uint16_t burstWords = wordsQueued;
+		if (burstWords > LSM6DSO_FIFO_WORDS_PER_BURST) {
+			burstWords = LSM6DSO_FIFO_WORDS_PER_BURST;
+		}
+
+		if (lsm6dso_read_reg(ctx, LSM6DSO_FIFO_DATA_OUT_TAG, fifoBurstBuffer,
+			(uint16_t)(burstWords * LSM6DSO_FIFO_WORD_SIZE)) != 0) {
+			return -1;
+		}
+		fifoStats.bursts++;
+
+		for (int i = 0; i < burstWords; i++) {
+
+			uint8_t *pWord = &fifoBurstBuffer[i * LSM6DSO_FIFO_WORD_SIZE];
+			lsm6dso_fifo_data_out_tag_t *pTag = (lsm6dso_fifo_data_out_tag_t *)pWord;
+			fifo_word_t word;
+
+			word.tag = (lsm6dso_fifo_tag_t)pTag->tag_sensor;
+			word.tagCount = pTag->tag_cnt;
+			word.timeNs = 0;
+			memcpy(word.data.u8bit, &pWord[1], sizeof(word.data.u8bit));
+
+			if (handler != NULL) {
+				handler(&word);
+			}
+		}
+
+		wordsQueued -= burstWords;
+		wordsDrained += burstWords;
+	}
+
+	fifoStats.words += (uint32_t)wordsDrained;
+	return wordsDrained;
+}
+
+/// <summary>
+///     Adds one drained FIFO word to the capture statistics.
+/// </summary>
+static void CaptureFifoWord(const fifo_word_t *word)
+{
+	if ((word->tag != captureTag) || (captureResult->samples >= captureLimit)) {
+		return;
+	}
+
+	uint32_t count = ++captureResult->samples;
+	for (int axis = 0; axis < 3; axis++) {
+		double value = (double)word->data.i16bit[axis];
+		double delta = value - captureResult->mean[axis];
+		captureResult->mean[axis] += delta / (double)count;
+		captureM2[axis] += delta * (value - captureResult->mean[axis]);
+	}
+}
+
+/// <summary>
+///     Fills the FIFO once with one sensor's samples and returns their mean and standard deviation.
+/// </summary>
+/// <returns>0 if enough samples were collected, or -1 on failure</returns>
+int lsm6dsoFifoCapture(lsm6dso_ctx_t *ctx, lsm6dso_fifo_tag_t tag, float rateHz, uint16_t samples, fifo_capture_t *capture)
+{
+	memset(capture, 0, sizeof(*capture));
+	memset(captureM2, 0, sizeof(captureM2));
+	captureTag = tag;
+	captureLimit = samples;
+	captureResult = capture;
+
+	if ((rateHz <= 0.0f) || (samples < 2)) {
+		return -1;
+	}
+
+	// Bypass mode empties the FIFO, FIFO mode then stops batching once it is full
+	if ((lsm6dso_fifo_mode_set(ctx, LSM6DSO_BYPASS_MODE) != 0) || (lsm6dso_fifo_mode_set(ctx, LSM6DSO_FIFO_MODE) != 0)) {
+		return -1;
+	}
+
+	uint32_t captureMs = (uint32_t)((float)samples * 1000.0f / rateHz);
+	captureMs += captureMs * CAPTURE_MARGIN_PERCENT / 100 + 1;
+	struct timespec delay = { .tv_sec = captureMs / 1000,.tv_nsec = (long)(captureMs % 1000) * 1000000L };
+	nanosleep(&delay, NULL);
+
+	int drained = drainLsm6dsoFifo(ctx, CaptureFifoWord);
+	lsm6dso_fifo_mode_set(ctx, LSM6DSO_BYPASS_MODE);
+	if (drained < 0) {
+		return -1;
+	}
+
+	if (capture->samples < samples) {
+		Log_Debug("ERROR: FIFO capture collected %u of %u samples\n", capture->samples, samples);
+		return -1;
+	}
+
+	for (int axis = 0; axis < 3; axis++) {
+		capture->stdDev[axis] = sqrt(captureM2[axis] / (double)(capture->samples - 1));
+	}
+
+	return 0;
+}
+
+/// <summary>
+///     Returns the running FIFO statistics.
+/// </summary>
+const fifo_stats_t *getLsm6dsoFifoStats(void)
+{
+	return &fifoStats;
+}
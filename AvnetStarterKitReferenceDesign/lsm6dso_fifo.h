@@ -0,0 +1,76 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+
+// Each FIFO word is one tag byte followed by six data bytes
+#define LSM6DSO_FIFO_WORD_SIZE 7
+
+// Maximum number of FIFO words pulled across the bus in a single burst read
+#define LSM6DSO_FIFO_WORDS_PER_BURST 32
+
+typedef struct {
+	lsm6dso_fifo_tag_t tag;
+	uint8_t tagCount;
+	axis3bit16_t data;
+	// CLOCK_MONOTONIC capture time in nanoseconds, 0 when not known (see lsm6dso_timestamp.h)
+	uint64_t timeNs;
+} fifo_word_t;
+
+// Mean and standard deviation of the samples of one sensor collected by lsm6dsoFifoCapture, raw LSB
+typedef struct {
+	uint32_t samples;
+	double mean[3];
+	double stdDev[3];
+} fifo_capture_t;
+
+typedef struct {
+	uint32_t bursts;
+	uint32_t words;
+	uint32_t overruns;
+} fifo_stats_t;
+
+/// <summary>
+///     Function signature for the handler called once for every word drained from the FIFO.
+/// </summary>
+typedef void (*FifoWordHandler)(const fifo_word_t *word);
+
+/// <summary>
+///     Configures the LSM6DSO FIFO in continuous (stream) mode with the requested watermark
+///     and accelerometer/gyroscope batch rates.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int initLsm6dsoFifo(lsm6dso_ctx_t *ctx, uint16_t watermark, lsm6dso_bdr_xl_t xlBatch, lsm6dso_bdr_gy_t gyBatch);
+
+/// <summary>
+///     Enables FIFO compression, or disables it with LSM6DSO_CMP_DISABLE.  rate also sets how often
+///     an uncompressed word is forced.  Call before initLsm6dsoFifo, compressed words must be
+///     expanded with lsm6dsoFifoDecode (lsm6dso_fifo_decoder.h).
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoFifoCompressionSet(lsm6dso_ctx_t *ctx, lsm6dso_uncoptr_rate_t rate);
+
+/// <summary>
+///     Drains every word currently queued in the FIFO using burst reads and hands each
+///     decoded word to the handler.
+/// </summary>
+/// <returns>The number of words drained, or -1 on failure</returns>
+int drainLsm6dsoFifo(lsm6dso_ctx_t *ctx, FifoWordHandler handler);
+
+/// <summary>
+///     Empties the FIFO, lets it fill in FIFO mode until samples words tagged tag have been batched
+///     at rateHz and drains it in one go.  The FIFO must be set up to batch that sensor, and as
+///     little else as possible, with compression off.  The FIFO is left in bypass mode.  The call
+///     sleeps for the whole capture, there is no polling.
+/// </summary>
+/// <returns>0 if enough samples were collected, or -1 on failure</returns>
+int lsm6dsoFifoCapture(lsm6dso_ctx_t *ctx, lsm6dso_fifo_tag_t tag, float rateHz, uint16_t samples, fifo_capture_t *capture);
+
+/// <summary>
+///     Returns the running FIFO statistics.
+/// </summary>
+const fifo_stats_t *getLsm6dsoFifoStats(void);
@@ -0,0 +1,147 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <string.h>
+
+#include "lsm6dso_fifo_decoder.h"
+
+// FIFO compression stores up to three samples of a sensor in one word:
+//   NC, NC_T_1, NC_T_2  one uncompressed sample
+//   2xC                 two samples, each axis an int8_t difference from the sample before it
+//   3xC                 three samples, each a 16 bit little endian word holding three 5 bit
+//                       differences, X in bits 4:0, Y in bits 9:5 and Z in bits 14:10
+// The words of a sensor come out of the FIFO in time order, so each sample is rebuilt from the
+// one decoded before it.
+
+/// <summary>
+///     Clears the decoder.
+/// </summary>
+void initLsm6dsoFifoDecoder(fifo_decoder_t *decoder, uint32_t slotPeriodNs)
+{
+	memset(decoder, 0, sizeof(*decoder));
+	decoder->slotPeriodNs = slotPeriodNs;
+}
+
+/// <summary>
+///     Passes a rebuilt sample to the handler and makes it the reference for the next one.
+///     slotsBack is how many time slots before the word's own slot the sample was taken.
+/// </summary>
+static void EmitSample(const fifo_decoder_t *decoder, fifo_decoder_channel_t *channel, lsm6dso_fifo_tag_t tag,
+	const fifo_word_t *word, int slotsBack, const int16_t *sample, FifoWordHandler handler)
+{
+	fifo_word_t decoded;
+	uint64_t slotsBackNs = (uint64_t)slotsBack * decoder->slotPeriodNs;
+
+	decoded.tag = tag;
+	decoded.tagCount = word->tagCount;
+	decoded.timeNs = (word->timeNs > slotsBackNs) ? (word->timeNs - slotsBackNs) : 0;
+	for (int axis = 0; axis < 3; axis++) {
+		decoded.data.i16bit[axis] = sample[axis];
+		channel->last.i16bit[axis] = sample[axis];
+	}
+	channel->valid = true;
+
+	if (handler != NULL) {
+		handler(&decoded);
+	}
+}
+
+/// <summary>
+///     Sign extends a 5 bit difference.
+/// </summary>
+static int16_t Diff5(uint16_t packed, int shift)
+{
+	int16_t diff = (int16_t)((packed >> shift) & 0x1F);
+	return (diff < 16) ? diff : (int16_t)(diff - 32);
+}
+
+/// <summary>
+///     Decodes one FIFO word.
+/// </summary>
+/// <returns>The number of words passed to the handler</returns>
+int lsm6dsoFifoDecode(fifo_decoder_t *decoder, const fifo_word_t *word, FifoWordHandler handler)
+{
+	fifo_decoder_channel_t *channel;
+	lsm6dso_fifo_tag_t outputTag;
+	int16_t sample[3];
+
+	switch (word->tag) {
+	case LSM6DSO_XL_NC_TAG:
+	case LSM6DSO_XL_NC_T_1_TAG:
+	case LSM6DSO_XL_NC_T_2_TAG:
+	case LSM6DSO_XL_2XC_TAG:
+	case LSM6DSO_XL_3XC_TAG:
+		channel = &decoder->accel;
+		outputTag = LSM6DSO_XL_NC_TAG;
+		break;
+
+	case LSM6DSO_GYRO_NC_TAG:
+	case LSM6DSO_GYRO_NC_T_1_TAG:
+	case LSM6DSO_GYRO_NC_T_2_TAG:
+	case LSM6DSO_GYRO_2XC_TAG:
+	case LSM6DSO_GYRO_3XC_TAG:
+		channel = &decoder->gyro;
+		outputTag = LSM6DSO_GYRO_NC_TAG;
+		break;
+
+	default:
+		if (handler != NULL) {
+			handler(word);
+		}
+		return 1;
+	}
+
+	switch (word->tag) {
+	case LSM6DSO_XL_2XC_TAG:
+	case LSM6DSO_GYRO_2XC_TAG:
+		if (!channel->valid) {
+			decoder->droppedWords++;
+			return 0;
+		}
+		decoder->compressedWords++;
+		for (int i = 0; i < 2; i++) {
+			for (int axis = 0; axis < 3; axis++) {
+				sample[axis] = (int16_t)(channel->last.i16bit[axis] + (int8_t)word->data.u8bit[3 * i + axis]);
+			}
+			// t-2 then t-1
+			EmitSample(decoder, channel, outputTag, word, 2 - i, sample, handler);
+		}
+		decoder->samples += 2;
+		return 2;
+
+	case LSM6DSO_XL_3XC_TAG:
+	case LSM6DSO_GYRO_3XC_TAG:
+		if (!channel->valid) {
+			decoder->droppedWords++;
+			return 0;
+		}
+		decoder->compressedWords++;
+		for (int i = 0; i < 3; i++) {
+			uint16_t packed = (uint16_t)(word->data.u8bit[2 * i] | (word->data.u8bit[2 * i + 1] << 8));
+			for (int axis = 0; axis < 3; axis++) {
+				sample[axis] = (int16_t)(channel->last.i16bit[axis] + Diff5(packed, 5 * axis));
+			}
+			// t-2, t-1 then t
+			EmitSample(decoder, channel, outputTag, word, 2 - i, sample, handler);
+		}
+		decoder->samples += 3;
+		return 3;
+
+	case LSM6DSO_XL_NC_T_2_TAG:
+	case LSM6DSO_GYRO_NC_T_2_TAG:
+		EmitSample(decoder, channel, outputTag, word, 2, word->data.i16bit, handler);
+		decoder->samples++;
+		return 1;
+
+	case LSM6DSO_XL_NC_T_1_TAG:
+	case LSM6DSO_GYRO_NC_T_1_TAG:
+		EmitSample(decoder, channel, outputTag, word, 1, word->data.i16bit, handler);
+		decoder->samples++;
+		return 1;
+
+	default:
+		EmitSample(decoder, channel, outputTag, word, 0, word->data.i16bit, handler);
+		decoder->samples++;
+		return 1;
+	}
+}
@@ -0,0 +1,42 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+#include "lsm6dso_fifo.h"
+
+// Reconstruction state for one sensor, the last sample decoded is the reference the next
+// compressed word is relative to
+typedef struct {
+	axis3bit16_t last;
+	bool valid;
+} fifo_decoder_channel_t;
+
+typedef struct {
+	fifo_decoder_channel_t accel;
+	fifo_decoder_channel_t gyro;
+	// Time between FIFO time slots, compressed words hold samples from up to two slots back
+	uint32_t slotPeriodNs;
+	uint32_t compressedWords;
+	uint32_t samples;
+	uint32_t droppedWords;
+} fifo_decoder_t;
+
+/// <summary>
+///     Clears the decoder.  Must be called when FIFO compression is (re)initialized and after a
+///     FIFO overrun, compressed words are then dropped until an uncompressed word arrives.
+///     slotPeriodNs is the FIFO batch period, used to time the samples of compressed words.
+/// </summary>
+void initLsm6dsoFifoDecoder(fifo_decoder_t *decoder, uint32_t slotPeriodNs);
+
+/// <summary>
+///     Decodes one FIFO word.  Accelerometer and gyroscope words, compressed or not, are expanded
+///     into one LSM6DSO_XL_NC_TAG or LSM6DSO_GYRO_NC_TAG word per sample, in time order.  If the
+///     word has a timeNs each sample gets the time of its own slot.  Any other word is passed to
+///     the handler unchanged.
+/// </summary>
+/// <returns>The number of words passed to the handler</returns>
+int lsm6dsoFifoDecode(fifo_decoder_t *decoder, const fifo_word_t *word, FifoWordHandler handler);
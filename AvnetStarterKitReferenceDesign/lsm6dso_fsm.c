@@ -0,0 +1,292 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+
+#include "lsm6dso_events.h"
+#include "lsm6dso_fsm.h"
+
+// Offset of SIZE in a program, after CONFIG_A and CONFIG_B
+#define PROGRAM_SIZE_OFFSET 2
+
+// lsm6dso_ln_pg_write and lsm6dso_ln_pg_read take at most this many bytes at a time
+#define PAGE_CHUNK_SIZE 255
+
+// FSM_LC_TIMEOUT_L through FSM_START_ADD_H, FSM_PROGRAMS is followed by an unused line
+#define FSM_SETTINGS_SIZE 6
+
+/// <summary>
+///     Value of a hexadecimal digit, or -1.
+/// </summary>
+static int HexDigit(char c)
+{
+	if ((c >= '0') && (c <= '9')) {
+		return c - '0';
+	}
+	if ((c >= 'a') && (c <= 'f')) {
+		return c - 'a' + 10;
+	}
+	if ((c >= 'A') && (c <= 'F')) {
+		return c - 'A' + 10;
+	}
+	return -1;
+}
+
+/// <summary>
+///     Decodes a program image written as hexadecimal digits.
+/// </summary>
+/// <returns>The number of bytes decoded, or -1 on failure</returns>
+int lsm6dsoFsmHexDecode(const char *hex, uint8_t *image, size_t size)
+{
+	size_t length = strlen(hex);
+
+	if (((length % 2) != 0) || ((length / 2) > size)) {
+		return -1;
+	}
+
+	for (size_t i = 0; i < length / 2; i++) {
+		int high = HexDigit(hex[2 * i]);
+		int low = HexDigit(hex[2 * i + 1]);
+		if ((high < 0) || (low < 0)) {
+			return -1;
+		}
+		image[i] = (uint8_t)((high << 4) | low);
+	}
+
+	return (int)(length / 2);
+}
+
+/// <summary>
+///     Checks a program image.
+/// </summary>
+/// <returns>0 if the image is valid, or -1 if it isn't</returns>
+int lsm6dsoFsmParseImage(const uint8_t *image, size_t size, lsm6dso_fsm_image_t *parsed)
+{
+	if (size < LSM6DSO_FSM_IMAGE_HEADER_SIZE) {
+		Log_Debug("ERROR: FSM image of %u bytes has no header\n", (unsigned)size);
+		return -1;
+	}
+
+	parsed->programs = image[0];
+	parsed->odr = (lsm6dso_fsm_odr_t)image[1];
+	parsed->longCounterTimeout = (uint16_t)(image[2] | (image[3] << 8));
+	parsed->code = &image[LSM6DSO_FSM_IMAGE_HEADER_SIZE];
+	parsed->codeSize = size - LSM6DSO_FSM_IMAGE_HEADER_SIZE;
+
+	if ((parsed->programs > LSM6DSO_FSM_MAX_PROGRAMS) || (image[1] > LSM6DSO_ODR_FSM_104Hz)) {
+		Log_Debug("ERROR: FSM image with %u programs at rate %u\n", parsed->programs, image[1]);
+		return -1;
+	}
+	static const float odrHz[] = { 12.5f, 26.0f, 52.0f, 104.0f };
+	parsed->odrHz = odrHz[parsed->odr];
+
+	if (parsed->codeSize > LSM6DSO_FSM_MAX_CODE_SIZE) {
+		Log_Debug("ERROR: FSM programs of %u bytes don't fit in %u bytes\n", (unsigned)parsed->codeSize,
+			LSM6DSO_FSM_MAX_CODE_SIZE);
+		return -1;
+	}
+
+	// Every program has to end where the next one starts and the last one where the image ends
+	size_t offset = 0;
+	for (int i = 0; i < parsed->programs; i++) {
+		if (offset + PROGRAM_SIZE_OFFSET >= parsed->codeSize) {
+			Log_Debug("ERROR: FSM image ends before program %d\n", i + 1);
+			return -1;
+		}
+		uint8_t programSize = parsed->code[offset + PROGRAM_SIZE_OFFSET];
+		if (programSize <= PROGRAM_SIZE_OFFSET) {
+			Log_Debug("ERROR: FSM program %d has size %u\n", i + 1, programSize);
+			return -1;
+		}
+		offset += programSize;
+	}
+	if (offset != parsed->codeSize) {
+		Log_Debug("ERROR: FSM programs add up to %u bytes, the image holds %u\n", (unsigned)offset,
+			(unsigned)parsed->codeSize);
+		return -1;
+	}
+
+	return 0;
+}
+
+/// <summary>
+///     Writes len bytes from reg on in the embedded functions bank.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+static int EmbeddedWrite(lsm6dso_ctx_t *ctx, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	int32_t ret = lsm6dso_mem_bank_set(ctx, LSM6DSO_EMBEDDED_FUNC_BANK);
+	if (ret == 0) {
+		ret = lsm6dso_write_reg(ctx, reg, data, len);
+	}
+	// Back to the user bank even if the write failed
+	if (lsm6dso_mem_bank_set(ctx, LSM6DSO_USER_BANK) != 0) {
+		ret = -1;
+	}
+	return (ret == 0) ? 0 : -1;
+}
+
+/// <summary>
+///     Writes size bytes to the advanced pages from address on, in chunks, and reads them back.
+/// </summary>
+/// <returns>0 if everything reads back as written, or -1 on failure</returns>
+static int WritePages(lsm6dso_ctx_t *ctx, uint16_t address, const uint8_t *data, size_t size)
+{
+	uint8_t chunk[PAGE_CHUNK_SIZE];
+
+	for (size_t offset = 0; offset < size; offset += PAGE_CHUNK_SIZE) {
+		uint8_t len = (uint8_t)(((size - offset) < PAGE_CHUNK_SIZE) ? (size - offset) : PAGE_CHUNK_SIZE);
+		memcpy(chunk, &data[offset], len);
+		if (lsm6dso_ln_pg_write(ctx, (uint16_t)(address + offset), chunk, len) != 0) {
+			return -1;
+		}
+	}
+
+	for (size_t offset = 0; offset < size; offset += PAGE_CHUNK_SIZE) {
+		uint8_t len = (uint8_t)(((size - offset) < PAGE_CHUNK_SIZE) ? (size - offset) : PAGE_CHUNK_SIZE);
+		if (lsm6dso_ln_pg_read(ctx, (uint16_t)(address + offset), chunk, len) != 0) {
+			return -1;
+		}
+		if (memcmp(chunk, &data[offset], len) != 0) {
+			Log_Debug("ERROR: FSM page data at 0x%04X doesn't read back as written\n", (unsigned)(address + offset));
+			return -1;
+		}
+	}
+
+	return 0;
+}
+
+/// <summary>
+///     Stops the FSMs, writes the programs and their settings, reads them back and starts them.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoFsmLoad(lsm6dso_ctx_t *ctx, const lsm6dso_fsm_image_t *image, bool int1)
+{
+	lsm6dso_emb_fsm_enable_t enable;
+	memset(&enable, 0, sizeof(enable));
+
+	// Stop every FSM before its program changes, this also clears EMB_FUNC_EN_B fsm_en
+	if (lsm6dso_fsm_enable_set(ctx, &enable) != 0) {
+		return -1;
+	}
+	if (image->programs == 0) {
+		Log_Debug("LSM6DSO: FSM programs stopped\n");
+		return 0;
+	}
+
+	if (lsm6dso_fsm_data_rate_set(ctx, image->odr) != 0) {
+		return -1;
+	}
+
+	uint8_t settings[FSM_SETTINGS_SIZE] = {
+		(uint8_t)(image->longCounterTimeout & 0xFF),
+		(uint8_t)(image->longCounterTimeout >> 8),
+		image->programs,
+		0,
+		(uint8_t)(LSM6DSO_FSM_START_ADDRESS & 0xFF),
+		(uint8_t)(LSM6DSO_FSM_START_ADDRESS >> 8)
+	};
+	if ((lsm6dso_ln_pg_write(ctx, LSM6DSO_FSM_LC_TIMEOUT_L, &settings[0], 2) != 0) ||
+		(lsm6dso_fsm_number_of_programs_set(ctx, &settings[2]) != 0) ||
+		(lsm6dso_fsm_start_address_set(ctx, &settings[4]) != 0)) {
+		return -1;
+	}
+
+	uint8_t readBack[FSM_SETTINGS_SIZE];
+	if (lsm6dso_ln_pg_read(ctx, LSM6DSO_FSM_LC_TIMEOUT_L, readBack, FSM_SETTINGS_SIZE) != 0) {
+		return -1;
+	}
+	readBack[3] = 0;
+	if (memcmp(readBack, settings, FSM_SETTINGS_SIZE) != 0) {
+		Log_Debug("ERROR: FSM settings don't read back as written\n");
+		return -1;
+	}
+
+	if (WritePages(ctx, LSM6DSO_FSM_START_ADDRESS, image->code, image->codeSize) != 0) {
+		return -1;
+	}
+
+	// One bit per program in FSM_ENABLE_A/B and FSM_INT1_A/B
+	uint16_t programMask = (uint16_t)((1U << image->programs) - 1U);
+	uint8_t int1Routing[2] = { 0, 0 };
+	if (int1) {
+		int1Routing[0] = (uint8_t)(programMask & 0xFF);
+		int1Routing[1] = (uint8_t)(programMask >> 8);
+	}
+	if ((lsm6dsoEventsLatchEmbedded(ctx) != 0) || (EmbeddedWrite(ctx, LSM6DSO_FSM_INT1_A, int1Routing, 2) != 0)) {
+		return -1;
+	}
+
+	// Start from the reset pointer of every program
+	if (lsm6dso_fsm_init_set(ctx, PROPERTY_ENABLE) != 0) {
+		return -1;
+	}
+
+	uint8_t enableBits[2] = { (uint8_t)(programMask & 0xFF), (uint8_t)(programMask >> 8) };
+	memcpy(&enable.fsm_enable_a, &enableBits[0], 1);
+	memcpy(&enable.fsm_enable_b, &enableBits[1], 1);
+	if (lsm6dso_fsm_enable_set(ctx, &enable) != 0) {
+		return -1;
+	}
+
+	Log_Debug("LSM6DSO: %u FSM programs loaded, %u bytes\n", image->programs, (unsigned)image->codeSize);
+	return 0;
+}
+
+/// <summary>
+///     Reads the FSM status and hands every program that signalled to the handler.
+/// </summary>
+/// <returns>The number of programs that signalled, or -1 on failure</returns>
+int lsm6dsoFsmReadEvents(lsm6dso_ctx_t *ctx, FsmEventHandler handler)
+{
+	uint8_t status[2];
+
+	// FSM_STATUS_A_MAINPAGE and FSM_STATUS_B_MAINPAGE are in the user bank
+	if (lsm6dso_read_reg(ctx, LSM6DSO_FSM_STATUS_A_MAINPAGE, status, 2) != 0) {
+		return -1;
+	}
+
+	uint16_t signalled = (uint16_t)(status[0] | (status[1] << 8));
+	if (signalled == 0) {
+		return 0;
+	}
+
+	lsm6dso_fsm_out_t outs;
+	if (lsm6dso_fsm_out_get(ctx, &outs) != 0) {
+		return -1;
+	}
+	const uint8_t *outputs = (const uint8_t *)&outs;
+
+	int events = 0;
+	for (int i = 0; i < LSM6DSO_FSM_MAX_PROGRAMS; i++) {
+		if ((signalled & (1U << i)) == 0) {
+			continue;
+		}
+		lsm6dso_fsm_event_t event = { .program = i + 1, .output = outputs[i] };
+		if (handler != NULL) {
+			handler(&event);
+		}
+		events++;
+	}
+
+	return events;
+}
+
+/// <summary>
+///     Writes an event as a JSON object.
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int lsm6dsoFsmEventToJson(const lsm6dso_fsm_event_t *event, char *json, size_t size)
+{
+	int written = snprintf(json, size, "{\"fsm\":%d,\"output\":%u}", event->program, event->output);
+	if ((written < 0) || ((size_t)written >= size)) {
+		return -1;
+	}
+	return written;
+}
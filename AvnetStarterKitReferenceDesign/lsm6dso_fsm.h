@@ -0,0 +1,84 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+
+// The LSM6DSO runs up to 16 finite state machine programs
+#define LSM6DSO_FSM_MAX_PROGRAMS 16
+
+// Programs are written back to back from this address of the embedded advanced pages
+#define LSM6DSO_FSM_START_ADDRESS 0x0400
+
+// Program memory from LSM6DSO_FSM_START_ADDRESS to the end of the advanced pages
+#define LSM6DSO_FSM_MAX_CODE_SIZE 0x0400
+
+// A program image is a 4 byte header followed by the programs.  The header holds the number of
+// programs, the FSM output data rate (lsm6dso_fsm_odr_t) and the long counter timeout, little
+// endian.  Each program starts with its CONFIG_A, CONFIG_B and SIZE bytes, SIZE being the length
+// of the whole program.
+#define LSM6DSO_FSM_IMAGE_HEADER_SIZE 4
+#define LSM6DSO_FSM_MAX_IMAGE_SIZE (LSM6DSO_FSM_IMAGE_HEADER_SIZE + LSM6DSO_FSM_MAX_CODE_SIZE)
+
+// A program image checked by lsm6dsoFsmParseImage, code points into the image
+typedef struct {
+	uint8_t programs;
+	lsm6dso_fsm_odr_t odr;
+	float odrHz;
+	uint16_t longCounterTimeout;
+	const uint8_t *code;
+	size_t codeSize;
+} lsm6dso_fsm_image_t;
+
+// A program that signalled, with its FSM_OUTS register
+typedef struct {
+	// 1 to 16
+	int program;
+	uint8_t output;
+} lsm6dso_fsm_event_t;
+
+/// <summary>
+///     Function signature for the handler called once for every program that signalled.
+/// </summary>
+typedef void (*FsmEventHandler)(const lsm6dso_fsm_event_t *event);
+
+/// <summary>
+///     Decodes a program image written as hexadecimal digits, for a direct method payload or a
+///     build option.
+/// </summary>
+/// <returns>The number of bytes decoded, or -1 if hex isn't an even number of hexadecimal digits
+/// or doesn't fit in size bytes</returns>
+int lsm6dsoFsmHexDecode(const char *hex, uint8_t *image, size_t size);
+
+/// <summary>
+///     Checks the header of a program image and that the program sizes add up to the rest of it.
+///     An image with no programs is valid, loading it stops the FSMs.
+/// </summary>
+/// <returns>0 if the image is valid, or -1 if it isn't</returns>
+int lsm6dsoFsmParseImage(const uint8_t *image, size_t size, lsm6dso_fsm_image_t *parsed);
+
+/// <summary>
+///     Stops the FSMs, writes the programs through the embedded advanced pages, reads them back
+///     and starts them.  Their interrupts are latched until lsm6dsoFsmReadEvents and, with int1,
+///     routed to INT1, which also needs MD1_CFG int1_emb_func.  The FSMs are left stopped when
+///     anything fails, including the read back.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoFsmLoad(lsm6dso_ctx_t *ctx, const lsm6dso_fsm_image_t *image, bool int1);
+
+/// <summary>
+///     Reads FSM_STATUS_A/B, which clears the latched interrupts, and hands every program that
+///     signalled to the handler with its FSM_OUTS register.
+/// </summary>
+/// <returns>The number of programs that signalled, or -1 on failure</returns>
+int lsm6dsoFsmReadEvents(lsm6dso_ctx_t *ctx, FsmEventHandler handler);
+
+/// <summary>
+///     Writes an event as a JSON object, for example {"fsm":3,"output":64}
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int lsm6dsoFsmEventToJson(const lsm6dso_fsm_event_t *event, char *json, size_t size);
@@ -0,0 +1,152 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdio.h>
+#include <string.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+
+#include "lsm6dso_pedometer.h"
+#include "lsm6dso_timestamp.h"
+
+/// <summary>
+///     Switches the pedometer to mode and sets step word batching.  The driver functions select
+///     the embedded functions bank and go back to the user bank themselves.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoPedometerSet(lsm6dso_ctx_t *ctx, lsm6dso_pedo_md_t mode, bool batch)
+{
+	if (lsm6dso_pedo_sens_set(ctx, mode) != 0) {
+		return -1;
+	}
+
+	bool enabled = (mode != LSM6DSO_PEDO_DISABLE);
+	if (lsm6dso_fifo_pedo_batch_set(ctx, (enabled && batch) ? PROPERTY_ENABLE : PROPERTY_DISABLE) != 0) {
+		return -1;
+	}
+
+	if (!enabled) {
+		Log_Debug("LSM6DSO: pedometer disabled\n");
+		return 0;
+	}
+
+	if (lsm6dso_steps_reset(ctx) != 0) {
+		return -1;
+	}
+
+	Log_Debug("LSM6DSO: pedometer enabled, mode 0x%02X, %s\n", (unsigned)mode,
+		batch ? "steps batched in the FIFO" : "step counter read");
+	return 0;
+}
+
+/// <summary>
+///     Starts counting from a step counter that was just reset.
+/// </summary>
+void initLsm6dsoPedometer(lsm6dso_pedometer_t *pedometer)
+{
+	memset(pedometer, 0, sizeof(*pedometer));
+}
+
+/// <summary>
+///     Counts the steps between the last step counter value seen and counter.  The counter wraps
+///     at 65536 steps, which is hours of walking between two reads.
+/// </summary>
+/// <returns>The number of new steps</returns>
+static uint32_t CountSteps(lsm6dso_pedometer_t *pedometer, uint16_t counter)
+{
+	uint32_t newSteps = (uint16_t)(counter - pedometer->counter);
+
+	pedometer->counter = counter;
+	pedometer->steps += newSteps;
+	pedometer->periodSteps += newSteps;
+	return newSteps;
+}
+
+/// <summary>
+///     Reads STEP_COUNTER_L/STEP_COUNTER_H and counts the new steps.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoPedometerRead(lsm6dso_ctx_t *ctx, lsm6dso_pedometer_t *pedometer)
+{
+	uint8_t counter[2];
+
+	if (lsm6dso_number_of_steps_get(ctx, counter) != 0) {
+		return -1;
+	}
+
+	CountSteps(pedometer, (uint16_t)(counter[0] | (counter[1] << 8)));
+	return 0;
+}
+
+/// <summary>
+///     Counts a FIFO step word.  The six data bytes hold the step counter, little endian, and
+///     the 32 bit timestamp counter when the step was detected.
+/// </summary>
+/// <returns>true if word was a step word</returns>
+bool lsm6dsoPedometerFifoWord(lsm6dso_pedometer_t *pedometer, const fifo_word_t *word)
+{
+	if (word->tag != LSM6DSO_STEP_CPUNTER_TAG) {
+		return false;
+	}
+
+	const uint8_t *raw = word->data.u8bit;
+	uint16_t counter = (uint16_t)(raw[0] | (raw[1] << 8));
+	uint32_t ticks = (uint32_t)raw[2] | ((uint32_t)raw[3] << 8) | ((uint32_t)raw[4] << 16) | ((uint32_t)raw[5] << 24);
+
+	uint32_t newSteps = CountSteps(pedometer, counter);
+	if (pedometer->stepWords == 0) {
+		pedometer->firstTicks = ticks;
+	}
+	else {
+		pedometer->timedSteps += newSteps;
+	}
+	pedometer->lastTicks = ticks;
+	pedometer->stepWords++;
+	return true;
+}
+
+/// <summary>
+///     Steps per minute over the current period.
+/// </summary>
+float lsm6dsoPedometerStepsPerMinute(const lsm6dso_pedometer_t *pedometer, float periodSeconds)
+{
+	// The timestamps are 0 when the timestamp counter is off, the difference wraps with the counter
+	uint32_t ticks = pedometer->lastTicks - pedometer->firstTicks;
+	if ((pedometer->stepWords >= 2) && (ticks > 0)) {
+		return (float)((double)pedometer->timedSteps * 60e9 / ((double)ticks * LSM6DSO_TIMESTAMP_TICK_NS));
+	}
+
+	if (periodSeconds > 0.0f) {
+		return (float)pedometer->periodSteps * 60.0f / periodSeconds;
+	}
+	return 0.0f;
+}
+
+/// <summary>
+///     Writes the counters as a JSON object.
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int lsm6dsoPedometerToJson(const lsm6dso_pedometer_t *pedometer, float periodSeconds, char *json, size_t size)
+{
+	int written = snprintf(json, size, "{\"steps\":%u,\"newSteps\":%u,\"stepsPerMin\":%.1f}", pedometer->steps,
+		pedometer->periodSteps, lsm6dsoPedometerStepsPerMinute(pedometer, periodSeconds));
+	if ((written < 0) || ((size_t)written >= size)) {
+		return -1;
+	}
+	return written;
+}
+
+/// <summary>
+///     Starts a new period.
+/// </summary>
+void lsm6dsoPedometerNewPeriod(lsm6dso_pedometer_t *pedometer)
+{
+	pedometer->periodSteps = 0;
+	pedometer->stepWords = 0;
+	pedometer->firstTicks = 0;
+	pedometer->lastTicks = 0;
+	pedometer->timedSteps = 0;
+}
@@ -0,0 +1,73 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+#include "lsm6dso_fifo.h"
+
+/// <summary>
+///     Steps counted by the LSM6DSO pedometer.  The 16 bit step counter is followed from FIFO step
+///     words or from STEP_COUNTER reads, and the steps since the last lsm6dsoPedometerNewPeriod are
+///     kept with the step counter timestamps of the first and last step word among them, which
+///     give the step rate without looking at a single acceleration sample.
+/// </summary>
+typedef struct {
+	// Steps since the counter was reset, unwrapped
+	uint32_t steps;
+	// Step counter value last seen
+	uint16_t counter;
+	// Steps of the current period
+	uint32_t periodSteps;
+	// Step words of the current period, the timestamps of the first and last and the steps between them
+	uint32_t stepWords;
+	uint32_t firstTicks;
+	uint32_t lastTicks;
+	uint32_t timedSteps;
+} lsm6dso_pedometer_t;
+
+/// <summary>
+///     Switches the pedometer to mode, with or without a FIFO step word for every step, and
+///     resets the step counter when it is switched on.  Call initLsm6dsoPedometer afterwards.
+///     The pedometer needs the accelerometer at 26 Hz or faster.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoPedometerSet(lsm6dso_ctx_t *ctx, lsm6dso_pedo_md_t mode, bool batch);
+
+/// <summary>
+///     Starts counting from a step counter that was just reset.
+/// </summary>
+void initLsm6dsoPedometer(lsm6dso_pedometer_t *pedometer);
+
+/// <summary>
+///     Reads STEP_COUNTER and counts the steps taken since it was last seen.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoPedometerRead(lsm6dso_ctx_t *ctx, lsm6dso_pedometer_t *pedometer);
+
+/// <summary>
+///     Counts a FIFO step word, which holds the step counter and the timestamp counter at the
+///     step.  Other words are ignored.
+/// </summary>
+/// <returns>true if word was a step word</returns>
+bool lsm6dsoPedometerFifoWord(lsm6dso_pedometer_t *pedometer, const fifo_word_t *word);
+
+/// <summary>
+///     Steps per minute over the current period.  Taken from the timestamps of the step words
+///     when the period has two or more, otherwise the period steps are spread over periodSeconds.
+/// </summary>
+float lsm6dsoPedometerStepsPerMinute(const lsm6dso_pedometer_t *pedometer, float periodSeconds);
+
+/// <summary>
+///     Writes the counters as a JSON object, for example {"steps":1234,"newSteps":52,"stepsPerMin":104.2}
+/// </summary>
+/// <returns>The length of the JSON string, or -1 if it doesn't fit in the buffer</returns>
+int lsm6dsoPedometerToJson(const lsm6dso_pedometer_t *pedometer, float periodSeconds, char *json, size_t size);
+
+/// <summary>
+///     Starts a new period, steps keeps counting.
+/// </summary>
+void lsm6dsoPedometerNewPeriod(lsm6dso_pedometer_t *pedometer);
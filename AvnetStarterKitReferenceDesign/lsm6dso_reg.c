@@ -1315,16 +1315,17 @@ int32_t lsm6dso_ln_pg_write(lsm6dso_ctx_t *ctx, uint16_t address,
                             uint8_t *buf, uint8_t len)
 {
   lsm6dso_page_rw_t page_rw;
-  lsm6dso_page_sel_t page_sel;
+  lsm6dso_page_sel_t page_sel = { 0 };
   lsm6dso_page_address_t  page_address;
-  int32_t ret;
+  int32_t ret, bank_ret, err;
   uint8_t msb, lsb;
   uint8_t i ;
 
   msb = ((uint8_t)(address >> 8) & 0x0fU);
   lsb = (uint8_t)address & 0xFFU;
 
-  ret = lsm6dso_mem_bank_set(ctx, LSM6DSO_EMBEDDED_FUNC_BANK);
+  bank_ret = lsm6dso_mem_bank_set(ctx, LSM6DSO_EMBEDDED_FUNC_BANK);
+  ret = bank_ret;
   if (ret == 0) {
 
     ret = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_RW, (uint8_t*) &page_rw, 1);
@@ -1352,10 +1353,10 @@ int32_t lsm6dso_ln_pg_write(lsm6dso_ctx_t *ctx, uint16_t address,
     for (i = 0; ( (i < len) && (ret == 0) ); i++)
     {
       ret = lsm6dso_write_reg(ctx, LSM6DSO_PAGE_VALUE, &buf[i], 1);
+      lsb++;
 
       /* Check if page wrap */
       if ( (lsb == 0x00U) && (ret == 0) ) {
-        lsb++;
         msb++;
         ret = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_SEL, (uint8_t*)&page_sel, 1);
         if (ret == 0) {
@@ -1366,22 +1367,31 @@ int32_t lsm6dso_ln_pg_write(lsm6dso_ctx_t *ctx, uint16_t address,
         }
       }
     }
+  }
+
+  /* Page 0, page_write off and the user bank are restored even after a
+   * failure, the first error is the one returned */
+  if (bank_ret == 0) {
     page_sel.page_sel = 0;
     page_sel.not_used_01 = 1;
-    ret = lsm6dso_write_reg(ctx, LSM6DSO_PAGE_SEL, (uint8_t*) &page_sel, 1);
-  }
-  if (ret == 0) {
+    err = lsm6dso_write_reg(ctx, LSM6DSO_PAGE_SEL, (uint8_t*) &page_sel, 1);
+    if (ret == 0) {
+      ret = err;
+    }
 
-    ret = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_RW, (uint8_t*) &page_rw, 1);
-  }
-  if (ret == 0) {
-    page_rw.page_rw = 0x00; /* page_write disable */
-    ret = lsm6dso_write_reg(ctx, LSM6DSO_PAGE_RW, (uint8_t*) &page_rw, 1);
+    err = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_RW, (uint8_t*) &page_rw, 1);
+    if (err == 0) {
+      page_rw.page_rw = 0x00; /* page_write disable */
+      err = lsm6dso_write_reg(ctx, LSM6DSO_PAGE_RW, (uint8_t*) &page_rw, 1);
+    }
+    if (ret == 0) {
+      ret = err;
+    }
   }
 
+  err = lsm6dso_mem_bank_set(ctx, LSM6DSO_USER_BANK);
   if (ret == 0) {
-
-    ret = lsm6dso_mem_bank_set(ctx, LSM6DSO_USER_BANK);
+    ret = err;
   }
   return ret;
 }
@@ -1427,7 +1437,7 @@ int32_t lsm6dso_ln_pg_read_byte(lsm6dso_ctx_t *ctx, uint16_t address,
   }
   if (ret == 0) {
 
-    ret = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_VALUE, val, 2);
+    ret = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_VALUE, val, 1);
   }
   if (ret == 0) {
     ret = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_RW, (uint8_t*) &page_rw, 1);
@@ -1443,6 +1453,100 @@ int32_t lsm6dso_ln_pg_read_byte(lsm6dso_ctx_t *ctx, uint16_t address,
   return ret;
 }
 
+/**
+  * @brief  Read buffer in a page.[get]
+  *
+  * @param  ctx      read / write interface definitions
+  * @param  uint8_t address: page line address
+  * @param  uint8_t *buf: buffer to read
+  * @param  uint8_t len: buffer len
+  *
+  */
+int32_t lsm6dso_ln_pg_read(lsm6dso_ctx_t *ctx, uint16_t address,
+                           uint8_t *buf, uint8_t len)
+{
+  lsm6dso_page_rw_t page_rw;
+  lsm6dso_page_sel_t page_sel = { 0 };
+  lsm6dso_page_address_t  page_address;
+  int32_t ret, bank_ret, err;
+  uint8_t msb, lsb;
+  uint8_t i ;
+
+  msb = ((uint8_t)(address >> 8) & 0x0fU);
+  lsb = (uint8_t)address & 0xFFU;
+
+  bank_ret = lsm6dso_mem_bank_set(ctx, LSM6DSO_EMBEDDED_FUNC_BANK);
+  ret = bank_ret;
+  if (ret == 0) {
+    ret = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_RW, (uint8_t*) &page_rw, 1);
+  }
+  if (ret == 0) {
+    page_rw.page_rw = 0x01; /* page_read enable*/
+    ret = lsm6dso_write_reg(ctx, LSM6DSO_PAGE_RW, (uint8_t*) &page_rw, 1);
+  }
+  if (ret == 0) {
+    ret = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_SEL, (uint8_t*) &page_sel, 1);
+  }
+  if (ret == 0) {
+    page_sel.page_sel = msb;
+    page_sel.not_used_01 = 1;
+    ret = lsm6dso_write_reg(ctx, LSM6DSO_PAGE_SEL, (uint8_t*) &page_sel, 1);
+  }
+  if (ret == 0) {
+    page_address.page_addr = lsb;
+    ret = lsm6dso_write_reg(ctx, LSM6DSO_PAGE_ADDRESS,
+                            (uint8_t*)&page_address, 1);
+  }
+
+  if (ret == 0) {
+
+    for (i = 0; ( (i < len) && (ret == 0) ); i++)
+    {
+      /* One byte per read, PAGE_VALUE is not followed by the next line */
+      ret = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_VALUE, &buf[i], 1);
+      lsb++;
+
+      /* Check if page wrap */
+      if ( (lsb == 0x00U) && (ret == 0) ) {
+        msb++;
+        ret = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_SEL, (uint8_t*)&page_sel, 1);
+        if (ret == 0) {
+          page_sel.page_sel = msb;
+          page_sel.not_used_01 = 1;
+          ret = lsm6dso_write_reg(ctx, LSM6DSO_PAGE_SEL,
+                                  (uint8_t*)&page_sel, 1);
+        }
+      }
+    }
+  }
+
+  /* Page 0, page_read off and the user bank are restored even after a
+   * failure, the first error is the one returned */
+  if (bank_ret == 0) {
+    page_sel.page_sel = 0;
+    page_sel.not_used_01 = 1;
+    err = lsm6dso_write_reg(ctx, LSM6DSO_PAGE_SEL, (uint8_t*) &page_sel, 1);
+    if (ret == 0) {
+      ret = err;
+    }
+
+    err = lsm6dso_read_reg(ctx, LSM6DSO_PAGE_RW, (uint8_t*) &page_rw, 1);
+    if (err == 0) {
+      page_rw.page_rw = 0x00; /* page_read disable */
+      err = lsm6dso_write_reg(ctx, LSM6DSO_PAGE_RW, (uint8_t*) &page_rw, 1);
+    }
+    if (ret == 0) {
+      ret = err;
+    }
+  }
+
+  err = lsm6dso_mem_bank_set(ctx, LSM6DSO_USER_BANK);
+  if (ret == 0) {
+    ret = err;
+  }
+  return ret;
+}
+
 /**
   * @brief  Data-ready pulsed / letched mode.[set]
   *
@@ -7913,7 +8017,7 @@ int32_t lsm6dso_fsm_out_get(lsm6dso_ctx_t *ctx, lsm6dso_fsm_out_t *val)
 
   ret = lsm6dso_mem_bank_set(ctx, LSM6DSO_EMBEDDED_FUNC_BANK);
   if (ret == 0) {
-    ret = lsm6dso_read_reg(ctx, LSM6DSO_FSM_OUTS1, (uint8_t*) &val, 16);
+    ret = lsm6dso_read_reg(ctx, LSM6DSO_FSM_OUTS1, (uint8_t*) val, 16);
   }
   if (ret == 0) {
     ret = lsm6dso_mem_bank_set(ctx, LSM6DSO_USER_BANK);
@@ -8646,7 +8750,7 @@ int32_t lsm6dso_sh_reset_get(lsm6dso_ctx_t *ctx, uint8_t *val)
   * @brief  Rate at which the master communicates.[set]
   *
   * @param  ctx      read / write interface definitions
-  * @param  val      change the values of shub_odr in reg slv1_CONFIG
+  * @param  val      change the values of shub_odr in reg slv0_CONFIG
   *
   */
 int32_t lsm6dso_sh_data_rate_set(lsm6dso_ctx_t *ctx, lsm6dso_shub_odr_t val)
@@ -8656,11 +8760,11 @@ int32_t lsm6dso_sh_data_rate_set(lsm6dso_ctx_t *ctx, lsm6dso_shub_odr_t val)
 
   ret = lsm6dso_mem_bank_set(ctx, LSM6DSO_SENSOR_HUB_BANK);
   if (ret == 0) {
-    ret = lsm6dso_read_reg(ctx, LSM6DSO_SLV1_CONFIG, (uint8_t*)&reg, 1);
+    ret = lsm6dso_read_reg(ctx, LSM6DSO_SLV0_CONFIG, (uint8_t*)&reg, 1);
   }
   if (ret == 0) {
     reg.shub_odr = (uint8_t)val;
-    ret = lsm6dso_write_reg(ctx, LSM6DSO_SLV1_CONFIG, (uint8_t*)&reg, 1);
+    ret = lsm6dso_write_reg(ctx, LSM6DSO_SLV0_CONFIG, (uint8_t*)&reg, 1);
   }
   if (ret == 0) {
     ret = lsm6dso_mem_bank_set(ctx, LSM6DSO_USER_BANK);
@@ -8673,7 +8777,7 @@ int32_t lsm6dso_sh_data_rate_set(lsm6dso_ctx_t *ctx, lsm6dso_shub_odr_t val)
   * @brief  Rate at which the master communicates.[get]
   *
   * @param  ctx      read / write interface definitions
-  * @param  val      Get the values of shub_odr in reg slv1_CONFIG
+  * @param  val      Get the values of shub_odr in reg slv0_CONFIG
   *
   */
 int32_t lsm6dso_sh_data_rate_get(lsm6dso_ctx_t *ctx,
@@ -8684,7 +8788,7 @@ int32_t lsm6dso_sh_data_rate_get(lsm6dso_ctx_t *ctx,
 
   ret = lsm6dso_mem_bank_set(ctx, LSM6DSO_SENSOR_HUB_BANK);
   if (ret == 0) {
-    ret = lsm6dso_read_reg(ctx, LSM6DSO_SLV1_CONFIG, (uint8_t*)&reg, 1);
+    ret = lsm6dso_read_reg(ctx, LSM6DSO_SLV0_CONFIG, (uint8_t*)&reg, 1);
   }
   if (ret == 0) {
     switch (reg.shub_odr) {
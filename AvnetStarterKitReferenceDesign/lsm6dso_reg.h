@@ -1728,7 +1728,7 @@ int32_t lsm6dso_ln_pg_read_byte(lsm6dso_ctx_t *ctx, uint16_t address,
 int32_t lsm6dso_ln_pg_write(lsm6dso_ctx_t *ctx, uint16_t address,
                             uint8_t *buf, uint8_t len);
 int32_t lsm6dso_ln_pg_read(lsm6dso_ctx_t *ctx, uint16_t address,
-                           uint8_t *val);
+                           uint8_t *buf, uint8_t len);
 
 typedef enum {
   LSM6DSO_DRDY_LATCHED = 0,
@@ -0,0 +1,223 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <stdbool.h>
+#include <string.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+
+#include "lsm6dso_shadow.h"
+
+// CTRL3_C bits that start a reset/reboot, the device clears them once it's done
+#define CTRL3_C_RESET_BITS 0x81
+
+typedef struct {
+	uint8_t first;
+	uint8_t last;
+	// Bits the device clears on its own, a register holding any of them is never shadowed
+	uint8_t selfClearingBits;
+} shadow_range_t;
+
+// User bank registers only the host writes, status and output registers always go to the bus
+static const shadow_range_t shadowRanges[] = {
+	{LSM6DSO_PIN_CTRL, LSM6DSO_PIN_CTRL, 0x00},
+	{LSM6DSO_FIFO_CTRL1, LSM6DSO_FIFO_CTRL4, 0x00},
+	{LSM6DSO_COUNTER_BDR_REG1, LSM6DSO_COUNTER_BDR_REG1, 0x40},
+	{LSM6DSO_COUNTER_BDR_REG2, LSM6DSO_INT2_CTRL, 0x00},
+	{LSM6DSO_CTRL1_XL, LSM6DSO_CTRL2_G, 0x00},
+	{LSM6DSO_CTRL3_C, LSM6DSO_CTRL3_C, CTRL3_C_RESET_BITS},
+	{LSM6DSO_CTRL4_C, LSM6DSO_CTRL10_C, 0x00},
+	{LSM6DSO_TAP_CFG0, LSM6DSO_MD2_CFG, 0x00},
+	{LSM6DSO_I3C_BUS_AVB, LSM6DSO_I3C_BUS_AVB, 0x00},
+	{LSM6DSO_X_OFS_USR, LSM6DSO_Z_OFS_USR, 0x00},
+};
+
+static lsm6dso_read_ptr busRead = NULL;
+static lsm6dso_write_ptr busWrite = NULL;
+
+static uint8_t shadow[LSM6DSO_SHADOW_SIZE];
+static bool shadowValid[LSM6DSO_SHADOW_SIZE];
+
+// FUNC_CFG_ACCESS is mapped in every bank, the rest of the shadow only while the user bank is selected
+static lsm6dso_reg_access_t currentBank = LSM6DSO_USER_BANK;
+
+static lsm6dso_shadow_stats_t shadowStats;
+
+/// <summary>
+///     Looks up a register in the shadow map.
+/// </summary>
+/// <returns>true if the register is shadowed, selfClearingBits is set to its self-clearing bits</returns>
+static bool IsShadowed(uint16_t reg, uint8_t *selfClearingBits)
+{
+	*selfClearingBits = 0x00;
+
+	if (reg == LSM6DSO_FUNC_CFG_ACCESS) {
+		return true;
+	}
+
+	if (currentBank != LSM6DSO_USER_BANK) {
+		return false;
+	}
+
+	for (size_t i = 0; i < sizeof(shadowRanges) / sizeof(shadowRanges[0]); i++) {
+		if ((reg >= shadowRanges[i].first) && (reg <= shadowRanges[i].last)) {
+			*selfClearingBits = shadowRanges[i].selfClearingBits;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+/// <summary>
+///     Records register values that were just read from or written to the device.
+/// </summary>
+static void UpdateShadow(uint8_t reg, const uint8_t *data, uint16_t len)
+{
+	uint8_t selfClearingBits;
+
+	for (uint16_t i = 0; i < len; i++) {
+
+		uint16_t address = (uint16_t)(reg + i);
+		if (address >= LSM6DSO_SHADOW_SIZE) {
+			break;
+		}
+
+		if (!IsShadowed(address, &selfClearingBits)) {
+			continue;
+		}
+
+		// The device will change this value behind our back, read it from the bus next time
+		if ((data[i] & selfClearingBits) != 0) {
+			shadowValid[address] = false;
+			continue;
+		}
+
+		shadow[address] = data[i];
+		shadowValid[address] = true;
+	}
+}
+
+/// <summary>
+///     Forgets the shadowed values in a register range.
+/// </summary>
+static void InvalidateRange(uint8_t reg, uint16_t len)
+{
+	for (uint16_t i = 0; (i < len) && (reg + i < LSM6DSO_SHADOW_SIZE); i++) {
+		shadowValid[reg + i] = false;
+	}
+}
+
+/// <summary>
+///     lsm6dso_ctx_t read_reg hook.  Answers the read from the shadow when every register in
+///     the range is shadowed and known, otherwise reads the bus and fills the shadow.
+/// </summary>
+static int32_t ShadowRead(int *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	bool hit = (len > 0);
+	uint8_t selfClearingBits;
+
+	for (uint16_t i = 0; hit && (i < len); i++) {
+		uint16_t address = (uint16_t)(reg + i);
+		hit = (address < LSM6DSO_SHADOW_SIZE) && IsShadowed(address, &selfClearingBits) && shadowValid[address];
+	}
+
+	if (hit) {
+		memcpy(data, &shadow[reg], len);
+		shadowStats.shadowReads++;
+		return 0;
+	}
+
+	shadowStats.busReads++;
+	int32_t ret = busRead(handle, reg, data, len);
+	if (ret == 0) {
+		UpdateShadow(reg, data, len);
+	}
+
+	return ret;
+}
+
+/// <summary>
+///     lsm6dso_ctx_t write_reg hook.  Writes through to the bus and keeps the shadow and the
+///     selected register bank in step with the device.
+/// </summary>
+static int32_t ShadowWrite(int *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	shadowStats.busWrites++;
+	int32_t ret = busWrite(handle, reg, data, len);
+	if (ret != 0) {
+		// We don't know what the device ended up with
+		InvalidateRange(reg, len);
+		return ret;
+	}
+
+	// Software reset and reboot restore the register defaults and select the user bank
+	if ((currentBank == LSM6DSO_USER_BANK) && (reg <= LSM6DSO_CTRL3_C) && (reg + len > LSM6DSO_CTRL3_C) &&
+		((data[LSM6DSO_CTRL3_C - reg] & CTRL3_C_RESET_BITS) != 0)) {
+		invalidateLsm6dsoShadow();
+		return ret;
+	}
+
+	UpdateShadow(reg, data, len);
+
+	if ((reg <= LSM6DSO_FUNC_CFG_ACCESS) && (reg + len > LSM6DSO_FUNC_CFG_ACCESS)) {
+		lsm6dso_func_cfg_access_t *access = (lsm6dso_func_cfg_access_t *)&data[LSM6DSO_FUNC_CFG_ACCESS - reg];
+		currentBank = (lsm6dso_reg_access_t)access->reg_access;
+	}
+
+	return ret;
+}
+
+/// <summary>
+///     Installs the shadow between the driver and the ctx bus hooks.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int initLsm6dsoShadow(lsm6dso_ctx_t *ctx)
+{
+	if ((ctx->read_reg == NULL) || (ctx->write_reg == NULL)) {
+		Log_Debug("ERROR: LSM6DSO bus hooks must be set before the shadow is installed\n");
+		return -1;
+	}
+
+	// Installing twice would make the shadow call itself
+	if (ctx->read_reg != ShadowRead) {
+		busRead = ctx->read_reg;
+		busWrite = ctx->write_reg;
+		ctx->read_reg = ShadowRead;
+		ctx->write_reg = ShadowWrite;
+	}
+
+	invalidateLsm6dsoShadow();
+	resetLsm6dsoShadowStats();
+
+	return 0;
+}
+
+/// <summary>
+///     Forgets every shadowed register.
+/// </summary>
+void invalidateLsm6dsoShadow(void)
+{
+	memset(shadowValid, 0, sizeof(shadowValid));
+	currentBank = LSM6DSO_USER_BANK;
+	shadowStats.invalidations++;
+}
+
+/// <summary>
+///     Returns the bus/shadow transaction counters.
+/// </summary>
+const lsm6dso_shadow_stats_t *getLsm6dsoShadowStats(void)
+{
+	return &shadowStats;
+}
+
+/// <summary>
+///     Clears the transaction counters.
+/// </summary>
+void resetLsm6dsoShadowStats(void)
+{
+	memset(&shadowStats, 0, sizeof(shadowStats));
+}
@@ -0,0 +1,44 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+
+// The shadow covers the user bank register map, 0x00 - 0x7F
+#define LSM6DSO_SHADOW_SIZE 0x80
+
+typedef struct {
+	// Transactions forwarded to the bus
+	uint32_t busReads;
+	uint32_t busWrites;
+	// Reads answered from the shadow without touching the bus
+	uint32_t shadowReads;
+	uint32_t invalidations;
+} lsm6dso_shadow_stats_t;
+
+/// <summary>
+///     Installs a write-through shadow of the LSM6DSO control registers between the driver
+///     and the ctx read_reg/write_reg hooks.  The read half of the read-modify-write done by
+///     every lsm6dso_*_set is then answered from the shadow and only the write reaches the bus.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int initLsm6dsoShadow(lsm6dso_ctx_t *ctx);
+
+/// <summary>
+///     Forgets every shadowed register.  Called automatically when sw_reset or boot is written
+///     to CTRL3_C, call it directly if the device is reset by other means (power cycle).
+/// </summary>
+void invalidateLsm6dsoShadow(void);
+
+/// <summary>
+///     Returns the bus/shadow transaction counters.
+/// </summary>
+const lsm6dso_shadow_stats_t *getLsm6dsoShadowStats(void);
+
+/// <summary>
+///     Clears the transaction counters, the shadowed registers are kept.
+/// </summary>
+void resetLsm6dsoShadowStats(void);
@@ -0,0 +1,72 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+
+#include "lsm6dso_events.h"
+#include "lsm6dso_tilt.h"
+
+/// <summary>
+///     Routes the tilt interrupt to INT1 or takes it off.  EMB_FUNC_INT1 is in the embedded
+///     functions bank.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+static int RouteTilt(lsm6dso_ctx_t *ctx, bool int1)
+{
+	lsm6dso_emb_func_int1_t embFuncInt1;
+
+	int32_t ret = lsm6dso_mem_bank_set(ctx, LSM6DSO_EMBEDDED_FUNC_BANK);
+	if (ret == 0) {
+		ret = lsm6dso_read_reg(ctx, LSM6DSO_EMB_FUNC_INT1, (uint8_t *)&embFuncInt1, 1);
+	}
+	if (ret == 0) {
+		embFuncInt1.int1_tilt = int1 ? PROPERTY_ENABLE : PROPERTY_DISABLE;
+		ret = lsm6dso_write_reg(ctx, LSM6DSO_EMB_FUNC_INT1, (uint8_t *)&embFuncInt1, 1);
+	}
+	// Back to the user bank even if the write failed
+	if (lsm6dso_mem_bank_set(ctx, LSM6DSO_USER_BANK) != 0) {
+		ret = -1;
+	}
+	return (ret == 0) ? 0 : -1;
+}
+
+/// <summary>
+///     Switches tilt detection on or off.  The driver function selects the embedded functions
+///     bank and goes back to the user bank itself.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoTiltSet(lsm6dso_ctx_t *ctx, bool enable, bool int1)
+{
+	if (enable && (lsm6dsoEventsLatchEmbedded(ctx) != 0)) {
+		return -1;
+	}
+	if (RouteTilt(ctx, enable && int1) != 0) {
+		return -1;
+	}
+	if (lsm6dso_tilt_sens_set(ctx, enable ? PROPERTY_ENABLE : PROPERTY_DISABLE) != 0) {
+		return -1;
+	}
+
+	Log_Debug("LSM6DSO: tilt detection %s\n", enable ? (int1 ? "enabled on INT1" : "enabled") : "disabled");
+	return 0;
+}
+
+/// <summary>
+///     Reads the tilt flag.  EMB_FUNC_STATUS_MAINPAGE holds the same flag as EMB_FUNC_STATUS, which
+///     lsm6dso_tilt_flag_data_ready_get reads, without switching banks back and forth.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoTiltRead(lsm6dso_ctx_t *ctx, bool *tilt)
+{
+	lsm6dso_emb_func_status_mainpage_t status;
+
+	if (lsm6dso_read_reg(ctx, LSM6DSO_EMB_FUNC_STATUS_MAINPAGE, (uint8_t *)&status, 1) != 0) {
+		return -1;
+	}
+
+	*tilt = (status.is_tilt != 0);
+	return 0;
+}
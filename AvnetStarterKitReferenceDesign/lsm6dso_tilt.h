@@ -0,0 +1,21 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include "lsm6dso_reg.h"
+
+/// <summary>
+///     Switches tilt detection on or off.  Its interrupt is latched until lsm6dsoTiltRead and,
+///     with int1, routed to INT1, which also needs MD1_CFG int1_emb_func.  Tilt detection needs
+///     the accelerometer at 26 Hz or faster.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoTiltSet(lsm6dso_ctx_t *ctx, bool enable, bool int1);
+
+/// <summary>
+///     Reads the tilt flag, which also clears the latched interrupt.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoTiltRead(lsm6dso_ctx_t *ctx, bool *tilt);
@@ -0,0 +1,265 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#include <string.h>
+#include <time.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+
+#include "lsm6dso_timestamp.h"
+
+// The counter is 32 bits of 25 us ticks and wraps about every 30 hours.  Every counter value seen,
+// from TIMESTAMP0..3 or from a FIFO timestamp word, is unwrapped against the newest value seen so
+// far, which works for values up to 2^31 ticks either side of it.
+//
+// Ticks are mapped to CLOCK_MONOTONIC with an anchor and a rate: time = anchorNs + (ticks -
+// anchorTicks) * nsPerTick.  Each sync measures the error of the mapping, moves the anchor part
+// of the way towards it and, once enough time has passed, re-measures the rate.
+
+static bool synced;
+static uint64_t newestTicks;
+static uint64_t anchorTicks;
+static double anchorNs;
+static double nsPerTick;
+static double nominalNsPerTick;
+
+// Start of the current rate measurement, and of the one that takes over when it's a window long
+static uint64_t rateStartTicks;
+static uint64_t rateStartNs;
+static bool nextRateStarted;
+static uint64_t nextRateStartTicks;
+static uint64_t nextRateStartNs;
+
+// CLOCK_REALTIME - CLOCK_MONOTONIC at the last sync
+static int64_t utcOffsetNs;
+
+// FIFO time slot tracking, slots are counted from the tag_cnt changes between words
+static uint32_t slotPeriodTicks;
+static uint8_t lastTagCount;
+static uint64_t slot;
+static bool slotTicksKnown;
+static uint64_t slotTicksBase;
+static uint64_t slotBase;
+
+static lsm6dso_timestamp_stats_t timestampStats;
+
+/// <summary>
+///     Returns the time in nanoseconds.
+/// </summary>
+static uint64_t ClockNs(clockid_t clock)
+{
+	struct timespec now;
+	clock_gettime(clock, &now);
+	return (uint64_t)now.tv_sec * 1000000000ULL + (uint64_t)now.tv_nsec;
+}
+
+/// <summary>
+///     Extends a 32 bit counter value to 64 bits.
+/// </summary>
+static uint64_t Unwrap(uint32_t ticks)
+{
+	int32_t delta = (int32_t)(ticks - (uint32_t)newestTicks);
+	uint64_t unwrapped = newestTicks + (uint64_t)(int64_t)delta;
+
+	if (delta > 0) {
+		newestTicks = unwrapped;
+	}
+
+	return unwrapped;
+}
+
+/// <summary>
+///     Maps unwrapped ticks to CLOCK_MONOTONIC nanoseconds.
+/// </summary>
+static double TicksToNs(uint64_t ticks)
+{
+	return anchorNs + ((double)(int64_t)(ticks - anchorTicks)) * nsPerTick;
+}
+
+/// <summary>
+///     Starts the timestamp counter and batches it into the FIFO.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int initLsm6dsoTimestamp(lsm6dso_ctx_t *ctx, lsm6dso_odr_ts_batch_t decimation, float batchHz)
+{
+	uint8_t freqFine;
+
+	memset(&timestampStats, 0, sizeof(timestampStats));
+	synced = false;
+	newestTicks = 0;
+
+	// The trimmed counter period is 25 us / (1 + 0.0015 * INTERNAL_FREQ_FINE)
+	if (lsm6dso_odr_cal_reg_get(ctx, &freqFine) != 0) {
+		return -1;
+	}
+	nominalNsPerTick = LSM6DSO_TIMESTAMP_TICK_NS / (1.0 + 0.0015 * (double)(int8_t)freqFine);
+	nsPerTick = nominalNsPerTick;
+
+	lsm6dsoTimestampSetBatchRate(batchHz);
+
+	if (lsm6dso_timestamp_set(ctx, PROPERTY_ENABLE) != 0) {
+		return -1;
+	}
+
+	if (lsm6dso_fifo_timestamp_decimation_set(ctx, decimation) != 0) {
+		return -1;
+	}
+
+	if (lsm6dsoTimestampSync(ctx) != 0) {
+		return -1;
+	}
+
+	Log_Debug("LSM6DSO: timestamps enabled, %.1f ns per tick\n", nominalNsPerTick);
+	return 0;
+}
+
+/// <summary>
+///     Reads the counter and CLOCK_MONOTONIC together to correct the mapping between them.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoTimestampSync(lsm6dso_ctx_t *ctx)
+{
+	uint8_t raw[4];
+
+	uint64_t before = ClockNs(CLOCK_MONOTONIC);
+	if (lsm6dso_timestamp_raw_get(ctx, raw) != 0) {
+		return -1;
+	}
+	uint64_t after = ClockNs(CLOCK_MONOTONIC);
+	int64_t utcOffset = (int64_t)(ClockNs(CLOCK_REALTIME) - after);
+
+	if (after - before > LSM6DSO_TIMESTAMP_MAX_SYNC_NS) {
+		timestampStats.rejectedSyncs++;
+		return 0;
+	}
+
+	// The counter was sampled somewhere in the read, take the middle
+	uint64_t nowNs = before + (after - before) / 2;
+	uint64_t ticks = Unwrap((uint32_t)raw[0] | ((uint32_t)raw[1] << 8) | ((uint32_t)raw[2] << 16) | ((uint32_t)raw[3] << 24));
+
+	if (!synced) {
+		anchorTicks = ticks;
+		anchorNs = (double)nowNs;
+		rateStartTicks = ticks;
+		rateStartNs = nowNs;
+		nextRateStarted = false;
+		synced = true;
+	}
+	else {
+		double rateSpanNs = (double)(ticks - rateStartTicks) * nominalNsPerTick;
+		if (rateSpanNs >= LSM6DSO_TIMESTAMP_RATE_MIN_SECONDS * 1e9) {
+			nsPerTick = (double)(nowNs - rateStartNs) / (double)(ticks - rateStartTicks);
+		}
+
+		// Hand over to the measurement started half a window ago, or start afresh if the syncs
+		// stopped for longer than that
+		if (rateSpanNs >= LSM6DSO_TIMESTAMP_RATE_WINDOW_SECONDS * 1e9) {
+			rateStartTicks = nextRateStarted ? nextRateStartTicks : ticks;
+			rateStartNs = nextRateStarted ? nextRateStartNs : nowNs;
+			nextRateStarted = false;
+		}
+		else if (!nextRateStarted && (rateSpanNs >= LSM6DSO_TIMESTAMP_RATE_WINDOW_SECONDS * 0.5e9)) {
+			nextRateStartTicks = ticks;
+			nextRateStartNs = nowNs;
+			nextRateStarted = true;
+		}
+
+		double predictedNs = TicksToNs(ticks);
+		double errorNs = (double)nowNs - predictedNs;
+		anchorTicks = ticks;
+		anchorNs = predictedNs + errorNs / LSM6DSO_TIMESTAMP_OFFSET_FILTER;
+
+		timestampStats.lastErrorNs = (int64_t)errorNs;
+	}
+
+	utcOffsetNs = utcOffset;
+	timestampStats.syncs++;
+	timestampStats.driftPpm = (nsPerTick / nominalNsPerTick - 1.0) * 1e6;
+
+	return 0;
+}
+
+/// <summary>
+///     Sets the FIFO time slot period from the fastest batch rate.
+/// </summary>
+void lsm6dsoTimestampSetBatchRate(float batchHz)
+{
+	slotPeriodTicks = (batchHz > 0.0f) ? (uint32_t)(1e9 / (double)batchHz / nominalNsPerTick + 0.5) : 0;
+	lsm6dsoTimestampResetFifo();
+}
+
+/// <summary>
+///     Forgets the FIFO time slot position.
+/// </summary>
+void lsm6dsoTimestampResetFifo(void)
+{
+	lastTagCount = 0;
+	slot = 0;
+	slotTicksKnown = false;
+}
+
+/// <summary>
+///     Sets word->timeNs to the time of the FIFO time slot the word was written in.
+/// </summary>
+void lsm6dsoTimestampFifoWord(fifo_word_t *word)
+{
+	// Words of the same time slot share tag_cnt, a 2 bit counter
+	slot += (uint8_t)(word->tagCount - lastTagCount) & 0x03;
+	lastTagCount = word->tagCount;
+
+	if (word->tag == LSM6DSO_TIMESTAMP_TAG) {
+		const uint8_t *raw = word->data.u8bit;
+		uint64_t ticks = Unwrap((uint32_t)raw[0] | ((uint32_t)raw[1] << 8) | ((uint32_t)raw[2] << 16) | ((uint32_t)raw[3] << 24));
+
+		// A whole number of tag_cnt cycles went missing if the slot count disagrees with the time,
+		// move the count on by the slots skipped
+		if (slotTicksKnown && (slotPeriodTicks > 0)) {
+			int64_t skewTicks = (int64_t)(ticks - (slotTicksBase + (slot - slotBase) * slotPeriodTicks));
+			int64_t skewSlots = (skewTicks + ((skewTicks >= 0) ? 1 : -1) * (int64_t)(slotPeriodTicks / 2)) /
+				(int64_t)slotPeriodTicks;
+			if (skewSlots != 0) {
+				slot += (uint64_t)skewSlots;
+				timestampStats.slotGaps++;
+			}
+		}
+
+		slotTicksBase = ticks;
+		slotBase = slot;
+		slotTicksKnown = true;
+	}
+
+	if (!synced || !slotTicksKnown) {
+		word->timeNs = 0;
+		return;
+	}
+
+	uint64_t ticks = slotTicksBase + (slot - slotBase) * slotPeriodTicks;
+	word->timeNs = (uint64_t)TicksToNs(ticks);
+}
+
+/// <summary>
+///     FIFO time slot period in nanoseconds.
+/// </summary>
+uint32_t lsm6dsoTimestampSlotPeriodNs(void)
+{
+	return (uint32_t)((double)slotPeriodTicks * nsPerTick);
+}
+
+/// <summary>
+///     Converts a CLOCK_MONOTONIC time to UTC.
+/// </summary>
+uint64_t lsm6dsoTimestampToUtcNs(uint64_t monotonicNs)
+{
+	return (uint64_t)((int64_t)monotonicNs + utcOffsetNs);
+}
+
+/// <summary>
+///     Returns the timestamp statistics.
+/// </summary>
+const lsm6dso_timestamp_stats_t *getLsm6dsoTimestampStats(void)
+{
+	return &timestampStats;
+}
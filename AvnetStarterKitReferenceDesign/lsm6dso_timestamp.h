@@ -0,0 +1,84 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+#include "lsm6dso_fifo.h"
+
+// Nominal timestamp counter period, INTERNAL_FREQ_FINE holds the trimmed value
+#define LSM6DSO_TIMESTAMP_TICK_NS 25000.0
+
+// Syncs where reading the counter took longer than this are too uncertain to use
+#define LSM6DSO_TIMESTAMP_MAX_SYNC_NS 2000000
+
+// The counter rate is measured over at least LSM6DSO_TIMESTAMP_RATE_MIN_SECONDS of syncs.  To
+// follow temperature drift it covers at most the last LSM6DSO_TIMESTAMP_RATE_WINDOW_SECONDS: a
+// new measurement starts halfway through each one and takes over when it ends, so after the
+// first half window the rate always spans at least LSM6DSO_TIMESTAMP_RATE_WINDOW_SECONDS / 2
+#define LSM6DSO_TIMESTAMP_RATE_MIN_SECONDS 10
+#define LSM6DSO_TIMESTAMP_RATE_WINDOW_SECONDS 600
+
+// Fraction of the measured offset applied at each sync, 1/n, so the mapping slews instead of stepping
+#define LSM6DSO_TIMESTAMP_OFFSET_FILTER 4
+
+typedef struct {
+	uint32_t syncs;
+	uint32_t rejectedSyncs;
+	int64_t lastErrorNs;
+	double driftPpm;
+	// FIFO timestamp words that showed the time slot count was off, tag_cnt only counts to 4
+	uint32_t slotGaps;
+} lsm6dso_timestamp_stats_t;
+
+/// <summary>
+///     Starts the LSM6DSO timestamp counter, batches it into the FIFO every decimation time slots
+///     and takes the first sync.  batchHz is the fastest FIFO batch rate, which sets the time
+///     slot period.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int initLsm6dsoTimestamp(lsm6dso_ctx_t *ctx, lsm6dso_odr_ts_batch_t decimation, float batchHz);
+
+/// <summary>
+///     Reads the counter and CLOCK_MONOTONIC together to correct the mapping between them.  Call
+///     periodically, at least every few hours so the 32 bit counter can be unwrapped.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int lsm6dsoTimestampSync(lsm6dso_ctx_t *ctx);
+
+/// <summary>
+///     Changes the time slot period after the batch rates changed, and forgets the FIFO time
+///     slot position.  The FIFO must have been flushed.
+/// </summary>
+void lsm6dsoTimestampSetBatchRate(float batchHz);
+
+/// <summary>
+///     Forgets the FIFO time slot position, call when the FIFO is flushed or has overrun.  Words
+///     get no time until the next timestamp word.
+/// </summary>
+void lsm6dsoTimestampResetFifo(void);
+
+/// <summary>
+///     Sets word->timeNs to the CLOCK_MONOTONIC time of the FIFO time slot the word was written in,
+///     or 0 if not known yet.  Must be called on every word in FIFO order, before decompression.
+///     Each timestamp word re-anchors the slot count, which catches gaps of four or more slots
+///     the 2 bit tag_cnt can't show.
+/// </summary>
+void lsm6dsoTimestampFifoWord(fifo_word_t *word);
+
+/// <summary>
+///     FIFO time slot period in nanoseconds.
+/// </summary>
+uint32_t lsm6dsoTimestampSlotPeriodNs(void);
+
+/// <summary>
+///     Converts a CLOCK_MONOTONIC time to UTC, nanoseconds since the epoch.
+/// </summary>
+uint64_t lsm6dsoTimestampToUtcNs(uint64_t monotonicNs);
+
+/// <summary>
+///     Returns the timestamp statistics.
+/// </summary>
+const lsm6dso_timestamp_stats_t *getLsm6dsoTimestampStats(void);
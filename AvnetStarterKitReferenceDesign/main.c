@@ -52,6 +52,7 @@
 #include "applibs_versions.h"
 #include "epoll_timerfd_utilities.h"
 #include "i2c.h"
+#include "i2c_stats.h"
 #include "hw/avnet_mt3620_sk.h"
 
 #include "deviceTwin.h"
@@ -150,6 +151,43 @@ static int DirectMethodCall (const char *methodName, const char *payload, size_t
 
 	int result = 404; // HTTP status code.
 
+#ifdef ENABLE_LSM6DSO_FSM
+	// Check to see if the loadFsmProgram direct method was called.  Program images don't fit in the
+	// 32 byte payloads the other methods take, the payload is {"image": "<hexadecimal image>"}.
+	// The response says how many programs were loaded, or why the image was rejected.
+	if (strcmp(methodName, "loadFsmProgram") == 0) {
+
+		Log_Debug("loadFsmProgram() Direct Method called\n");
+
+		// Copy the payload to the heap then null terminate it, it can be a couple of kilobytes
+		char *fsmCallContent = malloc(payloadSize + 1);
+		if (fsmCallContent == NULL) {
+			Log_Debug("ERROR: Could not allocate buffer for direct method request payload.\n");
+			abort();
+		}
+		memcpy(fsmCallContent, payload, payloadSize);
+		fsmCallContent[payloadSize] = 0; // Null terminated string.
+
+		JSON_Value *payloadJson = json_parse_string(fsmCallContent);
+		free(fsmCallContent);
+		const char *image = json_object_get_string(json_value_get_object(payloadJson), "image");
+		if (image == NULL) {
+			json_value_free(payloadJson);
+			goto payloadError;
+		}
+
+		*responsePayload = malloc(LSM6DSO_FSM_RESPONSE_JSON_SIZE);
+		if (*responsePayload == NULL) {
+			Log_Debug("ERROR: Could not allocate buffer for direct method response payload.\n");
+			abort();
+		}
+		result = (loadFsmProgram(image, *responsePayload, LSM6DSO_FSM_RESPONSE_JSON_SIZE) == 0) ? 200 : 400;
+		*responsePayloadSize = strlen(*responsePayload);
+		json_value_free(payloadJson);
+		return result;
+	}
+#endif
+
 	if (payloadSize < 32) {
 
 		// Declare a char buffer on the stack where we'll operate on a copy of the payload.  
@@ -245,6 +283,46 @@ static int DirectMethodCall (const char *methodName, const char *payload, size_t
 				return result;
 			}
 		}
+		// Check to see if the calibrateAccelerometer direct method was called.  The board must be lying still
+		// on one of its faces.  This direct method does not require any payload, other than a valid Json
+		// argument such as {}.  The response holds the offsets written to the device and the residuals.
+		else if (strcmp(methodName, "calibrateAccelerometer") == 0) {
+
+			Log_Debug("calibrateAccelerometer() Direct Method called\n");
+
+			*responsePayload = malloc(ACCEL_CALIBRATION_JSON_SIZE);
+			if (*responsePayload == NULL) {
+				Log_Debug("ERROR: Could not allocate buffer for direct method response payload.\n");
+				abort();
+			}
+			result = (calibrateAccelerometer(*responsePayload, ACCEL_CALIBRATION_JSON_SIZE) == 0) ? 200 : 500;
+			*responsePayloadSize = strlen(*responsePayload);
+			return result;
+		}
+#ifdef ENABLE_I2C_STATS
+		// Check to see if the getI2cStats direct method was called.  This direct method does not
+		// require any payload, other than a valid Json argument such as {}.
+		else if (strcmp(methodName, "getI2cStats") == 0) {
+
+			Log_Debug("getI2cStats() Direct Method called\n");
+			result = 200;
+
+			*responsePayload = malloc(I2C_STATS_JSON_SIZE);
+			if (*responsePayload == NULL) {
+				Log_Debug("ERROR: Could not allocate buffer for direct method response payload.\n");
+				abort();
+			}
+			if (i2cStatsToJson(*responsePayload, I2C_STATS_JSON_SIZE) < 0) {
+				Log_Debug("ERROR: I2C statistics don't fit in the direct method response.\n");
+				free(*responsePayload);
+				*responsePayload = NULL;
+				return 500;
+			}
+			*responsePayloadSize = strlen(*responsePayload);
+			i2cStatsLog();
+			return result;
+		}
+#endif
 		else {
 			result = 404;
 			Log_Debug("INFO: Direct Method called \"%s\" not found.\n", methodName);
@@ -0,0 +1,439 @@
+/*
+ *  The sensor hub sequencing in this file is based on the ST Micro LSM6DSO sensor hub examples.
+ *
+ *  A sensor hub transaction configures slave 0 on the LSM6DSO I2C master, then uses the
+ *  accelerometer data-ready as the trigger and waits for SENS_HUB_ENDOP.  The accelerometer is
+ *  always running at the application's rate, so the transaction never touches CTRL1_XL and the
+ *  accelerometer samples, batched or polled, carry on undisturbed.  The waiting is done
+ *  either by sleeping (sensorHubReadSync/sensorHubWriteSync, only used during initialization)
+ *  or from a one-shot timerfd in the epoll loop (sensorHubReadAsync/sensorHubWriteAsync), so the
+ *  buttons and Azure IoT processing keep running while a transaction is in flight.
+ *
+ *  Alternatively startSensorHubContinuous() configures slave 0 once and leaves the I2C master
+ *  running, with every slave 0 read batched into the LSM6DSO FIFO next to the accelerometer and
+ *  gyroscope data.  No further sensor hub traffic is needed after that.
+ */
+
+#include <errno.h>
+#include <signal.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+// applibs_versions.h defines the API struct versions to use for applibs APIs.
+#include "applibs_versions.h"
+
+#include <applibs/log.h>
+
+#include "epoll_timerfd_utilities.h"
+#include "build_options.h"
+#include "i2c.h"
+#include "lps22hh_reg.h"
+#include "sensor_hub.h"
+
+typedef enum {
+	SENSOR_HUB_IDLE = 0,
+	SENSOR_HUB_WAIT_ENDOP,
+	SENSOR_HUB_CONTINUOUS
+} sensor_hub_state_t;
+
+static lsm6dso_ctx_t *shCtx = NULL;
+static int sensorHubTimerFd = -1;
+static sensor_hub_state_t shState = SENSOR_HUB_IDLE;
+static bool shIsRead;
+static uint16_t shLen;
+static struct timespec shStart;
+static SensorHubCompletionHandler shHandler = NULL;
+static lsm6dso_emb_sh_read_t shData;
+static sensor_hub_stats_t shStats;
+
+extern volatile sig_atomic_t terminationRequired;
+
+/// <summary>
+///     Returns the nanoseconds elapsed since start
+/// </summary>
+static uint64_t NsSince(const struct timespec *start)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+	return (uint64_t)(now.tv_sec - start->tv_sec) * 1000000000ULL + (uint64_t)now.tv_nsec - (uint64_t)start->tv_nsec;
+}
+
+/// <summary>
+///     Configure slave 0 for the transaction and start the I2C master, the next accelerometer
+///     data-ready triggers it.
+/// </summary>
+static int32_t StartTransaction(bool isRead, uint8_t reg, uint8_t data, uint16_t len)
+{
+	int32_t ret;
+	lsm6dso_status_master_t master_status;
+
+	shIsRead = isRead;
+	shLen = len;
+	clock_gettime(CLOCK_MONOTONIC, &shStart);
+
+	if (isRead) {
+		lsm6dso_sh_cfg_read_t sh_cfg_read;
+
+		/* Configure Sensor Hub to read LPS22HH. */
+		sh_cfg_read.slv_add = (LPS22HH_I2C_ADD_L & 0xFEU) >> 1; /* 7bit I2C address */
+		sh_cfg_read.slv_subadd = reg;
+		sh_cfg_read.slv_len = (uint8_t)len;
+		ret = lsm6dso_sh_slv0_cfg_read(shCtx, &sh_cfg_read);
+
+		// Using slave 0 only
+		if (ret == 0) {
+			ret = lsm6dso_sh_slave_connected_set(shCtx, LSM6DSO_SLV_0);
+		}
+	}
+	else {
+		lsm6dso_sh_cfg_write_t sh_cfg_write;
+
+		// Configure Sensor Hub to write to the LPS22HH, and send the write data
+		sh_cfg_write.slv0_add = (LPS22HH_I2C_ADD_L & 0xFEU) >> 1; // 7bit I2C address
+		sh_cfg_write.slv0_subadd = reg;
+		sh_cfg_write.slv0_data = data;
+		ret = lsm6dso_sh_cfg_write(shCtx, &sh_cfg_write);
+	}
+
+	// Reading STATUS_MASTER clears an end of operation left over from the previous transaction
+	if (ret == 0) {
+		ret = lsm6dso_read_reg(shCtx, LSM6DSO_STATUS_MASTER_MAINPAGE, (uint8_t *)&master_status, 1);
+	}
+
+	/* Enable I2C Master, the running accelerometer triggers the operation. */
+	if (ret == 0) {
+		ret = lsm6dso_sh_master_set(shCtx, PROPERTY_ENABLE);
+	}
+
+	shState = SENSOR_HUB_WAIT_ENDOP;
+	return ret;
+}
+
+/// <summary>
+///     Check on the transaction in flight.
+/// </summary>
+/// <returns>1 when the transaction has completed, 0 if it is still pending, or -1 on failure</returns>
+static int PollTransaction(void)
+{
+	lsm6dso_status_master_t master_status;
+
+	// STATUS_MASTER is mirrored on the main page, which saves two bank switches per check
+	if (lsm6dso_read_reg(shCtx, LSM6DSO_STATUS_MASTER_MAINPAGE, (uint8_t *)&master_status, 1) != 0) {
+		return -1;
+	}
+	if (master_status.sens_hub_endop) {
+		return 1;
+	}
+
+	if (NsSince(&shStart) >= SENSOR_HUB_TIMEOUT_NANO_SECONDS) {
+		Log_Debug("ERROR: Sensor hub transaction timed out\n");
+		return -1;
+	}
+
+	return 0;
+}
+
+/// <summary>
+///     Stop the I2C master and collect the data for reads.
+/// </summary>
+static int32_t FinishTransaction(void)
+{
+	/* Disable I2C master. */
+	int32_t ret = lsm6dso_sh_master_set(shCtx, PROPERTY_DISABLE);
+
+	if (shIsRead && (ret == 0)) {
+		// Read the data from the device
+		ret = lsm6dso_sh_read_data_raw_get(shCtx, &shData, (uint8_t)shLen);
+	}
+
+	shState = SENSOR_HUB_IDLE;
+	return ret;
+}
+
+/// <summary>
+///     Run a complete transaction, sleeping between status checks.
+/// </summary>
+static int32_t RunTransactionSync(bool isRead, uint8_t reg, uint8_t data, uint16_t len)
+{
+	struct timespec start;
+	struct timespec pollPeriod = { .tv_sec = 0,.tv_nsec = SENSOR_HUB_SYNC_POLL_PERIOD_NANO_SECONDS };
+	int result;
+
+	if (shState != SENSOR_HUB_IDLE) {
+		Log_Debug("ERROR: Sensor hub busy\n");
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	int32_t ret = StartTransaction(isRead, reg, data, len);
+	do {
+		nanosleep(&pollPeriod, NULL);
+		result = PollTransaction();
+	} while (result == 0);
+
+	if (FinishTransaction() != 0 || result < 0) {
+		ret = -1;
+		shStats.failedTransactions++;
+	}
+
+	uint64_t blockedNs = NsSince(&start);
+	shStats.syncTransactions++;
+	shStats.syncBlockedNs += blockedNs;
+	if (blockedNs > shStats.maxSyncBlockedNs) {
+		shStats.maxSyncBlockedNs = blockedNs;
+	}
+
+	return ret;
+}
+
+/// <summary>
+///     Account for the time one step of an asynchronous transaction held the epoll loop.
+/// </summary>
+static void AddAsyncBlockedTime(const struct timespec *start)
+{
+	uint64_t blockedNs = NsSince(start);
+	shStats.asyncBlockedNs += blockedNs;
+	if (blockedNs > shStats.maxAsyncBlockedNs) {
+		shStats.maxAsyncBlockedNs = blockedNs;
+	}
+}
+
+/// <summary>
+///     Arm the one-shot timer for the next status check.
+/// </summary>
+static int ArmSensorHubTimer(void)
+{
+	struct timespec pollPeriod = { .tv_sec = 0,.tv_nsec = SENSOR_HUB_POLL_PERIOD_NANO_SECONDS };
+	return SetTimerFdToSingleExpiry(sensorHubTimerFd, &pollPeriod);
+}
+
+/// <summary>
+///     Handle the sensor hub timer event: advance the transaction in flight.
+/// </summary>
+static void SensorHubTimerEventHandler(EventData *eventData)
+{
+	(void)eventData;
+
+	struct timespec start;
+
+	if (ConsumeTimerFdEvent(sensorHubTimerFd) != 0) {
+		terminationRequired = true;
+		return;
+	}
+
+	if (shState != SENSOR_HUB_WAIT_ENDOP) {
+		return;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	int result = PollTransaction();
+	if (result == 0) {
+		ArmSensorHubTimer();
+		AddAsyncBlockedTime(&start);
+		return;
+	}
+
+	int32_t status = FinishTransaction();
+	if (result < 0) {
+		status = -1;
+	}
+	if (status != 0) {
+		shStats.failedTransactions++;
+	}
+	AddAsyncBlockedTime(&start);
+
+	// The handler may start the next transaction, so clear our copy first
+	SensorHubCompletionHandler handler = shHandler;
+	shHandler = NULL;
+	if (handler != NULL) {
+		handler(status, (const uint8_t *)&shData, shLen);
+	}
+}
+
+// event handler data structures. Only the event handler field needs to be populated.
+static EventData sensorHubEventData = { .eventHandler = &SensorHubTimerEventHandler };
+
+/// <summary>
+///     Start an asynchronous transaction and arm the timer.
+/// </summary>
+static int RunTransactionAsync(bool isRead, uint8_t reg, uint8_t data, uint16_t len, SensorHubCompletionHandler handler)
+{
+	struct timespec start;
+
+	if (shState != SENSOR_HUB_IDLE || sensorHubTimerFd < 0) {
+		return -1;
+	}
+
+	clock_gettime(CLOCK_MONOTONIC, &start);
+
+	shHandler = handler;
+	shStats.asyncTransactions++;
+
+	if (StartTransaction(isRead, reg, data, len) != 0 || ArmSensorHubTimer() != 0) {
+		FinishTransaction();
+		shHandler = NULL;
+		shStats.failedTransactions++;
+		AddAsyncBlockedTime(&start);
+		return -1;
+	}
+
+	AddAsyncBlockedTime(&start);
+	return 0;
+}
+
+/// <summary>
+///     Creates the one-shot timer that drives asynchronous sensor hub transactions.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int initSensorHub(lsm6dso_ctx_t *ctx, int epollFd)
+{
+	shCtx = ctx;
+	shState = SENSOR_HUB_IDLE;
+	memset(&shStats, 0, sizeof(shStats));
+
+	// A zero period leaves the timer disarmed until a transaction is started
+	struct timespec disarmed = { .tv_sec = 0,.tv_nsec = 0 };
+	sensorHubTimerFd = CreateTimerFdAndAddToEpoll(epollFd, &disarmed, &sensorHubEventData, EPOLLIN);
+	if (sensorHubTimerFd < 0) {
+		return -1;
+	}
+
+	return 0;
+}
+
+/// <summary>
+///     Closes the sensor hub timer.
+/// </summary>
+void closeSensorHub(void)
+{
+	CloseFdAndPrintError(sensorHubTimerFd, "sensorHubTimer");
+	sensorHubTimerFd = -1;
+}
+
+/*
+ * @brief  Read LPS22HH device register through the sensor hub (used by configuration functions)
+ *
+ * @param  handle    customizable argument, not used.
+ * @param  reg       register to read
+ * @param  data      pointer to buffer that store the data read
+ * @param  len       number of consecutive register to read
+ *
+ */
+int32_t sensorHubReadSync(void *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	(void)handle;
+
+	if (len > SENSOR_HUB_MAX_READ_LEN) {
+		return -1;
+	}
+
+	int32_t ret = RunTransactionSync(true, reg, 0, len);
+	memcpy(data, &shData, len);
+	return ret;
+}
+
+/*
+ * @brief  Write LPS22HH device register through the sensor hub (used by configuration functions)
+ *
+ * @param  handle    customizable argument, not used.
+ * @param  reg       register to write
+ * @param  data      pointer to data to write in register reg
+ * @param  len       number of consecutive register to write, only the first byte is written
+ *
+ */
+int32_t sensorHubWriteSync(void *handle, uint8_t reg, uint8_t *data, uint16_t len)
+{
+	(void)handle;
+
+	return RunTransactionSync(false, reg, *data, len);
+}
+
+/// <summary>
+///     Starts a non-blocking slave 0 register read.
+/// </summary>
+/// <returns>0 if the transaction was started, or -1 on failure or if a transaction is in flight</returns>
+int sensorHubReadAsync(uint8_t reg, uint16_t len, SensorHubCompletionHandler handler)
+{
+	if (len > SENSOR_HUB_MAX_READ_LEN) {
+		return -1;
+	}
+
+	return RunTransactionAsync(true, reg, 0, len, handler);
+}
+
+/// <summary>
+///     Starts a non-blocking slave 0 single register write.
+/// </summary>
+/// <returns>0 if the transaction was started, or -1 on failure or if a transaction is in flight</returns>
+int sensorHubWriteAsync(uint8_t reg, uint8_t data, SensorHubCompletionHandler handler)
+{
+	return RunTransactionAsync(false, reg, data, 1, handler);
+}
+
+/// <summary>
+///     Configures slave 0 to read the same registers continuously at the requested rate and
+///     batches the results into the FIFO.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int startSensorHubContinuous(uint8_t reg, uint16_t len, lsm6dso_shub_odr_t odr)
+{
+	lsm6dso_sh_cfg_read_t sh_cfg_read;
+	int32_t ret;
+
+	if (shState != SENSOR_HUB_IDLE || len > SENSOR_HUB_MAX_READ_LEN) {
+		return -1;
+	}
+
+	/* Configure Sensor Hub to read LPS22HH. */
+	sh_cfg_read.slv_add = (LPS22HH_I2C_ADD_L & 0xFEU) >> 1; /* 7bit I2C address */
+	sh_cfg_read.slv_subadd = reg;
+	sh_cfg_read.slv_len = (uint8_t)len;
+	ret = lsm6dso_sh_slv0_cfg_read(shCtx, &sh_cfg_read);
+
+	// Using slave 0 only
+	if (ret == 0) {
+		ret = lsm6dso_sh_slave_connected_set(shCtx, LSM6DSO_SLV_0);
+	}
+	if (ret == 0) {
+		ret = lsm6dso_sh_data_rate_set(shCtx, odr);
+	}
+
+	// Every slave 0 read lands in the FIFO tagged LSM6DSO_SENSORHUB_SLAVE0_TAG
+	if (ret == 0) {
+		ret = lsm6dso_sh_batch_slave_0_set(shCtx, PROPERTY_ENABLE);
+	}
+
+	/* Enable I2C Master, the accelerometer data-ready keeps triggering it from now on. */
+	if (ret == 0) {
+		ret = lsm6dso_sh_master_set(shCtx, PROPERTY_ENABLE);
+	}
+
+	if (ret != 0) {
+		Log_Debug("ERROR: Could not start continuous sensor hub reads\n");
+		return -1;
+	}
+
+	shState = SENSOR_HUB_CONTINUOUS;
+	return 0;
+}
+
+/// <summary>
+///     Returns true while an asynchronous transaction is in flight, or while continuous
+///     reads are running.
+/// </summary>
+bool sensorHubBusy(void)
+{
+	return shState != SENSOR_HUB_IDLE;
+}
+
+/// <summary>
+///     Returns the sensor hub blocking-time statistics.
+/// </summary>
+const sensor_hub_stats_t *getSensorHubStats(void)
+{
+	return &shStats;
+}
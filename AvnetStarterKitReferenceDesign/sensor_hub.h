@@ -0,0 +1,87 @@
+/* Copyright (c) Microsoft Corporation. All rights reserved.
+   Licensed under the MIT License. */
+
+#pragma once
+
+#include <stdbool.h>
+#include <stdint.h>
+#include "lsm6dso_reg.h"
+
+// Slave 0 can read at most 7 consecutive registers in one sensor hub transaction
+#define SENSOR_HUB_MAX_READ_LEN 7
+
+// How often the sensor hub status is checked while an asynchronous transaction is in flight
+#define SENSOR_HUB_POLL_PERIOD_NANO_SECONDS 20000000
+
+// How often sensorHubReadSync and sensorHubWriteSync check the status while they sleep
+#define SENSOR_HUB_SYNC_POLL_PERIOD_NANO_SECONDS 1000000
+
+// Time from the start of a transaction after which it is abandoned
+#define SENSOR_HUB_TIMEOUT_NANO_SECONDS 1000000000ULL
+
+typedef struct {
+	uint32_t syncTransactions;
+	uint32_t asyncTransactions;
+	uint32_t failedTransactions;
+	// Time the epoll loop was blocked by sensor hub transactions
+	uint64_t syncBlockedNs;
+	uint64_t asyncBlockedNs;
+	uint64_t maxSyncBlockedNs;
+	uint64_t maxAsyncBlockedNs;
+} sensor_hub_stats_t;
+
+/// <summary>
+///     Function signature for the handler called when an asynchronous sensor hub
+///     transaction completes.  status is 0 on success, data is only valid for reads.
+/// </summary>
+typedef void (*SensorHubCompletionHandler)(int32_t status, const uint8_t *data, uint16_t len);
+
+/// <summary>
+///     Creates the one-shot timer that drives asynchronous sensor hub transactions.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int initSensorHub(lsm6dso_ctx_t *ctx, int epollFd);
+
+/// <summary>
+///     Closes the sensor hub timer.
+/// </summary>
+void closeSensorHub(void);
+
+/// <summary>
+///     Blocking slave 0 register read/write, used through the lps22hh_ctx_t read_reg and
+///     write_reg hooks during initialization.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int32_t sensorHubReadSync(void *handle, uint8_t reg, uint8_t *data, uint16_t len);
+int32_t sensorHubWriteSync(void *handle, uint8_t reg, uint8_t *data, uint16_t len);
+
+/// <summary>
+///     Starts a non-blocking slave 0 register read.  The handler is called from the epoll
+///     loop when the data is available.
+/// </summary>
+/// <returns>0 if the transaction was started, or -1 on failure or if a transaction is in flight</returns>
+int sensorHubReadAsync(uint8_t reg, uint16_t len, SensorHubCompletionHandler handler);
+
+/// <summary>
+///     Starts a non-blocking slave 0 single register write.
+/// </summary>
+/// <returns>0 if the transaction was started, or -1 on failure or if a transaction is in flight</returns>
+int sensorHubWriteAsync(uint8_t reg, uint8_t data, SensorHubCompletionHandler handler);
+
+/// <summary>
+///     Configures slave 0 to read the same registers continuously at the requested rate and
+///     batches the results into the FIFO.  Single transactions are refused from then on.
+/// </summary>
+/// <returns>0 on success, or -1 on failure</returns>
+int startSensorHubContinuous(uint8_t reg, uint16_t len, lsm6dso_shub_odr_t odr);
+
+/// <summary>
+///     Returns true while an asynchronous transaction is in flight, or while continuous
+///     reads are running.
+/// </summary>
+bool sensorHubBusy(void);
+
+/// <summary>
+///     Returns the sensor hub blocking-time statistics.
+/// </summary>
+const sensor_hub_stats_t *getSensorHubStats(void);